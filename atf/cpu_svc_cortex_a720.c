@@ -15,144 +15,151 @@
 #include <common/runtime_svc.h>
 #include <smccc_helpers.h>
 
-#define CPU_SVC_GET_L1I_CACHELINE	0x81000001
-#define CPU_SVC_GET_L1D_CACHELINE	0x81000002
-#define CPU_SVC_GET_L2U_CACHELINE	0x81000003
-#define CPU_SVC_GET_L3U_CACHELINE	0x81000004
+#include "cpu_svc_ramindex.h"
 
-static u_register_t cortex_a720_get_l1i_cacheline(void *handle, u_register_t set, u_register_t way)
-{
-	uint64_t selector;
-	uint64_t r0, r1;
-	int i;
-
-	/*
-	* RAMINDEX bit assignments
-	* When AArch64-RAMINDEX.ID == 0x00 and 32KiB of L1 I$
-	*
-	* [63:32] Reserved
-	* [31:24] RAMID		ID of the selected memory (L1 I$ Tag)
-	* [23:20] Reserved
-	* [19:18] Way
-	* [17:13] Reserved
-	* [12:6] Set		Virtual Address bits [12:6]
-	* [5:0] Reserved
-	*/
-	selector = 0x0000000000000000ULL; /* this selects l1 instruction cache tag (ramid = 0x00) */
-	selector |= (way & 0x3) << 18;
-	selector |= (set & 0x7f) << 6;
+/*
+ * RAMINDEX bit assignments
+ * When AArch64-RAMINDEX.ID == 0x00 (Tag) or 0x01 (Data) and 32KiB of L1 I$
+ *
+ * [63:32] Reserved
+ * [31:24] RAMID	ID of the selected memory
+ * [23:20] Reserved
+ * [19:18] Way
+ * [17] Reserved
+ * [16:14] VA[5:3]	Virtual Address bits[5:3] (Data only)
+ * [13] Reserved
+ * [12:6] Set		Virtual Address bits [12:6]
+ * [5:0] Reserved
+ */
+static const struct cpu_svc_ram cortex_a720_l1i = {
+	.tag_ramid = 0x00, .data_ramid = 0x01,
+	.way_shift = 18, .way_mask = 0x3, .set_mask = 0x7f,
+	.nbeats = 8, .beat_shift = 14, .iside = true, .shared = false,
+};
 
-	asm volatile("sys #6, c15, c0, #0, %0" : : "r" (selector));
-	asm volatile("dsb sy");
-	asm volatile("isb");
-	asm volatile("mrs %0, s3_6_c15_c0_0" : "=r" (r0));
+/*
+ * RAMINDEX bit assignments
+ * When AArch64-RAMINDEX.ID == 0x08 (Tag) or 0x09 (Data) and 32KiB of L1 D$
+ *
+ * [63:32] Reserved
+ * [31:24] RAMID	ID of the selected memory
+ * [23:20] Reserved
+ * [19:18] Way
+ * [17:16] BANK		0b00 Tag RAM 0, 0b01 Tag RAM 1, 0b10 Tag RAM 2 (Tag)
+ *         VA[5:4]	Virtual Address bits[5:4] (Data)
+ * [15:13] Reserved
+ * [12:6] Set		Virtual Address bits [12:6]
+ * [5:0] Reserved
+ */
+static const struct cpu_svc_ram cortex_a720_l1d = {
+	.tag_ramid = 0x08, .data_ramid = 0x09,
+	.way_shift = 18, .way_mask = 0x3, .set_mask = 0x7f,
+	.nbeats = 4, .beat_shift = 16, .iside = false, .shared = false,
+};
 
-	write_ctx_reg((get_gpregs_ctx(handle)), (CTX_GPREG_X1), r0);
+/*
+ * RAMINDEX bit assignments
+ * When AArch64-RAMINDEX.ID == 0x10 (Tag) or 0x11 (Data) and 8-way L2 (up to 512KiB)
+ *
+ * [63:32] Reserved
+ * [31:24] RAMID	ID of the selected memory
+ * [23:22] Reserved
+ * [21:19] Way
+ * [18:17] Reserved
+ * [16:6] Set		Physical Address bits [16:6]
+ * [5:4] PA[5:4]	Physical Address bits [5:4] (Data only)
+ * [3:0] Reserved
+ */
+static const struct cpu_svc_ram cortex_a720_l2u = {
+	.tag_ramid = 0x10, .data_ramid = 0x11,
+	.way_shift = 19, .way_mask = 0x7, .set_mask = 0x7ff,
+	.nbeats = 4, .beat_shift = 4, .iside = false, .shared = false,
+};
 
-	/*
-	* RAMINDEX bit assignments
-	* When AArch64-RAMINDEX.ID == 0x01 and 32KiB of L1 I$
-	*
-	* [63:32] Reserved
-	* [31:24] RAMID		ID of the selected memory (L1 I$ Data)
-	* [23:20] Reserved
-	* [19:18] Way
-	* [17] Reserved
-	* [16:14] VA[5:3]	Virtual Address bits[5:3]
-	* [13] Reserved
-	* [12:6] Set		Virtual Address bits [12:6]
-	* [5:0] Reserved
-	*/
-	for (i = 0; i < 8; i++) {
-		selector = 0x0000000001000000ULL; /* this selects l1 instruction cache data (ramid = 0x01) */
-		selector |= (way & 0x3) << 18;
-		selector |= (set & 0x7f) << 6;
-		selector |= (i & 0x7) << 14; /* this selects bytes [0+i*8:7+i*8] from cacheline */
-		asm volatile("sys #6, c15, c0, #0, %0" : : "r" (selector));
-		asm volatile("dsb sy");
-		asm volatile("isb");
-		asm volatile("mrs %0, s3_6_c15_c0_0" : "=r" (r0));
-		asm volatile("mrs %0, s3_6_c15_c0_1" : "=r" (r1));
-
-		write_ctx_reg((get_gpregs_ctx(handle)), (CTX_GPREG_X2 + i * sizeof(u_register_t)),
-			(r1 & 0xffffffff) << 32 | (r0 & 0xffffffff));
-	}
+/*
+ * RAMINDEX bit assignments
+ * When AArch64-RAMINDEX.ID == 0x18 (Tag) or 0x19 (Data) and 16-way DSU L3
+ *
+ * [63:32] Reserved
+ * [31:24] RAMID	ID of the selected memory
+ * [23:20] Way
+ * [19:6] Set		Physical Address bits [19:6]
+ * [5:4] PA[5:4]	Physical Address bits [5:4] (Data only)
+ * [3:0] Reserved
+ */
+static const struct cpu_svc_ram cortex_a720_l3u = {
+	.tag_ramid = 0x18, .data_ramid = 0x19,
+	.way_shift = 20, .way_mask = 0xf, .set_mask = 0x3fff,
+	.nbeats = 4, .beat_shift = 4, .iside = false, .shared = true,
+};
 
-	return SMC_OK;
+static u_register_t cortex_a720_get_l1i_cacheline(void *handle, u_register_t set, u_register_t way, u_register_t flags)
+{
+	return cpu_svc_get_cacheline(&cortex_a720_l1i, handle, set, way, flags);
 }
 
-static u_register_t cortex_a720_get_l1d_cacheline(void *handle, u_register_t set, u_register_t way)
+static u_register_t cortex_a720_get_l1d_cacheline(void *handle, u_register_t set, u_register_t way, u_register_t flags)
 {
-	uint64_t selector;
-	uint64_t r0, r1;
-	int i;
+	return cpu_svc_get_cacheline(&cortex_a720_l1d, handle, set, way, flags);
+}
 
-	/*
-	* RAMINDEX bit assignments
-	* When AArch64-RAMINDEX.ID == 0x08 and 32KiB of L1 D$
-	*
-	* [63:32] Reserved
-	* [31:24] RAMID		ID of the selected memory (L1 D$ Tag)
-	* [23:20] Reserved
-	* [19:18] Way
-	* [17:16] BANK		0b00 Tag RAM 0, 0b01 Tag RAM 1, 0b10 Tag RAM 2
-	* [15:13] Reserved
-	* [12:6] Set		Virtual Address bits [12:6]
-	* [5:0] Reserved
-	*/
-	selector = 0x0000000008000000ULL; /* this selects l1 data cache tag (ramid = 0x08) */
-	selector |= (way & 0x3) << 18;
-	selector |= (set & 0x7f) << 6;
+static u_register_t cortex_a720_get_l2u_cacheline(void *handle, u_register_t set, u_register_t way, u_register_t flags)
+{
+	return cpu_svc_get_cacheline(&cortex_a720_l2u, handle, set, way, flags);
+}
 
-	asm volatile("sys #6, c15, c0, #0, %0" : : "r" (selector));
-	asm volatile("dsb sy");
-	asm volatile("isb");
-	asm volatile("mrs %0, s3_6_c15_c1_0" : "=r" (r0));
+static u_register_t cortex_a720_get_l3u_cacheline(void *handle, u_register_t set, u_register_t way, u_register_t flags)
+{
+	return cpu_svc_get_cacheline(&cortex_a720_l3u, handle, set, way, flags);
+}
 
-	write_ctx_reg((get_gpregs_ctx(handle)), (CTX_GPREG_X1), r0);
+static u_register_t cortex_a720_get_tlb_entry(void *handle, u_register_t tlb, u_register_t set, u_register_t way)
+{
+	uint64_t selector;
+	uint64_t r0, r1, r2;
 
 	/*
 	* RAMINDEX bit assignments
-	* When AArch64-RAMINDEX.ID == 0x09 and 32KiB of L1 D$
+	* When AArch64-RAMINDEX.ID == 0x20 (L1 I-TLB, 48 entries, fully associative)
+	*   or AArch64-RAMINDEX.ID == 0x21 (L1 D-TLB, 48 entries, fully associative)
+	*   or AArch64-RAMINDEX.ID == 0x22 (L2 TLB, 1536 entries, 6-way)
 	*
 	* [63:32] Reserved
-	* [31:24] RAMID		ID of the selected memory (L1 D$ Data)
-	* [23:20] Reserved
-	* [19:18] Way
-	* [17:16] VA[5:4]	Virtual Address bits[5:4]
-	* [15:13] Reserved
-	* [12:6] Set		Virtual Address bits [12:6]
-	* [5:0] Reserved
+	* [31:24] RAMID		ID of the selected memory
+	* [23:21] Reserved
+	* [20:18] Way		(L2 TLB only)
+	* [17:8] Reserved
+	* [7:0] Entry/Set
 	*/
-
-	for (i = 0; i < 4; i++) {
-		selector = 0x0000000009000000ULL; /* this selects l1 data cache data (ramid = 0x09) */
-		selector |= (way & 0x3) << 18;
-		selector |= (set & 0x7f) << 6;
-		selector |= (i & 0x3) << 16; /* this selects bytes [0+i*16:15+i*16] from cacheline */
-		asm volatile("sys #6, c15, c0, #0, %0" : : "r" (selector));
-		asm volatile("dsb sy");
-		asm volatile("isb");
-		asm volatile("mrs %0, s3_6_c15_c1_0" : "=r" (r0));
-		asm volatile("mrs %0, s3_6_c15_c1_1" : "=r" (r1));
-
-		write_ctx_reg((get_gpregs_ctx(handle)), (CTX_GPREG_X2 + (i * 2 + 0) * sizeof(u_register_t)), r0);
-		write_ctx_reg((get_gpregs_ctx(handle)), (CTX_GPREG_X2 + (i * 2 + 1) * sizeof(u_register_t)), r1);
+	switch (tlb) {
+	case CPU_SVC_TLB_L1I:
+		selector = 0x0000000020000000ULL; /* this selects l1 instruction tlb (ramid = 0x20) */
+		selector |= (set & 0x3f) << 0;
+		break;
+	case CPU_SVC_TLB_L1D:
+		selector = 0x0000000021000000ULL; /* this selects l1 data tlb (ramid = 0x21) */
+		selector |= (set & 0x3f) << 0;
+		break;
+	case CPU_SVC_TLB_L2:
+		selector = 0x0000000022000000ULL; /* this selects l2 tlb (ramid = 0x22) */
+		selector |= (way & 0x7) << 18;
+		selector |= (set & 0xff) << 0;
+		break;
+	default:
+		return SMC_UNK;
 	}
 
-	return SMC_OK;
-}
+	cpu_svc_ramindex(selector, 0, false);
+	asm volatile("mrs %0, s3_6_c15_c2_0" : "=r" (r0));
+	asm volatile("mrs %0, s3_6_c15_c2_1" : "=r" (r1));
+	asm volatile("mrs %0, s3_6_c15_c2_2" : "=r" (r2));
 
-static u_register_t cortex_a720_get_l2u_cacheline(void *handle, u_register_t set, u_register_t way)
-{
-	/* To be implemented yet */
-	return SMC_UNK;
-}
+	/* IMP_TLB_DATA0_EL3 to IMP_TLB_DATA2_EL3 are returned in x1 till x3 */
+	write_ctx_reg((get_gpregs_ctx(handle)), (CTX_GPREG_X1), r0);
+	write_ctx_reg((get_gpregs_ctx(handle)), (CTX_GPREG_X2), r1);
+	write_ctx_reg((get_gpregs_ctx(handle)), (CTX_GPREG_X3), r2);
 
-static u_register_t cortex_a720_get_l3u_cacheline(void *handle, u_register_t set, u_register_t way)
-{
-	/* To be implemented yet */
-	return SMC_UNK;
+	return SMC_OK;
 }
 
 uintptr_t cortex_a720_smc_handler(uint32_t smc_fid,
@@ -168,19 +175,23 @@ uintptr_t cortex_a720_smc_handler(uint32_t smc_fid,
 
 	switch (smc_fid) {
 	case CPU_SVC_GET_L1I_CACHELINE:
-		ret = cortex_a720_get_l1i_cacheline(handle, x1, x2);
+		ret = cortex_a720_get_l1i_cacheline(handle, x1, x2, x3);
 		SMC_RET1(handle, ret);
 
 	case CPU_SVC_GET_L1D_CACHELINE:
-		ret = cortex_a720_get_l1d_cacheline(handle, x1, x2);
+		ret = cortex_a720_get_l1d_cacheline(handle, x1, x2, x3);
 		SMC_RET1(handle, ret);
 
 	case CPU_SVC_GET_L2U_CACHELINE:
-		ret = cortex_a720_get_l2u_cacheline(handle, x1, x2);
+		ret = cortex_a720_get_l2u_cacheline(handle, x1, x2, x3);
 		SMC_RET1(handle, ret);
 
 	case CPU_SVC_GET_L3U_CACHELINE:
-		ret = cortex_a720_get_l3u_cacheline(handle, x1, x2);
+		ret = cortex_a720_get_l3u_cacheline(handle, x1, x2, x3);
+		SMC_RET1(handle, ret);
+
+	case CPU_SVC_GET_TLB_ENTRY:
+		ret = cortex_a720_get_tlb_entry(handle, x1, x2, x3);
 		SMC_RET1(handle, ret);
 
 	default:
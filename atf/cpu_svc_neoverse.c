@@ -0,0 +1,156 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/*
+ * cpu_svc_neoverse.c
+ *
+ * CPU service of Neoverse N1 and N2 platforms. Both cores have 64KiB 4-way
+ * L1 I$ and L1 D$ and an 8-way private L2 of up to 1MiB, their RAMs are
+ * read the same way as the ones of Cortex-A720 (cpu_svc_cortex_a720.c).
+ * The system level cache lives in the interconnect and is not reachable
+ * by RAMINDEX.
+ *
+ * Copyright (c) 2024 Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <common/debug.h>
+#include <common/runtime_svc.h>
+#include <smccc_helpers.h>
+
+#include "cpu_svc_ramindex.h"
+
+/*
+ * RAMINDEX bit assignments
+ * When AArch64-RAMINDEX.ID == 0x00 (Tag) or 0x01 (Data) and 64KiB of L1 I$
+ *
+ * [63:32] Reserved
+ * [31:24] RAMID	ID of the selected memory
+ * [23:20] Reserved
+ * [19:18] Way
+ * [17] Reserved
+ * [16:14] VA[5:3]	Virtual Address bits[5:3] (Data only)
+ * [13:6] Set		Virtual Address bits [13:6]
+ * [5:0] Reserved
+ */
+static const struct cpu_svc_ram neoverse_l1i = {
+	.tag_ramid = 0x00, .data_ramid = 0x01,
+	.way_shift = 18, .way_mask = 0x3, .set_mask = 0xff,
+	.nbeats = 8, .beat_shift = 14, .iside = true, .shared = false,
+	.nways = 4,
+};
+
+/*
+ * RAMINDEX bit assignments
+ * When AArch64-RAMINDEX.ID == 0x08 (Tag) or 0x09 (Data) and 64KiB of L1 D$
+ *
+ * [63:32] Reserved
+ * [31:24] RAMID	ID of the selected memory
+ * [23:20] Reserved
+ * [19:18] Way
+ * [17:16] VA[5:4]	Virtual Address bits[5:4] (Data only)
+ * [15:14] Reserved
+ * [13:6] Set		Virtual Address bits [13:6]
+ * [5:0] Reserved
+ */
+static const struct cpu_svc_ram neoverse_l1d = {
+	.tag_ramid = 0x08, .data_ramid = 0x09,
+	.way_shift = 18, .way_mask = 0x3, .set_mask = 0xff,
+	.nbeats = 4, .beat_shift = 16, .iside = false, .shared = false,
+	.nways = 4,
+};
+
+/*
+ * RAMINDEX bit assignments
+ * When AArch64-RAMINDEX.ID == 0x10 (Tag) or 0x11 (Data) and 8-way L2 (up to 1MiB)
+ *
+ * [63:32] Reserved
+ * [31:24] RAMID	ID of the selected memory
+ * [23:22] Reserved
+ * [21:19] Way
+ * [18:17] Reserved
+ * [16:6] Set		Physical Address bits [16:6]
+ * [5:4] PA[5:4]	Physical Address bits [5:4] (Data only)
+ * [3:0] Reserved
+ */
+static const struct cpu_svc_ram neoverse_l2u = {
+	.tag_ramid = 0x10, .data_ramid = 0x11,
+	.way_shift = 19, .way_mask = 0x7, .set_mask = 0x7ff,
+	.nbeats = 4, .beat_shift = 4, .iside = false, .shared = false,
+	.nways = 8,
+};
+
+static u_register_t neoverse_get_l1i_cacheline(void *handle, u_register_t set, u_register_t way, u_register_t flags)
+{
+	return cpu_svc_get_cacheline(&neoverse_l1i, handle, set, way, flags);
+}
+
+static u_register_t neoverse_get_l1d_cacheline(void *handle, u_register_t set, u_register_t way, u_register_t flags)
+{
+	return cpu_svc_get_cacheline(&neoverse_l1d, handle, set, way, flags);
+}
+
+static u_register_t neoverse_get_l2u_cacheline(void *handle, u_register_t set, u_register_t way, u_register_t flags)
+{
+	return cpu_svc_get_cacheline(&neoverse_l2u, handle, set, way, flags);
+}
+
+static u_register_t neoverse_get_tags(void *handle, u_register_t cache, u_register_t set, u_register_t flags)
+{
+	switch (cache) {
+	case CPU_SVC_CACHE_L1I:
+		return cpu_svc_get_tags(&neoverse_l1i, handle, set, flags);
+	case CPU_SVC_CACHE_L1D:
+		return cpu_svc_get_tags(&neoverse_l1d, handle, set, flags);
+	case CPU_SVC_CACHE_L2U:
+		return cpu_svc_get_tags(&neoverse_l2u, handle, set, flags);
+	default:
+		return SMC_UNK;
+	}
+}
+
+uintptr_t neoverse_smc_handler(uint32_t smc_fid,
+				u_register_t x1,
+				u_register_t x2,
+				u_register_t x3,
+				u_register_t x4,
+				void *cookie,
+				void *handle,
+				u_register_t flags)
+{
+	u_register_t ret;
+
+	switch (smc_fid) {
+	case CPU_SVC_GET_L1I_CACHELINE:
+		ret = neoverse_get_l1i_cacheline(handle, x1, x2, x3);
+		SMC_RET1(handle, ret);
+
+	case CPU_SVC_GET_L1D_CACHELINE:
+		ret = neoverse_get_l1d_cacheline(handle, x1, x2, x3);
+		SMC_RET1(handle, ret);
+
+	case CPU_SVC_GET_L2U_CACHELINE:
+		ret = neoverse_get_l2u_cacheline(handle, x1, x2, x3);
+		SMC_RET1(handle, ret);
+
+	case CPU_SVC_GET_TAGS:
+		ret = neoverse_get_tags(handle, x1, x2, x3);
+		SMC_RET1(handle, ret);
+
+	default:
+		ERROR("%s: unhandled SMC (0x%x)\n", __func__, smc_fid);
+		SMC_RET1(handle, SMC_UNK);
+	}
+}
+
+/* Define a runtime service descriptor for fast SMC calls */
+DECLARE_RT_SVC(
+	neoverse_cpu_svc,
+	OEN_CPU_START,
+	OEN_CPU_END,
+	SMC_TYPE_FAST,
+	neoverse_smc_handler
+);
@@ -0,0 +1,183 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/*
+ * cpu_svc_ramindex.h
+ *
+ * RAMINDEX access shared by the CPU services of cores allowing for access
+ * to caches' internal memory only in EL3 (see cpu_svc_cortex_a720.c and
+ * cpu_svc_neoverse.c). A core is described by a struct cpu_svc_ram per
+ * cache, the loops below are always inlined with such static const
+ * descriptors.
+ *
+ * Copyright (c) 2024 Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+#ifndef CPU_SVC_RAMINDEX_H
+#define CPU_SVC_RAMINDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <common/runtime_svc.h>
+#include <smccc_helpers.h>
+
+#define CPU_SVC_GET_L1I_CACHELINE	0x81000001
+#define CPU_SVC_GET_L1D_CACHELINE	0x81000002
+#define CPU_SVC_GET_L2U_CACHELINE	0x81000003
+#define CPU_SVC_GET_L3U_CACHELINE	0x81000004
+#define CPU_SVC_GET_TLB_ENTRY		0x81000005
+#define CPU_SVC_GET_TAGS		0x81000006
+
+/* x1 of CPU_SVC_GET_TLB_ENTRY call */
+#define CPU_SVC_TLB_L1I			0x0
+#define CPU_SVC_TLB_L1D			0x1
+#define CPU_SVC_TLB_L2			0x2
+
+/* x1 of CPU_SVC_GET_TAGS call */
+#define CPU_SVC_CACHE_L1I		0x0
+#define CPU_SVC_CACHE_L1D		0x1
+#define CPU_SVC_CACHE_L2U		0x2
+#define CPU_SVC_CACHE_L3U		0x3
+
+/* CPU_SVC_GET_TAGS returns tags of all the ways of a set in x1 till x16 */
+#define CPU_SVC_TAGS_MAX		16
+
+/* x3 flags of CPU_SVC_GET_*_CACHELINE (and CPU_SVC_GET_TAGS) calls */
+#define CPU_SVC_FLAG_TAG_ONLY		0x1 /* do not read line data (x2 till x9 are left untouched) */
+#define CPU_SVC_FLAG_MIN_BARRIERS	0x2 /* issue the minimal access sequence */
+
+/*
+ * Issues RAMINDEX operation and waits until its result lands in
+ * IMP_*_DATAn_EL3 registers. The conservative sequence completes it with
+ * dsb sy, the minimal one (CPU_SVC_FLAG_MIN_BARRIERS) with a dsb limited to
+ * the shareability domain of the RAM - non-shareable for core private
+ * RAMs, inner shareable for RAMs shared by a cluster (@shared). The isb is
+ * needed either way, so that the following mrs reads are not executed before
+ * the operation completes.
+ */
+static inline void cpu_svc_ramindex(uint64_t selector, u_register_t flags, bool shared)
+{
+	asm volatile("sys #6, c15, c0, #0, %0" : : "r" (selector));
+	if (!(flags & CPU_SVC_FLAG_MIN_BARRIERS))
+		asm volatile("dsb sy");
+	else if (shared)
+		asm volatile("dsb ish");
+	else
+		asm volatile("dsb nsh");
+	asm volatile("isb");
+}
+
+/*
+ * Tag and data RAMs of one cache:
+ * tag_ramid, data_ramid	RAMIDs of the tag and data RAMs
+ * way_shift, way_mask		position and mask of the way within the selector
+ * set_mask			mask of the set (the set is always at bit 6)
+ * nbeats, beat_shift		number of data RAM accesses per line and position
+ *				of the beat index within the selector
+ * iside			results land in IMP_ISIDE_DATAn_EL3 (two 32-bit
+ *				halves of 8 bytes), IMP_DSIDE_DATAn_EL3 otherwise
+ *				(two 64-bit halves of 16 bytes)
+ * shared			the RAMs are shared by the cores of a cluster
+ * nways			number of ways returned by CPU_SVC_GET_TAGS
+ *				(0 if the call is not provided for the cache)
+ */
+struct cpu_svc_ram {
+	uint64_t tag_ramid;
+	uint64_t data_ramid;
+	unsigned int way_shift;
+	uint64_t way_mask;
+	uint64_t set_mask;
+	unsigned int nbeats;
+	unsigned int beat_shift;
+	bool iside;
+	bool shared;
+	unsigned int nways;
+};
+
+/*
+ * Reads the line selected by set and way of the cache described by ram,
+ * the tag is returned in x1 and (unless CPU_SVC_FLAG_TAG_ONLY is set)
+ * the data in x2 till x9. Always inlined into per cache getters, which pass
+ * static const descriptors, so every one of them gets its own loop with
+ * the selector layout and the beat layout folded into immediates.
+ */
+static inline __attribute__((always_inline)) u_register_t cpu_svc_get_cacheline(
+	const struct cpu_svc_ram *ram, void *handle,
+	u_register_t set, u_register_t way, u_register_t flags)
+{
+	gp_regs_t *gpregs = get_gpregs_ctx(handle);
+	uint64_t selector;
+	uint64_t r0, r1;
+	unsigned int i;
+
+	selector = (way & ram->way_mask) << ram->way_shift;
+	selector |= (set & ram->set_mask) << 6;
+
+	cpu_svc_ramindex(ram->tag_ramid << 24 | selector, flags, ram->shared);
+	if (ram->iside)
+		asm volatile("mrs %0, s3_6_c15_c0_0" : "=r" (r0));
+	else
+		asm volatile("mrs %0, s3_6_c15_c1_0" : "=r" (r0));
+
+	write_ctx_reg(gpregs, (CTX_GPREG_X1), r0);
+
+	if (flags & CPU_SVC_FLAG_TAG_ONLY)
+		return SMC_OK;
+
+	selector |= ram->data_ramid << 24;
+
+	for (i = 0; i < ram->nbeats; i++) {
+		/* this selects bytes [0+i*beat:beat-1+i*beat] from cacheline */
+		cpu_svc_ramindex(selector | (uint64_t)i << ram->beat_shift, flags, ram->shared);
+		if (ram->iside) {
+			asm volatile("mrs %0, s3_6_c15_c0_0" : "=r" (r0));
+			asm volatile("mrs %0, s3_6_c15_c0_1" : "=r" (r1));
+
+			write_ctx_reg(gpregs, (CTX_GPREG_X2 + i * sizeof(u_register_t)),
+				(r1 & 0xffffffff) << 32 | (r0 & 0xffffffff));
+		} else {
+			asm volatile("mrs %0, s3_6_c15_c1_0" : "=r" (r0));
+			asm volatile("mrs %0, s3_6_c15_c1_1" : "=r" (r1));
+
+			write_ctx_reg(gpregs, (CTX_GPREG_X2 + (i * 2 + 0) * sizeof(u_register_t)), r0);
+			write_ctx_reg(gpregs, (CTX_GPREG_X2 + (i * 2 + 1) * sizeof(u_register_t)), r1);
+		}
+	}
+
+	return SMC_OK;
+}
+
+/*
+ * Reads tags of all the ways of a set of the cache described by ram
+ * and returns them in x1 till x(nways), so that tag only dumps of big
+ * caches take one round trip per set instead of one per line.
+ */
+static inline __attribute__((always_inline)) u_register_t cpu_svc_get_tags(
+	const struct cpu_svc_ram *ram, void *handle,
+	u_register_t set, u_register_t flags)
+{
+	gp_regs_t *gpregs = get_gpregs_ctx(handle);
+	uint64_t selector;
+	uint64_t r0;
+	unsigned int way;
+
+	if (ram->nways == 0 || ram->nways > CPU_SVC_TAGS_MAX)
+		return SMC_UNK;
+
+	selector = ram->tag_ramid << 24;
+	selector |= (set & ram->set_mask) << 6;
+
+	for (way = 0; way < ram->nways; way++) {
+		cpu_svc_ramindex(selector | (way & ram->way_mask) << ram->way_shift,
+			flags, ram->shared);
+		if (ram->iside)
+			asm volatile("mrs %0, s3_6_c15_c0_0" : "=r" (r0));
+		else
+			asm volatile("mrs %0, s3_6_c15_c1_0" : "=r" (r0));
+
+		write_ctx_reg(gpregs, (CTX_GPREG_X1 + way * sizeof(u_register_t)), r0);
+	}
+
+	return SMC_OK;
+}
+
+#endif /* CPU_SVC_RAMINDEX_H */
@@ -0,0 +1,108 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ramindex-nodes.bpf.c
+ *
+ * Copyright (C) 2024 Lukasz Wiecaszek <lukasz.wiecaszek(at)gmail.com>
+ *
+ * Example BPF program aggregating lines of a cache in the kernel
+ * with the ramindex kfuncs. Lines of the selected cache of the cpu
+ * the program runs on are counted per NUMA node and per physical page,
+ * only the counters (not the lines) end up in userspace.
+ *
+ * Build and run it on cpu 2 (syscall programs run on the cpu of the caller):
+ *
+ *	$ bpftool btf dump file /sys/kernel/btf/vmlinux format c > vmlinux.h
+ *	$ clang -O2 -g -target bpf -I. -c ramindex-nodes.bpf.c -o ramindex-nodes.bpf.o
+ *	$ sudo bpftool prog loadall ramindex-nodes.bpf.o /sys/fs/bpf/ramindex pinmaps /sys/fs/bpf/ramindex
+ *	$ sudo taskset -c 2 bpftool prog run pinned /sys/fs/bpf/ramindex/ramindex_nodes data_in /dev/null
+ *	$ sudo bpftool map dump pinned /sys/fs/bpf/ramindex/nodes
+ */
+
+#include "vmlinux.h"
+
+#include <bpf/bpf_helpers.h>
+
+#define MAX_NODES 64
+#define MAX_PAGES 65536
+#define PAGE_SHIFT 12
+
+/* as defined by the ramindex module (relocated against its BTF) */
+struct ramindex_line {
+	__s32 set;
+	__s32 way;
+	__u8 valid;
+	__u8 dirty;
+	__u8 ns;
+	__u8 state;
+	__u64 tag;
+} __attribute__((preserve_access_index));
+
+struct bpf_iter_ramindex {
+	__u64 __opaque[6];
+} __attribute__((aligned(8)));
+
+extern int bpf_iter_ramindex_new(struct bpf_iter_ramindex *it, int level, int icache) __weak __ksym;
+extern struct ramindex_line *bpf_iter_ramindex_next(struct bpf_iter_ramindex *it) __weak __ksym;
+extern void bpf_iter_ramindex_destroy(struct bpf_iter_ramindex *it) __weak __ksym;
+extern int bpf_ramindex_pfn_to_nid(__u64 pfn) __weak __ksym;
+
+struct ramindex_counters {
+	__u64 valid;
+	__u64 dirty;
+};
+
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__uint(max_entries, MAX_NODES);
+	__type(key, __u32);
+	__type(value, struct ramindex_counters);
+} nodes SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, MAX_PAGES);
+	__type(key, __u64);
+	__type(value, struct ramindex_counters);
+} pages SEC(".maps");
+
+/* selected cache (may be changed by a skeleton based loader) */
+const volatile int level = 0;
+const volatile int icache = 0;
+
+SEC("syscall")
+int ramindex_nodes(void *ctx)
+{
+	struct ramindex_counters zero = {};
+	struct ramindex_counters *c;
+	struct ramindex_line *l;
+	__u32 nid;
+	__u64 pfn;
+
+	bpf_for_each(ramindex, l, level, icache) {
+		if (!l->valid)
+			continue;
+
+		pfn = l->tag >> PAGE_SHIFT;
+
+		nid = bpf_ramindex_pfn_to_nid(pfn);
+		c = bpf_map_lookup_elem(&nodes, &nid);
+		if (c) {
+			c->valid++;
+			c->dirty += l->dirty;
+		}
+
+		c = bpf_map_lookup_elem(&pages, &pfn);
+		if (!c) {
+			bpf_map_update_elem(&pages, &pfn, &zero, BPF_NOEXIST);
+			c = bpf_map_lookup_elem(&pages, &pfn);
+		}
+		if (c) {
+			c->valid++;
+			c->dirty += l->dirty;
+		}
+	}
+
+	return 0;
+}
+
+char LICENSE[] SEC("license") = "GPL";
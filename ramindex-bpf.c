@@ -0,0 +1,163 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ramindex-bpf.c
+ *
+ * Copyright (C) 2024 Lukasz Wiecaszek <lukasz.wiecaszek(at)gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License (in file COPYING) for more details.
+ */
+
+#include <linux/types.h>
+#include <linux/errno.h>
+#include <linux/string.h>
+#include <linux/preempt.h>
+#include <linux/mm.h>
+#include <linux/memory_hotplug.h>
+#include <linux/numa.h>
+#include <linux/bpf.h>
+#include <linux/btf.h>
+#include <linux/btf_ids.h>
+
+#include "ramindex-ops.h"
+#include "ramindex-main.h"
+#include "ramindex-bpf.h"
+
+#if IS_ENABLED(CONFIG_DEBUG_INFO_BTF_MODULES)
+
+/*
+ * Open coded BPF iterator over lines of the selected cache of the cpu
+ * the BPF program runs on (BPF programs run with migration disabled,
+ * so all the lines come from the same cpu), e.g.:
+ *
+ *	struct ramindex_line *l;
+ *
+ *	bpf_for_each(ramindex, l, 0, 0)
+ *		if (l->valid && l->dirty)
+ *			...
+ *
+ * Only tags are read, every line is read with preemption disabled
+ * when the program asks for it, so nothing is buffered.
+ */
+struct bpf_iter_ramindex {
+	__u64 __opaque[6];
+} __aligned(8);
+
+struct bpf_iter_ramindex_kern {
+	dumpfunction_t df;
+	__u32 nways;
+	__u32 index;
+	__u32 total;
+	__u32 reserved;
+	struct ramindex_line line;
+} __aligned(8);
+
+__bpf_kfunc_start_defs();
+
+__bpf_kfunc int bpf_iter_ramindex_new(struct bpf_iter_ramindex *it, int level, int icache)
+{
+	struct bpf_iter_ramindex_kern *kit = (void *)it;
+	struct ramindex_ccsidr ccsidr;
+
+	BUILD_BUG_ON(sizeof(struct bpf_iter_ramindex_kern) > sizeof(struct bpf_iter_ramindex));
+	BUILD_BUG_ON(__alignof__(struct bpf_iter_ramindex_kern) !=
+		__alignof__(struct bpf_iter_ramindex));
+
+	memset(kit, 0, sizeof(*kit));
+
+	kit->df = ramindex_get_dumpfunction(level, icache);
+	if (kit->df == NULL)
+		return -EOPNOTSUPP;
+
+	memset(&ccsidr, 0, sizeof(ccsidr));
+	ccsidr.level = level;
+	ccsidr.icache = icache;
+	ramindex_get_ccsidr(&ccsidr);
+
+	kit->nways = ccsidr.nways;
+	kit->total = ccsidr.nsets * ccsidr.nways;
+
+	return 0;
+}
+
+__bpf_kfunc struct ramindex_line *bpf_iter_ramindex_next(struct bpf_iter_ramindex *it)
+{
+	struct bpf_iter_ramindex_kern *kit = (void *)it;
+	int status;
+
+	if (kit->index >= kit->total)
+		return NULL;
+
+	preempt_disable();
+	status = kit->df(kit->index / kit->nways, kit->index % kit->nways, &kit->line, NULL, 0);
+	preempt_enable();
+
+	if (status) {
+		kit->index = kit->total;
+		return NULL;
+	}
+
+	kit->index++;
+
+	return &kit->line;
+}
+
+__bpf_kfunc void bpf_iter_ramindex_destroy(struct bpf_iter_ramindex *it)
+{
+}
+
+/*
+ * Returns NUMA node of the physical frame (NUMA_NO_NODE if there is no such
+ * frame online). pfn_valid() holds for offline sections and ZONE_DEVICE memory
+ * as well, whose struct pages may be uninitialised.
+ */
+__bpf_kfunc int bpf_ramindex_pfn_to_nid(__u64 pfn)
+{
+	struct page *page = pfn_to_online_page(pfn);
+
+	if (page == NULL)
+		return NUMA_NO_NODE;
+
+	return page_to_nid(page);
+}
+
+__bpf_kfunc_end_defs();
+
+BTF_KFUNCS_START(ramindex_kfunc_ids)
+BTF_ID_FLAGS(func, bpf_iter_ramindex_new, KF_ITER_NEW)
+BTF_ID_FLAGS(func, bpf_iter_ramindex_next, KF_ITER_NEXT | KF_RET_NULL)
+BTF_ID_FLAGS(func, bpf_iter_ramindex_destroy, KF_ITER_DESTROY)
+BTF_ID_FLAGS(func, bpf_ramindex_pfn_to_nid)
+BTF_KFUNCS_END(ramindex_kfunc_ids)
+
+static const struct btf_kfunc_id_set ramindex_kfunc_set = {
+	.owner = THIS_MODULE,
+	.set = &ramindex_kfunc_ids,
+};
+
+int ramindex_bpf_init(void)
+{
+	static const enum bpf_prog_type types[] = {
+		BPF_PROG_TYPE_SYSCALL,
+		BPF_PROG_TYPE_TRACING,
+		BPF_PROG_TYPE_PERF_EVENT,
+	};
+	size_t i;
+	int status;
+
+	for (i = 0; i < ARRAY_SIZE(types); i++) {
+		status = register_btf_kfunc_id_set(types[i], &ramindex_kfunc_set);
+		if (status)
+			return status;
+	}
+
+	return 0;
+}
+
+#endif /* CONFIG_DEBUG_INFO_BTF_MODULES */
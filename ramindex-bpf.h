@@ -0,0 +1,32 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ramindex-bpf.h
+ *
+ * Copyright (C) 2024 Lukasz Wiecaszek <lukasz.wiecaszek(at)gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License (in file COPYING) for more details.
+ */
+
+#ifndef _RAMINDEX_BPF_H_
+#define _RAMINDEX_BPF_H_
+
+#include <linux/kconfig.h>
+
+#if IS_ENABLED(CONFIG_DEBUG_INFO_BTF_MODULES)
+/* registers kfuncs letting BPF programs iterate over cache lines */
+int ramindex_bpf_init(void);
+#else
+static inline int ramindex_bpf_init(void)
+{
+	return 0;
+}
+#endif
+
+#endif /* _RAMINDEX_BPF_H_ */
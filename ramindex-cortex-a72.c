@@ -16,207 +16,383 @@
 
 #include <linux/types.h>
 #include <linux/errno.h>
-#include <linux/uaccess.h>
+#include <linux/sizes.h>
+#include <linux/bitops.h>
+#include <linux/kernel.h>
 
 #include "ramindex-ops.h"
+#include "ramindex-desc.h"
+#include "ramindex-stats.h"
+#include "ramindex-trace.h"
 
-static int ramindex_cortex_a72_dump_l1i_cacheline(__s32 set, __s32 way, __u32 lsize, struct ramindex_cacheline __user *l)
-{
-	__u8 valid;
-	__u8 dirty;
-	__u8 ns;
-	__u64 tag;
-	__u32 ls;
-	__u32 linesize;
-	__u32 *linedata;
-	__u32 selector;
-	__u32 r0, r1;
-	int ret = 0;
+/* L1 D$ and L2 tags hold MESI state in two bits (0b00 I, 0b01 S, 0b10 E, 0b11 M) */
+static const __u8 ramindex_cortex_a72_mesi[4] = {
+	CSTATE_INVALID, CSTATE_SHARED_CLEAN, CSTATE_UNIQUE_CLEAN, CSTATE_UNIQUE_DIRTY
+};
 
-	ret |= get_user(linesize, (__u32 __user *)&l->linesize);
-	ret |= get_user(linedata, (__u32* __user *)&l->linedata);
+/* page (block) sizes as encoded in TLB entries */
+static const __u64 ramindex_cortex_a72_tlb_pagesize[8] = {
+	SZ_4K, SZ_64K, SZ_1M, SZ_2M, SZ_16M, SZ_32M, SZ_512M, SZ_1G
+};
 
-	if (ret)
-		return ret;
+/* L2 tag and data RAMs (ramid 0x10 and 0x11) are shared by all the cores of a cluster */
+#define RAMINDEX_CORTEX_A72_RAMID_SHARED(selector) (((selector) >> 25) == (0x10 >> 1))
 
-	if (lsize < linesize)
-		linesize = lsize;
+/*
+ * Issues RAMINDEX operation and waits until its result lands in
+ * IL1DATAn_EL1/DL1DATAn_EL1 registers. The conservative sequence completes
+ * it with dsb sy, the minimal one with a dsb limited to the shareability
+ * domain of the RAM (non-shareable for core private L1 and TLB RAMs, inner
+ * shareable for the cluster's L2 RAMs). The isb is needed either way, so that
+ * the following mrs reads are not executed before the operation completes.
+ * The operation is timed only when statistics or ramindex_sysop tracepoint
+ * are enabled.
+ */
+static __always_inline void ramindex_cortex_a72_ramindex(__u32 selector)
+{
+	u64 start_ns = 0, duration_ns;
 
-	/*
-	* RAMINDEX bit assignments
-	* When AArch64-RAMINDEX.ID == 0x00 and 48KiB of L1 I$
-	*
-	* [31:24] RAMID		ID of the selected memory (L1 I$ Tag)
-	* [23:20] Reserved
-	* [19:18] Way
-	* [17:14] Reserved
-	* [13:6] Set		Virtual Address bits [13:6]
-	* [5:0] Reserved
-	*/
-	selector = 0x00000000; /* this selects l1 instruction cache tag (ramid = 0x00) */
-	selector |= (way & 0x3) << 18;
-	selector |= (set & 0xff) << 6;
+	if (ramindex_stats_on() || trace_ramindex_sysop_enabled())
+		start_ns = local_clock();
 
 	asm volatile("sys #0, c15, c4, #0, %0" : : "r" (selector));
-	asm volatile("dsb sy");
+	if (!ramindex_access_minimal())
+		asm volatile("dsb sy");
+	else if (RAMINDEX_CORTEX_A72_RAMID_SHARED(selector))
+		asm volatile("dsb ish");
+	else
+		asm volatile("dsb nsh");
 	asm volatile("isb");
-	asm volatile("mrs %0, s3_0_c15_c0_0" : "=r" (r0));
-	asm volatile("mrs %0, s3_0_c15_c0_1" : "=r" (r1));
 
-	valid = (r1 >> 1) & 0x1;
-	dirty = 0; /* dirty bit is not present in instruction cache */
-	ns = (r1 >> 0) & 0x1;
-	tag = r0 << 12 | (set & 0x3f) << 6;
+	if (start_ns) {
+		duration_ns = local_clock() - start_ns;
+		ramindex_stats_add(RAMINDEX_CNT_SYSOPS, 1);
+		ramindex_stats_hist(RAMINDEX_HIST_SYSOP_NS, duration_ns);
+		trace_ramindex_sysop(selector, duration_ns);
+	}
+}
+
+/**
+ * struct ramindex_cortex_a72_ram - tag and data RAMs of one cache
+ * @tag_ramid:	RAMID of the tag RAM
+ * @data_ramid:	RAMID of the data RAM
+ * @way_shift:	position of the way within the RAMINDEX selector
+ * @way_mask:	mask of the way (applied before shifting it up)
+ * @set_mask:	mask of the set (the set is always at bit 6 of the selector)
+ * @beat_bytes:	bytes of the line returned by one data RAM access
+ *		(8 in DATA0/DATA1 or 16 in DATA0 to DATA3)
+ * @beat_mask:	bits of the line offset selecting the beat within the selector
+ * @dside:	results land in DL1DATAn_EL1 (IL1DATAn_EL1 otherwise)
+ * @tag:	layout of the tag in DATA0 (register 0) and DATA1 (register 1)
+ */
+struct ramindex_cortex_a72_ram {
+	u32 tag_ramid;
+	u32 data_ramid;
+	u8 way_shift;
+	u32 way_mask;
+	u32 set_mask;
+	u8 beat_bytes;
+	u32 beat_mask;
+	bool dside;
+	struct ramindex_tag_desc tag;
+};
 
-	ret |= put_user(set, (__s32 __user *)&l->set);
-	ret |= put_user(way, (__s32 __user *)&l->way);
-	ret |= put_user(valid, (__u8 __user *)&l->valid);
-	ret |= put_user(dirty, (__u8 __user *)&l->dirty);
-	ret |= put_user(ns, (__u8 __user *)&l->ns);
-	ret |= put_user(tag, (__u64 __user *)&l->tag);
-	ret |= put_user(linesize, (__u32 __user *)&l->linesize);
+/*
+ * RAMINDEX bit assignments
+ * When AArch64-RAMINDEX.ID == 0x00 (Tag) or 0x01 (Data) and 48KiB of L1 I$
+ *
+ * [31:24] RAMID	ID of the selected memory
+ * [23:20] Reserved
+ * [19:18] Way
+ * [17:14] Reserved
+ * [13:6] Set		Virtual Address bits [13:6]/Index
+ * [5:4] Bank select	(Data only)
+ * [3] Upper or lower doubleword within the quadword (Data only)
+ * [2:0] Reserved
+ *
+ * IL1DATA0 [31:0] Tag	Physical Address bits [43:12]
+ * IL1DATA1 [0] NS	Non-secure identifier
+ * IL1DATA1 [1] Valid
+ */
+static const struct ramindex_cortex_a72_ram ramindex_cortex_a72_l1i = {
+	.tag_ramid = 0x00, .data_ramid = 0x01,
+	.way_shift = 18, .way_mask = 0x3, .set_mask = 0xff,
+	.beat_bytes = 8, .beat_mask = 0x38, .dside = false,
+	.tag = {
+		.tag_reg = 0, .tag_shift = 0, .tag_mask = 0xffffffff, .tag_lsb = 12,
+		.set_mask = 0x3f,
+		.ns_reg = 1, .ns_bit = 0,
+		.state_reg = 1, .state_shift = 1, .state_mask = 0x1, .states = NULL,
+	},
+};
 
-	if (ret)
-		return ret;
+/*
+ * RAMINDEX bit assignments
+ * When AArch64-RAMINDEX.ID == 0x08 (Tag) or 0x09 (Data) and 32KB of L1 D$
+ *
+ * [31:24] RAMID	ID of the selected memory
+ * [23:19] Reserved
+ * [18] Way
+ * [17:14] Reserved
+ * [13:6] Set		Virtual Address bits [13:6]
+ * [5:4] Bank select	(Data only)
+ * [3] Upper or lower doubleword within the quadword (Data only)
+ * [2:0] Reserved
+ *
+ * DL1DATA0 [29:0] Tag	Physical Address bits [43:14]
+ * DL1DATA0 [30] NS	Non-secure identifier
+ * DL1DATA1 [1:0] State	0b00 Invalid, 0b01 Shared, 0b10 Exclusive, 0b11 Modified
+ */
+static const struct ramindex_cortex_a72_ram ramindex_cortex_a72_l1d = {
+	.tag_ramid = 0x08, .data_ramid = 0x09,
+	.way_shift = 18, .way_mask = 0x1, .set_mask = 0xff,
+	.beat_bytes = 8, .beat_mask = 0x38, .dside = true,
+	.tag = {
+		.tag_reg = 0, .tag_shift = 0, .tag_mask = 0x3fffffff, .tag_lsb = 14,
+		.set_mask = 0xff,
+		.ns_reg = 0, .ns_bit = 30,
+		.state_reg = 1, .state_shift = 0, .state_mask = 0x3, .states = ramindex_cortex_a72_mesi,
+	},
+};
 
-	/*
-	* RAMINDEX bit assignments
-	* When AArch64-RAMINDEX.ID == 0x01 and 48KiB of L1 I$
-	*
-	* [31:24] RAMID		ID of the selected memory (L1 I$ Data)
-	* [23:20] Reserved
-	* [19:18] Way
-	* [17:14] Reserved
-	* [13:6] Set		Virtual Address bits [13:6]/Index
-	* [5:4] Bank select
-	* [3] Upper or lower doubleword within the quadword
-	* [2:0] Reserved
-	*/
-	for (ls = 0; !ret && ls < linesize; ls+=sizeof(*linedata)*2, linedata+=2) {
-		selector = 0x01000000; /* this selects l1 instruction cache data (ramid = 0x01) */
-		selector |= (way & 0x3) << 18;
-		selector |= (set & 0xff) << 6;
-		selector |= ls;
+/*
+ * RAMINDEX bit assignments
+ * When AArch64-RAMINDEX.ID == 0x10 (Tag) or 0x11 (Data)
+ * and 16-way L2 cache (512KiB up to 4MiB)
+ *
+ * [31:24] RAMID	ID of the selected memory
+ * [23:22] Reserved
+ * [21:18] Way
+ * [17:6] Set		Physical Address bits [17:6] (upper bits are ignored
+ *			for L2 caches smaller than 4MiB)
+ * [5:4] Quadword select	Physical Address bits [5:4] (Data only)
+ * [3:0] Reserved
+ *
+ * Each data access returns one quadword (16 bytes) in DL1DATA0 to DL1DATA3.
+ *
+ * DL1DATA0 [28:0] Tag	Physical Address bits [43:15]
+ * DL1DATA0 [29] NS	Non-secure identifier
+ * DL1DATA1 [1:0] State	0b00 Invalid, 0b01 Shared, 0b10 Exclusive, 0b11 Modified
+ *
+ * The tag always holds PA[43:15], so for L2 caches bigger than 512KiB
+ * its lowest bits overlap with the set index and are simply OR-ed.
+ */
+static const struct ramindex_cortex_a72_ram ramindex_cortex_a72_l2 = {
+	.tag_ramid = 0x10, .data_ramid = 0x11,
+	.way_shift = 18, .way_mask = 0xf, .set_mask = 0xfff,
+	.beat_bytes = 16, .beat_mask = 0x30, .dside = true,
+	.tag = {
+		.tag_reg = 0, .tag_shift = 0, .tag_mask = 0x1fffffff, .tag_lsb = 15,
+		.set_mask = 0xfff,
+		.ns_reg = 0, .ns_bit = 29,
+		.state_reg = 1, .state_shift = 0, .state_mask = 0x3, .states = ramindex_cortex_a72_mesi,
+	},
+};
 
-		asm volatile("sys #0, c15, c4, #0, %0" : : "r" (selector));
-		asm volatile("dsb sy");
-		asm volatile("isb");
-		asm volatile("mrs %0, s3_0_c15_c0_0" : "=r" (r0));
-		asm volatile("mrs %0, s3_0_c15_c0_1" : "=r" (r1));
-
-		if (ls + sizeof(*linedata)*2 < linesize) {
-			ret |= put_user(r0, (__u32 __user *)(linedata + 0));
-			ret |= put_user(r1, (__u32 __user *)(linedata + 1));
-		} else if (ls + sizeof(*linedata) < linesize) {
-			ret |= put_user(r0, (__u32 __user *)(linedata + 0));
-			ret |= copy_to_user((void __user *)(linedata + 1), &r1, linesize - ls - sizeof(*linedata));
-		} else {
-			ret |= copy_to_user((void __user *)(linedata + 0), &r0, linesize - ls);
+/*
+ * Reads @n (2 or 4) result registers of the last RAMINDEX operation.
+ * Register names have to be immediates, hence the branches (which are
+ * resolved at compile time as @dside and @n are constants of a descriptor).
+ */
+static __always_inline void ramindex_cortex_a72_read_data(bool dside, int n, __u32 *r)
+{
+	if (dside) {
+		asm volatile("mrs %0, s3_0_c15_c1_0" : "=r" (r[0]));
+		asm volatile("mrs %0, s3_0_c15_c1_1" : "=r" (r[1]));
+		if (n > 2) {
+			asm volatile("mrs %0, s3_0_c15_c1_2" : "=r" (r[2]));
+			asm volatile("mrs %0, s3_0_c15_c1_3" : "=r" (r[3]));
+		}
+	} else {
+		asm volatile("mrs %0, s3_0_c15_c0_0" : "=r" (r[0]));
+		asm volatile("mrs %0, s3_0_c15_c0_1" : "=r" (r[1]));
+		if (n > 2) {
+			asm volatile("mrs %0, s3_0_c15_c0_2" : "=r" (r[2]));
+			asm volatile("mrs %0, s3_0_c15_c0_3" : "=r" (r[3]));
 		}
 	}
-
-	return ret;
 }
 
-static int ramindex_cortex_a72_dump_l1d_cacheline(__s32 set, __s32 way, __u32 lsize, struct ramindex_cacheline __user *l)
+/*
+ * Reads the line selected by @set and @way of the cache described by @ram.
+ * Always inlined into the dump functions below, which pass static const
+ * descriptors, so every one of them gets its own loop with the selector
+ * layout, the beat size and the tag layout folded into immediates.
+ */
+static __always_inline int ramindex_cortex_a72_dump_cacheline(const struct ramindex_cortex_a72_ram *ram,
+	__s32 set, __s32 way, struct ramindex_line *l, void *linedata, __u32 linesize)
 {
-	__u8 valid;
-	__u8 dirty;
-	__u8 ns;
-	__u64 tag;
 	__u32 ls;
-	__u32 linesize;
-	__u32 *linedata;
+	__u32 *ld = linedata;
 	__u32 selector;
-	__u32 r0, r1;
-	int ret = 0;
+	__u32 r[2];
+	u64 tag[2];
+
+	selector = ram->tag_ramid << 24;
+	selector |= (way & ram->way_mask) << ram->way_shift;
+	selector |= (set & ram->set_mask) << 6;
+
+	ramindex_cortex_a72_ramindex(selector);
+	ramindex_cortex_a72_read_data(ram->dside, 2, r);
 
-	ret |= get_user(linesize, (__u32 __user *)&l->linesize);
-	ret |= get_user(linedata, (__u32* __user *)&l->linedata);
+	tag[0] = r[0];
+	tag[1] = r[1];
+	ramindex_decode_tag(&ram->tag, set, way, tag, l);
 
-	if (ret)
-		return ret;
+	selector = ram->data_ramid << 24;
+	selector |= (way & ram->way_mask) << ram->way_shift;
+	selector |= (set & ram->set_mask) << 6;
 
-	if (lsize < linesize)
-		linesize = lsize;
+	for (ls = 0; ls < linesize; ls += ram->beat_bytes, ld += ram->beat_bytes / sizeof(*ld)) {
+		ramindex_cortex_a72_ramindex(selector | (ls & ram->beat_mask));
+		ramindex_cortex_a72_read_data(ram->dside, ram->beat_bytes / sizeof(*ld), ld);
+	}
+
+	return 0;
+}
+
+#define RAMINDEX_CORTEX_A72_DUMPFUNCTION(cache) \
+static int ramindex_cortex_a72_dump_##cache##_cacheline(__s32 set, __s32 way, struct ramindex_line *l, void *linedata, __u32 linesize) \
+{ \
+	return ramindex_cortex_a72_dump_cacheline(&ramindex_cortex_a72_##cache, set, way, l, linedata, linesize); \
+}
+
+RAMINDEX_CORTEX_A72_DUMPFUNCTION(l1i)
+RAMINDEX_CORTEX_A72_DUMPFUNCTION(l1d)
+RAMINDEX_CORTEX_A72_DUMPFUNCTION(l2)
+
+/*
+* All the TLB RAMs return an entry in four 32-bit words
+* (IL1DATA0 to IL1DATA3 for L1 I-TLB, DL1DATA0 to DL1DATA3 for L1 D-TLB and L2 TLB).
+*
+* The layout below has NOT been confirmed against the TRM for any of the
+* RAMs (0x04, 0x0a, 0x18), which may well differ from each other. Entries are
+* hence reported as unverified, with the words read returned next to them.
+*
+* word 0 [0] Valid
+* word 0 [1] NS		Non-secure identifier
+* word 0 [2] nG		Non-global (tagged with ASID)
+* word 0 [5:3] Page size	0b000 4KiB, 0b001 64KiB, 0b010 1MiB, 0b011 2MiB,
+*				0b100 16MiB, 0b101 32MiB, 0b110 512MiB, 0b111 1GiB
+* word 0 [21:6] ASID
+* word 0 [29:22] VMID
+* word 1 [31:0] VA		Virtual Address bits [43:12]
+* word 2 [4:0] VA		Virtual Address bits [48:44]
+* word 3 [31:0] PA		Physical Address bits [43:12]
+*/
+static void ramindex_cortex_a72_decode_tlbentry(__s32 set, __s32 way, const __u32 *r, struct ramindex_tlbentry *e)
+{
+	__u64 va;
+	int n;
+
+	e->set = set;
+	e->way = way;
+	e->valid = (r[0] >> 0) & 0x1;
+	e->ns = (r[0] >> 1) & 0x1;
+	e->global = !((r[0] >> 2) & 0x1);
+	e->unverified = 1;
+	e->pagesize = ramindex_cortex_a72_tlb_pagesize[(r[0] >> 3) & 0x7];
+	e->asid = (r[0] >> 6) & 0xffff;
+	e->vmid = (r[0] >> 22) & 0xff;
+
+	va = (__u64)(r[2] & 0x1f) << 44 | (__u64)r[1] << 12;
+	e->va = sign_extend64(va, 48) & ~(e->pagesize - 1);
+	e->pa = ((__u64)r[3] << 12) & ~(e->pagesize - 1);
+
+	for (n = 0; n < ARRAY_SIZE(e->raw); n++)
+		e->raw[n] = r[n];
+}
+
+static int ramindex_cortex_a72_dump_l1i_tlbentry(__s32 set, __s32 way, struct ramindex_tlbentry *e)
+{
+	__u32 selector;
+	__u32 r[4];
 
 	/*
 	* RAMINDEX bit assignments
-	* When AArch64-RAMINDEX.ID == 0x08 and 32KB of L1 D$
+	* When AArch64-RAMINDEX.ID == 0x04 (48 entries, fully associative)
 	*
-	* [31:24] RAMID		ID of the selected memory (L1 D$ Tag)
-	* [23:19] Reserved
-	* [18] Way
-	* [17:14] Reserved
-	* [13:6] Set		Virtual Address bits [13:6]
-	* [5:0] Reserved
+	* [31:24] RAMID		ID of the selected memory (L1 I-TLB)
+	* [23:6] Reserved
+	* [5:0] Entry
 	*/
-	selector = 0x08000000; /* this selects l1 data cache tag (ramid = 0x08) */
-	selector |= (way & 0x1) << 18;
-	selector |= (set & 0xff) << 6;
+	selector = 0x04000000; /* this selects l1 instruction tlb (ramid = 0x04) */
+	selector |= (set & 0x3f) << 0;
 
-	asm volatile("sys #0, c15, c4, #0, %0" : : "r" (selector));
-	asm volatile("dsb sy");
-	asm volatile("isb");
-	asm volatile("mrs %0, s3_0_c15_c1_0" : "=r" (r0));
-	asm volatile("mrs %0, s3_0_c15_c1_1" : "=r" (r1));
+	ramindex_cortex_a72_ramindex(selector);
+	ramindex_cortex_a72_read_data(false, 4, r);
+
+	ramindex_cortex_a72_decode_tlbentry(set, way, r, e);
+
+	return 0;
+}
 
-	valid = (r1 & 0x3) != 0;
-	dirty = (r1 & 0x3) == 0x3;
-	ns = (r0 >> 30) & 0x1;
-	tag = (r0 & 0x3fffffff) << 14 | (set & 0xff) << 6;
+static int ramindex_cortex_a72_dump_l1d_tlbentry(__s32 set, __s32 way, struct ramindex_tlbentry *e)
+{
+	__u32 selector;
+	__u32 r[4];
 
-	ret |= put_user(set, (__s32 __user *)&l->set);
-	ret |= put_user(way, (__s32 __user *)&l->way);
-	ret |= put_user(valid, (__u8 __user *)&l->valid);
-	ret |= put_user(dirty, (__u8 __user *)&l->dirty);
-	ret |= put_user(ns, (__u8 __user *)&l->ns);
-	ret |= put_user(tag, (__u64 __user *)&l->tag);
-	ret |= put_user(linesize, (__u32 __user *)&l->linesize);
+	/*
+	* RAMINDEX bit assignments
+	* When AArch64-RAMINDEX.ID == 0x0a (32 entries, fully associative)
+	*
+	* [31:24] RAMID		ID of the selected memory (L1 D-TLB)
+	* [23:5] Reserved
+	* [4:0] Entry
+	*/
+	selector = 0x0a000000; /* this selects l1 data tlb (ramid = 0x0a) */
+	selector |= (set & 0x1f) << 0;
 
-	if (ret)
-		return ret;
+	ramindex_cortex_a72_ramindex(selector);
+	ramindex_cortex_a72_read_data(true, 4, r);
+
+	ramindex_cortex_a72_decode_tlbentry(set, way, r, e);
+
+	return 0;
+}
+
+static int ramindex_cortex_a72_dump_l2_tlbentry(__s32 set, __s32 way, struct ramindex_tlbentry *e)
+{
+	__u32 selector;
+	__u32 r[4];
 
 	/*
 	* RAMINDEX bit assignments
-	* When AArch64-RAMINDEX.ID == 0x09 and 32KB of L1 D$
+	* When AArch64-RAMINDEX.ID == 0x18 (1024 entries, 4-way)
 	*
-	* [31:24] RAMID		ID of the selected memory (L1 D$ Data)
-	* [23:19] Reserved
-	* [18] Way
-	* [17:14] Reserved
-	* [13:6] Set		Virtual Address bits [13:6]
-	* [5:4] Bank select
-	* [3] Upper or lower doubleword within the quadword
-	* [2:0] Reserved
+	* [31:24] RAMID		ID of the selected memory (L2 TLB)
+	* [23:20] Reserved
+	* [19:18] Way
+	* [17:8] Reserved
+	* [7:0] Set
 	*/
-	for (ls = 0; !ret && ls < linesize; ls+=sizeof(*linedata)*2, linedata+=2) {
-		selector = 0x09000000; /* this selects l1 data cache data (ramid = 0x09) */
-		selector |= (way & 0x1) << 18;
-		selector |= (set & 0xff) << 6;
-		selector |= ls;
+	selector = 0x18000000; /* this selects l2 tlb (ramid = 0x18) */
+	selector |= (way & 0x3) << 18;
+	selector |= (set & 0xff) << 0;
 
-		asm volatile("sys #0, c15, c4, #0, %0" : : "r" (selector));
-		asm volatile("dsb sy");
-		asm volatile("isb");
-		asm volatile("mrs %0, s3_0_c15_c1_0" : "=r" (r0));
-		asm volatile("mrs %0, s3_0_c15_c1_1" : "=r" (r1));
-
-		if (ls + sizeof(*linedata)*2 < linesize) {
-			ret |= put_user(r0, (__u32 __user *)(linedata + 0));
-			ret |= put_user(r1, (__u32 __user *)(linedata + 1));
-		} else if (ls + sizeof(*linedata) < linesize) {
-			ret |= put_user(r0, (__u32 __user *)(linedata + 0));
-			ret |= copy_to_user((void __user *)(linedata + 1), &r1, linesize - ls - sizeof(*linedata));
-		} else {
-			ret |= copy_to_user((void __user *)(linedata + 0), &r0, linesize - ls);
-		}
-	}
+	ramindex_cortex_a72_ramindex(selector);
+	ramindex_cortex_a72_read_data(true, 4, r);
 
-	return ret;
+	ramindex_cortex_a72_decode_tlbentry(set, way, r, e);
+
+	return 0;
+}
+
+static void ramindex_cortex_a72_bench_access(void)
+{
+	__u32 r0;
+
+	ramindex_cortex_a72_ramindex(0x08000000); /* l1 data cache tag of set 0, way 0 */
+	asm volatile("mrs %0, s3_0_c15_c1_0" : "=r" (r0));
 }
 
 const struct ramindex_ops ramindex_cortex_a72_ops = {
+	.name = "cortex-a72",
 	.dump_l1i_cacheline = ramindex_cortex_a72_dump_l1i_cacheline,
 	.dump_l1d_cacheline = ramindex_cortex_a72_dump_l1d_cacheline,
+	.dump_l2d_cacheline = ramindex_cortex_a72_dump_l2_cacheline,
+	.l1i_tlb = { .nsets = 48, .nways = 1, .dump_entry = ramindex_cortex_a72_dump_l1i_tlbentry },
+	.l1d_tlb = { .nsets = 32, .nways = 1, .dump_entry = ramindex_cortex_a72_dump_l1d_tlbentry },
+	.l2_tlb = { .nsets = 256, .nways = 4, .dump_entry = ramindex_cortex_a72_dump_l2_tlbentry },
+	.bench_access = ramindex_cortex_a72_bench_access,
 };
@@ -21,210 +21,190 @@
 
 #include <linux/types.h>
 #include <linux/errno.h>
-#include <linux/uaccess.h>
-#include <linux/arm-smccc.h>
+#include <linux/sizes.h>
+#include <linux/bitops.h>
 
 #include "ramindex-ops.h"
+#include "ramindex-cpu-svc.h"
 
-#define CPU_SVC_GET_L1I_CACHELINE \
-	ARM_SMCCC_CALL_VAL(ARM_SMCCC_FAST_CALL, ARM_SMCCC_SMC_32, ARM_SMCCC_OWNER_CPU, 0x0001)
-
-#define CPU_SVC_GET_L1D_CACHELINE \
-	ARM_SMCCC_CALL_VAL(ARM_SMCCC_FAST_CALL, ARM_SMCCC_SMC_32, ARM_SMCCC_OWNER_CPU, 0x0002)
-
-#define CPU_SVC_GET_L2U_CACHELINE \
-	ARM_SMCCC_CALL_VAL(ARM_SMCCC_FAST_CALL, ARM_SMCCC_SMC_32, ARM_SMCCC_OWNER_CPU, 0x0003)
-
-#define CPU_SVC_GET_L3U_CACHELINE \
-	ARM_SMCCC_CALL_VAL(ARM_SMCCC_FAST_CALL, ARM_SMCCC_SMC_32, ARM_SMCCC_OWNER_CPU, 0x0004)
+/*
+ * L1 D$ tags hold the state in two bits:
+ * 0b00 Invalid, 0b01 Unique Clean, 0b10 Unique Dirty, 0b11 Shared Clean.
+ */
+static const __u8 ramindex_cortex_a720_l1d_state[4] = {
+	CSTATE_INVALID, CSTATE_UNIQUE_CLEAN, CSTATE_UNIQUE_DIRTY, CSTATE_SHARED_CLEAN
+};
 
-static int ramindex_cortex_a720_dump_l1i_cacheline(__s32 set, __s32 way, __u32 lsize, struct ramindex_cacheline __user *l)
-{
-	__u8 valid;
-	__u8 dirty;
-	__u8 ns;
-	__u64 tag;
-	__u32 linesize;
-	__u64 *linedata;
-	struct arm_smccc_1_2_regs in;
-	struct arm_smccc_1_2_regs out;
-	int ret = 0;
+/*
+ * L2 and (DSU) L3 tags hold the state in three bits:
+ * 0b000 Invalid, 0b001 Shared Clean, 0b010 Unique Clean,
+ * 0b011 Unique Dirty, 0b100 Shared Dirty (other encodings are reserved).
+ */
+static const __u8 ramindex_cortex_a720_l2_state[8] = {
+	CSTATE_INVALID, CSTATE_SHARED_CLEAN, CSTATE_UNIQUE_CLEAN, CSTATE_UNIQUE_DIRTY,
+	CSTATE_SHARED_DIRTY, CSTATE_UNKNOWN, CSTATE_UNKNOWN, CSTATE_UNKNOWN
+};
 
-	ret |= get_user(linesize, (__u32 __user *)&l->linesize);
-	ret |= get_user(linedata, (__u64* __user *)&l->linedata);
+/* page (block) sizes as encoded in TLB entries */
+static const __u64 ramindex_cortex_a720_tlb_pagesize[8] = {
+	SZ_4K, SZ_16K, SZ_64K, SZ_2M, SZ_32M, SZ_512M, SZ_1G, 0
+};
 
-	if (ret)
-		return ret;
+/*
+ * IMP_ISIDE_DATA0_EL3 for L1 I$ tag:
+ *
+ * [27:0] Tag		Physical Address bits [39:12]
+ * [28] NS		Non-secure identifier
+ * [29] Valid
+ */
+static const struct ramindex_cpu_svc_ram ramindex_cortex_a720_l1i = {
+	.fid = CPU_SVC_GET_L1I_CACHELINE,
+	.cache = CPU_SVC_CACHE_L1I,
+	.tag = {
+		.tag_shift = 0, .tag_mask = 0x0fffffff, .tag_lsb = 12, .set_mask = 0x3f,
+		.ns_bit = 28,
+		.state_shift = 29, .state_mask = 0x1, .states = NULL,
+	},
+};
 
-	if (lsize < linesize)
-		linesize = lsize;
+/*
+ * IMP_DSIDE_DATA0_EL3 for L1 D$ tag:
+ *
+ * [1:0] State
+ * [29:2] Tag		Physical Address bits [39:12]
+ * [30] NS		Non-secure identifier
+ */
+static const struct ramindex_cpu_svc_ram ramindex_cortex_a720_l1d = {
+	.fid = CPU_SVC_GET_L1D_CACHELINE,
+	.cache = CPU_SVC_CACHE_L1D,
+	.tag = {
+		.tag_shift = 2, .tag_mask = 0x0fffffff, .tag_lsb = 12, .set_mask = 0x3f,
+		.ns_bit = 30,
+		.state_shift = 0, .state_mask = 0x3, .states = ramindex_cortex_a720_l1d_state,
+	},
+};
 
-	in.a0 = CPU_SVC_GET_L1I_CACHELINE;
-	in.a1 = set;
-	in.a2 = way;
-	arm_smccc_1_2_smc(&in, &out);
+/*
+ * L2 and L3 tags share the format of IMP_DSIDE_DATA0_EL3:
+ *
+ * [2:0] State
+ * [3] NS		Non-secure identifier
+ * [36:4] Tag		Physical Address bits [47:15]
+ *
+ * The tag always holds PA[47:15], so its lowest bits overlap with
+ * the set index of caches having more than 512 sets and are simply OR-ed.
+ */
+static const struct ramindex_cpu_svc_ram ramindex_cortex_a720_l2u = {
+	.fid = CPU_SVC_GET_L2U_CACHELINE,
+	.cache = CPU_SVC_CACHE_L2U,
+	.tag = {
+		.tag_shift = 4, .tag_mask = 0x1ffffffffULL, .tag_lsb = 15, .set_mask = 0x7ff,
+		.ns_bit = 3,
+		.state_shift = 0, .state_mask = 0x7, .states = ramindex_cortex_a720_l2_state,
+	},
+};
 
-	/* Secure Monitor returns SMC_OK on success, and SMC_UNK on error */
-	if (out.a0)
-		return -EFAULT;
+static const struct ramindex_cpu_svc_ram ramindex_cortex_a720_l3u = {
+	.fid = CPU_SVC_GET_L3U_CACHELINE,
+	.cache = CPU_SVC_CACHE_L3U,
+	.tag = {
+		.tag_shift = 4, .tag_mask = 0x1ffffffffULL, .tag_lsb = 15, .set_mask = 0x3fff,
+		.ns_bit = 3,
+		.state_shift = 0, .state_mask = 0x7, .states = ramindex_cortex_a720_l2_state,
+	},
+};
 
-	/* out.a1 contains IMP_ISIDE_DATA0_EL3 for L1 instruction cache tag */
-	valid = (out.a1 >> 29) & 0x1;
-	dirty = 0; /* dirty bit is not present in instruction cache */
-	ns = (out.a1 >> 28) & 0x1;
-	tag = ((out.a1 & 0x0fffffff) << 12) | ((set & 0x3f) << 6);
-
-	ret |= put_user(set, (__s32 __user *)&l->set);
-	ret |= put_user(way, (__s32 __user *)&l->way);
-	ret |= put_user(valid, (__u8 __user *)&l->valid);
-	ret |= put_user(dirty, (__u8 __user *)&l->dirty);
-	ret |= put_user(ns, (__u8 __user *)&l->ns);
-	ret |= put_user(tag, (__u64 __user *)&l->tag);
-	ret |= put_user(linesize, (__u32 __user *)&l->linesize);
-
-	if (ret)
-		return ret;
-
-#define COPY_TO_USER(value, index)                                                        \
-	if (linesize >= 8) {                                                              \
-		ret |= put_user(value, (__u32 __user *)(linedata + index));               \
-		linesize -= 8;                                                            \
-	} else {                                                                          \
-		ret |= copy_to_user((void __user *)(linedata + index), &value, linesize); \
-		break;                                                                    \
-	}
-	/* out.a2 till out.a9 contain cache line data */
-	do {
-		COPY_TO_USER(out.a2, 0);
-		COPY_TO_USER(out.a3, 1);
-		COPY_TO_USER(out.a4, 2);
-		COPY_TO_USER(out.a5, 3);
-		COPY_TO_USER(out.a6, 4);
-		COPY_TO_USER(out.a7, 5);
-		COPY_TO_USER(out.a8, 6);
-		COPY_TO_USER(out.a9, 7);
-	} while (0);
-#undef COPY_TO_USER
-
-	return ret;
-}
+RAMINDEX_CPU_SVC_DUMPFUNCTION(ramindex_cortex_a720, l1i)
+RAMINDEX_CPU_SVC_DUMPFUNCTION(ramindex_cortex_a720, l1d)
+RAMINDEX_CPU_SVC_DUMPFUNCTION(ramindex_cortex_a720, l2u)
+RAMINDEX_CPU_SVC_DUMPFUNCTION(ramindex_cortex_a720, l3u)
 
-static int ramindex_cortex_a720_dump_l1d_cacheline(__s32 set, __s32 way, __u32 lsize, struct ramindex_cacheline __user *l)
+/*
+ * TLB entries are returned in IMP_TLB_DATA0_EL3 to IMP_TLB_DATA2_EL3.
+ *
+ * The layout below has NOT been confirmed against the TRM, neither for the
+ * L1 TLBs nor for the L2 TLB. Entries are hence reported as unverified, with
+ * the registers read returned next to them.
+ *
+ * DATA0 [0] Valid
+ * DATA0 [1] NS		Non-secure identifier
+ * DATA0 [2] nG		Non-global (tagged with ASID)
+ * DATA0 [5:3] Page size	0b000 4KiB, 0b001 16KiB, 0b010 64KiB, 0b011 2MiB,
+ *				0b100 32MiB, 0b101 512MiB, 0b110 1GiB
+ * DATA0 [21:6] ASID
+ * DATA0 [37:22] VMID
+ * DATA1 [36:0] VA		Virtual Address bits [48:12]
+ * DATA2 [35:0] PA		Physical Address bits [47:12]
+ */
+static int ramindex_cortex_a720_dump_tlbentry(__u32 tlb, __s32 set, __s32 way, struct ramindex_tlbentry *e)
 {
-	__u8 valid;
-	__u8 dirty;
-	__u8 ns;
-	__u64 tag;
-	__u32 linesize;
-	__u64 *linedata;
 	struct arm_smccc_1_2_regs in;
 	struct arm_smccc_1_2_regs out;
-	int ret = 0;
 
-	ret |= get_user(linesize, (__u32 __user *)&l->linesize);
-	ret |= get_user(linedata, (__u64* __user *)&l->linedata);
-
-	if (ret)
-		return ret;
-
-	if (lsize < linesize)
-		linesize = lsize;
-
-	in.a0 = CPU_SVC_GET_L1D_CACHELINE;
-	in.a1 = set;
-	in.a2 = way;
-	arm_smccc_1_2_smc(&in, &out);
+	in.a0 = CPU_SVC_GET_TLB_ENTRY;
+	in.a1 = tlb;
+	in.a2 = set;
+	in.a3 = way;
+	ramindex_cpu_svc_smc(&in, &out);
 
 	/* Secure Monitor returns SMC_OK on success, and SMC_UNK on error */
 	if (out.a0)
 		return -EFAULT;
 
-	/* out.a1 contains IMP_DSIDE_DATA0_EL3 for L1 data cache tag */
-	valid = (out.a1 & 0x3) != 0;
-	dirty = (out.a1 & 0x3) == 0x2;
-	ns = (out.a1 >> 30) & 0x1;
-	tag = (((out.a1 >> 2) & 0x0fffffff) << 12) | ((set & 0x3f) << 6);
-
-	ret |= put_user(set, (__s32 __user *)&l->set);
-	ret |= put_user(way, (__s32 __user *)&l->way);
-	ret |= put_user(valid, (__u8 __user *)&l->valid);
-	ret |= put_user(dirty, (__u8 __user *)&l->dirty);
-	ret |= put_user(ns, (__u8 __user *)&l->ns);
-	ret |= put_user(tag, (__u64 __user *)&l->tag);
-	ret |= put_user(linesize, (__u32 __user *)&l->linesize);
-
-	if (ret)
-		return ret;
-
-#define COPY_TO_USER(value, index)                                                        \
-	if (linesize >= 8) {                                                              \
-		ret |= put_user(value, (__u32 __user *)(linedata + index));               \
-		linesize -= 8;                                                            \
-	} else {                                                                          \
-		ret |= copy_to_user((void __user *)(linedata + index), &value, linesize); \
-		break;                                                                    \
-	}
-	/* out.a2 till out.a9 contain cache line data */
-	do {
-		COPY_TO_USER(out.a2, 0);
-		COPY_TO_USER(out.a3, 1);
-		COPY_TO_USER(out.a4, 2);
-		COPY_TO_USER(out.a5, 3);
-		COPY_TO_USER(out.a6, 4);
-		COPY_TO_USER(out.a7, 5);
-		COPY_TO_USER(out.a8, 6);
-		COPY_TO_USER(out.a9, 7);
-	} while (0);
-#undef COPY_TO_USER
-
-	return ret;
+	e->set = set;
+	e->way = way;
+	e->valid = (out.a1 >> 0) & 0x1;
+	e->ns = (out.a1 >> 1) & 0x1;
+	e->global = !((out.a1 >> 2) & 0x1);
+	e->unverified = 1;
+	e->pagesize = ramindex_cortex_a720_tlb_pagesize[(out.a1 >> 3) & 0x7];
+	e->asid = (out.a1 >> 6) & 0xffff;
+	e->vmid = (out.a1 >> 22) & 0xffff;
+	e->va = sign_extend64((out.a2 & GENMASK_ULL(36, 0)) << 12, 48) & ~(e->pagesize - 1);
+	e->pa = ((out.a3 & GENMASK_ULL(35, 0)) << 12) & ~(e->pagesize - 1);
+	e->raw[0] = out.a1;
+	e->raw[1] = out.a2;
+	e->raw[2] = out.a3;
+	e->raw[3] = 0;
+
+	return 0;
 }
 
-static int ramindex_cortex_a720_dump_l2u_cacheline(__s32 set, __s32 way, __u32 lsize, struct ramindex_cacheline __user *l)
+static int ramindex_cortex_a720_dump_l1i_tlbentry(__s32 set, __s32 way, struct ramindex_tlbentry *e)
 {
-	struct arm_smccc_1_2_regs in;
-	struct arm_smccc_1_2_regs out;
-
-	in.a0 = CPU_SVC_GET_L2U_CACHELINE;
-	in.a1 = set;
-	in.a2 = way;
-	arm_smccc_1_2_smc(&in, &out);
-
-	pr_info("%s: %lu, %lu, %lu %lu, %lu, %lu, %lu %lu\n",
-		__func__, out.a0, out.a1, out.a2, out.a3, out.a4, out.a5, out.a6, out.a7);
-
-	if (out.a0)
-		return -EFAULT;
+	return ramindex_cortex_a720_dump_tlbentry(CPU_SVC_TLB_L1I, set, way, e);
+}
 
-	//TODO: Parse response from ATF
+static int ramindex_cortex_a720_dump_l1d_tlbentry(__s32 set, __s32 way, struct ramindex_tlbentry *e)
+{
+	return ramindex_cortex_a720_dump_tlbentry(CPU_SVC_TLB_L1D, set, way, e);
+}
 
-	return 0;
+static int ramindex_cortex_a720_dump_l2_tlbentry(__s32 set, __s32 way, struct ramindex_tlbentry *e)
+{
+	return ramindex_cortex_a720_dump_tlbentry(CPU_SVC_TLB_L2, set, way, e);
 }
 
-static int ramindex_cortex_a720_dump_l3u_cacheline(__s32 set, __s32 way, __u32 lsize, struct ramindex_cacheline __user *l)
+static void ramindex_cortex_a720_bench_access(void)
 {
 	struct arm_smccc_1_2_regs in;
 	struct arm_smccc_1_2_regs out;
 
-	in.a0 = CPU_SVC_GET_L3U_CACHELINE;
-	in.a1 = set;
-	in.a2 = way;
-	arm_smccc_1_2_smc(&in, &out);
-
-	pr_info("%s: %lu, %lu, %lu %lu, %lu, %lu, %lu %lu\n",
-		__func__, out.a0, out.a1, out.a2, out.a3, out.a4, out.a5, out.a6, out.a7);
-
-	if (out.a0)
-		return -EFAULT;
-
-	//TODO: Parse response from ATF
-
-	return 0;
+	in.a0 = CPU_SVC_GET_L1D_CACHELINE;
+	in.a1 = 0; /* set */
+	in.a2 = 0; /* way */
+	in.a3 = ramindex_cpu_svc_flags(0);
+	ramindex_cpu_svc_smc(&in, &out);
 }
 
 const struct ramindex_ops ramindex_cortex_a720_ops = {
+	.name = "cortex-a720",
 	.dump_l1i_cacheline = ramindex_cortex_a720_dump_l1i_cacheline,
 	.dump_l1d_cacheline = ramindex_cortex_a720_dump_l1d_cacheline,
 	.dump_l2d_cacheline = ramindex_cortex_a720_dump_l2u_cacheline,
 	.dump_l3d_cacheline = ramindex_cortex_a720_dump_l3u_cacheline,
+	.l1i_tlb = { .nsets = 48, .nways = 1, .dump_entry = ramindex_cortex_a720_dump_l1i_tlbentry },
+	.l1d_tlb = { .nsets = 48, .nways = 1, .dump_entry = ramindex_cortex_a720_dump_l1d_tlbentry },
+	.l2_tlb = { .nsets = 256, .nways = 6, .dump_entry = ramindex_cortex_a720_dump_l2_tlbentry },
+	.bench_access = ramindex_cortex_a720_bench_access,
 };
@@ -0,0 +1,105 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ramindex-cpu-svc.c
+ *
+ * Copyright (C) 2024 Lukasz Wiecaszek <lukasz.wiecaszek(at)gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License (in file COPYING) for more details.
+ */
+
+#include <linux/types.h>
+#include <linux/errno.h>
+#include <linux/percpu.h>
+#include <linux/irqflags.h>
+#include <linux/bits.h>
+#include <linux/time64.h>
+#include <linux/sched/clock.h>
+
+#include "ramindex-cpu-svc.h"
+
+/*
+ * Tags of a set are used only that long after they have been read, so that
+ * a dump interrupted in the middle of a set (between chunks, or one selecting
+ * some ways only) never picks up tags left over by an earlier one.
+ */
+#define RAMINDEX_CPU_SVC_TAGS_MAX_AGE_NS (100 * NSEC_PER_USEC)
+
+/**
+ * struct ramindex_cpu_svc_tags - tags of one set read by CPU_SVC_GET_TAGS
+ * @ram:	cache the tags belong to
+ * @set:	set the tags belong to
+ * @pending:	ways whose tags have not been returned yet
+ * @read_ns:	when the tags have been read
+ * @tags:	tags of all the ways of the set
+ *
+ * Each tag is returned only once, a line read again (e.g. by
+ * RAMINDEX_ACCESS_VERIFY) makes the whole set to be read again.
+ *
+ * Triggers and BPF programs read tags from interrupt context as well, so the
+ * tags of a cpu are checked and updated with local interrupts disabled.
+ */
+struct ramindex_cpu_svc_tags {
+	const struct ramindex_cpu_svc_ram *ram;
+	__s32 set;
+	u32 pending;
+	u64 read_ns;
+	u64 tags[CPU_SVC_TAGS_MAX];
+};
+
+static DEFINE_PER_CPU(struct ramindex_cpu_svc_tags, ramindex_cpu_svc_tags);
+
+int ramindex_cpu_svc_get_tag(const struct ramindex_cpu_svc_ram *ram, __s32 set, __s32 way, u64 *tag)
+{
+	struct ramindex_cpu_svc_tags *t;
+	struct arm_smccc_1_2_regs in;
+	struct arm_smccc_1_2_regs out;
+	unsigned long flags;
+	u64 now_ns;
+	int retval = 0;
+
+	if (way < 0 || way >= ram->nways || ram->nways > CPU_SVC_TAGS_MAX)
+		return -EINVAL;
+
+	local_irq_save(flags);
+
+	t = this_cpu_ptr(&ramindex_cpu_svc_tags);
+	now_ns = local_clock();
+
+	if (t->ram != ram || t->set != set || !(t->pending & BIT(way)) ||
+		now_ns - t->read_ns > RAMINDEX_CPU_SVC_TAGS_MAX_AGE_NS) {
+		in.a0 = CPU_SVC_GET_TAGS;
+		in.a1 = ram->cache;
+		in.a2 = set;
+		in.a3 = ramindex_cpu_svc_flags(0);
+		ramindex_cpu_svc_smc(&in, &out);
+
+		/* Secure Monitor returns SMC_OK on success, and SMC_UNK on error */
+		if (out.a0) {
+			t->ram = NULL;
+			retval = -EFAULT;
+			goto out;
+		}
+
+		/* out.a1 till out.a16 contain tags of ways 0 till 15 */
+		memcpy(t->tags, &out.a1, ram->nways * sizeof(out.a1));
+		t->ram = ram;
+		t->set = set;
+		t->pending = GENMASK(ram->nways - 1, 0);
+		t->read_ns = now_ns;
+	}
+
+	t->pending &= ~BIT(way);
+	*tag = t->tags[way];
+
+out:
+	local_irq_restore(flags);
+
+	return retval;
+}
@@ -0,0 +1,175 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ramindex-cpu-svc.h
+ *
+ * Copyright (C) 2024 Lukasz Wiecaszek <lukasz.wiecaszek(at)gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License (in file COPYING) for more details.
+ *
+ * Client side of the CPU service in EL3 (atf/ directory), shared by
+ * the backends of cores allowing access to caches' internal memory only
+ * in EL3 (Cortex-A720, Neoverse N1/N2).
+ */
+
+#ifndef _RAMINDEX_CPU_SVC_H_
+#define _RAMINDEX_CPU_SVC_H_
+
+#include <linux/types.h>
+#include <linux/errno.h>
+#include <linux/string.h>
+#include <linux/minmax.h>
+#include <linux/arm-smccc.h>
+
+#include "ramindex-ops.h"
+#include "ramindex-desc.h"
+#include "ramindex-stats.h"
+#include "ramindex-trace.h"
+
+#define CPU_SVC_GET_L1I_CACHELINE \
+	ARM_SMCCC_CALL_VAL(ARM_SMCCC_FAST_CALL, ARM_SMCCC_SMC_32, ARM_SMCCC_OWNER_CPU, 0x0001)
+
+#define CPU_SVC_GET_L1D_CACHELINE \
+	ARM_SMCCC_CALL_VAL(ARM_SMCCC_FAST_CALL, ARM_SMCCC_SMC_32, ARM_SMCCC_OWNER_CPU, 0x0002)
+
+#define CPU_SVC_GET_L2U_CACHELINE \
+	ARM_SMCCC_CALL_VAL(ARM_SMCCC_FAST_CALL, ARM_SMCCC_SMC_32, ARM_SMCCC_OWNER_CPU, 0x0003)
+
+#define CPU_SVC_GET_L3U_CACHELINE \
+	ARM_SMCCC_CALL_VAL(ARM_SMCCC_FAST_CALL, ARM_SMCCC_SMC_32, ARM_SMCCC_OWNER_CPU, 0x0004)
+
+#define CPU_SVC_GET_TLB_ENTRY \
+	ARM_SMCCC_CALL_VAL(ARM_SMCCC_FAST_CALL, ARM_SMCCC_SMC_32, ARM_SMCCC_OWNER_CPU, 0x0005)
+
+#define CPU_SVC_GET_TAGS \
+	ARM_SMCCC_CALL_VAL(ARM_SMCCC_FAST_CALL, ARM_SMCCC_SMC_32, ARM_SMCCC_OWNER_CPU, 0x0006)
+
+/* x1 of CPU_SVC_GET_TLB_ENTRY call */
+#define CPU_SVC_TLB_L1I 0x0
+#define CPU_SVC_TLB_L1D 0x1
+#define CPU_SVC_TLB_L2 0x2
+
+/* x1 of CPU_SVC_GET_TAGS call */
+#define CPU_SVC_CACHE_L1I 0x0
+#define CPU_SVC_CACHE_L1D 0x1
+#define CPU_SVC_CACHE_L2U 0x2
+#define CPU_SVC_CACHE_L3U 0x3
+
+/* x3 flags of CPU_SVC_GET_*_CACHELINE (and CPU_SVC_GET_TAGS) calls */
+#define CPU_SVC_FLAG_TAG_ONLY 0x1 /* do not read line data (x2 till x9 are left untouched) */
+#define CPU_SVC_FLAG_MIN_BARRIERS 0x2 /* minimal access sequence (ignored by older firmware) */
+
+/* CPU_SVC_GET_TAGS returns tags of all the ways of a set in x1 till x16 */
+#define CPU_SVC_TAGS_MAX 16
+
+/**
+ * struct ramindex_cpu_svc_ram - one cache as read through the CPU service
+ * @fid:	function ID of the CPU_SVC_GET_*_CACHELINE call
+ * @cache:	x1 of CPU_SVC_GET_TAGS call (CPU_SVC_CACHE_*)
+ * @nways:	number of ways of the cache, tags of all of them are read
+ *		by one CPU_SVC_GET_TAGS call in tag only accesses, 0 if
+ *		the service does not provide CPU_SVC_GET_TAGS for the cache
+ * @tag:	layout of the tag returned in x1 (register 0)
+ */
+struct ramindex_cpu_svc_ram {
+	u32 fid;
+	u32 cache;
+	u32 nways;
+	struct ramindex_tag_desc tag;
+};
+
+/*
+ * SMC round trip to the CPU service in EL3. The call is timed only
+ * when statistics or ramindex_smc tracepoint are enabled.
+ */
+static __always_inline void ramindex_cpu_svc_smc(const struct arm_smccc_1_2_regs *in,
+	struct arm_smccc_1_2_regs *out)
+{
+	u64 start_ns = 0, duration_ns;
+
+	if (ramindex_stats_on() || trace_ramindex_smc_enabled())
+		start_ns = local_clock();
+
+	arm_smccc_1_2_smc(in, out);
+
+	if (start_ns) {
+		duration_ns = local_clock() - start_ns;
+		ramindex_stats_add(RAMINDEX_CNT_SMCS, 1);
+		ramindex_stats_hist(RAMINDEX_HIST_SMC_NS, duration_ns);
+		trace_ramindex_smc(in->a0, in->a1, in->a2, out->a0, duration_ns);
+	}
+}
+
+/* x3 of CPU_SVC_GET_*_CACHELINE calls (tag only accesses are requested by @linesize of 0) */
+static __always_inline u64 ramindex_cpu_svc_flags(__u32 linesize)
+{
+	return (linesize ? 0 : CPU_SVC_FLAG_TAG_ONLY) |
+		(ramindex_access_minimal() ? CPU_SVC_FLAG_MIN_BARRIERS : 0);
+}
+
+/*
+ * Returns the tag of the line selected by @set and @way of the cache described
+ * by @ram, out of tags of the whole set read by one CPU_SVC_GET_TAGS call.
+ * Called with preemption disabled, from any context (it disables local interrupts
+ * around the per cpu tags itself).
+ */
+int ramindex_cpu_svc_get_tag(const struct ramindex_cpu_svc_ram *ram, __s32 set, __s32 way, u64 *tag);
+
+/*
+ * Reads the line selected by @set and @way of the cache described by @ram.
+ * Always inlined into per cache dump functions passing static const
+ * descriptors (see RAMINDEX_CPU_SVC_DUMPFUNCTION).
+ */
+static __always_inline int ramindex_cpu_svc_dump_cacheline(const struct ramindex_cpu_svc_ram *ram,
+	__s32 set, __s32 way, struct ramindex_line *l, void *linedata, __u32 linesize)
+{
+	struct arm_smccc_1_2_regs in;
+	struct arm_smccc_1_2_regs out;
+	u64 tag;
+	int status;
+
+	if (ram->nways && linesize == 0) {
+		status = ramindex_cpu_svc_get_tag(ram, set, way, &tag);
+		if (status)
+			return status;
+
+		ramindex_decode_tag(&ram->tag, set, way, &tag, l);
+
+		return 0;
+	}
+
+	in.a0 = ram->fid;
+	in.a1 = set;
+	in.a2 = way;
+	in.a3 = ramindex_cpu_svc_flags(linesize);
+	ramindex_cpu_svc_smc(&in, &out);
+
+	/* Secure Monitor returns SMC_OK on success, and SMC_UNK on error */
+	if (out.a0)
+		return -EFAULT;
+
+	/* out.a1 contains IMP_ISIDE_DATA0_EL3/IMP_DSIDE_DATA0_EL3 for the tag */
+	tag = out.a1;
+	ramindex_decode_tag(&ram->tag, set, way, &tag, l);
+
+	/* out.a2 till out.a9 contain cache line data */
+	if (linesize)
+		memcpy(linedata, &out.a2, min_t(__u32, linesize, 8 * sizeof(out.a2)));
+
+	return 0;
+}
+
+/* defines prefix_dump_<cache>_cacheline() reading the cache described by prefix_<cache> */
+#define RAMINDEX_CPU_SVC_DUMPFUNCTION(prefix, cache) \
+static int prefix##_dump_##cache##_cacheline(__s32 set, __s32 way, struct ramindex_line *l, void *linedata, __u32 linesize) \
+{ \
+	return ramindex_cpu_svc_dump_cacheline(&prefix##_##cache, set, way, l, linedata, linesize); \
+}
+
+#endif /* _RAMINDEX_CPU_SVC_H_ */
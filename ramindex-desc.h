@@ -0,0 +1,86 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ramindex-desc.h
+ *
+ * Copyright (C) 2024 Lukasz Wiecaszek <lukasz.wiecaszek(at)gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License (in file COPYING) for more details.
+ */
+
+#ifndef _RAMINDEX_DESC_H_
+#define _RAMINDEX_DESC_H_
+
+#include <linux/types.h>
+#include <linux/compiler.h>
+
+#include "ramindex.h"
+#include "ramindex-line.h"
+
+/**
+ * struct ramindex_tag_desc - layout of a tag as returned by a core
+ * @tag_reg:	index of the register holding the tag
+ * @tag_shift:	position of the tag within @tag_reg
+ * @tag_mask:	mask of the tag (applied after shifting it down)
+ * @tag_lsb:	physical (virtual for VIPT caches) address bit the lowest
+ *		bit of the tag corresponds to
+ * @set_mask:	bits of the set index being address bits [..:6]
+ *		(they are OR-ed into the tag, overlapping bits included)
+ * @ns_reg:	index of the register holding the non-secure identifier
+ * @ns_bit:	position of the non-secure identifier within @ns_reg
+ * @state_reg:	index of the register holding the state
+ * @state_shift:	position of the state within @state_reg
+ * @state_mask:	mask of the state (applied after shifting it down)
+ * @states:	state to enum ramindex_cstate map, NULL if the state is just
+ *		a valid bit (instruction caches, whose lines are never dirty)
+ *
+ * Descriptors are meant to be static const objects passed to the
+ * __always_inline helpers below, so that all the fields end up as
+ * immediates of the generated code. This header depends on nothing but
+ * types, so the decoding is also built into userspace tests.
+ */
+struct ramindex_tag_desc {
+	__u8 tag_reg;
+	__u8 tag_shift;
+	__u8 tag_lsb;
+	__u64 tag_mask;
+	__u32 set_mask;
+	__u8 ns_reg;
+	__u8 ns_bit;
+	__u8 state_reg;
+	__u8 state_shift;
+	__u8 state_mask;
+	const __u8 *states;
+};
+
+/*
+ * Decodes tag registers @r of the line selected by @set and @way into @l.
+ */
+static __always_inline void ramindex_decode_tag(const struct ramindex_tag_desc *desc,
+	__s32 set, __s32 way, const __u64 *r, struct ramindex_line *l)
+{
+	__u64 state = (r[desc->state_reg] >> desc->state_shift) & desc->state_mask;
+
+	l->set = set;
+	l->way = way;
+	if (desc->states) {
+		l->state = desc->states[state];
+		l->valid = l->state != CSTATE_INVALID;
+		l->dirty = l->state == CSTATE_UNIQUE_DIRTY || l->state == CSTATE_SHARED_DIRTY;
+	} else {
+		l->valid = state != 0;
+		l->dirty = 0;
+		l->state = l->valid ? CSTATE_SHARED_CLEAN : CSTATE_INVALID;
+	}
+	l->ns = (r[desc->ns_reg] >> desc->ns_bit) & 0x1;
+	l->tag = ((r[desc->tag_reg] >> desc->tag_shift) & desc->tag_mask) << desc->tag_lsb |
+		(__u64)(set & desc->set_mask) << 6;
+}
+
+#endif /* _RAMINDEX_DESC_H_ */
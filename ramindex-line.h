@@ -0,0 +1,42 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ramindex-line.h
+ *
+ * Copyright (C) 2024 Lukasz Wiecaszek <lukasz.wiecaszek(at)gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License (in file COPYING) for more details.
+ */
+
+#ifndef _RAMINDEX_LINE_H_
+#define _RAMINDEX_LINE_H_
+
+#include <linux/types.h>
+
+/**
+ * struct ramindex_line - one cache line as read by ramindex operations
+ * @set:	the set (index within a way) of a cacheline
+ * @way:	the way requested cacheline belongs to
+ * @valid:	valid bit
+ * @dirty:	dirty bit (valid only for data caches)
+ * @ns:		non-secure identifier for physical address (tag)
+ * @state:	coherence state of the line (enum ramindex_cstate)
+ * @tag:	physical address tag
+ */
+struct ramindex_line {
+	__s32 set;
+	__s32 way;
+	__u8 valid;
+	__u8 dirty;
+	__u8 ns;
+	__u8 state;
+	__u64 tag;
+};
+
+#endif /* _RAMINDEX_LINE_H_ */
@@ -27,18 +27,71 @@
 #include <linux/miscdevice.h>
 #include <linux/fs.h>
 #include <linux/delay.h>
+#include <linux/stddef.h>
+#include <linux/minmax.h>
+#include <linux/preempt.h>
+#include <linux/sched.h>
+#include <linux/sched/signal.h>
+#include <linux/smp.h>
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
+#include <linux/atomic.h>
+#include <linux/timekeeping.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/string.h>
+#include <linux/kprobes.h>
+#include <linux/tracepoint.h>
+#include <linux/vmalloc.h>
+#include <linux/sort.h>
+#include <linux/bsearch.h>
+#include <linux/overflow.h>
+#include <linux/sched/task_stack.h>
+#include <linux/sched/clock.h>
+#include <linux/jump_label.h>
+#include <linux/kstrtox.h>
+#include <linux/perf_event.h>
+#include <linux/workqueue.h>
+#include <linux/eventfd.h>
+#include <linux/poll.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/version.h>
+#include <linux/bitops.h>
 
 #include <linux/uaccess.h>
 
 #include "ramindex.h"
 #include "ramindex-ops.h"
+#include "ramindex-main.h"
+#include "ramindex-bpf.h"
+#include "ramindex-stats.h"
+#include "ramindex-pmu.h"
+#include "ramindex-memcg.h"
+#include "ramindex-placement.h"
 #include "ramindex-cortex-a72.h"
 #include "ramindex-cortex-a720.h"
+#include "ramindex-neoverse.h"
+#include "ramindex-sim.h"
 
-#define ramindex_dbg_at1(args...) do { if (ramindex_debug_level >= 1) pr_info(args); } while (0)
-#define ramindex_dbg_at2(args...) do { if (ramindex_debug_level >= 2) pr_info(args); } while (0)
-#define ramindex_dbg_at3(args...) do { if (ramindex_debug_level >= 3) pr_info(args); } while (0)
-#define ramindex_dbg_at4(args...) do { if (ramindex_debug_level >= 4) pr_info(args); } while (0)
+#define CREATE_TRACE_POINTS
+#include "ramindex-trace.h"
+
+#define RAMINDEX_DEBUG_LEVEL_MAX 4
+
+/* key n is enabled when debug level is greater than n, so disabled messages cost a nop */
+static struct static_key_false ramindex_dbg_keys[RAMINDEX_DEBUG_LEVEL_MAX] = {
+	[0 ... RAMINDEX_DEBUG_LEVEL_MAX - 1] = STATIC_KEY_FALSE_INIT
+};
+
+#define ramindex_dbg_at(level, args...) \
+	do { if (static_branch_unlikely(&ramindex_dbg_keys[(level) - 1])) pr_info(args); } while (0)
+
+#define ramindex_dbg_at1(args...) ramindex_dbg_at(1, args)
+#define ramindex_dbg_at2(args...) ramindex_dbg_at(2, args)
+#define ramindex_dbg_at3(args...) ramindex_dbg_at(3, args)
+#define ramindex_dbg_at4(args...) ramindex_dbg_at(4, args)
 
 #define RAMINDEX_DEVICE_NAME "ramindex"
 
@@ -47,26 +100,195 @@
 	__stringify(RAMINDEX_VERSION_MINOR) "." \
 	__stringify(RAMINDEX_VERSION_MICRO)
 
+/* selector as used by RAMINDEX_DUMP before @nsets and @flags were added */
+#define RAMINDEX_SELECTOR_SIZE_V0 offsetofend(struct ramindex_selector, lines)
+#define RAMINDEX_DUMP_V0 \
+	_IOC(_IOC_READ | _IOC_WRITE, RAMINDEX_MAGIC, 45, RAMINDEX_SELECTOR_SIZE_V0)
+
+/* selector as used by RAMINDEX_DUMP before @npolluted was added */
+#define RAMINDEX_SELECTOR_SIZE_V1 offsetofend(struct ramindex_selector, flags)
+#define RAMINDEX_DUMP_V1 \
+	_IOC(_IOC_READ | _IOC_WRITE, RAMINDEX_MAGIC, 45, RAMINDEX_SELECTOR_SIZE_V1)
+
+#define RAMINDEX_DUMP_F_ALL \
+	(RAMINDEX_DUMP_F_TAGS_ONLY | RAMINDEX_DUMP_F_LOW_PERTURB | RAMINDEX_DUMP_F_VICTIM_LAST)
+
+/* implementer, architecture and part number fields of MIDR_EL1 */
+#define RAMINDEX_MIDR_PART_MASK 0xff0ffff0
+
+/* max number of pages making up the footprint of a low perturbation capture */
+#define RAMINDEX_FOOTPRINT_PAGES_MAX 4096
+
+#define RAMINDEX_CHUNK_LINES_MAX 4096
+
+#define RAMINDEX_BENCH_ITERATIONS_DEFAULT 1024
+#define RAMINDEX_BENCH_ITERATIONS_MAX (1024 * 1024)
+
+/* how long cpus taking part in RAMINDEX_SYNC_DUMP wait for each other */
+#define RAMINDEX_SYNC_TIMEOUT_NS (10 * NSEC_PER_MSEC)
+
 /* module's params */
 static int ramindex_debug_level = 0; /* do not emmit any traces by default */
-module_param_named(debug, ramindex_debug_level, int, 0660);
+
+static int ramindex_set_debug_level(const char *val, const struct kernel_param *kp)
+{
+	int level, i;
+	int status;
+
+	status = kstrtoint(val, 0, &level);
+	if (status)
+		return status;
+
+	level = clamp(level, 0, RAMINDEX_DEBUG_LEVEL_MAX);
+
+	for (i = 0; i < RAMINDEX_DEBUG_LEVEL_MAX; i++) {
+		if (i < level)
+			static_branch_enable(&ramindex_dbg_keys[i]);
+		else
+			static_branch_disable(&ramindex_dbg_keys[i]);
+	}
+
+	*(int *)kp->arg = level;
+
+	return 0;
+}
+
+static const struct kernel_param_ops ramindex_debug_level_ops = {
+	.set = ramindex_set_debug_level,
+	.get = param_get_int,
+};
+
+module_param_cb(debug, &ramindex_debug_level_ops, &ramindex_debug_level, 0660);
 MODULE_PARM_DESC(debug,
 	"Verbosity of debug messages (range: [0(none)-4(max)], default: 0)");
 
+static bool ramindex_sim = false;
+module_param_named(sim, ramindex_sim, bool, 0440);
+MODULE_PARM_DESC(sim,
+	"Use simulated backend instead of the one matching the cpu (default: false)");
+
+static bool ramindex_neoverse = false;
+module_param_named(neoverse, ramindex_neoverse, bool, 0440);
+MODULE_PARM_DESC(neoverse,
+	"Use Neoverse N1/N2 backends (tag layouts not yet confirmed) on matching cpus "
+	"(default: false)");
+
+static unsigned int ramindex_chunk_lines = 64;
+module_param_named(chunk, ramindex_chunk_lines, uint, 0660);
+MODULE_PARM_DESC(chunk,
+	"Number of lines read with preemption disabled before they are copied to userspace "
+	"(range: [1-4096], default: 64)");
+
+DEFINE_STATIC_KEY_FALSE(ramindex_access_minimal_enabled);
+DEFINE_PER_CPU(bool, ramindex_access_conservative);
+
+static int ramindex_access = RAMINDEX_ACCESS_CONSERVATIVE;
+
+static int ramindex_set_access(const char *val, const struct kernel_param *kp)
+{
+	int access;
+	int status;
+
+	status = kstrtoint(val, 0, &access);
+	if (status)
+		return status;
+
+	if (access < 0 || access >= RAMINDEX_ACCESS_NR)
+		return -EINVAL;
+
+	if (access == RAMINDEX_ACCESS_CONSERVATIVE)
+		static_branch_disable(&ramindex_access_minimal_enabled);
+	else
+		static_branch_enable(&ramindex_access_minimal_enabled);
+
+	WRITE_ONCE(*(int *)kp->arg, access);
+
+	return 0;
+}
+
+static const struct kernel_param_ops ramindex_access_ops = {
+	.set = ramindex_set_access,
+	.get = param_get_int,
+};
+
+module_param_cb(access, &ramindex_access_ops, &ramindex_access, 0660);
+MODULE_PARM_DESC(access,
+	"RAMINDEX access sequence (0: conservative, 1: minimal barriers, "
+	"2: read every line both ways and compare, default: 0)");
+
 /**
  * struct ramindex_device - groups device related data structures
  * @miscdev:	our character device
+ * @quiet_lock:	serializes users of @quiet_lines
+ * @quiet_nlines:	number of entries in @quiet_lines
+ * @quiet_lines:	page aligned buffer for RAMINDEX_DUMP_F_LOW_PERTURB captures,
+ *		large enough for the biggest of them
+ * @async_wq:	per cpu workqueue running RAMINDEX_ASYNC_SUBMIT requests
  */
 struct ramindex_device {
 	struct miscdevice miscdev;
 	__u64 midr_el1;
 	__u64 clidr_el1;
 	const struct ramindex_ops *ops;
+	struct mutex quiet_lock;
+	__u32 quiet_nlines;
+	struct ramindex_line *quiet_lines;
+	struct workqueue_struct *async_wq;
 };
 
 static struct ramindex_device ramindex_device;
 
-static void ramindex_get_ccsidr(struct ramindex_ccsidr *ccsidr)
+/**
+ * struct ramindex_file - state of one open file
+ * @lock:	protects @completed, @noutstanding and @nrunning
+ * @wq:		woken up whenever a request completes
+ * @completed:	completed and not yet reaped requests, in order of completion
+ * @noutstanding:	number of submitted and not yet reaped requests
+ * @nrunning:	number of submitted and not yet completed requests
+ */
+struct ramindex_file {
+	spinlock_t lock;
+	wait_queue_head_t wq;
+	struct list_head completed;
+	__u32 noutstanding;
+	__u32 nrunning;
+};
+
+/**
+ * struct ramindex_async_request - one RAMINDEX_ASYNC_SUBMIT request
+ * @work:	reads the lines on the selected cpu
+ * @node:	links the request into @file->completed
+ * @file:	file the request has been submitted through
+ * @eventfd:	signalled on completion (NULL if none)
+ * @async:	the request as submitted
+ * @df:		dump function of the selected cache
+ * @start_set:	first selected set
+ * @end_set:	one past the last selected set
+ * @start_way:	first selected way
+ * @end_way:	one past the last selected way
+ * @linesize:	number of bytes of every line to be read (0 for tags only)
+ * @total:	number of lines to be read
+ * @lines:	lines read by the worker
+ * @data:	content of the lines read by the worker
+ * @completion:	filled by the worker
+ */
+struct ramindex_async_request {
+	struct work_struct work;
+	struct list_head node;
+	struct ramindex_file *file;
+	struct eventfd_ctx *eventfd;
+	struct ramindex_async async;
+	dumpfunction_t df;
+	__s32 start_set, end_set;
+	__s32 start_way, end_way;
+	__u32 linesize;
+	__u32 total;
+	struct ramindex_line *lines;
+	__u8 *data;
+	struct ramindex_async_completion completion;
+};
+
+void ramindex_get_ccsidr(struct ramindex_ccsidr *ccsidr)
 {
 	__u64 csselr_el1;
 	__u64 id_aa64mmfr2_el1;
@@ -75,10 +297,12 @@ static void ramindex_get_ccsidr(struct ramindex_ccsidr *ccsidr)
 
 	csselr_el1 = ((ccsidr->level & 0x7) << 1) | (ccsidr->icache & 0x1);
 
+	preempt_disable(); /* csselr_el1 and ccsidr_el1 have to be accessed on the same cpu */
 	asm volatile("msr csselr_el1, %0" : : "r" (csselr_el1)); /* select cache level */
 	asm volatile("isb"); /* sync change of cssidr_el1 */
 	asm volatile("mrs %0, s3_0_c0_c7_2" : "=r" (id_aa64mmfr2_el1)); /* read the id_aa64mmfr2_el1 */
 	asm volatile("mrs %0, ccsidr_el1" : "=r" (ccsidr_el1)); /* read the ccsidr_el1 */
+	preempt_enable();
 
 	ramindex_dbg_at2("ccsidr_el1: 0x%llx\n", ccsidr_el1);
 
@@ -159,35 +383,151 @@ static long ramindex_ioctl_ccsidr(void __user *ubuf, size_t size)
 	return 0;
 }
 
-static long ramindex_ioctl_dump(void __user *ubuf, size_t size)
+static int ramindex_copy_lines(struct ramindex_cacheline __user *ulines,
+	const struct ramindex_line *lines, const __u8 *data, __u32 n, __u32 linesize)
 {
-	long status = -EFAULT;
-	__s32 start_set, end_set, set;
-	__s32 start_way, end_way, way;
-	__u32 nlines = 0;
-	struct ramindex_selector selector;
-	struct ramindex_ccsidr ccsidr;
-	dumpfunction_t df = NULL;
+	struct ramindex_cacheline cacheline;
+	__u32 i;
 
-	if (size != sizeof(struct ramindex_selector))
-		return -EINVAL;
+	for (i = 0; i < n; i++) {
+		if (copy_from_user(&cacheline, ulines + i, sizeof(cacheline)))
+			return -EFAULT;
 
-	if (copy_from_user(&selector, ubuf, sizeof(selector)))
-		return -EFAULT;
+		cacheline.set = lines[i].set;
+		cacheline.way = lines[i].way;
+		cacheline.valid = lines[i].valid;
+		cacheline.dirty = lines[i].dirty;
+		cacheline.ns = lines[i].ns;
+		cacheline.state = lines[i].state;
+		cacheline.tag = lines[i].tag;
+		cacheline.linesize = min(cacheline.linesize, linesize);
+
+		if (copy_to_user(ulines + i, &cacheline, sizeof(cacheline)))
+			return -EFAULT;
+
+		if (cacheline.linesize &&
+			copy_to_user((void __user *)cacheline.linedata,
+				data + i * linesize, cacheline.linesize))
+			return -EFAULT;
+	}
+
+	return 0;
+}
+
+/* lines bigger than that are not verified (there is no room to keep them aside) */
+#define RAMINDEX_VERIFY_LINESIZE_MAX 256
+
+struct ramindex_verify_buffer {
+	u8 data[2][RAMINDEX_VERIFY_LINESIZE_MAX];
+};
+
+static DEFINE_PER_CPU(struct ramindex_verify_buffer, ramindex_verify_buffers);
+
+static bool ramindex_lines_equal(const struct ramindex_line *a, const void *adata,
+	const struct ramindex_line *b, const void *bdata, __u32 linesize)
+{
+	return a->valid == b->valid && a->dirty == b->dirty && a->ns == b->ns &&
+		a->state == b->state && a->tag == b->tag &&
+		(linesize == 0 || memcmp(adata, bdata, linesize) == 0);
+}
+
+static int ramindex_verify_reference(dumpfunction_t df, __s32 set, __s32 way,
+	struct ramindex_line *l, void *linedata, __u32 linesize)
+{
+	int status;
+
+	this_cpu_write(ramindex_access_conservative, true);
+	status = df(set, way, l, linedata, linesize);
+	this_cpu_write(ramindex_access_conservative, false);
+
+	return status;
+}
+
+/*
+ * Reads the line with the conservative and with the minimal sequence.
+ * Lines of shared caches (and snooped lines of private ones) may legitimately
+ * change in between, so a difference is reported only if another conservative
+ * read agrees with the first one. Called with preemption disabled.
+ */
+static int ramindex_verify_line(dumpfunction_t df, __s32 set, __s32 way,
+	struct ramindex_line *l, void *linedata, __u32 linesize)
+{
+	struct ramindex_verify_buffer *buffer = this_cpu_ptr(&ramindex_verify_buffers);
+	struct ramindex_line ref[2];
+	int status;
+
+	if (linesize > RAMINDEX_VERIFY_LINESIZE_MAX)
+		return df(set, way, l, linedata, linesize);
+
+	status = ramindex_verify_reference(df, set, way, &ref[0], buffer->data[0], linesize);
+	if (status)
+		return status;
+
+	status = df(set, way, l, linedata, linesize);
+	if (status)
+		return status;
+
+	if (ramindex_lines_equal(l, linedata, &ref[0], buffer->data[0], linesize))
+		return 0;
+
+	status = ramindex_verify_reference(df, set, way, &ref[1], buffer->data[1], linesize);
+	if (status)
+		return status;
+
+	if (!ramindex_lines_equal(&ref[0], buffer->data[0], &ref[1], buffer->data[1], linesize))
+		return 0;
+
+	ramindex_stats_add(RAMINDEX_CNT_MISMATCHES, 1);
+	pr_warn_ratelimited(
+		"Minimal access sequence read set %d way %d differently than the conservative one\n",
+		set, way);
+
+	return -EIO;
+}
+
+#define RAMINDEX_VERIFY_DUMPFUNCTION(name) \
+static int ramindex_verify_##name(__s32 set, __s32 way, struct ramindex_line *l, void *linedata, __u32 linesize) \
+{ \
+	return ramindex_verify_line(ramindex_device.ops->name, set, way, l, linedata, linesize); \
+}
+
+RAMINDEX_VERIFY_DUMPFUNCTION(dump_l1i_cacheline)
+RAMINDEX_VERIFY_DUMPFUNCTION(dump_l1d_cacheline)
+RAMINDEX_VERIFY_DUMPFUNCTION(dump_l2i_cacheline)
+RAMINDEX_VERIFY_DUMPFUNCTION(dump_l2d_cacheline)
+RAMINDEX_VERIFY_DUMPFUNCTION(dump_l3i_cacheline)
+RAMINDEX_VERIFY_DUMPFUNCTION(dump_l3d_cacheline)
+
+/* indexed by level and icache */
+static const dumpfunction_t ramindex_verify_dumpfunctions[3][2] = {
+	{ ramindex_verify_dump_l1d_cacheline, ramindex_verify_dump_l1i_cacheline },
+	{ ramindex_verify_dump_l2d_cacheline, ramindex_verify_dump_l2i_cacheline },
+	{ ramindex_verify_dump_l3d_cacheline, ramindex_verify_dump_l3i_cacheline },
+};
+
+dumpfunction_t ramindex_get_dumpfunction(__s32 level, __s32 icache)
+{
+	dumpfunction_t df;
+
+	/* the module is loaded on unknown cpus as well, for their geometries only */
+	if (ramindex_device.ops == NULL) {
+		ramindex_dbg_at1("There is no backend for this cpu\n");
+		return NULL;
+	}
 
-	switch (selector.level) {
+	switch (level) {
 	case 0:
-		df = selector.icache ?
+		df = icache ?
 			ramindex_device.ops->dump_l1i_cacheline :
 			ramindex_device.ops->dump_l1d_cacheline;
 		break;
 	case 1:
-		df = selector.icache ?
+		df = icache ?
 			ramindex_device.ops->dump_l2i_cacheline :
 			ramindex_device.ops->dump_l2d_cacheline;
 		break;
 	case 2:
-		df = selector.icache ?
+		df = icache ?
 			ramindex_device.ops->dump_l3i_cacheline :
 			ramindex_device.ops->dump_l3d_cacheline;
 		break;
@@ -196,146 +536,2402 @@ static long ramindex_ioctl_dump(void __user *ubuf, size_t size)
 		break;
 	}
 
-	/* Validate arguments */
-	if (df == NULL) {
+	if (df == NULL)
 		ramindex_dbg_at1(
 			"There is no associated operation to dump L%d %s cache\n",
-			selector.level + 1, selector.icache ? "instruction" : "data");
-		return -EOPNOTSUPP;
-	}
+			level + 1, icache ? "instruction" : "data");
+	else if (READ_ONCE(ramindex_access) == RAMINDEX_ACCESS_VERIFY)
+		df = ramindex_verify_dumpfunctions[level][icache ? 1 : 0];
 
-	memset(&ccsidr, 0, sizeof(ccsidr));
-	ccsidr.level = selector.level;
-	ccsidr.icache = selector.icache;
-	ramindex_get_ccsidr(&ccsidr);
+	return df;
+}
 
-	if (selector.set >= 0 && selector.set >= ccsidr.nsets) {
-		ramindex_dbg_at1(
-			"Selected L%d %s cache has %d sets whereas %d set has been requested\n",
-			selector.level + 1, selector.icache ? "instruction" : "data",
-			ccsidr.nsets, selector.set);
-		return -EINVAL;
-	}
+static int ramindex_pfn_compare(const void *a, const void *b)
+{
+	unsigned long pa = *(const unsigned long *)a;
+	unsigned long pb = *(const unsigned long *)b;
 
-	if (selector.way >= 0 && selector.way >= ccsidr.nways) {
-		ramindex_dbg_at1(
-			"Selected L%d %s cache has %d ways whereas %d way has been requested\n",
-			selector.level + 1, selector.icache ? "instruction" : "data",
-			ccsidr.nways, selector.way);
-		return -EINVAL;
-	}
+	return pa < pb ? -1 : pa > pb;
+}
 
-	if (selector.set < 0)
-		start_set = 0, end_set = ccsidr.nsets;
-	else
-		start_set = selector.set, end_set = selector.set + 1;
+static unsigned long ramindex_addr_to_pfn(const void *addr)
+{
+	if (is_vmalloc_or_module_addr(addr))
+		return vmalloc_to_pfn(addr);
 
-	if (selector.way < 0)
-		start_way = 0, end_way = ccsidr.nways;
-	else
-		start_way = selector.way, end_way = selector.way + 1;
-
-	for (set = start_set; set < end_set; set++)
-		for (way = start_way; way < end_way; way++)
-			if (nlines < selector.nlines) {
-				struct ramindex_cacheline __user *cacheline =
-					selector.lines + nlines;
-				status = df(set, way, ccsidr.linesize, cacheline);
-				if (status)
+	return virt_to_pfn(addr);
+}
+
+/*
+ * The tight loop of low perturbation captures. It runs with interrupts
+ * disabled, touches nothing but the (sequentially written) buffer and
+ * calls nothing but the dump function, so the only lines it brings into
+ * the caches are its own code, a few stack lines and the buffer.
+ * Sets are read in up to three ranges: [r[0], r[1]), [r[2], r[3]), [r[4], r[5]).
+ */
+static noinline __u32 ramindex_quiet_read(dumpfunction_t df, const __s32 *r,
+	__s32 start_way, __s32 end_way, struct ramindex_line *lines, __u32 nlines, int *status)
+{
+	unsigned long flags;
+	__u32 n = 0;
+	__s32 set, way;
+	int i;
+
+	local_irq_save(flags);
+	for (i = 0; i < 6; i += 2)
+		for (set = r[i]; set < r[i + 1]; set++)
+			for (way = start_way; way < end_way && n < nlines; way++) {
+				*status = df(set, way, &lines[n], NULL, 0);
+				if (*status)
 					goto out;
-				nlines++;
+				n++;
 			}
-			else
-				goto out;
 out:
-	if (status)
-		return status;
+	local_irq_restore(flags);
 
-	put_user(nlines, (__u32 __user *)&(((struct ramindex_selector *)ubuf)->nlines));
+	return n;
+}
 
-	return 0;
+/*
+ * Collects (sorted) frames holding the footprint of a low perturbation capture:
+ * the code reading the lines, the device data, the stack and the buffer.
+ */
+static __u32 ramindex_quiet_footprint(unsigned long *pfns, dumpfunction_t df,
+	const struct ramindex_line *lines, __u32 nlines)
+{
+	const void *objs[] = {
+		ramindex_quiet_read, df, &ramindex_device, ramindex_device.ops,
+	};
+	const char *stack = task_stack_page(current);
+	const char *buf = (const char *)lines;
+	size_t len = (size_t)nlines * sizeof(*lines);
+	__u32 n = 0;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(objs); i++)
+		pfns[n++] = ramindex_addr_to_pfn(objs[i]);
+
+	for (i = 0; i < THREAD_SIZE && n < RAMINDEX_FOOTPRINT_PAGES_MAX; i += PAGE_SIZE)
+		pfns[n++] = ramindex_addr_to_pfn(stack + i);
+
+	for (i = 0; i < len && n < RAMINDEX_FOOTPRINT_PAGES_MAX; i += PAGE_SIZE)
+		pfns[n++] = ramindex_addr_to_pfn(buf + i);
+
+	sort(pfns, n, sizeof(*pfns), ramindex_pfn_compare, NULL);
+
+	return n;
 }
 
-static long ramindex_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+static long ramindex_dump_quiet(void __user *ubuf, size_t size,
+	const struct ramindex_selector *selector, const struct ramindex_ccsidr *ccsidr,
+	dumpfunction_t df, __u32 *nread)
 {
-	long ret = -EFAULT;
-	size_t size = _IOC_SIZE(cmd);
-	void __user *ubuf = (void __user *)arg;
+	long status = 0;
+	int rstatus = 0;
+	__s32 r[6];
+	__s32 victim_start, victim_end;
+	__s32 start_way, end_way;
+	__u32 total, nlines, npolluted = 0, nfootprint, i;
+	u64 start_ns;
+	unsigned long *pfns;
+	struct ramindex_line *lines;
 
-	ramindex_dbg_at3("%s() cmd: %u '%s'\n",
-		__func__, cmd, ramindex_cmd_to_string(cmd));
+	if (selector->set < 0)
+		victim_start = victim_end = 0;
+	else
+		victim_start = selector->set, victim_end = selector->set + max(selector->nsets, 1);
 
-	switch (cmd) {
-	case RAMINDEX_VERSION:
-		ret = ramindex_ioctl_version(ubuf, size);
-		break;
-	case RAMINDEX_CLID:
-		ret = ramindex_ioctl_clid(ubuf, size);
-		break;
-	case RAMINDEX_CCSIDR:
-		ret = ramindex_ioctl_ccsidr(ubuf, size);
-		break;
-	case RAMINDEX_DUMP:
-		ret = ramindex_ioctl_dump(ubuf, size);
-		break;
-	default:
-		msleep(1000); /* deliberately sleep for 1 second */
-		ret = -EINVAL;
-		break;
+	if (selector->way < 0)
+		start_way = 0, end_way = ccsidr->nways;
+	else
+		start_way = selector->way, end_way = selector->way + 1;
+
+	/* the whole capture runs with interrupts disabled, so it is bounded to L1 sized reads */
+	if ((__u32)ccsidr->nsets * (end_way - start_way) > RAMINDEX_LOW_PERTURB_LINES_MAX) {
+		ramindex_dbg_at1("L%d cache has more than %d lines to be captured at once\n",
+			selector->level + 1, RAMINDEX_LOW_PERTURB_LINES_MAX);
+		return -E2BIG;
 	}
 
-	return ret;
-}
+	if (selector->flags & RAMINDEX_DUMP_F_VICTIM_LAST) {
+		r[0] = 0, r[1] = victim_start;
+		r[2] = victim_end, r[3] = ccsidr->nsets;
+		r[4] = victim_start, r[5] = victim_end;
+	} else {
+		r[0] = victim_start, r[1] = victim_end;
+		r[2] = 0, r[3] = victim_start;
+		r[4] = victim_end, r[5] = ccsidr->nsets;
+	}
 
-const struct file_operations ramindex_fops = {
-	.owner = THIS_MODULE,
-	.unlocked_ioctl = ramindex_ioctl,
-};
+	total = min_t(__u32, selector->nlines, ccsidr->nsets * (end_way - start_way));
 
-static int __init ramindex_init(void)
-{
-	int status;
-	__u64 midr_el1;
-	__u64 clidr_el1;
+	pfns = kmalloc_array(RAMINDEX_FOOTPRINT_PAGES_MAX, sizeof(*pfns), GFP_KERNEL);
+	if (pfns == NULL)
+		return -ENOMEM;
 
-	asm volatile("mrs %0, midr_el1" : "=r" (midr_el1));
-	asm volatile("mrs %0, clidr_el1" : "=r" (clidr_el1));
+	mutex_lock(&ramindex_device.quiet_lock);
 
-	switch (midr_el1) {
-	case 0x410fd083:
-		ramindex_device.ops = &ramindex_cortex_a72_ops;
-		break;
-	case 0x410fd811:
-		ramindex_device.ops = &ramindex_cortex_a720_ops;
-		break;
-	default:
-		status = -EOPNOTSUPP;
-		break;
+	lines = ramindex_device.quiet_lines;
+	if (lines == NULL || total > ramindex_device.quiet_nlines) {
+		status = -ENOMEM;
+		goto out;
 	}
 
-	ramindex_device.midr_el1 = midr_el1;
-	ramindex_device.clidr_el1 = clidr_el1;
+	/* collected beforehand, so that the capture itself does not touch @pfns */
+	nfootprint = ramindex_quiet_footprint(pfns, df, lines, total);
 
-	ramindex_device.miscdev.fops = &ramindex_fops;
-	ramindex_device.miscdev.minor = MISC_DYNAMIC_MINOR;
-	ramindex_device.miscdev.name = RAMINDEX_DEVICE_NAME;
-	status = misc_register(&ramindex_device.miscdev);
-	if (status < 0) {
-		pr_err("misc_register(%s) failed with code %d\n",
-			ramindex_device.miscdev.name, status);
-		return status;
+	start_ns = ramindex_stats_clock();
+	preempt_disable();
+	nlines = ramindex_quiet_read(df, r, start_way, end_way, lines, total, &rstatus);
+	ramindex_stats_hist_since(RAMINDEX_HIST_PREEMPT_OFF_NS, start_ns);
+	preempt_enable();
+
+	if (rstatus) {
+		status = rstatus;
+		goto out;
+	}
+
+	/* traced only after the capture, so that tracing does not add to the footprint */
+	if (trace_ramindex_line_enabled())
+		for (i = 0; i < nlines; i++)
+			trace_ramindex_line(lines[i].set, lines[i].way, lines[i].valid,
+				lines[i].dirty, lines[i].state, lines[i].tag);
+
+	for (i = 0; i < nlines; i++) {
+		unsigned long pfn = lines[i].tag >> PAGE_SHIFT;
+
+		if (lines[i].valid &&
+			bsearch(&pfn, pfns, nfootprint, sizeof(*pfns), ramindex_pfn_compare))
+			npolluted++;
 	}
 
-	pr_info("module loaded (version: %s, midr_el1: 0x%llx, clidr_el1: 0x%llx)\n",
-		RAMINDEX_VERSION_STR, midr_el1, clidr_el1);
+	ramindex_dbg_at2("Low perturbation capture of %u lines, %u of them polluted\n",
+		nlines, npolluted);
+
+	status = ramindex_copy_lines((struct ramindex_cacheline __user *)selector->lines,
+		lines, NULL, nlines, 0);
+	if (status)
+		goto out;
+
+	put_user(nlines, (__u32 __user *)&(((struct ramindex_selector *)ubuf)->nlines));
+	if (size >= offsetofend(struct ramindex_selector, npolluted))
+		put_user(npolluted,
+			(__u32 __user *)&(((struct ramindex_selector *)ubuf)->npolluted));
+
+	*nread = nlines;
+
+out:
+	mutex_unlock(&ramindex_device.quiet_lock);
+	kfree(pfns);
+
+	return status;
+}
+
+/*
+ * Allocates the buffer for low perturbation captures, large enough for tags
+ * of all the lines of the biggest cache we have a dump function for,
+ * but for no more than RAMINDEX_LOW_PERTURB_LINES_MAX lines.
+ */
+static int ramindex_quiet_alloc(void)
+{
+	struct ramindex_ccsidr ccsidr;
+	__u32 nlines = 0;
+	int level, icache;
+
+	for (level = 0; level < 3; level++)
+		for (icache = 0; icache < 2; icache++) {
+			if (ramindex_get_dumpfunction(level, icache) == NULL)
+				continue;
+			memset(&ccsidr, 0, sizeof(ccsidr));
+			ccsidr.level = level;
+			ccsidr.icache = icache;
+			ramindex_get_ccsidr(&ccsidr);
+			nlines = max_t(__u32, nlines, ccsidr.nsets * ccsidr.nways);
+		}
+
+	if (nlines == 0)
+		return 0;
+
+	nlines = min_t(__u32, nlines, RAMINDEX_LOW_PERTURB_LINES_MAX);
+
+	/* vmalloc() always returns page aligned memory */
+	ramindex_device.quiet_lines = vmalloc(array_size(nlines, sizeof(struct ramindex_line)));
+	if (ramindex_device.quiet_lines == NULL)
+		return -ENOMEM;
+
+	ramindex_device.quiet_nlines = nlines;
+
 	return 0;
 }
-module_init(ramindex_init);
 
-#ifdef MODULE
-static void __exit ramindex_exit(void)
+static bool ramindex_selector_valid(const struct ramindex_selector *selector,
+	const struct ramindex_ccsidr *ccsidr)
 {
-	misc_deregister(&ramindex_device.miscdev);
+	if (selector->set >= 0 && selector->set >= ccsidr->nsets) {
+		ramindex_dbg_at1(
+			"Selected L%d %s cache has %d sets whereas %d set has been requested\n",
+			selector->level + 1, selector->icache ? "instruction" : "data",
+			ccsidr->nsets, selector->set);
+		return false;
+	}
+
+	if (selector->set >= 0 &&
+		(selector->nsets < 0 || selector->nsets > ccsidr->nsets - selector->set)) {
+		ramindex_dbg_at1(
+			"Selected L%d %s cache has %d sets whereas %d sets from set %d have been requested\n",
+			selector->level + 1, selector->icache ? "instruction" : "data",
+			ccsidr->nsets, selector->nsets, selector->set);
+		return false;
+	}
+
+	if (selector->way >= 0 && selector->way >= ccsidr->nways) {
+		ramindex_dbg_at1(
+			"Selected L%d %s cache has %d ways whereas %d way has been requested\n",
+			selector->level + 1, selector->icache ? "instruction" : "data",
+			ccsidr->nways, selector->way);
+		return false;
+	}
+
+	return true;
+}
+
+/* range of sets and ways selected by already validated @selector */
+static void ramindex_selector_range(const struct ramindex_selector *selector,
+	const struct ramindex_ccsidr *ccsidr, __s32 *start_set, __s32 *end_set,
+	__s32 *start_way, __s32 *end_way)
+{
+	if (selector->set < 0)
+		*start_set = 0, *end_set = ccsidr->nsets;
+	else
+		*start_set = selector->set, *end_set = selector->set + max(selector->nsets, 1);
+
+	if (selector->way < 0)
+		*start_way = 0, *end_way = ccsidr->nways;
+	else
+		*start_way = selector->way, *end_way = selector->way + 1;
+}
+
+static void ramindex_dump_done(__s32 level, __s32 icache,
+	__u32 nlines, __u64 bytes, long status, u64 start_ns)
+{
+	trace_ramindex_dump_end(level, icache, nlines, bytes, status, local_clock() - start_ns);
+
+	ramindex_stats_add(RAMINDEX_CNT_DUMPS, 1);
+	ramindex_stats_add(RAMINDEX_CNT_LINES, nlines);
+	ramindex_stats_add(RAMINDEX_CNT_BYTES, bytes);
+	if (status)
+		ramindex_stats_add(RAMINDEX_CNT_ERRORS, 1);
+	ramindex_stats_hist(RAMINDEX_HIST_LINES, nlines);
+	ramindex_stats_hist(RAMINDEX_HIST_BYTES, bytes);
+}
+
+/* RAMINDEX_DUMP of an already copied @selector, called with migration disabled */
+static long ramindex_dump(void __user *ubuf, size_t size, const struct ramindex_selector *sel)
+{
+	long status = 0;
+	__s32 start_set, end_set;
+	__s32 start_way, end_way;
+	__u32 nlines = 0, total, chunk, n;
+	__u32 linesize;
+	__u64 bytes = 0;
+	u64 start_ns, chunk_ns;
+	struct ramindex_selector selector = *sel;
+	struct ramindex_ccsidr ccsidr;
+	struct ramindex_line *lines;
+	__u8 *data = NULL;
+	dumpfunction_t df = NULL;
+
+	/* Validate arguments */
+	df = ramindex_get_dumpfunction(selector.level, selector.icache);
+	if (df == NULL)
+		return -EOPNOTSUPP;
+
+	memset(&ccsidr, 0, sizeof(ccsidr));
+	ccsidr.level = selector.level;
+	ccsidr.icache = selector.icache;
+	ramindex_get_ccsidr(&ccsidr);
+
+	if (!ramindex_selector_valid(&selector, &ccsidr))
+		return -EINVAL;
+
+	trace_ramindex_dump_start(selector.level, selector.icache, selector.nlines, selector.flags);
+	start_ns = local_clock();
+
+	if (selector.flags & RAMINDEX_DUMP_F_LOW_PERTURB) {
+		status = ramindex_dump_quiet(ubuf, size, &selector, &ccsidr, df, &nlines);
+		ramindex_dump_done(selector.level, selector.icache, nlines,
+			(__u64)nlines * sizeof(struct ramindex_cacheline), status, start_ns);
+		return status;
+	}
+
+	ramindex_selector_range(&selector, &ccsidr, &start_set, &end_set, &start_way, &end_way);
+
+	linesize = (selector.flags & RAMINDEX_DUMP_F_TAGS_ONLY) ? 0 : ccsidr.linesize;
+	total = min_t(__u32, selector.nlines, (end_set - start_set) * (end_way - start_way));
+	chunk = clamp_t(__u32, READ_ONCE(ramindex_chunk_lines), 1, RAMINDEX_CHUNK_LINES_MAX);
+
+	lines = kmalloc_array(chunk, sizeof(*lines), GFP_KERNEL);
+	if (linesize)
+		data = kmalloc_array(chunk, linesize, GFP_KERNEL);
+	if (lines == NULL || (linesize && data == NULL)) {
+		status = -ENOMEM;
+		goto out;
+	}
+
+	/*
+	 * Lines are read in chunks with preemption disabled (so that all the
+	 * accesses needed to read a line are issued on the same cpu) into kernel
+	 * buffers, and copied to userspace only afterwards, when sleeping is allowed.
+	 * Thus the cpu is never held for longer than it takes to read one chunk.
+	 */
+	for (nlines = 0; nlines < total; nlines += n) {
+		memset(lines, 0, chunk * sizeof(*lines));
+
+		chunk_ns = ramindex_stats_clock();
+		preempt_disable();
+		for (n = 0; n < min(chunk, total - nlines); n++) {
+			__u32 index = nlines + n;
+			__s32 set = start_set + index / (end_way - start_way);
+			__s32 way = start_way + index % (end_way - start_way);
+
+			status = df(set, way, &lines[n], data ? data + n * linesize : NULL, linesize);
+			if (status)
+				break;
+
+			trace_ramindex_line(set, way, lines[n].valid, lines[n].dirty,
+				lines[n].state, lines[n].tag);
+		}
+		ramindex_stats_hist_since(RAMINDEX_HIST_PREEMPT_OFF_NS, chunk_ns);
+		preempt_enable();
+
+		if (status)
+			goto out;
+
+		status = ramindex_copy_lines(
+			(struct ramindex_cacheline __user *)selector.lines + nlines,
+			lines, data, n, linesize);
+		if (status)
+			goto out;
+
+		bytes += (__u64)n * (sizeof(struct ramindex_cacheline) + linesize);
+
+		if (fatal_signal_pending(current)) {
+			status = -EINTR;
+			goto out;
+		}
+
+		cond_resched();
+	}
+
+	put_user(nlines, (__u32 __user *)&(((struct ramindex_selector *)ubuf)->nlines));
+
+out:
+	kfree(data);
+	kfree(lines);
+
+	ramindex_dump_done(selector.level, selector.icache, nlines, bytes, status, start_ns);
+
+	return status;
+}
+
+static long ramindex_ioctl_dump(void __user *ubuf, size_t size)
+{
+	long status;
+	struct ramindex_selector selector;
+	int cpu;
+
+	if (size != sizeof(struct ramindex_selector) &&
+		size != RAMINDEX_SELECTOR_SIZE_V1 && size != RAMINDEX_SELECTOR_SIZE_V0)
+		return -EINVAL;
+
+	memset(&selector, 0, sizeof(selector));
+	if (copy_from_user(&selector, ubuf, size))
+		return -EFAULT;
+
+	if ((selector.flags & ~RAMINDEX_DUMP_F_ALL) || selector.reserved)
+		return -EINVAL;
+
+	/*
+	 * Chunks are read with preemption disabled, but the task may be migrated
+	 * in between them. The geometry and all the lines of a (private) cache
+	 * are thus read on one cpu, wherever the caller has been migrated to.
+	 */
+	migrate_disable();
+	cpu = smp_processor_id();
+	status = ramindex_dump(ubuf, size, &selector);
+	migrate_enable();
+
+	if (status == 0)
+		put_user(cpu, (__s32 __user *)&(((struct ramindex_selector *)ubuf)->cpu));
+
+	return status;
+}
+
+static long ramindex_ioctl_dump_pmu(void __user *ubuf, size_t size)
+{
+	long status;
+	u64 after[RAMINDEX_PMU_EVENTS_MAX];
+	struct ramindex_pmu_selector ps;
+	int n;
+
+	if (size != sizeof(struct ramindex_pmu_selector))
+		return -EINVAL;
+
+	if (copy_from_user(&ps, ubuf, size))
+		return -EFAULT;
+
+	if (ps.events == 0 || (ps.events & ~RAMINDEX_PMU_ALL))
+		return -EINVAL;
+
+	memset(ps.before, 0, sizeof(ps.before));
+
+	/* counters are bound to a cpu, so both reads and the dump shall happen on the same one */
+	migrate_disable();
+	ramindex_pmu_open(smp_processor_id(), ps.events);
+
+	preempt_disable();
+	ps.valid = ramindex_pmu_read(ps.events, ps.before);
+	preempt_enable();
+
+	/* the selector comes first, nlines of it is updated in place */
+	status = ramindex_ioctl_dump(ubuf, sizeof(struct ramindex_selector));
+
+	preempt_disable();
+	ps.valid &= ramindex_pmu_read(ps.events, after);
+	preempt_enable();
+	migrate_enable();
+
+	if (status)
+		return status;
+
+	for (n = 0; n < RAMINDEX_PMU_EVENTS_MAX; n++)
+		ps.delta[n] = (ps.valid & BIT(n)) ? after[n] - ps.before[n] : 0;
+
+	if (copy_to_user((__u8 __user *)ubuf + offsetof(struct ramindex_pmu_selector, valid),
+			&ps.valid, size - offsetof(struct ramindex_pmu_selector, valid)))
+		return -EFAULT;
+
+	return 0;
+}
+
+/**
+ * struct ramindex_occupancy_state - cgroups seen by RAMINDEX_OCCUPANCY
+ * @cgroups:	cgroups seen so far, sorted by their ids
+ * @ncgroups:	number of entries of @cgroups in use
+ * @max:	number of entries of @cgroups
+ * @last_pfn:	frame of the last attributed line
+ * @last_id:	cgroup of @last_pfn
+ */
+struct ramindex_occupancy_state {
+	struct ramindex_cgroup_lines *cgroups;
+	__u32 ncgroups;
+	__u32 max;
+	u64 last_pfn;
+	u64 last_id;
+};
+
+static int ramindex_occupancy_cmp(const void *key, const void *elt)
+{
+	u64 id = *(const u64 *)key;
+	const struct ramindex_cgroup_lines *cl = elt;
+
+	return id < cl->cgroup_id ? -1 : id > cl->cgroup_id ? 1 : 0;
+}
+
+/* returns entry of cgroup @id, added if there is room for it, NULL otherwise */
+static struct ramindex_cgroup_lines *ramindex_occupancy_cgroup(
+	struct ramindex_occupancy_state *st, u64 id)
+{
+	struct ramindex_cgroup_lines *cl;
+	__u32 lo = 0, hi = st->ncgroups;
+
+	cl = bsearch(&id, st->cgroups, st->ncgroups, sizeof(*cl), ramindex_occupancy_cmp);
+	if (cl || st->ncgroups == st->max)
+		return cl;
+
+	/* few cgroups own a cache, so new ones are rare and inserted in place */
+	while (lo < hi) {
+		__u32 mid = lo + (hi - lo) / 2;
+
+		if (st->cgroups[mid].cgroup_id < id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	memmove(&st->cgroups[lo + 1], &st->cgroups[lo], (st->ncgroups - lo) * sizeof(*cl));
+	cl = &st->cgroups[lo];
+	cl->cgroup_id = id;
+	cl->nlines = 0;
+	cl->ndirty = 0;
+	st->ncgroups++;
+
+	return cl;
+}
+
+static void ramindex_occupancy_add(struct ramindex_occupancy_state *st,
+	struct ramindex_occupancy *occupancy, const struct ramindex_line *l)
+{
+	struct ramindex_cgroup_lines *cl;
+	u64 pfn = l->tag >> PAGE_SHIFT;
+
+	if (!l->valid)
+		return;
+
+	occupancy->nlines++;
+	occupancy->ndirty += !!l->dirty;
+
+	if (pfn != st->last_pfn) {
+		st->last_pfn = pfn;
+		st->last_id = ramindex_memcg_id(pfn);
+	}
+
+	if (st->last_id == 0) {
+		occupancy->nunowned++;
+		return;
+	}
+
+	cl = ramindex_occupancy_cgroup(st, st->last_id);
+	if (cl == NULL) {
+		occupancy->noverflow++;
+		return;
+	}
+
+	cl->nlines++;
+	cl->ndirty += !!l->dirty;
+}
+
+/*
+ * Reads tags of all the lines of a cache as RAMINDEX_DUMP does and passes
+ * every line (@index counts lines by set and then by way) to @fn, which runs
+ * with preemption enabled and may thus look at the memory a tag points to.
+ */
+static long ramindex_walk_tags(const struct ramindex_ccsidr *ccsidr, dumpfunction_t df,
+	void (*fn)(void *arg, __u32 index, const struct ramindex_line *l), void *arg)
+{
+	long status = 0;
+	__u32 nlines, total, chunk, n;
+	struct ramindex_line *lines;
+
+	total = ccsidr->nsets * ccsidr->nways;
+	chunk = clamp_t(__u32, READ_ONCE(ramindex_chunk_lines), 1, RAMINDEX_CHUNK_LINES_MAX);
+
+	lines = kmalloc_array(chunk, sizeof(*lines), GFP_KERNEL);
+	if (lines == NULL)
+		return -ENOMEM;
+
+	for (nlines = 0; nlines < total; nlines += n) {
+		memset(lines, 0, chunk * sizeof(*lines));
+
+		preempt_disable();
+		for (n = 0; n < min(chunk, total - nlines); n++) {
+			__u32 index = nlines + n;
+
+			status = df(index / ccsidr->nways, index % ccsidr->nways, &lines[n], NULL, 0);
+			if (status)
+				break;
+		}
+		preempt_enable();
+
+		if (status)
+			break;
+
+		ramindex_stats_add(RAMINDEX_CNT_LINES, n);
+
+		for (n = 0; n < min(chunk, total - nlines); n++)
+			fn(arg, nlines + n, &lines[n]);
+
+		if (fatal_signal_pending(current)) {
+			status = -EINTR;
+			break;
+		}
+
+		cond_resched();
+	}
+
+	kfree(lines);
+
+	return status;
+}
+
+/**
+ * struct ramindex_occupancy_walk - arguments of ramindex_occupancy_line()
+ * @st:		cgroups seen so far
+ * @occupancy:	totals being filled
+ */
+struct ramindex_occupancy_walk {
+	struct ramindex_occupancy_state *st;
+	struct ramindex_occupancy *occupancy;
+};
+
+static void ramindex_occupancy_line(void *arg, __u32 index, const struct ramindex_line *l)
+{
+	struct ramindex_occupancy_walk *w = arg;
+
+	ramindex_occupancy_add(w->st, w->occupancy, l);
+}
+
+static long ramindex_ioctl_occupancy(void __user *ubuf, size_t size)
+{
+	long status = 0;
+	struct ramindex_occupancy occupancy;
+	struct ramindex_occupancy_state st;
+	struct ramindex_occupancy_walk w = { &st, &occupancy };
+	struct ramindex_ccsidr ccsidr;
+	dumpfunction_t df;
+
+	if (size != sizeof(struct ramindex_occupancy))
+		return -EINVAL;
+
+	if (copy_from_user(&occupancy, ubuf, size))
+		return -EFAULT;
+
+	if (occupancy.flags || occupancy.reserved || occupancy.ncgroups > RAMINDEX_OCCUPANCY_MAX)
+		return -EINVAL;
+
+	if (!ramindex_memcg_supported())
+		return -EOPNOTSUPP;
+
+	df = ramindex_get_dumpfunction(occupancy.level, occupancy.icache);
+	if (df == NULL)
+		return -EOPNOTSUPP;
+
+	memset(&ccsidr, 0, sizeof(ccsidr));
+	ccsidr.level = occupancy.level;
+	ccsidr.icache = occupancy.icache;
+	ramindex_get_ccsidr(&ccsidr);
+
+	memset(&st, 0, sizeof(st));
+	st.max = occupancy.ncgroups;
+	st.last_pfn = U64_MAX;
+	if (st.max) {
+		st.cgroups = kvmalloc_array(st.max, sizeof(*st.cgroups), GFP_KERNEL);
+		if (st.cgroups == NULL)
+			return -ENOMEM;
+	}
+
+	occupancy.nlines = occupancy.ndirty = 0;
+	occupancy.nunowned = occupancy.noverflow = 0;
+
+	/* tags of one cache are walked on one cpu, wherever the caller has been migrated to */
+	migrate_disable();
+	occupancy.cpu = smp_processor_id();
+	status = ramindex_walk_tags(&ccsidr, df, ramindex_occupancy_line, &w);
+	migrate_enable();
+
+	if (status)
+		goto out;
+
+	if (st.ncgroups && copy_to_user((struct ramindex_cgroup_lines __user *)occupancy.cgroups,
+			st.cgroups, st.ncgroups * sizeof(*st.cgroups))) {
+		status = -EFAULT;
+		goto out;
+	}
+
+	occupancy.ncgroups = st.ncgroups;
+	if (copy_to_user(ubuf, &occupancy, size))
+		status = -EFAULT;
+
+out:
+	kvfree(st.cgroups);
+
+	return status;
+}
+
+/**
+ * struct ramindex_placement_walk - arguments of ramindex_placement_line()
+ * @placement:	histograms being filled
+ * @lines:	placement of every line (NULL if not requested)
+ * @nlines:	number of entries of @lines
+ * @last_pfn:	frame of the last classified line
+ * @last:	placement of @last_pfn
+ */
+struct ramindex_placement_walk {
+	struct ramindex_placement *placement;
+	struct ramindex_line_placement *lines;
+	__u32 nlines;
+	u64 last_pfn;
+	struct ramindex_line_placement last;
+};
+
+static void ramindex_placement_line(void *arg, __u32 index, const struct ramindex_line *l)
+{
+	struct ramindex_placement_walk *w = arg;
+	struct ramindex_placement *placement = w->placement;
+	struct ramindex_line_placement lp = { -1, -1 };
+	u64 pfn = l->tag >> PAGE_SHIFT;
+
+	if (l->valid) {
+		placement->nvalid++;
+
+		if (pfn != w->last_pfn) {
+			w->last_pfn = pfn;
+			ramindex_placement_of(pfn, &w->last);
+		}
+		lp = w->last;
+
+		if (lp.node < 0)
+			placement->nunmanaged++;
+		else if (lp.node >= RAMINDEX_PLACEMENT_NODES)
+			placement->noverflow++;
+		else {
+			placement->valid[lp.node][lp.zone]++;
+			placement->dirty[lp.node][lp.zone] += !!l->dirty;
+		}
+	}
+
+	if (index < w->nlines)
+		w->lines[index] = lp;
+}
+
+static long ramindex_ioctl_placement(void __user *ubuf, size_t size)
+{
+	long status = 0;
+	struct ramindex_placement *placement;
+	struct ramindex_placement_walk w;
+	struct ramindex_ccsidr ccsidr;
+	dumpfunction_t df;
+
+	if (size != sizeof(struct ramindex_placement))
+		return -EINVAL;
+
+	/* histograms make it too big for the stack */
+	placement = memdup_user(ubuf, size);
+	if (IS_ERR(placement))
+		return PTR_ERR(placement);
+
+	memset(&w, 0, sizeof(w));
+
+	if (placement->flags) {
+		status = -EINVAL;
+		goto out;
+	}
+
+	df = ramindex_get_dumpfunction(placement->level, placement->icache);
+	if (df == NULL) {
+		status = -EOPNOTSUPP;
+		goto out;
+	}
+
+	memset(&ccsidr, 0, sizeof(ccsidr));
+	ccsidr.level = placement->level;
+	ccsidr.icache = placement->icache;
+	ramindex_get_ccsidr(&ccsidr);
+
+	w.placement = placement;
+	w.last_pfn = U64_MAX;
+	if (placement->lines)
+		w.nlines = min_t(__u32, placement->nlines, ccsidr.nsets * ccsidr.nways);
+	if (w.nlines) {
+		w.lines = kvmalloc_array(w.nlines, sizeof(*w.lines), GFP_KERNEL);
+		if (w.lines == NULL) {
+			status = -ENOMEM;
+			goto out;
+		}
+	}
+
+	placement->nvalid = placement->nunmanaged = placement->noverflow = 0;
+	memset(placement->valid, 0, sizeof(placement->valid));
+	memset(placement->dirty, 0, sizeof(placement->dirty));
+
+	/* tags of one cache are walked on one cpu, wherever the caller has been migrated to */
+	migrate_disable();
+	placement->cpu = smp_processor_id();
+	placement->cpu_node = cpu_to_node(placement->cpu);
+	status = ramindex_walk_tags(&ccsidr, df, ramindex_placement_line, &w);
+	migrate_enable();
+
+	if (status)
+		goto out;
+
+	if (w.nlines && copy_to_user((struct ramindex_line_placement __user *)placement->lines,
+			w.lines, w.nlines * sizeof(*w.lines))) {
+		status = -EFAULT;
+		goto out;
+	}
+
+	placement->nlines = w.nlines;
+	if (copy_to_user(ubuf, placement, size))
+		status = -EFAULT;
+
+out:
+	kvfree(w.lines);
+	kfree(placement);
+
+	return status;
+}
+
+/**
+ * struct ramindex_vec_plan - validated RAMINDEX_DUMPV entry
+ * @df:		dump function of the selected cache
+ * @start_set:	first selected set
+ * @end_set:	one past the last selected set
+ * @ways:	bitmask of the selected ways (0 for all of them)
+ * @nways:	number of ways of the selected cache
+ * @linesize:	number of bytes of every line to be read (0 for tags only)
+ * @total:	number of selected lines
+ */
+struct ramindex_vec_plan {
+	dumpfunction_t df;
+	__s32 start_set, end_set;
+	__u64 ways;
+	__s32 nways;
+	__u32 linesize;
+	__u32 total;
+};
+
+/* next way of @plan after @way, -1 if there is none */
+static __s32 ramindex_vec_next_way(const struct ramindex_vec_plan *plan, __s32 way)
+{
+	__u64 rest;
+
+	way++;
+	if (plan->ways == 0)
+		return way < plan->nways ? way : -1;
+
+	rest = way < 64 ? plan->ways >> way : 0;
+
+	return rest ? way + __ffs64(rest) : -1;
+}
+
+/* ccsidrs are indexed by level and type, @nsets of 0 tells one has not been read yet */
+static int ramindex_vec_prepare(const struct ramindex_vec_entry *entry,
+	struct ramindex_ccsidr ccsidrs[3][2], struct ramindex_vec_plan *plan)
+{
+	struct ramindex_selector selector;
+	struct ramindex_ccsidr *ccsidr;
+	__s32 start_way, end_way;
+
+	if (entry->flags & ~RAMINDEX_DUMP_F_TAGS_ONLY)
+		return -EINVAL;
+
+	plan->df = ramindex_get_dumpfunction(entry->level, entry->icache);
+	if (plan->df == NULL)
+		return -EOPNOTSUPP;
+
+	/* ramindex_get_dumpfunction() accepts levels 0 to 2 only */
+	ccsidr = &ccsidrs[entry->level][!!entry->icache];
+	if (ccsidr->nsets == 0) {
+		ccsidr->level = entry->level;
+		ccsidr->icache = !!entry->icache;
+		ramindex_get_ccsidr(ccsidr);
+	}
+
+	memset(&selector, 0, sizeof(selector));
+	selector.level = entry->level;
+	selector.icache = entry->icache;
+	selector.set = entry->set;
+	selector.nsets = entry->nsets;
+	selector.way = -1;
+	if (!ramindex_selector_valid(&selector, ccsidr))
+		return -EINVAL;
+
+	if (ccsidr->nways < 64 && (entry->ways >> ccsidr->nways)) {
+		ramindex_dbg_at1(
+			"Selected L%d %s cache has %d ways whereas ways 0x%llx have been requested\n",
+			entry->level + 1, entry->icache ? "instruction" : "data",
+			ccsidr->nways, entry->ways);
+		return -EINVAL;
+	}
+
+	ramindex_selector_range(&selector, ccsidr, &plan->start_set, &plan->end_set,
+		&start_way, &end_way);
+	plan->ways = entry->ways;
+	plan->nways = ccsidr->nways;
+	plan->linesize = (entry->flags & RAMINDEX_DUMP_F_TAGS_ONLY) ? 0 : ccsidr->linesize;
+	plan->total = (plan->end_set - plan->start_set) *
+		(entry->ways ? hweight64(entry->ways) : ccsidr->nways);
+
+	return 0;
+}
+
+static long ramindex_ioctl_dumpv(void __user *ubuf, size_t size)
+{
+	long status = 0;
+	__u32 i, nlines = 0, done, total, chunk, n;
+	__u32 linesize = 0;
+	__s32 set, way;
+	__u64 bytes;
+	u64 start_ns, chunk_ns;
+	struct ramindex_vec_selector vs;
+	struct ramindex_vec_entry *entries = NULL;
+	struct ramindex_vec_plan *plans = NULL, *plan;
+	struct ramindex_ccsidr ccsidrs[3][2];
+	struct ramindex_line *lines = NULL;
+	__u8 *data = NULL;
+	int cpu;
+
+	if (size != sizeof(struct ramindex_vec_selector))
+		return -EINVAL;
+
+	if (copy_from_user(&vs, ubuf, size))
+		return -EFAULT;
+
+	if (vs.nentries == 0 || vs.nentries > RAMINDEX_DUMPV_MAX || vs.reserved)
+		return -EINVAL;
+
+	/* the same as RAMINDEX_DUMP, geometries and lines of all the entries are read on one cpu */
+	migrate_disable();
+	cpu = smp_processor_id();
+
+	entries = kvmalloc_array(vs.nentries, sizeof(*entries), GFP_KERNEL);
+	plans = kvmalloc_array(vs.nentries, sizeof(*plans), GFP_KERNEL);
+	if (entries == NULL || plans == NULL) {
+		status = -ENOMEM;
+		goto out;
+	}
+
+	if (copy_from_user(entries, (void __user *)vs.entries, vs.nentries * sizeof(*entries))) {
+		status = -EFAULT;
+		goto out;
+	}
+
+	/* all the entries are validated (and every geometry read once) before any line is read */
+	memset(ccsidrs, 0, sizeof(ccsidrs));
+	for (i = 0; i < vs.nentries; i++) {
+		status = ramindex_vec_prepare(&entries[i], ccsidrs, &plans[i]);
+		if (status) {
+			ramindex_dbg_at1("Invalid entry %u of vectored dump\n", i);
+			goto out;
+		}
+		linesize = max(linesize, plans[i].linesize);
+	}
+
+	chunk = clamp_t(__u32, READ_ONCE(ramindex_chunk_lines), 1, RAMINDEX_CHUNK_LINES_MAX);
+
+	lines = kmalloc_array(chunk, sizeof(*lines), GFP_KERNEL);
+	if (linesize)
+		data = kmalloc_array(chunk, linesize, GFP_KERNEL);
+	if (lines == NULL || (linesize && data == NULL)) {
+		status = -ENOMEM;
+		goto out;
+	}
+
+	/* the same as RAMINDEX_DUMP, lines are read in chunks with preemption disabled */
+	for (i = 0; i < vs.nentries; i++) {
+		plan = &plans[i];
+		total = min(plan->total, vs.nlines - nlines);
+		set = plan->start_set;
+		way = ramindex_vec_next_way(plan, -1);
+		bytes = 0;
+
+		trace_ramindex_dump_start(entries[i].level, entries[i].icache, total, entries[i].flags);
+		start_ns = local_clock();
+
+		for (done = 0; done < total; done += n) {
+			memset(lines, 0, chunk * sizeof(*lines));
+
+			chunk_ns = ramindex_stats_clock();
+			preempt_disable();
+			for (n = 0; n < min(chunk, total - done); n++) {
+				status = plan->df(set, way, &lines[n],
+					data ? data + n * plan->linesize : NULL, plan->linesize);
+				if (status)
+					break;
+
+				trace_ramindex_line(set, way, lines[n].valid, lines[n].dirty,
+					lines[n].state, lines[n].tag);
+
+				way = ramindex_vec_next_way(plan, way);
+				if (way < 0) {
+					set++;
+					way = ramindex_vec_next_way(plan, -1);
+				}
+			}
+			ramindex_stats_hist_since(RAMINDEX_HIST_PREEMPT_OFF_NS, chunk_ns);
+			preempt_enable();
+
+			if (status == 0)
+				status = ramindex_copy_lines(
+					(struct ramindex_cacheline __user *)vs.lines + nlines + done,
+					lines, data, n, plan->linesize);
+			if (status == 0 && fatal_signal_pending(current))
+				status = -EINTR;
+			if (status) {
+				ramindex_dump_done(entries[i].level, entries[i].icache,
+					done, bytes, status, start_ns);
+				goto out;
+			}
+
+			bytes += (__u64)n * (sizeof(struct ramindex_cacheline) + plan->linesize);
+
+			cond_resched();
+		}
+
+		ramindex_dump_done(entries[i].level, entries[i].icache, total, bytes, 0, start_ns);
+
+		entries[i].nlines = total;
+		nlines += total;
+	}
+
+	if (copy_to_user((void __user *)vs.entries, entries, vs.nentries * sizeof(*entries)))
+		status = -EFAULT;
+	else {
+		put_user(nlines, (__u32 __user *)&(((struct ramindex_vec_selector *)ubuf)->nlines));
+		put_user(cpu, (__s32 __user *)&(((struct ramindex_vec_selector *)ubuf)->cpu));
+	}
+
+out:
+	migrate_enable();
+
+	kfree(data);
+	kfree(lines);
+	kvfree(plans);
+	kvfree(entries);
+
+	return status;
+}
+
+static const struct ramindex_tlb *ramindex_get_tlb(__s32 level, __s32 itlb)
+{
+	const struct ramindex_tlb *tlb;
+
+	if (ramindex_device.ops == NULL) {
+		ramindex_dbg_at1("There is no backend for this cpu\n");
+		return NULL;
+	}
+
+	switch (level) {
+	case 0:
+		tlb = itlb ?
+			&ramindex_device.ops->l1i_tlb :
+			&ramindex_device.ops->l1d_tlb;
+		break;
+	case 1:
+		tlb = &ramindex_device.ops->l2_tlb;
+		break;
+	default:
+		tlb = NULL;
+		break;
+	}
+
+	if (tlb == NULL || tlb->dump_entry == NULL) {
+		ramindex_dbg_at1(
+			"There is no associated operation to dump L%d %sTLB\n",
+			level + 1, level ? "" : itlb ? "instruction " : "data ");
+		return NULL;
+	}
+
+	return tlb;
+}
+
+static long ramindex_ioctl_tlb_geometry(void __user *ubuf, size_t size)
+{
+	struct ramindex_tlb_geometry geometry;
+	const struct ramindex_tlb *tlb;
+
+	if (size != sizeof(struct ramindex_tlb_geometry))
+		return -EINVAL;
+
+	if (copy_from_user(&geometry, ubuf, sizeof(geometry)))
+		return -EFAULT;
+
+	tlb = ramindex_get_tlb(geometry.level, geometry.itlb);
+	if (tlb == NULL)
+		return -EOPNOTSUPP;
+
+	geometry.nsets = tlb->nsets;
+	geometry.nways = tlb->nways;
+
+	if (copy_to_user(ubuf, &geometry, sizeof(geometry)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static long ramindex_ioctl_tlb_dump(void __user *ubuf, size_t size)
+{
+	long status = 0;
+	__u32 nentries, total, chunk, n;
+	struct ramindex_tlb_selector selector;
+	struct ramindex_tlbentry *entries;
+	const struct ramindex_tlb *tlb;
+	int cpu;
+
+	if (size != sizeof(struct ramindex_tlb_selector))
+		return -EINVAL;
+
+	if (copy_from_user(&selector, ubuf, sizeof(selector)))
+		return -EFAULT;
+
+	chunk = clamp_t(__u32, READ_ONCE(ramindex_chunk_lines), 1, RAMINDEX_CHUNK_LINES_MAX);
+
+	entries = kmalloc_array(chunk, sizeof(*entries), GFP_KERNEL);
+	if (entries == NULL)
+		return -ENOMEM;
+
+	/* TLBs are per core, all the chunks are read from the TLB of one cpu */
+	migrate_disable();
+	cpu = smp_processor_id();
+
+	tlb = ramindex_get_tlb(selector.level, selector.itlb);
+	if (tlb == NULL) {
+		status = -EOPNOTSUPP;
+		goto out;
+	}
+
+	total = min_t(__u32, selector.nentries, tlb->nsets * tlb->nways);
+
+	/* the same as cache lines, entries are read in chunks with preemption disabled */
+	for (nentries = 0; nentries < total; nentries += n) {
+		memset(entries, 0, chunk * sizeof(*entries));
+
+		preempt_disable();
+		for (n = 0; n < min(chunk, total - nentries); n++) {
+			__u32 index = nentries + n;
+
+			status = tlb->dump_entry(index / tlb->nways, index % tlb->nways, &entries[n]);
+			if (status)
+				break;
+		}
+		preempt_enable();
+
+		if (status)
+			goto out;
+
+		if (copy_to_user((struct ramindex_tlbentry __user *)selector.entries + nentries,
+				entries, n * sizeof(*entries))) {
+			status = -EFAULT;
+			goto out;
+		}
+
+		cond_resched();
+	}
+
+	put_user(nentries, (__u32 __user *)&(((struct ramindex_tlb_selector *)ubuf)->nentries));
+	put_user(cpu, (__s32 __user *)&(((struct ramindex_tlb_selector *)ubuf)->cpu));
+
+out:
+	migrate_enable();
+	kfree(entries);
+
+	return status;
+}
+
+/**
+ * struct ramindex_sync_state - state of one cpu taking part in RAMINDEX_SYNC_DUMP
+ * @cpu:	the cpu
+ * @status:	status of reading tags
+ * @flags:	RAMINDEX_SYNC_F_* flags
+ * @nlines:	number of lines to be read (on return number of lines read)
+ * @lines:	buffer for the lines
+ * @start_ns:	time the cpu started to read tags at
+ * @end_ns:	time the cpu finished reading tags at
+ * @sync:	state shared by all the cpus
+ * @work:	work item reading tags on @cpu
+ */
+struct ramindex_sync_state {
+	int cpu;
+	int status;
+	__u32 flags;
+	__u32 nlines;
+	struct ramindex_line *lines;
+	__u64 start_ns;
+	__u64 end_ns;
+	struct ramindex_sync *sync;
+	struct work_struct work;
+};
+
+/**
+ * struct ramindex_sync - shared by all the cpus taking part in RAMINDEX_SYNC_DUMP
+ * @df:		dump function of the selected cache
+ * @nways:	number of ways of the selected cache
+ * @pending:	number of cpus which have not yet reached the barrier
+ * @ncpus:	number of entries in @states array
+ * @states:	per cpu states
+ */
+struct ramindex_sync {
+	dumpfunction_t df;
+	__s32 nways;
+	atomic_t pending;
+	__u32 ncpus;
+	struct ramindex_sync_state *states;
+};
+
+/*
+ * Runs on every selected cpu as a work item of the cpu, so with interrupts
+ * enabled. All the cpus spin at the barrier until the last one arrives,
+ * then all of them read tags at the same time, as RAMINDEX_DUMP does - in
+ * chunks, with preemption disabled only while a chunk is read. A cpu which
+ * arrives too late (e.g. because its worker has been kept from running)
+ * does not block the others for more than RAMINDEX_SYNC_TIMEOUT_NS.
+ */
+static void ramindex_sync_work(struct work_struct *work)
+{
+	struct ramindex_sync_state *state = container_of(work, struct ramindex_sync_state, work);
+	struct ramindex_sync *sync = state->sync;
+	__u32 chunk, nlines, n = 0;
+	__u64 deadline;
+
+	chunk = clamp_t(__u32, READ_ONCE(ramindex_chunk_lines), 1, RAMINDEX_CHUNK_LINES_MAX);
+
+	atomic_dec(&sync->pending);
+
+	deadline = ktime_get_mono_fast_ns() + RAMINDEX_SYNC_TIMEOUT_NS;
+	while (atomic_read(&sync->pending) > 0) {
+		if (ktime_get_mono_fast_ns() > deadline) {
+			state->flags |= RAMINDEX_SYNC_F_TIMEDOUT;
+			break;
+		}
+		cpu_relax();
+	}
+
+	state->start_ns = ktime_get_mono_fast_ns();
+	for (nlines = 0; nlines < state->nlines && state->status == 0; nlines += n) {
+		preempt_disable();
+		/* cpus are kept online by the caller, so this is only a safety net */
+		if (smp_processor_id() != state->cpu)
+			state->status = -EAGAIN;
+		for (n = 0; n < min(chunk, state->nlines - nlines) && state->status == 0; n++) {
+			__u32 index = nlines + n;
+
+			state->status = sync->df(index / sync->nways, index % sync->nways,
+				&state->lines[index], NULL, 0);
+		}
+		preempt_enable();
+
+		cond_resched();
+	}
+	state->end_ns = ktime_get_mono_fast_ns();
+
+	state->nlines = nlines;
+}
+
+static long ramindex_ioctl_sync_dump(void __user *ubuf, size_t size)
+{
+	long status = 0;
+	__u64 min_start = U64_MAX, max_start = 0;
+	struct ramindex_sync_selector selector;
+	struct ramindex_sync_cpu __user *ucpus;
+	struct ramindex_sync_cpu scpu;
+	struct ramindex_ccsidr ccsidr;
+	struct ramindex_sync sync;
+	cpumask_var_t mask;
+	__u32 i;
+
+	if (size != sizeof(struct ramindex_sync_selector))
+		return -EINVAL;
+
+	if (copy_from_user(&selector, ubuf, sizeof(selector)))
+		return -EFAULT;
+
+	if (selector.ncpus == 0 || selector.ncpus > nr_cpu_ids)
+		return -EINVAL;
+
+	memset(&sync, 0, sizeof(sync));
+	sync.df = ramindex_get_dumpfunction(selector.level, selector.icache);
+	if (sync.df == NULL)
+		return -EOPNOTSUPP;
+
+	/* all the selected cpus are assumed to have caches of the same geometry */
+	memset(&ccsidr, 0, sizeof(ccsidr));
+	ccsidr.level = selector.level;
+	ccsidr.icache = selector.icache;
+	ramindex_get_ccsidr(&ccsidr);
+	sync.nways = ccsidr.nways;
+
+	if (!zalloc_cpumask_var(&mask, GFP_KERNEL))
+		return -ENOMEM;
+
+	sync.states = kcalloc(selector.ncpus, sizeof(*sync.states), GFP_KERNEL);
+	if (sync.states == NULL) {
+		status = -ENOMEM;
+		goto out;
+	}
+	sync.ncpus = selector.ncpus;
+
+	ucpus = (struct ramindex_sync_cpu __user *)selector.cpus;
+	for (i = 0; i < sync.ncpus; i++) {
+		struct ramindex_sync_state *state = &sync.states[i];
+
+		if (copy_from_user(&scpu, ucpus + i, sizeof(scpu))) {
+			status = -EFAULT;
+			goto out;
+		}
+
+		if (scpu.cpu < 0 || scpu.cpu >= nr_cpu_ids ||
+			cpumask_test_and_set_cpu(scpu.cpu, mask)) {
+			ramindex_dbg_at1("Invalid or repeated cpu %d\n", scpu.cpu);
+			status = -EINVAL;
+			goto out;
+		}
+
+		state->cpu = scpu.cpu;
+		state->nlines = min_t(__u32, scpu.nlines, ccsidr.nsets * ccsidr.nways);
+		state->lines = kvmalloc_array(max(state->nlines, 1u), sizeof(*state->lines),
+			GFP_KERNEL | __GFP_ZERO);
+		if (state->lines == NULL) {
+			status = -ENOMEM;
+			goto out;
+		}
+	}
+
+	cpus_read_lock();
+	if (!cpumask_subset(mask, cpu_online_mask)) {
+		cpus_read_unlock();
+		ramindex_dbg_at1("Some of the selected cpus are offline\n");
+		status = -ENODEV;
+		goto out;
+	}
+	atomic_set(&sync.pending, sync.ncpus);
+	for (i = 0; i < sync.ncpus; i++) {
+		sync.states[i].sync = &sync;
+		INIT_WORK(&sync.states[i].work, ramindex_sync_work);
+		queue_work_on(sync.states[i].cpu, system_highpri_wq, &sync.states[i].work);
+	}
+	for (i = 0; i < sync.ncpus; i++)
+		flush_work(&sync.states[i].work);
+	cpus_read_unlock();
+
+	for (i = 0; i < sync.ncpus; i++) {
+		struct ramindex_sync_state *state = &sync.states[i];
+
+		if (state->status) {
+			status = state->status;
+			goto out;
+		}
+
+		if (copy_from_user(&scpu, ucpus + i, sizeof(scpu))) {
+			status = -EFAULT;
+			goto out;
+		}
+
+		status = ramindex_copy_lines((struct ramindex_cacheline __user *)scpu.lines,
+			state->lines, NULL, state->nlines, 0);
+		if (status)
+			goto out;
+
+		scpu.flags = state->flags;
+		scpu.nlines = state->nlines;
+		scpu.start_ns = state->start_ns;
+		scpu.end_ns = state->end_ns;
+		if (copy_to_user(ucpus + i, &scpu, sizeof(scpu))) {
+			status = -EFAULT;
+			goto out;
+		}
+
+		min_start = min(min_start, state->start_ns);
+		max_start = max(max_start, state->start_ns);
+	}
+
+	ramindex_dbg_at2("Tags of %u cpus read with skew of %llu ns\n",
+		sync.ncpus, max_start - min_start);
+
+	put_user(max_start - min_start,
+		(__u64 __user *)&(((struct ramindex_sync_selector *)ubuf)->skew_ns));
+
+out:
+	if (sync.states)
+		for (i = 0; i < sync.ncpus; i++)
+			kvfree(sync.states[i].lines);
+	kfree(sync.states);
+	free_cpumask_var(mask);
+
+	return status;
+}
+
+/**
+ * struct ramindex_trigger_slot - one capture taken by an armed trigger
+ * @cpu:	cpu the trigger fired on
+ * @status:	status of reading tags
+ * @done:	set (with release semantics) once the capture is complete
+ * @nlines:	number of lines read
+ * @fired_ns:	time the trigger fired at
+ * @start_ns:	time the first tag was read at
+ * @end_ns:	time the last tag was read at
+ * @lines:	preallocated buffer for the lines
+ */
+struct ramindex_trigger_slot {
+	int cpu;
+	int status;
+	int done;
+	__u32 nlines;
+	__u64 fired_ns;
+	__u64 start_ns;
+	__u64 end_ns;
+	struct ramindex_line *lines;
+};
+
+/**
+ * struct ramindex_trigger_state - state of the (only) trigger
+ * @lock:	serializes arming, disarming, firing by ioctl and reading
+ * @armed:	true when the trigger is armed
+ * @trigger:	trigger as requested by userspace
+ * @df:		dump function of the selected cache
+ * @nways:	number of ways of the selected cache
+ * @nlines:	number of lines of the selected cache (lines per capture)
+ * @next:	next free slot (equal to @trigger.count when all are used)
+ * @missed:	number of hits which found no free slot
+ * @slots:	@trigger.count slots
+ * @lines:	buffer for lines of all the slots
+ * @kp:		kprobe of TRIGGER_KPROBE
+ * @tp:		tracepoint of TRIGGER_TRACEPOINT
+ * @probe:	probe registered on @tp
+ */
+struct ramindex_trigger_state {
+	struct mutex lock;
+	bool armed;
+	struct ramindex_trigger trigger;
+	dumpfunction_t df;
+	__s32 nways;
+	__u32 nlines;
+	atomic_t next;
+	atomic_t missed;
+	struct ramindex_trigger_slot *slots;
+	struct ramindex_line *lines;
+#ifdef CONFIG_KPROBES
+	struct kprobe kp;
+#endif
+#ifdef CONFIG_TRACEPOINTS
+	struct tracepoint *tp;
+	void *probe;
+#endif
+};
+
+static struct ramindex_trigger_state ramindex_trigger_state = {
+	.lock = __MUTEX_INITIALIZER(ramindex_trigger_state.lock),
+};
+
+/*
+ * Allocation free capture path, run from the context the trigger fired in
+ * (kprobe handler, tracepoint probe or ioctl). Hits on other than the selected
+ * cpu are ignored, hits finding no free slot are only counted.
+ */
+static void ramindex_trigger_capture(struct ramindex_trigger_state *ts, __u64 fired_ns)
+{
+	struct ramindex_trigger_slot *slot;
+	int index;
+	__u32 n;
+
+	preempt_disable();
+
+	if (ts->trigger.cpu >= 0 && ts->trigger.cpu != smp_processor_id())
+		goto out;
+
+	index = atomic_fetch_add_unless(&ts->next, 1, ts->trigger.count);
+	if (index == ts->trigger.count) {
+		atomic_inc(&ts->missed);
+		goto out;
+	}
+
+	slot = &ts->slots[index];
+	slot->cpu = smp_processor_id();
+	slot->fired_ns = fired_ns;
+	slot->start_ns = ktime_get_mono_fast_ns();
+	for (n = 0; n < ts->nlines; n++) {
+		slot->status = ts->df(n / ts->nways, n % ts->nways, &slot->lines[n], NULL, 0);
+		if (slot->status)
+			break;
+	}
+	slot->end_ns = ktime_get_mono_fast_ns();
+	slot->nlines = n;
+
+	smp_store_release(&slot->done, 1);
+
+out:
+	preempt_enable();
+}
+
+#ifdef CONFIG_KPROBES
+static int ramindex_trigger_kprobe(struct kprobe *kp, struct pt_regs *regs)
+{
+	ramindex_trigger_capture(&ramindex_trigger_state, ktime_get_mono_fast_ns());
+	return 0;
+}
+#endif
+
+#ifdef CONFIG_TRACEPOINTS
+struct irqaction;
+struct pt_regs;
+
+/*
+ * Tracepoints call their probes through pointers of the type of their
+ * prototype (checked under CONFIG_CFI_CLANG), so every supported tracepoint
+ * has its own probe of exactly that type, arguments are not used.
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 18, 0)
+static void ramindex_trigger_sched_switch(void *data, bool preempt,
+	struct task_struct *prev, struct task_struct *next, unsigned int prev_state)
+#else
+static void ramindex_trigger_sched_switch(void *data, bool preempt,
+	struct task_struct *prev, struct task_struct *next)
+#endif
+{
+	ramindex_trigger_capture(data, ktime_get_mono_fast_ns());
+}
+
+static void ramindex_trigger_sched_wakeup(void *data, struct task_struct *p)
+{
+	ramindex_trigger_capture(data, ktime_get_mono_fast_ns());
+}
+
+static void ramindex_trigger_irq_handler_entry(void *data, int irq, struct irqaction *action)
+{
+	ramindex_trigger_capture(data, ktime_get_mono_fast_ns());
+}
+
+static void ramindex_trigger_sys_enter(void *data, struct pt_regs *regs, long id)
+{
+	ramindex_trigger_capture(data, ktime_get_mono_fast_ns());
+}
+
+static void ramindex_trigger_cpu_idle(void *data, unsigned int state, unsigned int cpu_id)
+{
+	ramindex_trigger_capture(data, ktime_get_mono_fast_ns());
+}
+
+/**
+ * struct ramindex_trigger_tracepoint - tracepoint a trigger may be armed on
+ * @name:	name of the tracepoint
+ * @probe:	probe of the prototype of the tracepoint
+ */
+struct ramindex_trigger_tracepoint {
+	const char *name;
+	void *probe;
+};
+
+static const struct ramindex_trigger_tracepoint ramindex_trigger_tracepoints[] = {
+	{ "sched_switch", ramindex_trigger_sched_switch },
+	{ "sched_wakeup", ramindex_trigger_sched_wakeup },
+	{ "irq_handler_entry", ramindex_trigger_irq_handler_entry },
+	{ "sys_enter", ramindex_trigger_sys_enter },
+	{ "cpu_idle", ramindex_trigger_cpu_idle },
+};
+
+static void *ramindex_trigger_tracepoint_probe(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(ramindex_trigger_tracepoints); i++)
+		if (!strcmp(ramindex_trigger_tracepoints[i].name, name))
+			return ramindex_trigger_tracepoints[i].probe;
+
+	return NULL;
+}
+
+static void ramindex_trigger_find_tracepoint(struct tracepoint *tp, void *priv)
+{
+	struct ramindex_trigger_state *ts = priv;
+
+	if (ts->tp == NULL && !strcmp(tp->name, ts->trigger.symbol))
+		ts->tp = tp;
+}
+#endif
+
+static int ramindex_trigger_register(struct ramindex_trigger_state *ts)
+{
+	int status;
+
+	switch (ts->trigger.type) {
+	case TRIGGER_KPROBE:
+#ifdef CONFIG_KPROBES
+		memset(&ts->kp, 0, sizeof(ts->kp));
+		ts->kp.symbol_name = ts->trigger.symbol;
+		ts->kp.pre_handler = ramindex_trigger_kprobe;
+		status = register_kprobe(&ts->kp);
+		if (status)
+			ramindex_dbg_at1("register_kprobe(%s) failed with code %d\n",
+				ts->trigger.symbol, status);
+		return status;
+#else
+		return -EOPNOTSUPP;
+#endif
+	case TRIGGER_TRACEPOINT:
+#ifdef CONFIG_TRACEPOINTS
+		ts->probe = ramindex_trigger_tracepoint_probe(ts->trigger.symbol);
+		if (ts->probe == NULL) {
+			ramindex_dbg_at1("Tracepoint '%s' is not supported\n", ts->trigger.symbol);
+			return -EOPNOTSUPP;
+		}
+		ts->tp = NULL;
+		for_each_kernel_tracepoint(ramindex_trigger_find_tracepoint, ts);
+		if (ts->tp == NULL) {
+			ramindex_dbg_at1("There is no '%s' tracepoint\n", ts->trigger.symbol);
+			return -ENOENT;
+		}
+		status = tracepoint_probe_register(ts->tp, ts->probe, ts);
+		if (status)
+			ramindex_dbg_at1("tracepoint_probe_register(%s) failed with code %d\n",
+				ts->trigger.symbol, status);
+		return status;
+#else
+		return -EOPNOTSUPP;
+#endif
+	case TRIGGER_IOCTL:
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+static void ramindex_trigger_unregister(struct ramindex_trigger_state *ts)
+{
+	switch (ts->trigger.type) {
+	case TRIGGER_KPROBE:
+#ifdef CONFIG_KPROBES
+		unregister_kprobe(&ts->kp); /* waits for running handlers */
+#endif
+		break;
+	case TRIGGER_TRACEPOINT:
+#ifdef CONFIG_TRACEPOINTS
+		tracepoint_probe_unregister(ts->tp, ts->probe, ts);
+		tracepoint_synchronize_unregister();
+#endif
+		break;
+	default:
+		break;
+	}
+}
+
+static void ramindex_trigger_disarm_locked(struct ramindex_trigger_state *ts)
+{
+	if (ts->armed) {
+		ramindex_trigger_unregister(ts);
+		ts->armed = false;
+	}
+}
+
+static void ramindex_trigger_free_locked(struct ramindex_trigger_state *ts)
+{
+	kvfree(ts->lines);
+	kfree(ts->slots);
+	ts->lines = NULL;
+	ts->slots = NULL;
+}
+
+static long ramindex_ioctl_trigger_arm(void __user *ubuf, size_t size)
+{
+	long status;
+	__u32 i;
+	struct ramindex_trigger trigger;
+	struct ramindex_ccsidr ccsidr;
+	struct ramindex_trigger_state *ts = &ramindex_trigger_state;
+	dumpfunction_t df;
+
+	if (size != sizeof(struct ramindex_trigger))
+		return -EINVAL;
+
+	if (copy_from_user(&trigger, ubuf, sizeof(trigger)))
+		return -EFAULT;
+
+	trigger.symbol[RAMINDEX_TRIGGER_SYMBOL_LEN - 1] = '\0';
+
+	if (trigger.type != TRIGGER_KPROBE && trigger.type != TRIGGER_TRACEPOINT &&
+		trigger.type != TRIGGER_IOCTL)
+		return -EINVAL;
+
+	if (trigger.count == 0 || trigger.count > RAMINDEX_TRIGGER_COUNT_MAX)
+		return -EINVAL;
+
+	if (trigger.cpu < -1 || (trigger.cpu >= 0 && trigger.cpu >= nr_cpu_ids))
+		return -EINVAL;
+
+	df = ramindex_get_dumpfunction(trigger.level, trigger.icache);
+	if (df == NULL)
+		return -EOPNOTSUPP;
+
+	memset(&ccsidr, 0, sizeof(ccsidr));
+	ccsidr.level = trigger.level;
+	ccsidr.icache = trigger.icache;
+	ramindex_get_ccsidr(&ccsidr);
+
+	/* captures are taken with preemption (and often interrupts) disabled */
+	if ((__u32)ccsidr.nsets * ccsidr.nways > RAMINDEX_TRIGGER_LINES_MAX) {
+		ramindex_dbg_at1("L%d cache has more than %d lines to be captured by a trigger\n",
+			trigger.level + 1, RAMINDEX_TRIGGER_LINES_MAX);
+		return -EINVAL;
+	}
+
+	mutex_lock(&ts->lock);
+
+	ramindex_trigger_disarm_locked(ts);
+	ramindex_trigger_free_locked(ts);
+
+	ts->trigger = trigger;
+	ts->df = df;
+	ts->nways = ccsidr.nways;
+	ts->nlines = ccsidr.nsets * ccsidr.nways;
+	atomic_set(&ts->next, 0);
+	atomic_set(&ts->missed, 0);
+
+	ts->slots = kcalloc(trigger.count, sizeof(*ts->slots), GFP_KERNEL);
+	ts->lines = kvmalloc_array((size_t)trigger.count * ts->nlines, sizeof(*ts->lines),
+		GFP_KERNEL | __GFP_ZERO);
+	if (ts->slots == NULL || ts->lines == NULL) {
+		status = -ENOMEM;
+		goto error;
+	}
+
+	for (i = 0; i < trigger.count; i++)
+		ts->slots[i].lines = ts->lines + (size_t)i * ts->nlines;
+
+	status = ramindex_trigger_register(ts);
+	if (status)
+		goto error;
+
+	ts->armed = true;
+	mutex_unlock(&ts->lock);
+
+	ramindex_dbg_at2("Trigger armed (type: %d, symbol: '%s', L%d %s cache, cpu: %d, count: %u)\n",
+		trigger.type, trigger.symbol, trigger.level + 1,
+		trigger.icache ? "instruction" : "data", trigger.cpu, trigger.count);
+
+	return 0;
+
+error:
+	ramindex_trigger_free_locked(ts);
+	mutex_unlock(&ts->lock);
+
+	return status;
+}
+
+static long ramindex_ioctl_trigger_disarm(void)
+{
+	struct ramindex_trigger_state *ts = &ramindex_trigger_state;
+
+	mutex_lock(&ts->lock);
+	ramindex_trigger_disarm_locked(ts);
+	mutex_unlock(&ts->lock);
+
+	return 0;
+}
+
+static long ramindex_ioctl_trigger_fire(void)
+{
+	__u64 fired_ns = ktime_get_mono_fast_ns();
+	struct ramindex_trigger_state *ts = &ramindex_trigger_state;
+	long status = 0;
+
+	mutex_lock(&ts->lock);
+	if (ts->armed && ts->trigger.type == TRIGGER_IOCTL)
+		ramindex_trigger_capture(ts, fired_ns);
+	else
+		status = -EINVAL;
+	mutex_unlock(&ts->lock);
+
+	return status;
+}
+
+static long ramindex_ioctl_trigger_read(void __user *ubuf, size_t size)
+{
+	long status = 0;
+	struct ramindex_trigger_capture capture;
+	struct ramindex_trigger_state *ts = &ramindex_trigger_state;
+	struct ramindex_trigger_slot *slot;
+
+	if (size != sizeof(struct ramindex_trigger_capture))
+		return -EINVAL;
+
+	if (copy_from_user(&capture, ubuf, sizeof(capture)))
+		return -EFAULT;
+
+	mutex_lock(&ts->lock);
+
+	if (ts->slots == NULL || capture.index >= ts->trigger.count) {
+		status = ts->slots ? -EINVAL : -ENOENT;
+		goto out;
+	}
+
+	slot = &ts->slots[capture.index];
+	if (!smp_load_acquire(&slot->done)) {
+		status = -ENOENT;
+		goto out;
+	}
+
+	if (slot->status) {
+		status = slot->status;
+		goto out;
+	}
+
+	capture.cpu = slot->cpu;
+	capture.ncaptured = atomic_read(&ts->next);
+	capture.nmissed = atomic_read(&ts->missed);
+	capture.fired_ns = slot->fired_ns;
+	capture.latency_ns = slot->start_ns - slot->fired_ns;
+	capture.duration_ns = slot->end_ns - slot->start_ns;
+	capture.nlines = min(capture.nlines, slot->nlines);
+
+	status = ramindex_copy_lines((struct ramindex_cacheline __user *)capture.lines,
+		slot->lines, NULL, capture.nlines, 0);
+	if (status)
+		goto out;
+
+	if (copy_to_user(ubuf, &capture, sizeof(capture)))
+		status = -EFAULT;
+
+out:
+	mutex_unlock(&ts->lock);
+
+	return status;
+}
+
+/*
+ * Cycles are counted by a kernel perf counter bound to the cpu
+ * the benchmark runs on. Some systems (e.g. virtual machines) have
+ * no cpu cycles event, cycles are reported as 0 there.
+ */
+static struct perf_event *ramindex_bench_cycles_create(int cpu)
+{
+	struct perf_event *event;
+	struct perf_event_attr attr = {
+		.type = PERF_TYPE_HARDWARE,
+		.config = PERF_COUNT_HW_CPU_CYCLES,
+		.size = sizeof(struct perf_event_attr),
+		.pinned = 1,
+	};
+
+	event = perf_event_create_kernel_counter(&attr, cpu, NULL, NULL, NULL);
+	if (IS_ERR(event)) {
+		ramindex_dbg_at1("Cannot create cycles counter on cpu %d (%ld)\n",
+			cpu, PTR_ERR(event));
+		return NULL;
+	}
+
+	return event;
+}
+
+static __always_inline u64 ramindex_bench_cycles(struct perf_event *event)
+{
+	u64 value = 0;
+
+	if (event)
+		perf_event_read_local(event, &value, NULL, NULL);
+
+	return value;
+}
+
+static long ramindex_ioctl_bench(void __user *ubuf, size_t size)
+{
+	long status = 0;
+	__u32 iterations, total, chunk, linesize, i, n;
+	u64 start_ns, start_cycles;
+	struct ramindex_bench bench;
+	struct ramindex_ccsidr ccsidr;
+	struct ramindex_line line;
+	struct perf_event *event;
+	__u8 *data = NULL;
+	dumpfunction_t df;
+
+	if (size != sizeof(struct ramindex_bench))
+		return -EINVAL;
+
+	if (copy_from_user(&bench, ubuf, size))
+		return -EFAULT;
+
+	if (bench.flags & ~RAMINDEX_DUMP_F_TAGS_ONLY)
+		return -EINVAL;
+
+	if (bench.iterations > RAMINDEX_BENCH_ITERATIONS_MAX)
+		return -EINVAL;
+
+	df = ramindex_get_dumpfunction(bench.level, bench.icache);
+	if (df == NULL || ramindex_device.ops->bench_access == NULL)
+		return -EOPNOTSUPP;
+
+	memset(&ccsidr, 0, sizeof(ccsidr));
+	ccsidr.level = bench.level;
+	ccsidr.icache = bench.icache;
+	ramindex_get_ccsidr(&ccsidr);
+
+	iterations = bench.iterations ? bench.iterations : RAMINDEX_BENCH_ITERATIONS_DEFAULT;
+	linesize = (bench.flags & RAMINDEX_DUMP_F_TAGS_ONLY) ? 0 : ccsidr.linesize;
+	total = ccsidr.nsets * ccsidr.nways;
+	chunk = clamp_t(__u32, READ_ONCE(ramindex_chunk_lines), 1, RAMINDEX_CHUNK_LINES_MAX);
+
+	if (linesize) {
+		data = kmalloc(linesize, GFP_KERNEL);
+		if (data == NULL)
+			return -ENOMEM;
+	}
+
+	/* all the measurements are taken on one cpu, whose cycles counter may sleep to be created */
+	migrate_disable();
+	bench.cpu = smp_processor_id();
+	event = ramindex_bench_cycles_create(bench.cpu);
+
+	bench.access_ns = bench.access_cycles = 0;
+	for (i = 0; i < iterations; i += n) {
+		preempt_disable();
+		start_cycles = ramindex_bench_cycles(event);
+		start_ns = local_clock();
+		for (n = 0; n < min(chunk, iterations - i); n++)
+			ramindex_device.ops->bench_access();
+		bench.access_ns += local_clock() - start_ns;
+		bench.access_cycles += ramindex_bench_cycles(event) - start_cycles;
+		preempt_enable();
+
+		cond_resched();
+	}
+
+	bench.lines_ns = bench.lines_cycles = 0;
+	for (i = 0; i < total && status == 0; i += n) {
+		preempt_disable();
+		start_cycles = ramindex_bench_cycles(event);
+		start_ns = local_clock();
+		for (n = 0; n < min(chunk, total - i) && status == 0; n++)
+			status = df((i + n) / ccsidr.nways, (i + n) % ccsidr.nways, &line, data, linesize);
+		bench.lines_ns += local_clock() - start_ns;
+		bench.lines_cycles += ramindex_bench_cycles(event) - start_cycles;
+		preempt_enable();
+
+		if (fatal_signal_pending(current))
+			status = -EINTR;
+
+		cond_resched();
+	}
+
+	if (event)
+		perf_event_release_kernel(event);
+	migrate_enable();
+	kfree(data);
+
+	if (status)
+		return status;
+
+	bench.iterations = iterations;
+	bench.nlines = total;
+	strscpy(bench.backend, ramindex_device.ops->name, sizeof(bench.backend));
+
+	if (copy_to_user(ubuf, &bench, size))
+		return -EFAULT;
+
+	return 0;
+}
+
+static void ramindex_async_free(struct ramindex_async_request *req)
+{
+	if (req->eventfd)
+		eventfd_ctx_put(req->eventfd);
+	kvfree(req->data);
+	kvfree(req->lines);
+	kfree(req);
+}
+
+static void ramindex_async_work(struct work_struct *work)
+{
+	struct ramindex_async_request *req =
+		container_of(work, struct ramindex_async_request, work);
+	struct ramindex_file *rf = req->file;
+	__u32 chunk, nlines, n = 0;
+	int status = 0;
+
+	chunk = clamp_t(__u32, READ_ONCE(ramindex_chunk_lines), 1, RAMINDEX_CHUNK_LINES_MAX);
+
+	req->completion.start_ns = ktime_get_ns();
+
+	/* the same as RAMINDEX_DUMP, lines are read in chunks with preemption disabled */
+	for (nlines = 0; nlines < req->total && status == 0; nlines += n) {
+		preempt_disable();
+		/* work items of a cpu going offline are run on other cpus */
+		if (smp_processor_id() != req->async.cpu)
+			status = -EAGAIN;
+		for (n = 0; n < min(chunk, req->total - nlines) && status == 0; n++) {
+			__u32 index = nlines + n;
+			__s32 set = req->start_set + index / (req->end_way - req->start_way);
+			__s32 way = req->start_way + index % (req->end_way - req->start_way);
+
+			status = req->df(set, way, &req->lines[index],
+				req->data ? req->data + (size_t)index * req->linesize : NULL, req->linesize);
+		}
+		preempt_enable();
+
+		cond_resched();
+	}
+
+	req->completion.end_ns = ktime_get_ns();
+	req->completion.status = status;
+	req->completion.nlines = status ? 0 : nlines;
+
+	/* once the lock is dropped @rf may be gone (see ramindex_release()) */
+	spin_lock(&rf->lock);
+	list_add_tail(&req->node, &rf->completed);
+	rf->nrunning--;
+	if (req->eventfd)
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 8, 0)
+		eventfd_signal(req->eventfd);
+#else
+		eventfd_signal(req->eventfd, 1);
+#endif
+	wake_up(&rf->wq);
+	spin_unlock(&rf->lock);
+}
+
+static long ramindex_ioctl_async_submit(struct ramindex_file *rf, void __user *ubuf, size_t size)
+{
+	long status;
+	struct ramindex_async_request *req;
+	struct ramindex_ccsidr ccsidr;
+	struct ramindex_selector *selector;
+
+	if (size != sizeof(struct ramindex_async))
+		return -EINVAL;
+
+	req = kzalloc(sizeof(*req), GFP_KERNEL);
+	if (req == NULL)
+		return -ENOMEM;
+
+	if (copy_from_user(&req->async, ubuf, size)) {
+		status = -EFAULT;
+		goto err;
+	}
+
+	selector = &req->async.selector;
+	if ((selector->flags & ~RAMINDEX_DUMP_F_TAGS_ONLY) || selector->reserved) {
+		status = -EINVAL;
+		goto err;
+	}
+
+	if (req->async.cpu < 0 || req->async.cpu >= nr_cpu_ids || !cpu_online(req->async.cpu)) {
+		ramindex_dbg_at1("Invalid or offline cpu %d\n", req->async.cpu);
+		status = -EINVAL;
+		goto err;
+	}
+
+	req->df = ramindex_get_dumpfunction(selector->level, selector->icache);
+	if (req->df == NULL) {
+		status = -EOPNOTSUPP;
+		goto err;
+	}
+
+	memset(&ccsidr, 0, sizeof(ccsidr));
+	ccsidr.level = selector->level;
+	ccsidr.icache = selector->icache;
+	ramindex_get_ccsidr(&ccsidr);
+
+	if (!ramindex_selector_valid(selector, &ccsidr)) {
+		status = -EINVAL;
+		goto err;
+	}
+
+	ramindex_selector_range(selector, &ccsidr,
+		&req->start_set, &req->end_set, &req->start_way, &req->end_way);
+	req->linesize = (selector->flags & RAMINDEX_DUMP_F_TAGS_ONLY) ? 0 : ccsidr.linesize;
+	req->total = min_t(__u32, selector->nlines,
+		(req->end_set - req->start_set) * (req->end_way - req->start_way));
+
+	req->lines = kvcalloc(req->total, sizeof(*req->lines), GFP_KERNEL);
+	if (req->linesize)
+		req->data = kvmalloc_array(req->total, req->linesize, GFP_KERNEL);
+	if ((req->total && req->lines == NULL) || (req->total && req->linesize && req->data == NULL)) {
+		status = -ENOMEM;
+		goto err;
+	}
+
+	if (req->async.eventfd >= 0) {
+		req->eventfd = eventfd_ctx_fdget(req->async.eventfd);
+		if (IS_ERR(req->eventfd)) {
+			status = PTR_ERR(req->eventfd);
+			req->eventfd = NULL;
+			goto err;
+		}
+	}
+
+	req->file = rf;
+	req->completion.cookie = req->async.cookie;
+	req->completion.cpu = req->async.cpu;
+	INIT_WORK(&req->work, ramindex_async_work);
+
+	spin_lock(&rf->lock);
+	if (rf->noutstanding >= RAMINDEX_ASYNC_MAX) {
+		spin_unlock(&rf->lock);
+		status = -EBUSY;
+		goto err;
+	}
+	rf->noutstanding++;
+	rf->nrunning++;
+	spin_unlock(&rf->lock);
+
+	queue_work_on(req->async.cpu, ramindex_device.async_wq, &req->work);
+
+	return 0;
+
+err:
+	ramindex_async_free(req);
+
+	return status;
+}
+
+static long ramindex_ioctl_async_reap(struct ramindex_file *rf, void __user *ubuf, size_t size)
+{
+	long status = 0;
+	struct ramindex_async_request *req;
+
+	if (size != sizeof(struct ramindex_async_completion))
+		return -EINVAL;
+
+	spin_lock(&rf->lock);
+	req = list_first_entry_or_null(&rf->completed, struct ramindex_async_request, node);
+	if (req) {
+		list_del(&req->node);
+		rf->noutstanding--;
+	}
+	spin_unlock(&rf->lock);
+
+	if (req == NULL)
+		return -EAGAIN;
+
+	/* copied by the reaping thread, as the worker has no access to its memory */
+	if (req->completion.status == 0)
+		req->completion.status = ramindex_copy_lines(
+			(struct ramindex_cacheline __user *)req->async.selector.lines,
+			req->lines, req->data, req->completion.nlines, req->linesize);
+	if (req->completion.status)
+		req->completion.nlines = 0;
+
+	if (copy_to_user(ubuf, &req->completion, size))
+		status = -EFAULT;
+
+	ramindex_async_free(req);
+
+	return status;
+}
+
+static long ramindex_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+	long ret = -EFAULT;
+	size_t size = _IOC_SIZE(cmd);
+	void __user *ubuf = (void __user *)arg;
+
+	ramindex_dbg_at3("%s() cmd: %u '%s'\n",
+		__func__, cmd, ramindex_cmd_to_string(cmd));
+
+	switch (cmd) {
+	case RAMINDEX_VERSION:
+		ret = ramindex_ioctl_version(ubuf, size);
+		break;
+	case RAMINDEX_CLID:
+		ret = ramindex_ioctl_clid(ubuf, size);
+		break;
+	case RAMINDEX_CCSIDR:
+		ret = ramindex_ioctl_ccsidr(ubuf, size);
+		break;
+	case RAMINDEX_DUMP:
+	case RAMINDEX_DUMP_V1:
+	case RAMINDEX_DUMP_V0:
+		ret = ramindex_ioctl_dump(ubuf, size);
+		break;
+	case RAMINDEX_DUMPV:
+		ret = ramindex_ioctl_dumpv(ubuf, size);
+		break;
+	case RAMINDEX_DUMP_PMU:
+		ret = ramindex_ioctl_dump_pmu(ubuf, size);
+		break;
+	case RAMINDEX_OCCUPANCY:
+		ret = ramindex_ioctl_occupancy(ubuf, size);
+		break;
+	case RAMINDEX_PLACEMENT:
+		ret = ramindex_ioctl_placement(ubuf, size);
+		break;
+	case RAMINDEX_TLB_GEOMETRY:
+		ret = ramindex_ioctl_tlb_geometry(ubuf, size);
+		break;
+	case RAMINDEX_TLB_DUMP:
+		ret = ramindex_ioctl_tlb_dump(ubuf, size);
+		break;
+	case RAMINDEX_SYNC_DUMP:
+		ret = ramindex_ioctl_sync_dump(ubuf, size);
+		break;
+	case RAMINDEX_TRIGGER_ARM:
+		ret = ramindex_ioctl_trigger_arm(ubuf, size);
+		break;
+	case RAMINDEX_TRIGGER_DISARM:
+		ret = ramindex_ioctl_trigger_disarm();
+		break;
+	case RAMINDEX_TRIGGER_FIRE:
+		ret = ramindex_ioctl_trigger_fire();
+		break;
+	case RAMINDEX_TRIGGER_READ:
+		ret = ramindex_ioctl_trigger_read(ubuf, size);
+		break;
+	case RAMINDEX_BENCH:
+		ret = ramindex_ioctl_bench(ubuf, size);
+		break;
+	case RAMINDEX_ASYNC_SUBMIT:
+		ret = ramindex_ioctl_async_submit(file->private_data, ubuf, size);
+		break;
+	case RAMINDEX_ASYNC_REAP:
+		ret = ramindex_ioctl_async_reap(file->private_data, ubuf, size);
+		break;
+	default:
+		msleep(1000); /* deliberately sleep for 1 second */
+		ret = -EINVAL;
+		break;
+	}
+
+	return ret;
+}
+
+static __poll_t ramindex_poll(struct file *file, poll_table *wait)
+{
+	struct ramindex_file *rf = file->private_data;
+	__poll_t mask = 0;
+
+	poll_wait(file, &rf->wq, wait);
+
+	spin_lock(&rf->lock);
+	if (!list_empty(&rf->completed))
+		mask |= EPOLLIN | EPOLLRDNORM;
+	spin_unlock(&rf->lock);
+
+	return mask;
+}
+
+static int ramindex_open(struct inode *inode, struct file *file)
+{
+	struct ramindex_file *rf;
+
+	rf = kzalloc(sizeof(*rf), GFP_KERNEL);
+	if (rf == NULL)
+		return -ENOMEM;
+
+	spin_lock_init(&rf->lock);
+	init_waitqueue_head(&rf->wq);
+	INIT_LIST_HEAD(&rf->completed);
+
+	/* replaces the miscdevice set by misc_open() */
+	file->private_data = rf;
+
+	return 0;
+}
+
+static bool ramindex_async_idle(struct ramindex_file *rf)
+{
+	bool idle;
+
+	spin_lock(&rf->lock);
+	idle = rf->nrunning == 0;
+	spin_unlock(&rf->lock);
+
+	return idle;
+}
+
+static int ramindex_release(struct inode *inode, struct file *file)
+{
+	struct ramindex_file *rf = file->private_data;
+	struct ramindex_async_request *req, *tmp;
+
+	/* requests are never cancelled, they read one cache at most */
+	wait_event(rf->wq, ramindex_async_idle(rf));
+
+	list_for_each_entry_safe(req, tmp, &rf->completed, node)
+		ramindex_async_free(req);
+
+	kfree(rf);
+
+	return 0;
+}
+
+const struct file_operations ramindex_fops = {
+	.owner = THIS_MODULE,
+	.open = ramindex_open,
+	.release = ramindex_release,
+	.poll = ramindex_poll,
+	.unlocked_ioctl = ramindex_ioctl,
+};
+
+static int __init ramindex_init(void)
+{
+	int status;
+	__u64 midr_el1;
+	__u64 clidr_el1;
+
+	asm volatile("mrs %0, midr_el1" : "=r" (midr_el1));
+	asm volatile("mrs %0, clidr_el1" : "=r" (clidr_el1));
+
+	switch (midr_el1) {
+	case 0x410fd083:
+		ramindex_device.ops = &ramindex_cortex_a72_ops;
+		break;
+	case 0x410fd811:
+		ramindex_device.ops = &ramindex_cortex_a720_ops;
+		break;
+	default:
+		status = -EOPNOTSUPP;
+		break;
+	}
+
+	/*
+	 * Neoverse parts are recognized regardless of their variant and revision,
+	 * but only on request, as their tag layouts are not confirmed yet
+	 */
+	switch (ramindex_neoverse ? midr_el1 & RAMINDEX_MIDR_PART_MASK : 0) {
+	case 0x410fd0c0:
+		ramindex_device.ops = &ramindex_neoverse_n1_ops;
+		break;
+	case 0x410fd490:
+		ramindex_device.ops = &ramindex_neoverse_n2_ops;
+		break;
+	}
+
+	if (ramindex_sim)
+		ramindex_device.ops = &ramindex_sim_ops;
+
+	ramindex_device.midr_el1 = midr_el1;
+	ramindex_device.clidr_el1 = clidr_el1;
+	mutex_init(&ramindex_device.quiet_lock);
+
+	if (ramindex_device.ops) {
+		status = ramindex_quiet_alloc();
+		if (status < 0) {
+			pr_err("cannot allocate buffer for low perturbation captures\n");
+			return status;
+		}
+	}
+
+	ramindex_device.async_wq = alloc_workqueue("ramindex", 0, 0);
+	if (ramindex_device.async_wq == NULL) {
+		pr_err("cannot allocate workqueue for asynchronous requests\n");
+		vfree(ramindex_device.quiet_lines);
+		return -ENOMEM;
+	}
+
+	status = ramindex_stats_init();
+	if (status < 0)
+		pr_warn("cannot create debugfs entries (%d), statistics will not be available\n",
+			status);
+
+	if (ramindex_device.ops) {
+		status = ramindex_bpf_init();
+		if (status < 0)
+			pr_warn("cannot register BPF kfuncs (%d), BPF programs will not see cache lines\n",
+				status);
+	}
+
+	ramindex_device.miscdev.fops = &ramindex_fops;
+	ramindex_device.miscdev.minor = MISC_DYNAMIC_MINOR;
+	ramindex_device.miscdev.name = RAMINDEX_DEVICE_NAME;
+	status = misc_register(&ramindex_device.miscdev);
+	if (status < 0) {
+		pr_err("misc_register(%s) failed with code %d\n",
+			ramindex_device.miscdev.name, status);
+		ramindex_stats_exit();
+		destroy_workqueue(ramindex_device.async_wq);
+		vfree(ramindex_device.quiet_lines);
+		return status;
+	}
+
+	pr_info("module loaded (version: %s, midr_el1: 0x%llx, clidr_el1: 0x%llx, backend: %s)\n",
+		RAMINDEX_VERSION_STR, midr_el1, clidr_el1,
+		ramindex_device.ops ? ramindex_device.ops->name : "none");
+	return 0;
+}
+module_init(ramindex_init);
+
+#ifdef MODULE
+static void __exit ramindex_exit(void)
+{
+	misc_deregister(&ramindex_device.miscdev);
+
+	mutex_lock(&ramindex_trigger_state.lock);
+	ramindex_trigger_disarm_locked(&ramindex_trigger_state);
+	ramindex_trigger_free_locked(&ramindex_trigger_state);
+	mutex_unlock(&ramindex_trigger_state.lock);
+
+	ramindex_pmu_exit();
+	ramindex_stats_exit();
+	destroy_workqueue(ramindex_device.async_wq);
+	vfree(ramindex_device.quiet_lines);
+
 	pr_info("module removed\n");
 }
 module_exit(ramindex_exit);
@@ -0,0 +1,34 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ramindex-main.h
+ *
+ * Copyright (C) 2024 Lukasz Wiecaszek <lukasz.wiecaszek(at)gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License (in file COPYING) for more details.
+ */
+
+#ifndef _RAMINDEX_MAIN_H_
+#define _RAMINDEX_MAIN_H_
+
+#include "ramindex-ops.h"
+
+/*
+ * Fills geometry (@nsets, @nways, @linesize) of the cache selected by
+ * @ccsidr->level and @ccsidr->icache, as seen by the calling cpu.
+ */
+void ramindex_get_ccsidr(struct ramindex_ccsidr *ccsidr);
+
+/*
+ * Returns dump function of the selected cache of the detected cpu
+ * or NULL if there is none.
+ */
+dumpfunction_t ramindex_get_dumpfunction(__s32 level, __s32 icache);
+
+#endif /* _RAMINDEX_MAIN_H_ */
@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ramindex-memcg.c
+ *
+ * Copyright (C) 2024 Lukasz Wiecaszek <lukasz.wiecaszek(at)gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License (in file COPYING) for more details.
+ */
+
+/*
+ * Attribution of physical frames to memory cgroups. Frames read out of
+ * tags are arbitrary ones, their pages may be getting freed, split or
+ * recharged at the same time, so the lookup takes no reference and relies
+ * on RCU only (the same way page_owner looks at random pages).
+ * A page in flux may thus be attributed to no cgroup or to its previous one.
+ */
+
+#include <linux/types.h>
+#include <linux/mm.h>
+#include <linux/memory_hotplug.h>
+#include <linux/memcontrol.h>
+#include <linux/cgroup.h>
+#include <linux/rcupdate.h>
+#include <linux/version.h>
+
+#include "ramindex-memcg.h"
+
+#if IS_ENABLED(CONFIG_MEMCG)
+
+u64 ramindex_memcg_id(u64 pfn)
+{
+	struct mem_cgroup *memcg;
+	struct page *page;
+	u64 id = 0;
+
+	/* holes, offline sections and memory not managed by the kernel have no pages */
+	page = pfn_to_online_page(pfn);
+	if (page == NULL)
+		return 0;
+
+	rcu_read_lock();
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 1, 0)
+	memcg = folio_memcg_check(page_folio(page));
+#else
+	memcg = page_memcg_check(page);
+#endif
+	if (memcg)
+		id = cgroup_id(memcg->css.cgroup);
+	rcu_read_unlock();
+
+	return id;
+}
+
+#endif /* CONFIG_MEMCG */
@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ramindex-memcg.h
+ *
+ * Copyright (C) 2024 Lukasz Wiecaszek <lukasz.wiecaszek(at)gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License (in file COPYING) for more details.
+ */
+
+#ifndef _RAMINDEX_MEMCG_H_
+#define _RAMINDEX_MEMCG_H_
+
+#include <linux/kconfig.h>
+#include <linux/types.h>
+
+#if IS_ENABLED(CONFIG_MEMCG)
+/*
+ * Returns id of the memory cgroup the page of the physical frame @pfn
+ * is charged to, 0 if there is none (or the frame is not online memory).
+ * Does not sleep.
+ */
+u64 ramindex_memcg_id(u64 pfn);
+
+static inline bool ramindex_memcg_supported(void)
+{
+	return true;
+}
+#else
+static inline u64 ramindex_memcg_id(u64 pfn)
+{
+	return 0;
+}
+
+static inline bool ramindex_memcg_supported(void)
+{
+	return false;
+}
+#endif
+
+#endif /* _RAMINDEX_MEMCG_H_ */
@@ -0,0 +1,91 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ramindex-neoverse-desc.h
+ *
+ * Copyright (C) 2024 Lukasz Wiecaszek <lukasz.wiecaszek(at)gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License (in file COPYING) for more details.
+ *
+ * Tag layouts of Neoverse N1 and N2, kept apart from the backend so that
+ * the decoding is checked by a userspace test (userspace/tests) against
+ * reference register values.
+ *
+ * They follow the Cortex-A720 ones and have not been confirmed against the
+ * N1/N2 reference manuals yet, hence the backend is used only when asked
+ * for (neoverse module parameter). Being descriptors, they are fixed by
+ * editing numbers should a core differ.
+ */
+
+#ifndef _RAMINDEX_NEOVERSE_DESC_H_
+#define _RAMINDEX_NEOVERSE_DESC_H_
+
+#include "ramindex-desc.h"
+
+/*
+ * L1 D$ tags hold the state in two bits:
+ * 0b00 Invalid, 0b01 Unique Clean, 0b10 Unique Dirty, 0b11 Shared Clean.
+ */
+static const __u8 ramindex_neoverse_l1d_state[4] = {
+	CSTATE_INVALID, CSTATE_UNIQUE_CLEAN, CSTATE_UNIQUE_DIRTY, CSTATE_SHARED_CLEAN
+};
+
+/*
+ * L2 tags hold the state in three bits:
+ * 0b000 Invalid, 0b001 Shared Clean, 0b010 Unique Clean,
+ * 0b011 Unique Dirty, 0b100 Shared Dirty (other encodings are reserved).
+ */
+static const __u8 ramindex_neoverse_l2_state[8] = {
+	CSTATE_INVALID, CSTATE_SHARED_CLEAN, CSTATE_UNIQUE_CLEAN, CSTATE_UNIQUE_DIRTY,
+	CSTATE_SHARED_DIRTY, CSTATE_UNKNOWN, CSTATE_UNKNOWN, CSTATE_UNKNOWN
+};
+
+/*
+ * IMP_ISIDE_DATA0_EL3 for L1 I$ tag:
+ *
+ * [27:0] Tag		Physical Address bits [39:12]
+ * [28] NS		Non-secure identifier
+ * [29] Valid
+ */
+#define RAMINDEX_NEOVERSE_L1I_TAG { \
+	.tag_shift = 0, .tag_mask = 0x0fffffff, .tag_lsb = 12, .set_mask = 0x3f, \
+	.ns_bit = 28, \
+	.state_shift = 29, .state_mask = 0x1, .states = NULL, \
+}
+
+/*
+ * IMP_DSIDE_DATA0_EL3 for L1 D$ tag:
+ *
+ * [1:0] State
+ * [29:2] Tag		Physical Address bits [39:12]
+ * [30] NS		Non-secure identifier
+ */
+#define RAMINDEX_NEOVERSE_L1D_TAG { \
+	.tag_shift = 2, .tag_mask = 0x0fffffff, .tag_lsb = 12, .set_mask = 0x3f, \
+	.ns_bit = 30, \
+	.state_shift = 0, .state_mask = 0x3, .states = ramindex_neoverse_l1d_state, \
+}
+
+/*
+ * IMP_DSIDE_DATA0_EL3 for L2 tag:
+ *
+ * [2:0] State
+ * [3] NS		Non-secure identifier
+ * [36:4] Tag		Physical Address bits [47:15]
+ *
+ * The tag always holds PA[47:15], so its lowest bits overlap with
+ * the set index of L2 caches having more than 512 sets and are simply OR-ed.
+ */
+#define RAMINDEX_NEOVERSE_L2U_TAG { \
+	.tag_shift = 4, .tag_mask = 0x1ffffffffULL, .tag_lsb = 15, .set_mask = 0x7ff, \
+	.ns_bit = 3, \
+	.state_shift = 0, .state_mask = 0x7, .states = ramindex_neoverse_l2_state, \
+}
+
+#endif /* _RAMINDEX_NEOVERSE_DESC_H_ */
@@ -0,0 +1,89 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ramindex-neoverse.c
+ *
+ * Copyright (C) 2024 Lukasz Wiecaszek <lukasz.wiecaszek(at)gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License (in file COPYING) for more details.
+ *
+ * Neoverse N1 and N2 (same as Cortex-A720) allow for access to caches'
+ * internal memory only in EL3, so they are read through the CPU service
+ * (atf/cpu_svc_neoverse.c). Both have 64KiB 4-way L1 I$ and L1 D$ and
+ * an 8-way private L2 of up to 1MiB. The system level cache lives in the
+ * interconnect and is not reachable by RAMINDEX, hence it is not dumped.
+ *
+ * Tag only dumps read tags of all the ways of a set by one SMC call
+ * (CPU_SVC_GET_TAGS), so that tags of a 1MiB L2 take 2048 round trips
+ * instead of 16384.
+ *
+ * Tag layouts (ramindex-neoverse-desc.h) follow the Cortex-A720 ones and
+ * are not confirmed for N1/N2 yet, so the backend is not picked by MIDR_EL1
+ * alone but only when the neoverse module parameter is set.
+ */
+
+#include <linux/types.h>
+#include <linux/errno.h>
+
+#include "ramindex-ops.h"
+#include "ramindex-cpu-svc.h"
+#include "ramindex-neoverse-desc.h"
+
+static const struct ramindex_cpu_svc_ram ramindex_neoverse_l1i = {
+	.fid = CPU_SVC_GET_L1I_CACHELINE,
+	.cache = CPU_SVC_CACHE_L1I,
+	.nways = 4,
+	.tag = RAMINDEX_NEOVERSE_L1I_TAG,
+};
+
+static const struct ramindex_cpu_svc_ram ramindex_neoverse_l1d = {
+	.fid = CPU_SVC_GET_L1D_CACHELINE,
+	.cache = CPU_SVC_CACHE_L1D,
+	.nways = 4,
+	.tag = RAMINDEX_NEOVERSE_L1D_TAG,
+};
+
+static const struct ramindex_cpu_svc_ram ramindex_neoverse_l2u = {
+	.fid = CPU_SVC_GET_L2U_CACHELINE,
+	.cache = CPU_SVC_CACHE_L2U,
+	.nways = 8,
+	.tag = RAMINDEX_NEOVERSE_L2U_TAG,
+};
+
+RAMINDEX_CPU_SVC_DUMPFUNCTION(ramindex_neoverse, l1i)
+RAMINDEX_CPU_SVC_DUMPFUNCTION(ramindex_neoverse, l1d)
+RAMINDEX_CPU_SVC_DUMPFUNCTION(ramindex_neoverse, l2u)
+
+static void ramindex_neoverse_bench_access(void)
+{
+	struct arm_smccc_1_2_regs in;
+	struct arm_smccc_1_2_regs out;
+
+	in.a0 = CPU_SVC_GET_L1D_CACHELINE;
+	in.a1 = 0; /* set */
+	in.a2 = 0; /* way */
+	in.a3 = ramindex_cpu_svc_flags(0);
+	ramindex_cpu_svc_smc(&in, &out);
+}
+
+const struct ramindex_ops ramindex_neoverse_n1_ops = {
+	.name = "neoverse-n1",
+	.dump_l1i_cacheline = ramindex_neoverse_dump_l1i_cacheline,
+	.dump_l1d_cacheline = ramindex_neoverse_dump_l1d_cacheline,
+	.dump_l2d_cacheline = ramindex_neoverse_dump_l2u_cacheline,
+	.bench_access = ramindex_neoverse_bench_access,
+};
+
+const struct ramindex_ops ramindex_neoverse_n2_ops = {
+	.name = "neoverse-n2",
+	.dump_l1i_cacheline = ramindex_neoverse_dump_l1i_cacheline,
+	.dump_l1d_cacheline = ramindex_neoverse_dump_l1d_cacheline,
+	.dump_l2d_cacheline = ramindex_neoverse_dump_l2u_cacheline,
+	.bench_access = ramindex_neoverse_bench_access,
+};
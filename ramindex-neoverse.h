@@ -0,0 +1,25 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ramindex-neoverse.h
+ *
+ * Copyright (C) 2024 Lukasz Wiecaszek <lukasz.wiecaszek(at)gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License (in file COPYING) for more details.
+ */
+
+#ifndef _RAMINDEX_NEOVERSE_H_
+#define _RAMINDEX_NEOVERSE_H_
+
+#include "ramindex-ops.h"
+
+extern const struct ramindex_ops ramindex_neoverse_n1_ops;
+extern const struct ramindex_ops ramindex_neoverse_n2_ops;
+
+#endif /* _RAMINDEX_NEOVERSE_H_ */
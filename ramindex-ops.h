@@ -18,14 +18,80 @@
 #define _RAMINDEX_OPS_H_
 
 #include <linux/types.h>
+#include <linux/percpu.h>
+#include <linux/jump_label.h>
 #include "ramindex.h"
+#include "ramindex-line.h"
 
-typedef int (*dumpfunction_t)(__s32 set, __s32 way, __u32 lsize, struct ramindex_cacheline __user *l);
+/*
+ * Reads the tag of a line selected by @set and @way into @l and,
+ * unless @linesize is 0 (tag only access), its content into @linedata.
+ * @linesize is either 0 or the line size reported by CCSIDR_EL1.
+ * Called with preemption disabled (RAMINDEX/SMC accesses have to be
+ * issued and completed on the same cpu), so it shall not sleep.
+ */
+typedef int (*dumpfunction_t)(__s32 set, __s32 way, struct ramindex_line *l, void *linedata, __u32 linesize);
+
+/*
+ * Reads a TLB entry selected by @set and @way into @e.
+ * Same as dumpfunction_t it is called with preemption disabled.
+ */
+typedef int (*tlbdumpfunction_t)(__s32 set, __s32 way, struct ramindex_tlbentry *e);
+
+/**
+ * struct ramindex_tlb - describes one TLB (TLBs are not described by CCSIDR_EL1)
+ * @nsets:	number of sets (entries of fully associative TLBs)
+ * @nways:	number of ways (1 for fully associative TLBs)
+ * @dump_entry:	reads one entry
+ */
+struct ramindex_tlb {
+	__s32 nsets;
+	__s32 nways;
+	tlbdumpfunction_t dump_entry;
+};
+
+/*
+ * Issues one raw access reading a tag (a RAMINDEX operation or an SMC
+ * round trip) without decoding it. Timed by RAMINDEX_BENCH, called
+ * with preemption disabled.
+ */
+typedef void (*benchfunction_t)(void);
+
+/**
+ * enum ramindex_access - RAMINDEX access sequences (access module parameter)
+ * @RAMINDEX_ACCESS_CONSERVATIVE:	every RAMINDEX operation is completed
+ *	by dsb sy + isb before its result registers are read
+ * @RAMINDEX_ACCESS_MINIMAL:	the dsb is limited to the shareability domain
+ *	of the RAM being read (non-shareable for core private RAMs)
+ * @RAMINDEX_ACCESS_VERIFY:	every line is read both ways and the results
+ *	are compared (dump fails with -EIO if they differ)
+ */
+enum ramindex_access {
+	RAMINDEX_ACCESS_CONSERVATIVE,
+	RAMINDEX_ACCESS_MINIMAL,
+	RAMINDEX_ACCESS_VERIFY,
+	RAMINDEX_ACCESS_NR
+};
+
+DECLARE_STATIC_KEY_FALSE(ramindex_access_minimal_enabled);
+DECLARE_PER_CPU(bool, ramindex_access_conservative);
+
+/*
+ * Tells the backends which sequence to issue. Reads done on behalf of
+ * RAMINDEX_ACCESS_VERIFY as the reference ones are forced to be conservative.
+ */
+static __always_inline bool ramindex_access_minimal(void)
+{
+	return static_branch_unlikely(&ramindex_access_minimal_enabled) &&
+		!this_cpu_read(ramindex_access_conservative);
+}
 
 /**
  * struct ramindex_ops - ramindex operations
  */
 struct ramindex_ops {
+	const char *name;
+
 	dumpfunction_t dump_l1i_cacheline;
 	dumpfunction_t dump_l1d_cacheline;
 
@@ -34,6 +100,12 @@ struct ramindex_ops {
 
 	dumpfunction_t dump_l3i_cacheline;
 	dumpfunction_t dump_l3d_cacheline;
+
+	struct ramindex_tlb l1i_tlb;
+	struct ramindex_tlb l1d_tlb;
+	struct ramindex_tlb l2_tlb;
+
+	benchfunction_t bench_access;
 };
 
 #endif /* _RAMINDEX_OPS_H_ */
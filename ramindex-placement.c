@@ -0,0 +1,67 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ramindex-placement.c
+ *
+ * Copyright (C) 2024 Lukasz Wiecaszek <lukasz.wiecaszek(at)gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License (in file COPYING) for more details.
+ */
+
+/*
+ * Attribution of physical frames to NUMA nodes and zones. Node and zone
+ * are encoded in page flags, which stay put while the page is online,
+ * so unlike memory cgroups they are read without any locking.
+ */
+
+#include <linux/types.h>
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/memory_hotplug.h>
+
+#include "ramindex-placement.h"
+
+static __s16 ramindex_placement_zone(const struct page *page)
+{
+	switch (page_zonenum(page)) {
+#ifdef CONFIG_ZONE_DMA
+	case ZONE_DMA:
+		return RAMINDEX_ZONE_DMA;
+#endif
+#ifdef CONFIG_ZONE_DMA32
+	case ZONE_DMA32:
+		return RAMINDEX_ZONE_DMA32;
+#endif
+	case ZONE_MOVABLE:
+		return RAMINDEX_ZONE_MOVABLE;
+#ifdef CONFIG_ZONE_DEVICE
+	case ZONE_DEVICE:
+		return RAMINDEX_ZONE_DEVICE;
+#endif
+	default:
+		/* ZONE_NORMAL, and ZONE_HIGHMEM where there is one */
+		return RAMINDEX_ZONE_NORMAL;
+	}
+}
+
+void ramindex_placement_of(u64 pfn, struct ramindex_line_placement *lp)
+{
+	struct page *page;
+
+	/* holes, offline sections and memory not managed by the kernel have no pages */
+	page = pfn_to_online_page(pfn);
+	if (page == NULL) {
+		lp->node = -1;
+		lp->zone = -1;
+		return;
+	}
+
+	lp->node = page_to_nid(page);
+	lp->zone = ramindex_placement_zone(page);
+}
@@ -0,0 +1,31 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ramindex-placement.h
+ *
+ * Copyright (C) 2024 Lukasz Wiecaszek <lukasz.wiecaszek(at)gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License (in file COPYING) for more details.
+ */
+
+#ifndef _RAMINDEX_PLACEMENT_H_
+#define _RAMINDEX_PLACEMENT_H_
+
+#include <linux/types.h>
+
+#include "ramindex.h"
+
+/*
+ * Fills @lp with the NUMA node and the zone of the page of the physical
+ * frame @pfn, -1 and -1 if the frame is not online memory.
+ * Does not sleep.
+ */
+void ramindex_placement_of(u64 pfn, struct ramindex_line_placement *lp);
+
+#endif /* _RAMINDEX_PLACEMENT_H_ */
@@ -0,0 +1,148 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ramindex-pmu.c
+ *
+ * Copyright (C) 2024 Lukasz Wiecaszek <lukasz.wiecaszek(at)gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License (in file COPYING) for more details.
+ */
+
+/*
+ * PMU counters read alongside dumps. Every counter is a pinned kernel
+ * counter bound to a cpu (counting whatever runs there, at all exception
+ * levels), created the first time its event is requested on that cpu
+ * and kept till the module is removed, so that successive reads of it
+ * tell what happened between the dumps. Events the PMU does not implement,
+ * or which do not fit into its counters, are never counted and reported
+ * as not valid.
+ */
+
+#define pr_fmt(fmt) "ramindex: " fmt
+
+#include <linux/types.h>
+#include <linux/errno.h>
+#include <linux/err.h>
+#include <linux/bits.h>
+#include <linux/printk.h>
+#include <linux/percpu.h>
+#include <linux/cpumask.h>
+#include <linux/mutex.h>
+#include <linux/smp.h>
+#include <linux/perf_event.h>
+
+#include "ramindex.h"
+#include "ramindex-pmu.h"
+
+/**
+ * struct ramindex_pmu_cpu - counters of one cpu
+ * @events:	counters of RAMINDEX_PMU_* events (NULL if not created)
+ * @failed:	bitmask of the events whose counters could not be created
+ */
+struct ramindex_pmu_cpu {
+	struct perf_event *events[RAMINDEX_PMU_NR];
+	u32 failed;
+};
+
+/* ARMv8 common architectural and microarchitectural events */
+static const struct {
+	u32 type;
+	u64 config;
+} ramindex_pmu_attrs[RAMINDEX_PMU_NR] = {
+	[RAMINDEX_PMU_CYCLES] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+	[RAMINDEX_PMU_INSTRUCTIONS] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+	[RAMINDEX_PMU_L1D_REFILL] = { PERF_TYPE_RAW, 0x03 },	/* L1D_CACHE_REFILL */
+	[RAMINDEX_PMU_L1I_REFILL] = { PERF_TYPE_RAW, 0x01 },	/* L1I_CACHE_REFILL */
+	[RAMINDEX_PMU_L2D_REFILL] = { PERF_TYPE_RAW, 0x17 },	/* L2D_CACHE_REFILL */
+	[RAMINDEX_PMU_L1D_WB] = { PERF_TYPE_RAW, 0x15 },	/* L1D_CACHE_WB */
+	[RAMINDEX_PMU_L2D_WB] = { PERF_TYPE_RAW, 0x18 },	/* L2D_CACHE_WB */
+};
+
+static DEFINE_PER_CPU(struct ramindex_pmu_cpu, ramindex_pmu_cpus);
+static DEFINE_MUTEX(ramindex_pmu_lock);
+
+void ramindex_pmu_open(int cpu, u32 events)
+{
+	struct ramindex_pmu_cpu *pc = per_cpu_ptr(&ramindex_pmu_cpus, cpu);
+	struct perf_event *event;
+	int n;
+
+	mutex_lock(&ramindex_pmu_lock);
+
+	for (n = 0; n < RAMINDEX_PMU_NR; n++) {
+		struct perf_event_attr attr = {
+			.type = ramindex_pmu_attrs[n].type,
+			.config = ramindex_pmu_attrs[n].config,
+			.size = sizeof(struct perf_event_attr),
+			.pinned = 1,
+		};
+
+		if (!(events & BIT(n)) || pc->events[n] || (pc->failed & BIT(n)))
+			continue;
+
+		event = perf_event_create_kernel_counter(&attr, cpu, NULL, NULL, NULL);
+		if (IS_ERR(event)) {
+			pr_debug("cannot create counter of event %d on cpu %d (%ld)\n",
+				n, cpu, PTR_ERR(event));
+			pc->failed |= BIT(n);
+			continue;
+		}
+
+		/* read locklessly by ramindex_pmu_read() */
+		WRITE_ONCE(pc->events[n], event);
+	}
+
+	mutex_unlock(&ramindex_pmu_lock);
+}
+
+u32 ramindex_pmu_read(u32 events, u64 *values)
+{
+	struct ramindex_pmu_cpu *pc = this_cpu_ptr(&ramindex_pmu_cpus);
+	struct perf_event *event;
+	u64 enabled, running;
+	u32 valid = 0;
+	int n;
+
+	for (n = 0; n < RAMINDEX_PMU_NR; n++) {
+		values[n] = 0;
+		if (!(events & BIT(n)))
+			continue;
+
+		event = READ_ONCE(pc->events[n]);
+		if (event == NULL ||
+			perf_event_read_local(event, &values[n], &enabled, &running))
+			continue;
+
+		/* a pinned counter which lost its place on the PMU counts no more */
+		if (running != enabled) {
+			values[n] = 0;
+			continue;
+		}
+
+		valid |= BIT(n);
+	}
+
+	return valid;
+}
+
+void ramindex_pmu_exit(void)
+{
+	struct ramindex_pmu_cpu *pc;
+	int cpu, n;
+
+	for_each_possible_cpu(cpu) {
+		pc = per_cpu_ptr(&ramindex_pmu_cpus, cpu);
+		for (n = 0; n < RAMINDEX_PMU_NR; n++) {
+			if (pc->events[n])
+				perf_event_release_kernel(pc->events[n]);
+			pc->events[n] = NULL;
+		}
+		pc->failed = 0;
+	}
+}
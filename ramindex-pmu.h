@@ -0,0 +1,40 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ramindex-pmu.h
+ *
+ * Copyright (C) 2024 Lukasz Wiecaszek <lukasz.wiecaszek(at)gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License (in file COPYING) for more details.
+ */
+
+#ifndef _RAMINDEX_PMU_H_
+#define _RAMINDEX_PMU_H_
+
+#include <linux/types.h>
+
+/*
+ * Creates (unless already created) kernel counters of the selected
+ * RAMINDEX_PMU_* events (a bitmask) on @cpu. Counters stay allocated
+ * and keep counting until ramindex_pmu_exit(). May sleep.
+ */
+void ramindex_pmu_open(int cpu, u32 events);
+
+/*
+ * Reads counters of the selected events into @values (RAMINDEX_PMU_NR
+ * entries, indexed by event) on the cpu the caller runs on, with preemption
+ * disabled. Returns the bitmask of the events whose counters have been
+ * counting all the time since they were created, @values of the others
+ * are set to 0.
+ */
+u32 ramindex_pmu_read(u32 events, u64 *values);
+
+void ramindex_pmu_exit(void);
+
+#endif /* _RAMINDEX_PMU_H_ */
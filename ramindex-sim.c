@@ -0,0 +1,135 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ramindex-sim.c
+ *
+ * Copyright (C) 2024 Lukasz Wiecaszek <lukasz.wiecaszek(at)gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License (in file COPYING) for more details.
+ */
+
+/*
+ * Simulated backend. It touches no implementation defined registers
+ * and makes no SMC calls, so it runs on any arm64 core (including
+ * virtual ones in CI). Lines and TLB entries are synthesized from
+ * their coordinates and the cpu they are read on, so consecutive
+ * dumps of the same cache on the same cpu return the same content.
+ * Only L1 and L2 caches are simulated (their geometry is taken from
+ * CCSIDR_EL1), as not every core has got L3 cache.
+ */
+
+#include <linux/types.h>
+#include <linux/errno.h>
+#include <linux/string.h>
+#include <linux/sizes.h>
+#include <linux/bitops.h>
+#include <linux/hash.h>
+#include <linux/smp.h>
+#include <linux/compiler.h>
+
+#include "ramindex-ops.h"
+
+/* level and type of the cache go to bits [3:0], cpu to bits [15:4] of the seed */
+static __always_inline __u64 ramindex_sim_hash(__u32 cache, __s32 set, __s32 way)
+{
+	__u64 seed = (__u64)(smp_processor_id() << 4 | cache) << 48;
+
+	return hash_64(seed | (__u64)set << 16 | way, 64);
+}
+
+static int ramindex_sim_dump_cacheline(__u32 cache, __s32 set, __s32 way,
+	struct ramindex_line *l, void *linedata, __u32 linesize)
+{
+	__u64 h = ramindex_sim_hash(cache, set, way);
+
+	l->set = set;
+	l->way = way;
+	l->valid = (h & 0x3) != 0; /* 3 out of 4 lines are valid */
+	l->dirty = l->valid && !(cache & 0x1) && (h & 0x4);
+	l->ns = (h >> 3) & 0x1;
+	l->state = !l->valid ? CSTATE_INVALID :
+		l->dirty ? CSTATE_UNIQUE_DIRTY : CSTATE_SHARED_CLEAN;
+	/* 40 bits of physical address, set index is part of the tag as on real cores */
+	l->tag = (h & GENMASK_ULL(39, 16)) | ((__u64)(set & 0x3ff) << 6);
+
+	if (linesize)
+		memset(linedata, (__u8)(h >> 8), linesize);
+
+	return 0;
+}
+
+static int ramindex_sim_dump_l1i_cacheline(__s32 set, __s32 way, struct ramindex_line *l, void *linedata, __u32 linesize)
+{
+	return ramindex_sim_dump_cacheline(0x1, set, way, l, linedata, linesize);
+}
+
+static int ramindex_sim_dump_l1d_cacheline(__s32 set, __s32 way, struct ramindex_line *l, void *linedata, __u32 linesize)
+{
+	return ramindex_sim_dump_cacheline(0x0, set, way, l, linedata, linesize);
+}
+
+static int ramindex_sim_dump_l2d_cacheline(__s32 set, __s32 way, struct ramindex_line *l, void *linedata, __u32 linesize)
+{
+	return ramindex_sim_dump_cacheline(0x2, set, way, l, linedata, linesize);
+}
+
+static int ramindex_sim_dump_tlbentry(__u32 tlb, __s32 set, __s32 way, struct ramindex_tlbentry *e)
+{
+	__u64 h = ramindex_sim_hash(0x8 | tlb, set, way);
+
+	e->set = set;
+	e->way = way;
+	e->valid = (h & 0x3) != 0;
+	e->ns = 1;
+	e->global = (h >> 2) & 0x1;
+	e->asid = e->global ? 0 : (h >> 3) & 0xff;
+	e->vmid = 0;
+	e->pagesize = SZ_4K;
+	e->va = (h & GENMASK_ULL(47, 12)) | 0xffff000000000000ULL;
+	e->pa = hash_64(h, 40) << 12;
+	e->unverified = 0;
+	e->raw[0] = h;
+	e->raw[1] = 0;
+	e->raw[2] = 0;
+	e->raw[3] = 0;
+
+	return 0;
+}
+
+static int ramindex_sim_dump_l1i_tlbentry(__s32 set, __s32 way, struct ramindex_tlbentry *e)
+{
+	return ramindex_sim_dump_tlbentry(0x0, set, way, e);
+}
+
+static int ramindex_sim_dump_l1d_tlbentry(__s32 set, __s32 way, struct ramindex_tlbentry *e)
+{
+	return ramindex_sim_dump_tlbentry(0x1, set, way, e);
+}
+
+static int ramindex_sim_dump_l2_tlbentry(__s32 set, __s32 way, struct ramindex_tlbentry *e)
+{
+	return ramindex_sim_dump_tlbentry(0x2, set, way, e);
+}
+
+/* there is no hardware access to be timed, which gives the baseline of the benchmark loop */
+static void ramindex_sim_bench_access(void)
+{
+	barrier();
+}
+
+const struct ramindex_ops ramindex_sim_ops = {
+	.name = "sim",
+	.dump_l1i_cacheline = ramindex_sim_dump_l1i_cacheline,
+	.dump_l1d_cacheline = ramindex_sim_dump_l1d_cacheline,
+	.dump_l2d_cacheline = ramindex_sim_dump_l2d_cacheline,
+	.l1i_tlb = { .nsets = 48, .nways = 1, .dump_entry = ramindex_sim_dump_l1i_tlbentry },
+	.l1d_tlb = { .nsets = 32, .nways = 1, .dump_entry = ramindex_sim_dump_l1d_tlbentry },
+	.l2_tlb = { .nsets = 256, .nways = 4, .dump_entry = ramindex_sim_dump_l2_tlbentry },
+	.bench_access = ramindex_sim_bench_access,
+};
@@ -0,0 +1,159 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ramindex-stats.c
+ *
+ * Copyright (C) 2024 Lukasz Wiecaszek <lukasz.wiecaszek(at)gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License (in file COPYING) for more details.
+ */
+
+#include <linux/types.h>
+#include <linux/errno.h>
+#include <linux/module.h>
+#include <linux/limits.h>
+#include <linux/string.h>
+#include <linux/kstrtox.h>
+#include <linux/cpumask.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+
+#include "ramindex-stats.h"
+
+DEFINE_PER_CPU(struct ramindex_stats, ramindex_stats);
+DEFINE_STATIC_KEY_FALSE(ramindex_stats_enabled);
+
+static struct dentry *ramindex_stats_dir;
+
+static const char * const ramindex_counter_names[RAMINDEX_CNT_NR] = {
+	[RAMINDEX_CNT_DUMPS] = "dumps",
+	[RAMINDEX_CNT_LINES] = "lines",
+	[RAMINDEX_CNT_BYTES] = "bytes",
+	[RAMINDEX_CNT_SMCS] = "smcs",
+	[RAMINDEX_CNT_SYSOPS] = "sysops",
+	[RAMINDEX_CNT_ERRORS] = "errors",
+	[RAMINDEX_CNT_MISMATCHES] = "mismatches",
+};
+
+static const char * const ramindex_hist_names[RAMINDEX_HIST_NR] = {
+	[RAMINDEX_HIST_LINES] = "lines_per_dump",
+	[RAMINDEX_HIST_BYTES] = "bytes_per_dump",
+	[RAMINDEX_HIST_SMC_NS] = "smc_ns",
+	[RAMINDEX_HIST_SYSOP_NS] = "sysop_ns",
+	[RAMINDEX_HIST_PREEMPT_OFF_NS] = "preempt_off_ns",
+};
+
+/*
+ * Format:
+ *	<counter> <value>
+ *	...
+ *	<histogram>
+ *	  [<from>, <to>) <count>	(only non empty buckets)
+ */
+static int ramindex_stats_show(struct seq_file *m, void *v)
+{
+	u64 sum[RAMINDEX_HIST_BUCKETS];
+	int cpu, c, h, b;
+
+	for (c = 0; c < RAMINDEX_CNT_NR; c++) {
+		u64 value = 0;
+
+		for_each_possible_cpu(cpu)
+			value += per_cpu(ramindex_stats, cpu).counters[c];
+		seq_printf(m, "%s %llu\n", ramindex_counter_names[c], value);
+	}
+
+	for (h = 0; h < RAMINDEX_HIST_NR; h++) {
+		memset(sum, 0, sizeof(sum));
+		for_each_possible_cpu(cpu)
+			for (b = 0; b < RAMINDEX_HIST_BUCKETS; b++)
+				sum[b] += per_cpu(ramindex_stats, cpu).hist[h][b];
+
+		seq_printf(m, "%s\n", ramindex_hist_names[h]);
+		for (b = 0; b < RAMINDEX_HIST_BUCKETS; b++)
+			if (sum[b])
+				seq_printf(m, "  [%llu, %llu) %llu\n",
+					b ? 1ULL << (b - 1) : 0ULL,
+					b < 64 ? 1ULL << b : U64_MAX, sum[b]);
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(ramindex_stats);
+
+static ssize_t ramindex_stats_enable_read(struct file *file, char __user *ubuf,
+	size_t count, loff_t *ppos)
+{
+	char buf[2] = { ramindex_stats_on() ? '1' : '0', '\n' };
+
+	return simple_read_from_buffer(ubuf, count, ppos, buf, sizeof(buf));
+}
+
+static ssize_t ramindex_stats_enable_write(struct file *file, const char __user *ubuf,
+	size_t count, loff_t *ppos)
+{
+	bool enable;
+	int status;
+
+	status = kstrtobool_from_user(ubuf, count, &enable);
+	if (status)
+		return status;
+
+	if (enable)
+		static_branch_enable(&ramindex_stats_enabled);
+	else
+		static_branch_disable(&ramindex_stats_enabled);
+
+	return count;
+}
+
+static const struct file_operations ramindex_stats_enable_fops = {
+	.owner = THIS_MODULE,
+	.read = ramindex_stats_enable_read,
+	.write = ramindex_stats_enable_write,
+	.llseek = default_llseek,
+};
+
+static ssize_t ramindex_stats_reset_write(struct file *file, const char __user *ubuf,
+	size_t count, loff_t *ppos)
+{
+	int cpu;
+
+	/* racy with respect to updates in flight, which is fine for statistics */
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(&ramindex_stats, cpu), 0, sizeof(struct ramindex_stats));
+
+	return count;
+}
+
+static const struct file_operations ramindex_stats_reset_fops = {
+	.owner = THIS_MODULE,
+	.write = ramindex_stats_reset_write,
+	.llseek = noop_llseek,
+};
+
+int ramindex_stats_init(void)
+{
+	ramindex_stats_dir = debugfs_create_dir("ramindex", NULL);
+	if (IS_ERR(ramindex_stats_dir))
+		return PTR_ERR(ramindex_stats_dir);
+
+	debugfs_create_file("stats", 0444, ramindex_stats_dir, NULL, &ramindex_stats_fops);
+	debugfs_create_file("enable", 0644, ramindex_stats_dir, NULL, &ramindex_stats_enable_fops);
+	debugfs_create_file("reset", 0200, ramindex_stats_dir, NULL, &ramindex_stats_reset_fops);
+
+	return 0;
+}
+
+void ramindex_stats_exit(void)
+{
+	debugfs_remove_recursive(ramindex_stats_dir);
+	static_branch_disable(&ramindex_stats_enabled);
+}
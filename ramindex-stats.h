@@ -0,0 +1,99 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ramindex-stats.h
+ *
+ * Copyright (C) 2024 Lukasz Wiecaszek <lukasz.wiecaszek(at)gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License (in file COPYING) for more details.
+ */
+
+#ifndef _RAMINDEX_STATS_H_
+#define _RAMINDEX_STATS_H_
+
+#include <linux/types.h>
+#include <linux/percpu.h>
+#include <linux/jump_label.h>
+#include <linux/bitops.h>
+#include <linux/sched/clock.h>
+
+/**
+ * enum ramindex_counter - counters exposed in debugfs
+ */
+enum ramindex_counter {
+	RAMINDEX_CNT_DUMPS,	/* RAMINDEX_DUMP requests */
+	RAMINDEX_CNT_LINES,	/* lines read */
+	RAMINDEX_CNT_BYTES,	/* bytes copied to userspace */
+	RAMINDEX_CNT_SMCS,	/* SMC round trips (Cortex-A720) */
+	RAMINDEX_CNT_SYSOPS,	/* RAMINDEX sys operations (Cortex-A72) */
+	RAMINDEX_CNT_ERRORS,	/* failed RAMINDEX_DUMP requests */
+	RAMINDEX_CNT_MISMATCHES,	/* lines read differently by the two access sequences */
+	RAMINDEX_CNT_NR
+};
+
+/**
+ * enum ramindex_hist - log2 histograms exposed in debugfs
+ */
+enum ramindex_hist {
+	RAMINDEX_HIST_LINES,		/* lines read per RAMINDEX_DUMP request */
+	RAMINDEX_HIST_BYTES,		/* bytes copied per RAMINDEX_DUMP request */
+	RAMINDEX_HIST_SMC_NS,		/* SMC round trip time */
+	RAMINDEX_HIST_SYSOP_NS,		/* RAMINDEX sys + dsb + isb time (either sequence) */
+	RAMINDEX_HIST_PREEMPT_OFF_NS,	/* time spent with preemption disabled per chunk */
+	RAMINDEX_HIST_NR
+};
+
+/* bucket n holds values from [2^(n-1), 2^n) range (bucket 0 holds zeros) */
+#define RAMINDEX_HIST_BUCKETS 65
+
+struct ramindex_stats {
+	u64 counters[RAMINDEX_CNT_NR];
+	u64 hist[RAMINDEX_HIST_NR][RAMINDEX_HIST_BUCKETS];
+};
+
+DECLARE_PER_CPU(struct ramindex_stats, ramindex_stats);
+DECLARE_STATIC_KEY_FALSE(ramindex_stats_enabled);
+
+/*
+ * Statistics are collected only when enabled (through debugfs),
+ * otherwise all the helpers below boil down to a not taken branch.
+ */
+static __always_inline bool ramindex_stats_on(void)
+{
+	return static_branch_unlikely(&ramindex_stats_enabled);
+}
+
+static __always_inline u64 ramindex_stats_clock(void)
+{
+	return ramindex_stats_on() ? local_clock() : 0;
+}
+
+static __always_inline void ramindex_stats_add(enum ramindex_counter c, u64 value)
+{
+	if (ramindex_stats_on())
+		this_cpu_add(ramindex_stats.counters[c], value);
+}
+
+static __always_inline void ramindex_stats_hist(enum ramindex_hist h, u64 value)
+{
+	if (ramindex_stats_on())
+		this_cpu_inc(ramindex_stats.hist[h][fls64(value)]);
+}
+
+static __always_inline void ramindex_stats_hist_since(enum ramindex_hist h, u64 start_ns)
+{
+	/* @start_ns is 0 if statistics got enabled after it was taken */
+	if (ramindex_stats_on() && start_ns)
+		this_cpu_inc(ramindex_stats.hist[h][fls64(local_clock() - start_ns)]);
+}
+
+int ramindex_stats_init(void);
+void ramindex_stats_exit(void);
+
+#endif /* _RAMINDEX_STATS_H_ */
@@ -0,0 +1,162 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * ramindex-trace.h
+ *
+ * Copyright (C) 2024 Lukasz Wiecaszek <lukasz.wiecaszek(at)gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License (in file COPYING) for more details.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM ramindex
+
+#if !defined(_RAMINDEX_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define _RAMINDEX_TRACE_H_
+
+#include <linux/types.h>
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(ramindex_dump_start,
+
+	TP_PROTO(int level, int icache, u32 nlines, u32 flags),
+
+	TP_ARGS(level, icache, nlines, flags),
+
+	TP_STRUCT__entry(
+		__field(int, level)
+		__field(int, icache)
+		__field(u32, nlines)
+		__field(u32, flags)
+	),
+
+	TP_fast_assign(
+		__entry->level = level;
+		__entry->icache = icache;
+		__entry->nlines = nlines;
+		__entry->flags = flags;
+	),
+
+	TP_printk("level=%d icache=%d nlines=%u flags=0x%x",
+		__entry->level, __entry->icache, __entry->nlines, __entry->flags)
+);
+
+TRACE_EVENT(ramindex_dump_end,
+
+	TP_PROTO(int level, int icache, u32 nlines, u64 bytes, int status, u64 duration_ns),
+
+	TP_ARGS(level, icache, nlines, bytes, status, duration_ns),
+
+	TP_STRUCT__entry(
+		__field(int, level)
+		__field(int, icache)
+		__field(u32, nlines)
+		__field(u64, bytes)
+		__field(int, status)
+		__field(u64, duration_ns)
+	),
+
+	TP_fast_assign(
+		__entry->level = level;
+		__entry->icache = icache;
+		__entry->nlines = nlines;
+		__entry->bytes = bytes;
+		__entry->status = status;
+		__entry->duration_ns = duration_ns;
+	),
+
+	TP_printk("level=%d icache=%d nlines=%u bytes=%llu status=%d duration=%llu ns",
+		__entry->level, __entry->icache, __entry->nlines, __entry->bytes,
+		__entry->status, __entry->duration_ns)
+);
+
+TRACE_EVENT(ramindex_line,
+
+	TP_PROTO(u32 set, u32 way, u32 valid, u32 dirty, u32 state, u64 tag),
+
+	TP_ARGS(set, way, valid, dirty, state, tag),
+
+	TP_STRUCT__entry(
+		__field(u32, set)
+		__field(u32, way)
+		__field(u8, valid)
+		__field(u8, dirty)
+		__field(u8, state)
+		__field(u64, tag)
+	),
+
+	TP_fast_assign(
+		__entry->set = set;
+		__entry->way = way;
+		__entry->valid = valid;
+		__entry->dirty = dirty;
+		__entry->state = state;
+		__entry->tag = tag;
+	),
+
+	TP_printk("set=%u way=%u valid=%u dirty=%u state=%u tag=0x%llx",
+		__entry->set, __entry->way, __entry->valid, __entry->dirty,
+		__entry->state, __entry->tag)
+);
+
+TRACE_EVENT(ramindex_smc,
+
+	TP_PROTO(u64 fid, u64 arg1, u64 arg2, u64 ret, u64 duration_ns),
+
+	TP_ARGS(fid, arg1, arg2, ret, duration_ns),
+
+	TP_STRUCT__entry(
+		__field(u64, fid)
+		__field(u64, arg1)
+		__field(u64, arg2)
+		__field(u64, ret)
+		__field(u64, duration_ns)
+	),
+
+	TP_fast_assign(
+		__entry->fid = fid;
+		__entry->arg1 = arg1;
+		__entry->arg2 = arg2;
+		__entry->ret = ret;
+		__entry->duration_ns = duration_ns;
+	),
+
+	TP_printk("fid=0x%llx arg1=0x%llx arg2=0x%llx ret=0x%llx duration=%llu ns",
+		__entry->fid, __entry->arg1, __entry->arg2, __entry->ret,
+		__entry->duration_ns)
+);
+
+TRACE_EVENT(ramindex_sysop,
+
+	TP_PROTO(u64 selector, u64 duration_ns),
+
+	TP_ARGS(selector, duration_ns),
+
+	TP_STRUCT__entry(
+		__field(u64, selector)
+		__field(u64, duration_ns)
+	),
+
+	TP_fast_assign(
+		__entry->selector = selector;
+		__entry->duration_ns = duration_ns;
+	),
+
+	TP_printk("selector=0x%llx duration=%llu ns",
+		__entry->selector, __entry->duration_ns)
+);
+
+#endif /* _RAMINDEX_TRACE_H_ */
+
+/* this part must be outside protection */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE ramindex-trace
+#include <trace/define_trace.h>
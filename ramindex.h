@@ -21,8 +21,8 @@
 #include <linux/ioctl.h>
 
 #define RAMINDEX_VERSION_MAJOR 0
-#define RAMINDEX_VERSION_MINOR 0
-#define RAMINDEX_VERSION_MICRO 7
+#define RAMINDEX_VERSION_MINOR 14
+#define RAMINDEX_VERSION_MICRO 0
 
 /**
  * struct ramindex_version - used by RAMINDEX_VERSION ioctl
@@ -64,6 +64,40 @@ static inline const char *ramindex_ctype_to_string(enum ramindex_ctype ctype)
 	}
 }
 
+/**
+ * enum ramindex_cstate - indicates coherence state of a cache line
+ *
+ * CSTATE_UNKNOWN is reported when the state is not decoded for the given cache.
+ * The remaining states follow MOESI (Modified = Unique Dirty,
+ * Owned = Shared Dirty, Exclusive = Unique Clean, Shared = Shared Clean).
+ */
+enum ramindex_cstate {
+	CSTATE_UNKNOWN = 0,
+	CSTATE_INVALID = 1,
+	CSTATE_SHARED_CLEAN = 2,
+	CSTATE_SHARED_DIRTY = 3,
+	CSTATE_UNIQUE_CLEAN = 4,
+	CSTATE_UNIQUE_DIRTY = 5
+};
+
+static inline const char *ramindex_cstate_to_string(enum ramindex_cstate cstate)
+{
+	switch (cstate) {
+	case CSTATE_INVALID:
+		return "I";
+	case CSTATE_SHARED_CLEAN:
+		return "SC";
+	case CSTATE_SHARED_DIRTY:
+		return "SD";
+	case CSTATE_UNIQUE_CLEAN:
+		return "UC";
+	case CSTATE_UNIQUE_DIRTY:
+		return "UD";
+	default:
+		return "--";
+	}
+}
+
 /**
  * struct ramindex_clid - identifies the type of caches
  *                        implemented at each level
@@ -101,6 +135,7 @@ struct ramindex_ccsidr {
  * @valid:	valid bit
  * @dirty:	dirty bit (valid only for data caches)
  * @ns:		non-secure identifier for physical address (tag)
+ * @state:	coherence state of the line (enum ramindex_cstate)
  * @tag:	physical address tag
  * @linesize:	size of the @linedata buffer
  * @linedata:	starting address of a buffer to hold content of a queried line
@@ -108,6 +143,8 @@ struct ramindex_ccsidr {
  * On entry @linesize depicts the size of the @linedata buffer.
  * On return @linesize contains the actual number of bytes
  * copied to @linedata (which is the min(@linesize, actual line size)).
+ * @state occupies what used to be padding, so the layout did not change
+ * when it was added (version 0.2.0).
  */
 struct ramindex_cacheline {
 	__s32 set;
@@ -115,11 +152,42 @@ struct ramindex_cacheline {
 	__u8 valid;
 	__u8 dirty;
 	__u8 ns;
+	__u8 state;
 	__u64 tag;
 	__u32 linesize;
 	void *linedata;
 };
 
+/*
+ * Flags modifying RAMINDEX_DUMP
+ *
+ * RAMINDEX_DUMP_F_TAGS_ONLY	only tags (and state bits) of the selected lines
+ *				are read, their content is neither read nor copied
+ *				(@linesize of every line is set to 0 on return)
+ */
+#define RAMINDEX_DUMP_F_TAGS_ONLY	(1u << 0)
+
+/*
+ * RAMINDEX_DUMP_F_LOW_PERTURB	low perturbation capture - tags (only) of all
+ *				the sets of the selected way(s) are read at once,
+ *				with interrupts disabled, by a tight loop into
+ *				a page aligned buffer preallocated at load time,
+ *				and copied to userspace only afterwards.
+ *				@set and @nsets select the victim sets then,
+ *				which are read first (or last, see below),
+ *				lines are returned in the order they were read,
+ *				@npolluted is filled on return; at most
+ *				RAMINDEX_LOW_PERTURB_LINES_MAX lines (an L1
+ *				cache, or some ways of a bigger one) are read,
+ *				bigger selections fail with E2BIG
+ * RAMINDEX_DUMP_F_VICTIM_LAST	victim sets are read last instead of first
+ */
+#define RAMINDEX_DUMP_F_LOW_PERTURB	(1u << 1)
+#define RAMINDEX_DUMP_F_VICTIM_LAST	(1u << 2)
+
+/* max number of lines read by a low perturbation capture (L1 caches fit) */
+#define RAMINDEX_LOW_PERTURB_LINES_MAX	2048
+
 /**
  * struct ramindex_selector - used by ioctls to select requested line(s)
  * @level:	selected cache level
@@ -127,13 +195,28 @@ struct ramindex_cacheline {
  * @set:	cache set to be selected (-1 for all sets)
  * @way:	cache way to be selected (-1 for all ways)
  * @nlines:	number of entries in @lines array
+ * @cpu:	cpu the lines have been read on (filled on return)
  * @lines:	array of @ramindex_cacheline elements
+ * @nsets:	number of consecutive sets, starting from @set, to be selected
+ *		(0 is treated as 1, ignored when @set is -1)
+ * @flags:	RAMINDEX_DUMP_F_* flags
+ * @npolluted:	number of returned valid lines holding the capture's own footprint
+ *		(driver's code and data, the stack and the buffer lines are read to),
+ *		filled on return by RAMINDEX_DUMP_F_LOW_PERTURB captures
+ * @reserved:	shall be 0
  *
  * The structure is used to locate, select, and copy
  * the requested cache lines to an array of @ramindex_cacheline elements.
- * It may be a single line, whole way, whole set or a whole cache.
+ * It may be a single line, whole way, whole set, a range of sets or a whole cache.
  * The passed array shall be large enough to store all the requested lines.
  * If it is not, then of course max @nlines entries/lines will be copied.
+ * Big caches may thus be dumped in chunks, a range of @nsets sets at a time.
+ * All the lines of one call are read on one cpu (reported in @cpu), even if
+ * the calling thread is not bound to it.
+ *
+ * @nsets and @flags were added in version 0.1.0, @npolluted in version 0.6.0,
+ * selectors without them (as used by older binaries) are still accepted.
+ * @cpu (version 0.14.0) takes what used to be padding.
  */
 struct ramindex_selector {
 	__s32 level;
@@ -141,9 +224,534 @@ struct ramindex_selector {
 	__s32 set;
 	__s32 way;
 	__u32 nlines;
+	__s32 cpu;
+	struct ramindex_cacheline *lines;
+	__s32 nsets;
+	__u32 flags;
+	__u32 npolluted;
+	__u32 reserved;
+};
+
+/**
+ * struct ramindex_tlb_geometry - provides information about the geometry
+ *                                of the selected TLB
+ * @level:	selected TLB level (0 for L1 TLBs, 1 for L2 TLB)
+ * @itlb:	non-zero if the selected L1 TLB is an instruction TLB, zero otherwise
+ * @nsets:	number of TLB sets (filled on return)
+ * @nways:	number of TLB ways (filled on return)
+ *
+ * Fully associative TLBs are reported as having @nsets sets of one way each.
+ */
+struct ramindex_tlb_geometry {
+	__s32 level;
+	__s32 itlb;
+	__s32 nsets;
+	__s32 nways;
+};
+
+/**
+ * struct ramindex_tlbentry - describes one TLB entry
+ * @set:	the set (index) of an entry
+ * @way:	the way requested entry belongs to
+ * @valid:	valid bit
+ * @ns:		non-secure identifier for physical address
+ * @global:	non-zero for global entries (not tagged with @asid)
+ * @unverified:	non-zero if the entry has been decoded by a layout not
+ *		confirmed against the reference manual of the core
+ * @asid:	address space identifier (meaningful for non-global entries)
+ * @vmid:	virtual machine identifier
+ * @pagesize:	size of the region translated by the entry (in bytes)
+ * @va:		virtual address of the region
+ * @pa:		physical address of the region
+ * @raw:	words of the entry as read from the TLB RAM (unused words are zero)
+ *
+ * Decoded fields of @unverified entries may be wrong, @raw tells what the
+ * hardware actually returned.
+ */
+struct ramindex_tlbentry {
+	__s32 set;
+	__s32 way;
+	__u8 valid;
+	__u8 ns;
+	__u8 global;
+	__u8 unverified;
+	__u16 asid;
+	__u16 vmid;
+	__u64 pagesize;
+	__u64 va;
+	__u64 pa;
+	__u64 raw[4];
+};
+
+/**
+ * struct ramindex_tlb_selector - used by RAMINDEX_TLB_DUMP ioctl
+ * @level:	selected TLB level (0 for L1 TLBs, 1 for L2 TLB)
+ * @itlb:	non-zero if the selected L1 TLB is an instruction TLB, zero otherwise
+ * @nentries:	number of entries in @entries array (filled on return with
+ *		the number of entries actually copied)
+ * @cpu:	cpu the entries have been read on (filled on return)
+ * @entries:	array of @ramindex_tlbentry elements
+ *
+ * All entries of the selected TLB are copied (at most @nentries of them),
+ * all of them from the TLB of one cpu (@cpu, added in version 0.14.0 in what
+ * used to be padding), even if the calling thread is not bound to it.
+ */
+struct ramindex_tlb_selector {
+	__s32 level;
+	__s32 itlb;
+	__u32 nentries;
+	__s32 cpu;
+	struct ramindex_tlbentry *entries;
+};
+
+/*
+ * Flags reported by RAMINDEX_SYNC_DUMP for every cpu
+ *
+ * RAMINDEX_SYNC_F_TIMEDOUT	the cpu gave up waiting for the other cpus
+ *				at the rendezvous, its tags were read anyway
+ *				(see @start_ns to find out how far apart)
+ */
+#define RAMINDEX_SYNC_F_TIMEDOUT	(1u << 0)
+
+/**
+ * struct ramindex_sync_cpu - per cpu part of the RAMINDEX_SYNC_DUMP request
+ * @cpu:	cpu whose cache shall be dumped
+ * @flags:	RAMINDEX_SYNC_F_* flags (filled on return)
+ * @nlines:	number of entries in @lines array (filled on return with
+ *		the number of lines actually copied)
+ * @lines:	array of @ramindex_cacheline elements
+ * @start_ns:	CLOCK_MONOTONIC time the cpu started to read tags at (filled on return)
+ * @end_ns:	CLOCK_MONOTONIC time the cpu finished reading tags at (filled on return)
+ */
+struct ramindex_sync_cpu {
+	__s32 cpu;
+	__u32 flags;
+	__u32 nlines;
+	struct ramindex_cacheline *lines;
+	__u64 start_ns;
+	__u64 end_ns;
+};
+
+/**
+ * struct ramindex_sync_selector - used by RAMINDEX_SYNC_DUMP ioctl
+ * @level:	selected cache level
+ * @icache:	non-zero if the selected cache is an instruction cache, zero otherwise
+ * @ncpus:	number of entries in @cpus array
+ * @cpus:	array of @ramindex_sync_cpu elements, one per selected cpu
+ * @skew_ns:	difference between the latest and the earliest @start_ns
+ *		of the selected cpus (filled on return)
+ *
+ * Tags of all the lines of the selected cache are read on all the selected
+ * cpus at once. A work item of every cpu meets the others at a barrier
+ * first, so the snapshots are taken as close in time as possible; @skew_ns
+ * tells how close they really were. Tags are read with interrupts enabled,
+ * in chunks as by RAMINDEX_DUMP. Only tags (and state bits) are read,
+ * @linesize of every line is set to 0 on return.
+ */
+struct ramindex_sync_selector {
+	__s32 level;
+	__s32 icache;
+	__u32 ncpus;
+	struct ramindex_sync_cpu *cpus;
+	__u64 skew_ns;
+};
+
+/**
+ * enum ramindex_trigger_type - indicates what fires an armed trigger
+ *
+ * TRIGGER_KPROBE	a kprobe placed on @symbol is hit
+ * TRIGGER_TRACEPOINT	tracepoint named @symbol is hit (one of sched_switch,
+ *			sched_wakeup, irq_handler_entry, sys_enter, cpu_idle)
+ * TRIGGER_IOCTL	RAMINDEX_TRIGGER_FIRE ioctl is issued by a cooperating process
+ */
+enum ramindex_trigger_type {
+	TRIGGER_KPROBE = 1,
+	TRIGGER_TRACEPOINT = 2,
+	TRIGGER_IOCTL = 3
+};
+
+#define RAMINDEX_TRIGGER_SYMBOL_LEN	64
+#define RAMINDEX_TRIGGER_COUNT_MAX	64
+/* max number of lines of a cache captured by a trigger (L1 caches fit) */
+#define RAMINDEX_TRIGGER_LINES_MAX	2048
+
+/**
+ * struct ramindex_trigger - used by RAMINDEX_TRIGGER_ARM ioctl
+ * @type:	what fires the trigger (enum ramindex_trigger_type)
+ * @level:	selected cache level
+ * @icache:	non-zero if the selected cache is an instruction cache, zero otherwise
+ * @cpu:	only hits on that cpu fire the trigger (-1 for any cpu)
+ * @count:	number of captures to be kept (range: [1-RAMINDEX_TRIGGER_COUNT_MAX])
+ * @symbol:	kprobed symbol or tracepoint name (ignored for TRIGGER_IOCTL)
+ *
+ * Buffers for @count tag-only captures of the whole selected cache are allocated
+ * when the trigger is armed, so the capture itself (run on the cpu the trigger
+ * fired on, from the context it fired in) allocates nothing and does not sleep.
+ * Hits arriving when all the buffers are used are counted as missed.
+ * EINVAL is returned if the selected cache has more than
+ * RAMINDEX_TRIGGER_LINES_MAX lines, EOPNOTSUPP if the tracepoint is not
+ * one of the supported ones. Only one trigger may be armed at a time,
+ * arming a new one drops the captures of the previous one.
+ */
+struct ramindex_trigger {
+	__s32 type;
+	__s32 level;
+	__s32 icache;
+	__s32 cpu;
+	__u32 count;
+	char symbol[RAMINDEX_TRIGGER_SYMBOL_LEN];
+};
+
+/**
+ * struct ramindex_trigger_capture - used by RAMINDEX_TRIGGER_READ ioctl
+ * @index:	capture to be read (0 is the first one)
+ * @cpu:	cpu the trigger fired on (filled on return)
+ * @ncaptured:	number of captures taken so far (filled on return)
+ * @nmissed:	number of hits which found no free buffer (filled on return)
+ * @fired_ns:	CLOCK_MONOTONIC time the trigger fired at (filled on return)
+ * @latency_ns:	time from firing to reading the first tag (filled on return)
+ * @duration_ns:	time it took to read all the tags (filled on return)
+ * @nlines:	number of entries in @lines array (filled on return with
+ *		the number of lines actually copied)
+ * @lines:	array of @ramindex_cacheline elements (only tags are copied,
+ *		@linesize of every line is set to 0)
+ *
+ * ENOENT is returned if the selected capture has not been taken (yet).
+ */
+struct ramindex_trigger_capture {
+	__u32 index;
+	__s32 cpu;
+	__u32 ncaptured;
+	__u32 nmissed;
+	__u64 fired_ns;
+	__u64 latency_ns;
+	__u64 duration_ns;
+	__u32 nlines;
 	struct ramindex_cacheline *lines;
 };
 
+#define RAMINDEX_BENCH_BACKEND_LEN	16
+
+/**
+ * struct ramindex_bench - used by RAMINDEX_BENCH ioctl
+ * @level:	cache the line read rate is measured on
+ * @icache:	non-zero if the selected cache is an instruction cache, zero otherwise
+ * @iterations:	number of raw accesses to be timed (0 selects 1024)
+ * @flags:	RAMINDEX_DUMP_F_TAGS_ONLY to time reads of tags only
+ * @cpu:	cpu the measurements were taken on (filled on return)
+ * @nlines:	number of lines read to measure the line read rate,
+ *		all the lines of the selected cache (filled on return)
+ * @access_ns:	time of @iterations raw accesses (filled on return)
+ * @access_cycles:	cpu cycles of @iterations raw accesses, 0 if there
+ *		is no cycle counter available (filled on return)
+ * @lines_ns:	time of reading @nlines lines (filled on return)
+ * @lines_cycles:	cpu cycles of reading @nlines lines, 0 if there
+ *		is no cycle counter available (filled on return)
+ * @backend:	name of the backend in use (filled on return)
+ *
+ * A raw access is a RAMINDEX operation followed by dsb and isb (Cortex-A72)
+ * or an SMC round trip to the CPU service in EL3 (Cortex-A720) reading
+ * one tag, without any decoding. Both use the access sequence selected by
+ * the access module parameter. Only time spent with preemption disabled
+ * is counted, thus copying to userspace is not included.
+ */
+struct ramindex_bench {
+	__s32 level;
+	__s32 icache;
+	__u32 iterations;
+	__u32 flags;
+	__s32 cpu;
+	__u32 nlines;
+	__u64 access_ns;
+	__u64 access_cycles;
+	__u64 lines_ns;
+	__u64 lines_cycles;
+	char backend[RAMINDEX_BENCH_BACKEND_LEN];
+};
+
+/* max number of submitted and not yet reaped requests per open file */
+#define RAMINDEX_ASYNC_MAX	64
+
+/**
+ * struct ramindex_async - used by RAMINDEX_ASYNC_SUBMIT ioctl
+ * @cookie:	value identifying the request in its completion
+ * @cpu:	cpu whose cache is to be dumped
+ * @eventfd:	eventfd to be signalled on completion (-1 for none)
+ * @selector:	what to dump, the same as for RAMINDEX_DUMP (low perturbation
+ *		captures are not supported), @selector.lines shall stay valid
+ *		until the request is reaped
+ *
+ * The request is queued to a kernel worker bound to @cpu and the ioctl
+ * returns at once. Lines are read into kernel buffers and copied to
+ * @selector.lines when the completion is reaped (RAMINDEX_ASYNC_REAP),
+ * by the thread reaping it. The file becomes readable (poll) whenever
+ * there is a completion to be reaped.
+ * EBUSY is returned if RAMINDEX_ASYNC_MAX requests are outstanding.
+ */
+struct ramindex_async {
+	__u64 cookie;
+	__s32 cpu;
+	__s32 eventfd;
+	struct ramindex_selector selector;
+};
+
+/**
+ * struct ramindex_async_completion - used by RAMINDEX_ASYNC_REAP ioctl
+ * @cookie:	@cookie of the completed request
+ * @cpu:	@cpu of the completed request
+ * @status:	0 on success or negative error code
+ *		(-EAGAIN if the cpu went offline before the dump completed)
+ * @nlines:	number of lines copied to @selector.lines of the request
+ * @start_ns:	CLOCK_MONOTONIC time the worker started reading lines at
+ * @end_ns:	CLOCK_MONOTONIC time the worker finished reading lines at
+ *
+ * Completions are reaped in order of completion,
+ * EAGAIN is returned if there is none.
+ */
+struct ramindex_async_completion {
+	__u64 cookie;
+	__s32 cpu;
+	__s32 status;
+	__u32 nlines;
+	__u32 reserved;
+	__u64 start_ns;
+	__u64 end_ns;
+};
+
+/* max number of entries of one RAMINDEX_DUMPV request */
+#define RAMINDEX_DUMPV_MAX	4096
+
+/**
+ * struct ramindex_vec_entry - one selection of RAMINDEX_DUMPV ioctl
+ * @level:	selected cache level
+ * @icache:	non-zero if the selected cache is an instruction cache, zero otherwise
+ * @set:	first cache set to be selected (-1 for all sets)
+ * @nsets:	number of consecutive sets, starting from @set, to be selected
+ *		(0 is treated as 1, ignored when @set is -1)
+ * @ways:	bitmask of the ways to be selected (bit n selects way n,
+ *		0 selects all the ways)
+ * @flags:	RAMINDEX_DUMP_F_TAGS_ONLY or 0
+ * @nlines:	number of lines of this selection copied to @lines of the request
+ *		(filled on return)
+ */
+struct ramindex_vec_entry {
+	__s32 level;
+	__s32 icache;
+	__s32 set;
+	__s32 nsets;
+	__u64 ways;
+	__u32 flags;
+	__u32 nlines;
+};
+
+/**
+ * struct ramindex_vec_selector - used by RAMINDEX_DUMPV ioctl
+ * @nentries:	number of entries in @entries array (range: [1-RAMINDEX_DUMPV_MAX])
+ * @reserved:	shall be 0
+ * @entries:	array of @ramindex_vec_entry elements
+ * @nlines:	number of entries in @lines array (filled on return with
+ *		the number of lines actually copied)
+ * @cpu:	cpu the lines have been read on (filled on return)
+ * @lines:	array of @ramindex_cacheline elements
+ *
+ * Many selections, possibly of different caches, are dumped by one call,
+ * all of them on one cpu (@cpu, added in version 0.14.0 in what used to be
+ * padding), even if the calling thread is not bound to it.
+ * All of them are validated before any line is read (EINVAL is returned
+ * if any of them is invalid, the faulty entry is reported at debug level 1),
+ * and then they are read back-to-back, in order, into one @lines array:
+ * the lines of an entry follow the lines of the previous one, within an entry
+ * lines are ordered by set and then by way. If @lines is too small,
+ * the dump stops when it is full (@nlines of the remaining entries is 0).
+ */
+struct ramindex_vec_selector {
+	__u32 nentries;
+	__u32 reserved;
+	struct ramindex_vec_entry *entries;
+	__u32 nlines;
+	__s32 cpu;
+	struct ramindex_cacheline *lines;
+};
+
+/**
+ * enum ramindex_pmu_event - PMU events counted by RAMINDEX_DUMP_PMU
+ *
+ * RAMINDEX_PMU_CYCLES		cpu cycles
+ * RAMINDEX_PMU_INSTRUCTIONS	instructions architecturally executed
+ * RAMINDEX_PMU_L1D_REFILL	L1 data cache refills
+ * RAMINDEX_PMU_L1I_REFILL	L1 instruction cache refills
+ * RAMINDEX_PMU_L2D_REFILL	L2 cache refills
+ * RAMINDEX_PMU_L1D_WB		L1 data cache write-backs
+ * RAMINDEX_PMU_L2D_WB		L2 cache write-backs
+ */
+enum ramindex_pmu_event {
+	RAMINDEX_PMU_CYCLES,
+	RAMINDEX_PMU_INSTRUCTIONS,
+	RAMINDEX_PMU_L1D_REFILL,
+	RAMINDEX_PMU_L1I_REFILL,
+	RAMINDEX_PMU_L2D_REFILL,
+	RAMINDEX_PMU_L1D_WB,
+	RAMINDEX_PMU_L2D_WB,
+	RAMINDEX_PMU_NR
+};
+
+#define RAMINDEX_PMU_EVENTS_MAX	8
+#define RAMINDEX_PMU_ALL	((1u << RAMINDEX_PMU_NR) - 1)
+
+/**
+ * struct ramindex_pmu_selector - used by RAMINDEX_DUMP_PMU ioctl
+ * @selector:	what to dump, the same as for RAMINDEX_DUMP
+ * @events:	bitmask of the events to be counted (bit n selects
+ *		enum ramindex_pmu_event n)
+ * @valid:	bitmask of the events counted (filled on return)
+ * @before:	counters read right before the dump, indexed by event (filled on return)
+ * @delta:	counts over the dump itself, indexed by event (filled on return)
+ *
+ * The dump is taken as by RAMINDEX_DUMP, on the cpu the caller runs on,
+ * with the PMU counters of the selected events read right before and right
+ * after it. Counters are created on the cpu the first time their events are
+ * requested there and keep counting everything running on it from then on,
+ * so @before of successive dumps tells what happened between them (less
+ * @delta of the earlier one). Events not implemented by the PMU, or not fitting
+ * into its counters, are left out of @valid (and their counts are 0).
+ */
+struct ramindex_pmu_selector {
+	struct ramindex_selector selector;
+	__u32 events;
+	__u32 valid;
+	__u64 before[RAMINDEX_PMU_EVENTS_MAX];
+	__u64 delta[RAMINDEX_PMU_EVENTS_MAX];
+};
+
+/* max number of cgroups reported by one RAMINDEX_OCCUPANCY request */
+#define RAMINDEX_OCCUPANCY_MAX	4096
+
+/**
+ * struct ramindex_cgroup_lines - lines of one cgroup reported by RAMINDEX_OCCUPANCY
+ * @cgroup_id:	id of the memory cgroup the lines are charged to (the inode
+ *		number of its directory in the cgroup filesystem)
+ * @nlines:	number of valid lines
+ * @ndirty:	number of dirty lines
+ */
+struct ramindex_cgroup_lines {
+	__u64 cgroup_id;
+	__u32 nlines;
+	__u32 ndirty;
+};
+
+/**
+ * struct ramindex_occupancy - used by RAMINDEX_OCCUPANCY ioctl
+ * @level:	selected cache level
+ * @icache:	non-zero if the selected cache is an instruction cache, zero otherwise
+ * @ncgroups:	number of entries in @cgroups array (filled on return with
+ *		the number of entries actually filled)
+ * @flags:	shall be 0
+ * @cgroups:	array of @ramindex_cgroup_lines elements (filled on return,
+ *		sorted by @cgroup_id)
+ * @nlines:	number of valid lines (filled on return)
+ * @ndirty:	number of dirty lines (filled on return)
+ * @nunowned:	number of valid lines not charged to any cgroup, e.g. of pages
+ *		owned by the kernel or of memory the kernel does not manage
+ *		(filled on return)
+ * @noverflow:	number of valid lines of cgroups not fitting into @cgroups
+ *		(filled on return)
+ * @cpu:	cpu the cache has been walked on (filled on return)
+ * @reserved:	shall be 0
+ *
+ * Tags of all the lines of the selected cache are read on the cpu the caller
+ * runs on, and every valid line is attributed in the kernel, by the page
+ * its physical address belongs to, to the memory cgroup the page is charged
+ * to. Only counts are copied to userspace, no lines. Pages change owners
+ * and get freed while the cache is walked, so the counts are best effort.
+ * EOPNOTSUPP is returned if the kernel has no memory cgroups.
+ */
+struct ramindex_occupancy {
+	__s32 level;
+	__s32 icache;
+	__u32 ncgroups;
+	__u32 flags;
+	struct ramindex_cgroup_lines *cgroups;
+	__u32 nlines;
+	__u32 ndirty;
+	__u32 nunowned;
+	__u32 noverflow;
+	__s32 cpu;
+	__u32 reserved;
+};
+
+/**
+ * enum ramindex_zone - memory zones lines are classified by (RAMINDEX_PLACEMENT)
+ *
+ * RAMINDEX_ZONE_DMA	ZONE_DMA
+ * RAMINDEX_ZONE_DMA32	ZONE_DMA32
+ * RAMINDEX_ZONE_NORMAL	ZONE_NORMAL
+ * RAMINDEX_ZONE_MOVABLE	ZONE_MOVABLE (e.g. hotplugged CXL memory)
+ * RAMINDEX_ZONE_DEVICE	ZONE_DEVICE
+ */
+enum ramindex_zone {
+	RAMINDEX_ZONE_DMA,
+	RAMINDEX_ZONE_DMA32,
+	RAMINDEX_ZONE_NORMAL,
+	RAMINDEX_ZONE_MOVABLE,
+	RAMINDEX_ZONE_DEVICE,
+	RAMINDEX_ZONE_NR
+};
+
+/* number of NUMA nodes RAMINDEX_PLACEMENT keeps histograms of */
+#define RAMINDEX_PLACEMENT_NODES	64
+
+/**
+ * struct ramindex_line_placement - where the memory of one line comes from
+ * @node:	NUMA node of the line's page (-1 for invalid lines and memory
+ *		the kernel does not manage)
+ * @zone:	zone of the line's page (enum ramindex_zone, -1 as for @node)
+ */
+struct ramindex_line_placement {
+	__s16 node;
+	__s16 zone;
+};
+
+/**
+ * struct ramindex_placement - used by RAMINDEX_PLACEMENT ioctl
+ * @level:	selected cache level
+ * @icache:	non-zero if the selected cache is an instruction cache, zero otherwise
+ * @cpu:	cpu the cache has been walked on (filled on return)
+ * @cpu_node:	NUMA node of @cpu (filled on return)
+ * @nlines:	number of entries in @lines array (filled on return with
+ *		the number of entries actually filled)
+ * @flags:	shall be 0
+ * @lines:	array of @ramindex_line_placement elements, one per line of
+ *		the cache ordered by set and then by way, may be NULL
+ * @nvalid:	number of valid lines (filled on return)
+ * @nunmanaged:	number of valid lines of memory the kernel does not manage
+ *		(filled on return)
+ * @noverflow:	number of valid lines of nodes not below
+ *		RAMINDEX_PLACEMENT_NODES (filled on return)
+ * @valid:	valid lines by node and zone (filled on return)
+ * @dirty:	dirty lines by node and zone (filled on return)
+ *
+ * Tags of all the lines of the selected cache are read on the cpu the caller
+ * runs on, and every valid line is classified by the NUMA node and the zone
+ * of the page its physical address belongs to. Memory tiers are made of nodes
+ * (see /sys/devices/virtual/memory_tiering), so the histograms are folded
+ * into tiers by userspace.
+ */
+struct ramindex_placement {
+	__s32 level;
+	__s32 icache;
+	__s32 cpu;
+	__s32 cpu_node;
+	__u32 nlines;
+	__u32 flags;
+	struct ramindex_line_placement *lines;
+	__u32 nvalid;
+	__u32 nunmanaged;
+	__u32 noverflow;
+	__u32 reserved;
+	__u32 valid[RAMINDEX_PLACEMENT_NODES][RAMINDEX_ZONE_NR];
+	__u32 dirty[RAMINDEX_PLACEMENT_NODES][RAMINDEX_ZONE_NR];
+};
+
 #define RAMINDEX_MAGIC 'r'
 #define RAMINDEX_IO(nr)		_IO(RAMINDEX_MAGIC, nr)
 #define RAMINDEX_IOR(nr, type)	_IOR(RAMINDEX_MAGIC, nr, type)
@@ -154,6 +762,20 @@ struct ramindex_selector {
 #define RAMINDEX_CLID		RAMINDEX_IOR (43, struct ramindex_clid)
 #define RAMINDEX_CCSIDR		RAMINDEX_IOWR(44, struct ramindex_ccsidr)
 #define RAMINDEX_DUMP		RAMINDEX_IOWR(45, struct ramindex_selector)
+#define RAMINDEX_TLB_GEOMETRY	RAMINDEX_IOWR(46, struct ramindex_tlb_geometry)
+#define RAMINDEX_TLB_DUMP	RAMINDEX_IOWR(47, struct ramindex_tlb_selector)
+#define RAMINDEX_SYNC_DUMP	RAMINDEX_IOWR(48, struct ramindex_sync_selector)
+#define RAMINDEX_TRIGGER_ARM	RAMINDEX_IOW (49, struct ramindex_trigger)
+#define RAMINDEX_TRIGGER_DISARM	RAMINDEX_IO  (50)
+#define RAMINDEX_TRIGGER_FIRE	RAMINDEX_IO  (51)
+#define RAMINDEX_TRIGGER_READ	RAMINDEX_IOWR(52, struct ramindex_trigger_capture)
+#define RAMINDEX_BENCH		RAMINDEX_IOWR(53, struct ramindex_bench)
+#define RAMINDEX_ASYNC_SUBMIT	RAMINDEX_IOW (54, struct ramindex_async)
+#define RAMINDEX_ASYNC_REAP	RAMINDEX_IOR (55, struct ramindex_async_completion)
+#define RAMINDEX_DUMPV		RAMINDEX_IOWR(56, struct ramindex_vec_selector)
+#define RAMINDEX_DUMP_PMU	RAMINDEX_IOWR(57, struct ramindex_pmu_selector)
+#define RAMINDEX_OCCUPANCY	RAMINDEX_IOWR(58, struct ramindex_occupancy)
+#define RAMINDEX_PLACEMENT	RAMINDEX_IOWR(59, struct ramindex_placement)
 
 static inline const char *ramindex_cmd_to_string(size_t cmd)
 {
@@ -166,6 +788,34 @@ static inline const char *ramindex_cmd_to_string(size_t cmd)
 		return "RAMINDEX_CCSIDR";
 	case RAMINDEX_DUMP:
 		return "RAMINDEX_DUMP";
+	case RAMINDEX_TLB_GEOMETRY:
+		return "RAMINDEX_TLB_GEOMETRY";
+	case RAMINDEX_TLB_DUMP:
+		return "RAMINDEX_TLB_DUMP";
+	case RAMINDEX_SYNC_DUMP:
+		return "RAMINDEX_SYNC_DUMP";
+	case RAMINDEX_TRIGGER_ARM:
+		return "RAMINDEX_TRIGGER_ARM";
+	case RAMINDEX_TRIGGER_DISARM:
+		return "RAMINDEX_TRIGGER_DISARM";
+	case RAMINDEX_TRIGGER_FIRE:
+		return "RAMINDEX_TRIGGER_FIRE";
+	case RAMINDEX_TRIGGER_READ:
+		return "RAMINDEX_TRIGGER_READ";
+	case RAMINDEX_BENCH:
+		return "RAMINDEX_BENCH";
+	case RAMINDEX_ASYNC_SUBMIT:
+		return "RAMINDEX_ASYNC_SUBMIT";
+	case RAMINDEX_ASYNC_REAP:
+		return "RAMINDEX_ASYNC_REAP";
+	case RAMINDEX_DUMPV:
+		return "RAMINDEX_DUMPV";
+	case RAMINDEX_DUMP_PMU:
+		return "RAMINDEX_DUMP_PMU";
+	case RAMINDEX_OCCUPANCY:
+		return "RAMINDEX_OCCUPANCY";
+	case RAMINDEX_PLACEMENT:
+		return "RAMINDEX_PLACEMENT";
 	default:
 		return "RAMINDEX_UNRECOGNIZED_COMMAND";
 	}
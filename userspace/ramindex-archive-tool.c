@@ -0,0 +1,263 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-archive-tool.c
+ *
+ * Builds archives of snapshots and reads samples back from them.
+ *
+ *     $ ramindex-archive -z -o l1.archive a.snapshot b.snapshot ...
+ *     $ ramindex-archive -l l1.archive
+ *     $ ramindex-archive -t 123456789 -o sample.snapshot l1.archive
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include <version.h>
+#include "ramindex-snapshot.h"
+#include "ramindex-archive.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local types definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global (external linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) functions definitions
+\*===========================================================================*/
+static void ramindex_archive_print_usage(const char* progname)
+{
+    fprintf(stdout, "%s: [ OPTIONS ] -o ARCHIVE SNAPSHOT...  (build an archive)\n", progname);
+    fprintf(stdout, "%s: [ OPTIONS ] ARCHIVE                 (read an archive)\n", progname);
+    fprintf(stdout, "\t-h, --help      this message\n");
+    fprintf(stdout, "\t-v, --version   output version information\n");
+    fprintf(stdout, "\t-o, --output    archive to be built, or snapshot file the selected\n");
+    fprintf(stdout, "\t                  sample is written to (instead of being printed)\n");
+    fprintf(stdout, "\t-z, --compress  zero-run encode frames of the archive being built\n");
+    fprintf(stdout, "\t-l, --list      list samples of the archive\n");
+    fprintf(stdout, "\t-t, --time      select the earliest sample taken at or after that time [ns]\n");
+    fprintf(stdout, "\t-i, --index     select sample by its index\n");
+}
+
+static void ramindex_archive_print_stats(const struct ramindex_archive *archive)
+{
+    const struct ramindex_archive_stats *st = &archive->stats;
+
+    fprintf(stdout, "Samples: %llu (%llu stored whole)\n",
+        (unsigned long long)st->nsamples, (unsigned long long)st->nkeys);
+    fprintf(stdout, "Distinct line contents: %llu\n", (unsigned long long)st->nblobs);
+    if (archive->writing) {
+        fprintf(stdout, "Lines: %llu, contents found already stored: %llu\n",
+            (unsigned long long)st->nlines, (unsigned long long)st->ndedup);
+        fprintf(stdout, "Size: %llu bytes (%llu as snapshots, ratio %.2f)\n",
+            (unsigned long long)st->bytes, (unsigned long long)st->rawbytes,
+            st->bytes ? (double)st->rawbytes / st->bytes : 0.0);
+    } else {
+        fprintf(stdout, "Size: %llu bytes\n", (unsigned long long)st->bytes);
+    }
+}
+
+static void ramindex_archive_build(const char *filename, int compress,
+    char * const *inputs, int ninputs)
+{
+    int n, status;
+    FILE *input;
+    struct ramindex_archive archive;
+    struct ramindex_snapshot snapshot;
+
+    if (ramindex_archive_create(&archive, filename,
+            compress ? RAMINDEX_ARCHIVE_F_COMPRESS : 0) < 0) {
+        fprintf(stderr, "Cannot create '%s': %s\n", filename, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    for (n = 0; n < ninputs; n++) {
+        input = fopen(inputs[n], "rb");
+        if (input == NULL) {
+            fprintf(stderr, "Cannot open '%s': %s\n", inputs[n], strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        while ((status = ramindex_snapshot_read(input, &snapshot)) > 0) {
+            status = ramindex_archive_append(&archive, &snapshot);
+            ramindex_snapshot_free(&snapshot);
+            if (status < 0) {
+                fprintf(stderr, "Cannot append to '%s': %s\n", filename, strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+        }
+        if (status < 0) {
+            fprintf(stderr, "Cannot read snapshot from '%s': %s\n", inputs[n], strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        fclose(input);
+    }
+
+    ramindex_archive_print_stats(&archive);
+
+    if (ramindex_archive_close(&archive) < 0) {
+        fprintf(stderr, "Cannot close '%s': %s\n", filename, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int main(int argc, char *argv[])
+{
+    int c;
+    int64_t selected = -1;
+    uint32_t n;
+    FILE *output;
+    struct ramindex_archive archive;
+    struct ramindex_snapshot snapshot;
+    // cmdline options
+    const char *filename = NULL;
+    int compress = 0;
+    int list = 0;
+    int64_t index = -1;
+    int64_t timestamp = -1;
+
+    static struct option long_options[] = {
+        {"help",     no_argument,       0, 'h'},
+        {"version",  no_argument,       0, 'v'},
+        {"output",   required_argument, 0, 'o'},
+        {"compress", no_argument,       0, 'z'},
+        {"list",     no_argument,       0, 'l'},
+        {"time",     required_argument, 0, 't'},
+        {"index",    required_argument, 0, 'i'},
+        {0, 0, 0, 0}
+    };
+
+    for (;;) {
+        c = getopt_long(argc, argv, "hvo:zlt:i:", long_options, 0);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'h':
+                ramindex_archive_print_usage(argv[0]);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'v':
+                fprintf(stdout, "%s (this program) version: %s\n", argv[0], PROJECT_VER);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'o':
+                filename = optarg;
+                break;
+
+            case 'z':
+                compress = 1;
+                break;
+
+            case 'l':
+                list = 1;
+                break;
+
+            case 't':
+                timestamp = strtoll(optarg, NULL, 0);
+                break;
+
+            case 'i':
+                index = strtoll(optarg, NULL, 0);
+                break;
+
+            default:
+                ramindex_archive_print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (optind >= argc) {
+        ramindex_archive_print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    /* no sample selected and an output given - snapshots are archived */
+    if (filename && index < 0 && timestamp < 0) {
+        ramindex_archive_build(filename, compress, &argv[optind], argc - optind);
+        return 0;
+    }
+
+    if (ramindex_archive_open(&archive, argv[optind]) < 0) {
+        fprintf(stderr, "Cannot open archive '%s': %s\n", argv[optind], strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    if (list) {
+        fprintf(stdout, "INDEX        TIMESTAMP  CPU  CACHE  STORED\n");
+        for (n = 0; n < archive.nentries; n++) {
+            const struct ramindex_archive_entry *e = &archive.entries[archive.order[n]];
+            fprintf(stdout, "%5u %16llu %4d  L%d%c    %s\n", archive.order[n],
+                (unsigned long long)e->timestamp, e->cpu, e->level + 1, e->icache ? 'i' : 'd',
+                e->prev == UINT32_MAX ? "whole" : "delta");
+        }
+    }
+
+    if (timestamp >= 0)
+        selected = ramindex_archive_seek(&archive, timestamp);
+    else if (index >= 0)
+        selected = index;
+
+    if (selected >= 0) {
+        if (ramindex_archive_read(&archive, selected, &snapshot) < 0) {
+            fprintf(stderr, "Cannot read sample %lld: %s\n", (long long)selected, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        if (filename) {
+            output = fopen(filename, "wb");
+            if (output == NULL || ramindex_snapshot_write(output, &snapshot) < 0) {
+                fprintf(stderr, "Cannot write snapshot to '%s': %s\n",
+                    filename, strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+            fclose(output);
+        } else {
+            fprintf(stdout, "Sample %lld taken at %llu on cpu %d\n", (long long)selected,
+                (unsigned long long)snapshot.timestamp, snapshot.cpu);
+            ramindex_snapshot_print(stdout, &snapshot);
+        }
+
+        ramindex_snapshot_free(&snapshot);
+    } else if (timestamp >= 0) {
+        fprintf(stderr, "No sample taken at or after %lld\n", (long long)timestamp);
+        exit(EXIT_FAILURE);
+    }
+
+    if (!list && selected < 0)
+        ramindex_archive_print_stats(&archive);
+
+    ramindex_archive_close(&archive);
+
+    return 0;
+}
@@ -0,0 +1,968 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-archive.c
+ *
+ * Archive of many snapshots taken over a long time.
+ *
+ * The file (host byte order) starts with a header followed by frames.
+ * A frame is a frame header and a payload (zero-run encoded if the frame
+ * says so). Samples are stored as RAMINDEX_ARCHIVE_FRAME_KEY (all the lines)
+ * or RAMINDEX_ARCHIVE_FRAME_DELTA (lines which changed, with their indexes)
+ * frames, both with a sample header kept out of the payload, so that the file
+ * may be scanned without decoding anything. Content of a line is stored
+ * in a RAMINDEX_ARCHIVE_FRAME_BLOB frame, written before the first sample
+ * referring to it, and is referred to by its 64-bit hash. Closing the archive
+ * appends a RAMINDEX_ARCHIVE_FRAME_INDEX frame and a trailer pointing to it.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "ramindex-archive.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define RAMINDEX_ARCHIVE_INDEX_MAGIC "RAMIAIDX"
+
+#define RAMINDEX_ARCHIVE_FRAME_KEY   1
+#define RAMINDEX_ARCHIVE_FRAME_DELTA 2
+#define RAMINDEX_ARCHIVE_FRAME_BLOB  3
+#define RAMINDEX_ARCHIVE_FRAME_INDEX 4
+
+/* delta payload is a sequence of line indexes, each followed by the line */
+#define RAMINDEX_ARCHIVE_CHANGE_SIZE (sizeof(uint32_t) + sizeof(struct ramindex_archive_line))
+
+/* zero-run encoding: control byte with the top bit set stands for a run
+   of (low bits + 1) zeros, a clear one for (low bits + 1) literal bytes */
+#define RAMINDEX_ARCHIVE_RUN_MAX 128
+
+/*===========================================================================*\
+ * local types definitions
+\*===========================================================================*/
+
+/* on-disk header of an archive */
+struct ramindex_archive_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+};
+
+/* on-disk header of every frame */
+struct ramindex_archive_frame {
+    uint32_t type;
+    uint32_t flags;
+    uint32_t size;
+    uint32_t rawsize;
+};
+
+/* on-disk header of a sample, follows the frame header of KEY and DELTA frames */
+struct ramindex_archive_sample {
+    int32_t cpu;
+    int32_t level;
+    int32_t icache;
+    int32_t nsets;
+    int32_t nways;
+    int32_t linesize;
+    uint32_t flags;
+    uint32_t nlines;
+    uint64_t timestamp;
+    uint32_t prev;
+    uint32_t reserved;
+};
+
+/* on-disk representation of a line, @blob is 0 if its content is not stored */
+struct ramindex_archive_line {
+    int32_t set;
+    int32_t way;
+    uint8_t valid;
+    uint8_t dirty;
+    uint8_t ns;
+    uint8_t state;
+    uint32_t linesize;
+    uint64_t tag;
+    uint64_t blob;
+};
+
+/* on-disk trailer of a closed archive */
+struct ramindex_archive_trailer {
+    uint64_t offset;
+    char magic[8];
+};
+
+/* stored content of a line, an entry of an open addressing hash table */
+struct ramindex_archive_blob {
+    uint64_t hash;
+    uint64_t offset;
+};
+
+/* lines of the last sample written (read) of one cpu and cache */
+struct ramindex_archive_stream {
+    struct ramindex_archive_sample sample;
+    uint32_t last;
+    uint32_t count;
+    struct ramindex_archive_line *lines;
+};
+
+/*===========================================================================*\
+ * local (internal linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global (external linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) functions definitions
+\*===========================================================================*/
+static uint64_t ramindex_archive_hash(const uint8_t *data, uint32_t size)
+{
+    uint64_t h = 0xcbf29ce484222325ULL ^ size;
+    uint64_t w;
+    uint32_t n;
+
+    for (n = 0; n + sizeof(w) <= size; n += sizeof(w)) {
+        memcpy(&w, data + n, sizeof(w));
+        h = (h ^ w) * 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 29;
+    }
+    for (; n < size; n++)
+        h = (h ^ data[n]) * 0x100000001b3ULL;
+
+    h ^= h >> 32;
+
+    /* 0 stands for no content */
+    return h ? h : 1;
+}
+
+static size_t ramindex_archive_encode(const uint8_t *src, size_t size, uint8_t *dst)
+{
+    size_t i = 0, o = 0, start, z;
+
+    while (i < size) {
+        for (z = 0; i + z < size && src[i + z] == 0 && z < RAMINDEX_ARCHIVE_RUN_MAX; z++)
+            ;
+        if (z >= 2) {
+            dst[o++] = 0x80 | (z - 1);
+            i += z;
+            continue;
+        }
+
+        /* literal bytes up to the next run of (at least two) zeros */
+        start = i;
+        while (i < size && i - start < RAMINDEX_ARCHIVE_RUN_MAX &&
+            !(src[i] == 0 && i + 1 < size && src[i + 1] == 0))
+            i++;
+        dst[o++] = i - start - 1;
+        memcpy(dst + o, src + start, i - start);
+        o += i - start;
+    }
+
+    return o;
+}
+
+static int ramindex_archive_decode(const uint8_t *src, size_t size, uint8_t *dst, size_t rawsize)
+{
+    size_t i = 0, o = 0, n;
+
+    while (i < size) {
+        n = (src[i] & 0x7f) + 1;
+        if (o + n > rawsize)
+            return -1;
+        if (src[i++] & 0x80) {
+            memset(dst + o, 0, n);
+        } else {
+            if (i + n > size)
+                return -1;
+            memcpy(dst + o, src + i, n);
+            i += n;
+        }
+        o += n;
+    }
+
+    return o == rawsize ? 0 : -1;
+}
+
+static int ramindex_archive_reserve(struct ramindex_archive *archive, size_t size)
+{
+    uint8_t *buffer, *encoded;
+
+    if (size <= archive->buffersize)
+        return 0;
+
+    /* worst case of zero-run encoding is one control byte per RUN_MAX bytes */
+    buffer = realloc(archive->buffer, size);
+    if (buffer)
+        archive->buffer = buffer;
+    encoded = realloc(archive->encoded, size + size / RAMINDEX_ARCHIVE_RUN_MAX + 1);
+    if (encoded)
+        archive->encoded = encoded;
+    if (buffer == NULL || encoded == NULL)
+        return -1;
+
+    archive->buffersize = size;
+
+    return 0;
+}
+
+/* writes a frame of the payload held by archive->buffer, head (if any) goes between */
+static int ramindex_archive_write_frame(struct ramindex_archive *archive, uint32_t type,
+    const void *head, size_t headsize, size_t rawsize)
+{
+    struct ramindex_archive_frame frame;
+    const uint8_t *payload = archive->buffer;
+
+    memset(&frame, 0, sizeof(frame));
+    frame.type = type;
+    frame.size = rawsize;
+    frame.rawsize = rawsize;
+
+    if (archive->flags & RAMINDEX_ARCHIVE_F_COMPRESS) {
+        size_t size = ramindex_archive_encode(archive->buffer, rawsize, archive->encoded);
+        if (size < rawsize) {
+            frame.flags = RAMINDEX_ARCHIVE_F_COMPRESS;
+            frame.size = size;
+            payload = archive->encoded;
+        }
+    }
+
+    if (fwrite(&frame, sizeof(frame), 1, archive->stream) != 1 ||
+        (headsize && fwrite(head, headsize, 1, archive->stream) != 1) ||
+        (frame.size && fwrite(payload, frame.size, 1, archive->stream) != 1))
+        return -1;
+
+    archive->stats.bytes += sizeof(frame) + headsize + frame.size;
+
+    return 0;
+}
+
+/* reads the payload of a frame which has just been read (with its head) into archive->buffer */
+static int ramindex_archive_read_payload(struct ramindex_archive *archive,
+    const struct ramindex_archive_frame *frame)
+{
+    if (ramindex_archive_reserve(archive, frame->rawsize > frame->size ?
+            frame->rawsize : frame->size) < 0)
+        return -1;
+
+    if (frame->flags & RAMINDEX_ARCHIVE_F_COMPRESS) {
+        if (frame->size && fread(archive->encoded, frame->size, 1, archive->stream) != 1)
+            return -1;
+        if (ramindex_archive_decode(archive->encoded, frame->size,
+                archive->buffer, frame->rawsize) < 0) {
+            errno = EINVAL;
+            return -1;
+        }
+    } else {
+        if (frame->size != frame->rawsize) {
+            errno = EINVAL;
+            return -1;
+        }
+        if (frame->size && fread(archive->buffer, frame->size, 1, archive->stream) != 1)
+            return -1;
+    }
+
+    return 0;
+}
+
+static struct ramindex_archive_blob *ramindex_archive_blob_find(
+    const struct ramindex_archive *archive, uint64_t hash)
+{
+    size_t n;
+
+    if (archive->maxblobs == 0)
+        return NULL;
+
+    for (n = hash & (archive->maxblobs - 1); archive->blobs[n].hash;
+            n = (n + 1) & (archive->maxblobs - 1))
+        if (archive->blobs[n].hash == hash)
+            return &archive->blobs[n];
+
+    return NULL;
+}
+
+static int ramindex_archive_blob_insert(struct ramindex_archive *archive,
+    uint64_t hash, uint64_t offset)
+{
+    struct ramindex_archive_blob *blobs, *old = archive->blobs;
+    size_t n, m, maxblobs = archive->maxblobs, oldmax = archive->maxblobs;
+
+    /* the table is kept at most half full */
+    if (2 * (archive->nblobs + 1) > maxblobs) {
+        maxblobs = maxblobs ? 2 * maxblobs : 1024;
+        blobs = calloc(maxblobs, sizeof(*blobs));
+        if (blobs == NULL)
+            return -1;
+
+        archive->blobs = blobs;
+        archive->maxblobs = maxblobs;
+        archive->nblobs = 0;
+        for (n = 0; n < oldmax; n++)
+            if (old[n].hash)
+                ramindex_archive_blob_insert(archive, old[n].hash, old[n].offset);
+        free(old);
+    }
+
+    for (m = hash & (maxblobs - 1); archive->blobs[m].hash; m = (m + 1) & (maxblobs - 1))
+        ;
+    archive->blobs[m].hash = hash;
+    archive->blobs[m].offset = offset;
+    archive->nblobs++;
+
+    return 0;
+}
+
+static struct ramindex_archive_stream *ramindex_archive_stream_find(
+    struct ramindex_archive *archive, const struct ramindex_archive_sample *sample)
+{
+    struct ramindex_archive_stream *streams, *s;
+    size_t n;
+
+    for (n = 0; n < archive->nstreams; n++) {
+        s = &archive->streams[n];
+        if (s->sample.cpu == sample->cpu && s->sample.level == sample->level &&
+            s->sample.icache == sample->icache)
+            return s;
+    }
+
+    streams = realloc(archive->streams, (archive->nstreams + 1) * sizeof(*streams));
+    if (streams == NULL)
+        return NULL;
+    archive->streams = streams;
+
+    s = &archive->streams[archive->nstreams++];
+    memset(s, 0, sizeof(*s));
+    s->sample = *sample;
+    s->last = UINT32_MAX;
+
+    return s;
+}
+
+static int ramindex_archive_add_entry(struct ramindex_archive *archive,
+    const struct ramindex_archive_sample *sample, uint64_t offset)
+{
+    struct ramindex_archive_entry *entries, *e;
+
+    if (archive->nentries == UINT32_MAX - 1) {
+        errno = EFBIG;
+        return -1;
+    }
+
+    if (archive->nentries == archive->maxentries) {
+        archive->maxentries = archive->maxentries ? 2 * archive->maxentries : 1024;
+        entries = realloc(archive->entries, archive->maxentries * sizeof(*entries));
+        if (entries == NULL)
+            return -1;
+        archive->entries = entries;
+    }
+
+    e = &archive->entries[archive->nentries++];
+    e->timestamp = sample->timestamp;
+    e->offset = offset;
+    e->prev = sample->prev;
+    e->cpu = sample->cpu;
+    e->level = sample->level;
+    e->icache = sample->icache;
+
+    archive->stats.nsamples++;
+    if (sample->prev == UINT32_MAX)
+        archive->stats.nkeys++;
+
+    return 0;
+}
+
+static int ramindex_archive_store_line(struct ramindex_archive *archive,
+    const struct ramindex_snapshot *snapshot, const struct ramindex_cacheline *l,
+    struct ramindex_archive_line *line)
+{
+    off_t offset;
+
+    memset(line, 0, sizeof(*line));
+    line->set = l->set;
+    line->way = l->way;
+    line->valid = l->valid;
+    line->dirty = l->dirty;
+    line->ns = l->ns;
+    line->state = l->state;
+    line->tag = l->tag;
+
+    if (!(snapshot->flags & RAMINDEX_SNAPSHOT_F_DATA) || l->linesize == 0)
+        return 0;
+
+    line->linesize = l->linesize;
+    line->blob = ramindex_archive_hash(l->linedata, l->linesize);
+
+    if (ramindex_archive_blob_find(archive, line->blob)) {
+        archive->stats.ndedup++;
+        return 0;
+    }
+
+    offset = ftello(archive->stream);
+    if (offset < 0 || ramindex_archive_blob_insert(archive, line->blob, offset) < 0)
+        return -1;
+
+    /* blob frames carry the hash as their head */
+    memcpy(archive->buffer, l->linedata, l->linesize);
+    if (ramindex_archive_write_frame(archive, RAMINDEX_ARCHIVE_FRAME_BLOB,
+            &line->blob, sizeof(line->blob), l->linesize) < 0)
+        return -1;
+
+    archive->stats.nblobs++;
+
+    return 0;
+}
+
+/* @lines is decoded from the frame at @offset (against @lines, for deltas) */
+static int ramindex_archive_decode_sample(struct ramindex_archive *archive, uint64_t offset,
+    struct ramindex_archive_sample *sample, struct ramindex_archive_line **lines)
+{
+    struct ramindex_archive_frame frame;
+    struct ramindex_archive_line *l;
+    uint32_t n, index;
+
+    if (fseeko(archive->stream, offset, SEEK_SET) < 0 ||
+        fread(&frame, sizeof(frame), 1, archive->stream) != 1 ||
+        fread(sample, sizeof(*sample), 1, archive->stream) != 1)
+        return -1;
+
+    if ((frame.type != RAMINDEX_ARCHIVE_FRAME_KEY && frame.type != RAMINDEX_ARCHIVE_FRAME_DELTA) ||
+        sample->nsets <= 0 || sample->nways <= 0 || sample->linesize <= 0 ||
+        sample->nlines > (uint32_t)sample->nsets * sample->nways) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (ramindex_archive_read_payload(archive, &frame) < 0)
+        return -1;
+
+    if (frame.type == RAMINDEX_ARCHIVE_FRAME_KEY) {
+        if (frame.rawsize != sample->nlines * sizeof(**lines)) {
+            errno = EINVAL;
+            return -1;
+        }
+        l = realloc(*lines, frame.rawsize ? frame.rawsize : 1);
+        if (l == NULL)
+            return -1;
+        memcpy(l, archive->buffer, frame.rawsize);
+        *lines = l;
+        return 0;
+    }
+
+    if (*lines == NULL || frame.rawsize % RAMINDEX_ARCHIVE_CHANGE_SIZE) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (n = 0; n < frame.rawsize; n += RAMINDEX_ARCHIVE_CHANGE_SIZE) {
+        memcpy(&index, archive->buffer + n, sizeof(index));
+        if (index >= sample->nlines) {
+            errno = EINVAL;
+            return -1;
+        }
+        memcpy(&(*lines)[index], archive->buffer + n + sizeof(index), sizeof(**lines));
+    }
+
+    return 0;
+}
+
+static int ramindex_archive_read_blob(struct ramindex_archive *archive, uint64_t hash,
+    uint8_t *data, uint32_t linesize)
+{
+    const struct ramindex_archive_blob *blob = ramindex_archive_blob_find(archive, hash);
+    struct ramindex_archive_frame frame;
+    uint64_t h;
+
+    if (blob == NULL) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    if (fseeko(archive->stream, blob->offset, SEEK_SET) < 0 ||
+        fread(&frame, sizeof(frame), 1, archive->stream) != 1 ||
+        fread(&h, sizeof(h), 1, archive->stream) != 1)
+        return -1;
+
+    if (frame.type != RAMINDEX_ARCHIVE_FRAME_BLOB || h != hash || frame.rawsize != linesize) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (ramindex_archive_read_payload(archive, &frame) < 0)
+        return -1;
+
+    memcpy(data, archive->buffer, linesize);
+
+    return 0;
+}
+
+static int ramindex_archive_read_index(struct ramindex_archive *archive)
+{
+    struct ramindex_archive_trailer trailer;
+    struct ramindex_archive_frame frame;
+    const struct ramindex_archive_blob *blobs;
+    uint64_t nentries, nblobs, n;
+
+    if (fseeko(archive->stream, -(off_t)sizeof(trailer), SEEK_END) < 0 ||
+        fread(&trailer, sizeof(trailer), 1, archive->stream) != 1 ||
+        memcmp(trailer.magic, RAMINDEX_ARCHIVE_INDEX_MAGIC, sizeof(trailer.magic)))
+        return -1;
+
+    if (fseeko(archive->stream, trailer.offset, SEEK_SET) < 0 ||
+        fread(&frame, sizeof(frame), 1, archive->stream) != 1 ||
+        frame.type != RAMINDEX_ARCHIVE_FRAME_INDEX ||
+        fread(&nentries, sizeof(nentries), 1, archive->stream) != 1 ||
+        fread(&nblobs, sizeof(nblobs), 1, archive->stream) != 1 ||
+        nentries >= UINT32_MAX)
+        return -1;
+
+    archive->entries = malloc((nentries ? nentries : 1) * sizeof(*archive->entries));
+    if (archive->entries == NULL ||
+        (nentries && fread(archive->entries, sizeof(*archive->entries), nentries,
+            archive->stream) != nentries))
+        return -1;
+    archive->nentries = archive->maxentries = nentries;
+
+    if (ramindex_archive_reserve(archive, (nblobs ? nblobs : 1) * sizeof(*blobs)) < 0 ||
+        (nblobs && fread(archive->buffer, sizeof(*blobs), nblobs, archive->stream) != nblobs))
+        return -1;
+
+    blobs = (const struct ramindex_archive_blob *)archive->buffer;
+    for (n = 0; n < nblobs; n++)
+        if (ramindex_archive_blob_insert(archive, blobs[n].hash, blobs[n].offset) < 0)
+            return -1;
+
+    for (n = 0; n < nentries; n++)
+        if (archive->entries[n].prev == UINT32_MAX)
+            archive->stats.nkeys++;
+    archive->stats.nsamples = nentries;
+    archive->stats.nblobs = nblobs;
+
+    return 0;
+}
+
+/* rebuilds the index of an archive which has not been closed */
+static int ramindex_archive_scan(struct ramindex_archive *archive, off_t size)
+{
+    struct ramindex_archive_frame frame;
+    struct ramindex_archive_sample sample;
+    uint64_t hash;
+    off_t offset = sizeof(struct ramindex_archive_header), end;
+    size_t headsize;
+
+    for (;;) {
+        if (fseeko(archive->stream, offset, SEEK_SET) < 0)
+            return -1;
+        if (fread(&frame, sizeof(frame), 1, archive->stream) != 1)
+            break;
+
+        if (frame.type == RAMINDEX_ARCHIVE_FRAME_KEY || frame.type == RAMINDEX_ARCHIVE_FRAME_DELTA)
+            headsize = sizeof(sample);
+        else if (frame.type == RAMINDEX_ARCHIVE_FRAME_BLOB)
+            headsize = sizeof(hash);
+        else if (frame.type == RAMINDEX_ARCHIVE_FRAME_INDEX)
+            headsize = 0;
+        else
+            break;
+
+        /* a frame cut short by the end of the file is ignored */
+        end = offset + sizeof(frame) + headsize + frame.size;
+        if (end > size)
+            break;
+
+        if (frame.type == RAMINDEX_ARCHIVE_FRAME_BLOB) {
+            if (fread(&hash, sizeof(hash), 1, archive->stream) != 1 ||
+                ramindex_archive_blob_insert(archive, hash, offset) < 0)
+                return -1;
+            archive->stats.nblobs++;
+        } else if (frame.type != RAMINDEX_ARCHIVE_FRAME_INDEX) {
+            if (fread(&sample, sizeof(sample), 1, archive->stream) != 1 ||
+                ramindex_archive_add_entry(archive, &sample, offset) < 0)
+                return -1;
+        }
+
+        offset = end;
+    }
+
+    clearerr(archive->stream);
+
+    return 0;
+}
+
+static int ramindex_archive_compare(const void *a, const void *b, void *arg)
+{
+    const struct ramindex_archive_entry *entries = arg;
+    uint32_t ia = *(const uint32_t *)a, ib = *(const uint32_t *)b;
+
+    if (entries[ia].timestamp != entries[ib].timestamp)
+        return entries[ia].timestamp < entries[ib].timestamp ? -1 : 1;
+
+    return ia < ib ? -1 : ia > ib;
+}
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int ramindex_archive_create(struct ramindex_archive *archive, const char *filename,
+    uint32_t flags)
+{
+    struct ramindex_archive_header header;
+
+    memset(archive, 0, sizeof(*archive));
+    archive->flags = flags & RAMINDEX_ARCHIVE_F_COMPRESS;
+    archive->writing = 1;
+
+    archive->stream = fopen(filename, "wb");
+    if (archive->stream == NULL)
+        return -1;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RAMINDEX_ARCHIVE_MAGIC, sizeof(header.magic));
+    header.version = RAMINDEX_ARCHIVE_VERSION;
+    header.flags = archive->flags;
+
+    if (fwrite(&header, sizeof(header), 1, archive->stream) != 1) {
+        fclose(archive->stream);
+        archive->stream = NULL;
+        return -1;
+    }
+    archive->stats.bytes = sizeof(header);
+
+    return 0;
+}
+
+int ramindex_archive_append(struct ramindex_archive *archive,
+    const struct ramindex_snapshot *snapshot)
+{
+    struct ramindex_archive_sample sample;
+    struct ramindex_archive_stream *s;
+    struct ramindex_archive_line *lines;
+    uint32_t n, nchanges = 0;
+    size_t size;
+    off_t offset;
+    int key;
+
+    if (!archive->writing) {
+        errno = EBADF;
+        return -1;
+    }
+
+    memset(&sample, 0, sizeof(sample));
+    sample.cpu = snapshot->cpu;
+    sample.level = snapshot->ccsidr.level;
+    sample.icache = snapshot->ccsidr.icache;
+    sample.nsets = snapshot->ccsidr.nsets;
+    sample.nways = snapshot->ccsidr.nways;
+    sample.linesize = snapshot->ccsidr.linesize;
+    sample.flags = snapshot->flags & RAMINDEX_SNAPSHOT_F_DATA;
+    sample.nlines = snapshot->nlines;
+    sample.timestamp = snapshot->timestamp;
+    sample.prev = UINT32_MAX;
+
+    s = ramindex_archive_stream_find(archive, &sample);
+    if (s == NULL)
+        return -1;
+
+    size = (size_t)snapshot->nlines * RAMINDEX_ARCHIVE_CHANGE_SIZE;
+    if (ramindex_archive_reserve(archive, size > (size_t)sample.linesize ? size : sample.linesize) < 0)
+        return -1;
+
+    lines = malloc((snapshot->nlines ? snapshot->nlines : 1) * sizeof(*lines));
+    if (lines == NULL)
+        return -1;
+
+    /* content of the lines goes to the blobs first */
+    for (n = 0; n < snapshot->nlines; n++)
+        if (ramindex_archive_store_line(archive, snapshot, &snapshot->lines[n], &lines[n]) < 0)
+            goto error;
+
+    key = s->lines == NULL || s->count % RAMINDEX_ARCHIVE_KEY_INTERVAL == 0 ||
+        memcmp(&s->sample.nsets, &sample.nsets,
+            offsetof(struct ramindex_archive_sample, timestamp) -
+            offsetof(struct ramindex_archive_sample, nsets));
+
+    if (!key) {
+        for (n = 0; n < snapshot->nlines; n++) {
+            if (memcmp(&lines[n], &s->lines[n], sizeof(*lines)) == 0)
+                continue;
+            memcpy(archive->buffer + nchanges * RAMINDEX_ARCHIVE_CHANGE_SIZE, &n, sizeof(n));
+            memcpy(archive->buffer + nchanges * RAMINDEX_ARCHIVE_CHANGE_SIZE + sizeof(n),
+                &lines[n], sizeof(*lines));
+            nchanges++;
+        }
+        /* a delta bigger than the sample itself is not worth it */
+        key = (size_t)nchanges * RAMINDEX_ARCHIVE_CHANGE_SIZE >= snapshot->nlines * sizeof(*lines);
+    }
+
+    if (key) {
+        s->count = 0;
+        memcpy(archive->buffer, lines, snapshot->nlines * sizeof(*lines));
+        size = snapshot->nlines * sizeof(*lines);
+    } else {
+        sample.prev = s->last;
+        size = (size_t)nchanges * RAMINDEX_ARCHIVE_CHANGE_SIZE;
+    }
+
+    offset = ftello(archive->stream);
+    if (offset < 0 ||
+        ramindex_archive_write_frame(archive,
+            key ? RAMINDEX_ARCHIVE_FRAME_KEY : RAMINDEX_ARCHIVE_FRAME_DELTA,
+            &sample, sizeof(sample), size) < 0 ||
+        ramindex_archive_add_entry(archive, &sample, offset) < 0)
+        goto error;
+
+    free(s->lines);
+    s->lines = lines;
+    s->sample = sample;
+    s->last = archive->nentries - 1;
+    s->count++;
+
+    archive->stats.nlines += snapshot->nlines;
+    archive->stats.rawbytes += ramindex_snapshot_size(snapshot);
+
+    return 0;
+
+error:
+    free(lines);
+    return -1;
+}
+
+int ramindex_archive_open(struct ramindex_archive *archive, const char *filename)
+{
+    struct ramindex_archive_header header;
+    uint32_t n;
+    off_t size;
+
+    memset(archive, 0, sizeof(*archive));
+
+    archive->stream = fopen(filename, "rb");
+    if (archive->stream == NULL)
+        return -1;
+
+    if (fread(&header, sizeof(header), 1, archive->stream) != 1 ||
+        memcmp(header.magic, RAMINDEX_ARCHIVE_MAGIC, sizeof(header.magic)) ||
+        header.version != RAMINDEX_ARCHIVE_VERSION) {
+        errno = EINVAL;
+        goto error;
+    }
+    archive->flags = header.flags;
+
+    if (fseeko(archive->stream, 0, SEEK_END) < 0 || (size = ftello(archive->stream)) < 0)
+        goto error;
+    archive->stats.bytes = size;
+
+    if (ramindex_archive_read_index(archive) < 0) {
+        /* not closed, whatever has been read is dropped */
+        free(archive->entries);
+        free(archive->blobs);
+        archive->entries = NULL;
+        archive->blobs = NULL;
+        archive->nentries = archive->maxentries = 0;
+        archive->nblobs = archive->maxblobs = 0;
+        memset(&archive->stats, 0, sizeof(archive->stats));
+        clearerr(archive->stream);
+        if (ramindex_archive_scan(archive, size) < 0)
+            goto error;
+        archive->stats.bytes = size;
+    }
+
+    archive->order = malloc((archive->nentries ? archive->nentries : 1) * sizeof(*archive->order));
+    if (archive->order == NULL)
+        goto error;
+    for (n = 0; n < archive->nentries; n++)
+        archive->order[n] = n;
+    qsort_r(archive->order, archive->nentries, sizeof(*archive->order),
+        ramindex_archive_compare, archive->entries);
+
+    return 0;
+
+error:
+    ramindex_archive_close(archive);
+    return -1;
+}
+
+int64_t ramindex_archive_seek(const struct ramindex_archive *archive, uint64_t timestamp)
+{
+    uint32_t lo = 0, hi = archive->nentries, mid;
+
+    if (archive->order == NULL)
+        return -1;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (archive->entries[archive->order[mid]].timestamp < timestamp)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo < archive->nentries ? archive->order[lo] : -1;
+}
+
+int ramindex_archive_read(struct ramindex_archive *archive, uint32_t index,
+    struct ramindex_snapshot *snapshot)
+{
+    const struct ramindex_archive_entry *e;
+    struct ramindex_archive_stream *s;
+    struct ramindex_archive_sample sample;
+    struct ramindex_ccsidr ccsidr;
+    uint32_t *chain, nchain = 0, i, n;
+
+    if (archive->writing || index >= archive->nentries) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    e = &archive->entries[index];
+    memset(&sample, 0, sizeof(sample));
+    sample.cpu = e->cpu;
+    sample.level = e->level;
+    sample.icache = e->icache;
+    s = ramindex_archive_stream_find(archive, &sample);
+    if (s == NULL)
+        return -1;
+
+    /* samples back to the last one decoded or to the one stored whole */
+    chain = malloc(RAMINDEX_ARCHIVE_KEY_INTERVAL * sizeof(*chain));
+    if (chain == NULL)
+        return -1;
+    for (i = index; ; i = archive->entries[i].prev) {
+        if (i == s->last && s->lines)
+            break;
+        if (nchain == RAMINDEX_ARCHIVE_KEY_INTERVAL || i >= archive->nentries) {
+            free(chain);
+            errno = EINVAL;
+            return -1;
+        }
+        chain[nchain++] = i;
+        if (archive->entries[i].prev == UINT32_MAX)
+            break;
+    }
+
+    while (nchain > 0) {
+        i = chain[--nchain];
+        if (ramindex_archive_decode_sample(archive, archive->entries[i].offset,
+                &sample, &s->lines) < 0) {
+            free(s->lines);
+            s->lines = NULL;
+            s->last = UINT32_MAX;
+            free(chain);
+            return -1;
+        }
+        s->sample = sample;
+        s->last = i;
+    }
+    free(chain);
+
+    memset(&ccsidr, 0, sizeof(ccsidr));
+    ccsidr.level = s->sample.level;
+    ccsidr.icache = s->sample.icache;
+    ccsidr.nsets = s->sample.nsets;
+    ccsidr.nways = s->sample.nways;
+    ccsidr.linesize = s->sample.linesize;
+
+    if (ramindex_snapshot_alloc(snapshot, &ccsidr, s->sample.flags) < 0)
+        return -1;
+
+    snapshot->cpu = s->sample.cpu;
+    snapshot->timestamp = s->sample.timestamp;
+    snapshot->nlines = s->sample.nlines;
+
+    for (n = 0; n < snapshot->nlines; n++) {
+        const struct ramindex_archive_line *line = &s->lines[n];
+        struct ramindex_cacheline *l = &snapshot->lines[n];
+
+        l->set = line->set;
+        l->way = line->way;
+        l->valid = line->valid;
+        l->dirty = line->dirty;
+        l->ns = line->ns;
+        l->state = line->state;
+        l->tag = line->tag;
+        l->linesize = 0;
+
+        if (line->blob == 0)
+            continue;
+
+        if (!(snapshot->flags & RAMINDEX_SNAPSHOT_F_DATA) ||
+            line->linesize > (uint32_t)ccsidr.linesize) {
+            errno = EINVAL;
+            goto error;
+        }
+        l->linesize = line->linesize;
+        if (ramindex_archive_read_blob(archive, line->blob, l->linedata, l->linesize) < 0)
+            goto error;
+    }
+
+    return 0;
+
+error:
+    ramindex_snapshot_free(snapshot);
+    return -1;
+}
+
+int ramindex_archive_close(struct ramindex_archive *archive)
+{
+    struct ramindex_archive_frame frame;
+    struct ramindex_archive_trailer trailer;
+    uint64_t nentries = archive->nentries, nblobs = archive->nblobs;
+    int status = 0;
+    size_t n;
+    off_t offset;
+
+    if (archive->writing && archive->stream) {
+        memset(&frame, 0, sizeof(frame));
+        frame.type = RAMINDEX_ARCHIVE_FRAME_INDEX;
+        frame.size = frame.rawsize = sizeof(nentries) + sizeof(nblobs) +
+            nentries * sizeof(*archive->entries) + nblobs * sizeof(*archive->blobs);
+
+        memset(&trailer, 0, sizeof(trailer));
+        memcpy(trailer.magic, RAMINDEX_ARCHIVE_INDEX_MAGIC, sizeof(trailer.magic));
+
+        offset = ftello(archive->stream);
+        trailer.offset = offset;
+
+        if (offset < 0 ||
+            fwrite(&frame, sizeof(frame), 1, archive->stream) != 1 ||
+            fwrite(&nentries, sizeof(nentries), 1, archive->stream) != 1 ||
+            fwrite(&nblobs, sizeof(nblobs), 1, archive->stream) != 1 ||
+            (nentries && fwrite(archive->entries, sizeof(*archive->entries), nentries,
+                archive->stream) != nentries))
+            status = -1;
+
+        for (n = 0; n < archive->maxblobs && status == 0; n++)
+            if (archive->blobs[n].hash &&
+                fwrite(&archive->blobs[n], sizeof(archive->blobs[n]), 1, archive->stream) != 1)
+                status = -1;
+
+        if (status == 0 && fwrite(&trailer, sizeof(trailer), 1, archive->stream) != 1)
+            status = -1;
+    }
+
+    if (archive->stream && fclose(archive->stream) != 0)
+        status = -1;
+
+    for (n = 0; n < archive->nstreams; n++)
+        free(archive->streams[n].lines);
+    free(archive->streams);
+    free(archive->entries);
+    free(archive->order);
+    free(archive->blobs);
+    free(archive->buffer);
+    free(archive->encoded);
+    memset(archive, 0, sizeof(*archive));
+
+    return status;
+}
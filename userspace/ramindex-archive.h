@@ -0,0 +1,177 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-archive.h
+ *
+ * Archive of many snapshots taken over a long time.
+ *
+ * Content of the lines is stored once per distinct content (content addressed
+ * blobs), tags and states of a sample are stored as changes against
+ * the previous sample of the same stream (cpu and cache), with every
+ * RAMINDEX_ARCHIVE_KEY_INTERVAL-th sample of a stream stored whole, so any
+ * sample may be decoded without reading more than that many others.
+ * An index written when the archive is closed lets it be opened and searched
+ * by time without being read through (archives which were not closed are
+ * scanned instead).
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+#ifndef _RAMINDEX_ARCHIVE_H_
+#define _RAMINDEX_ARCHIVE_H_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <stdio.h>
+#include <stdint.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "ramindex-snapshot.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define RAMINDEX_ARCHIVE_MAGIC "RAMIARCH"
+#define RAMINDEX_ARCHIVE_VERSION 1
+
+/* payloads of the frames are zero-run encoded (cheap and effective on tags) */
+#define RAMINDEX_ARCHIVE_F_COMPRESS (1u << 0)
+
+/* every that many samples of a stream one is stored whole */
+#define RAMINDEX_ARCHIVE_KEY_INTERVAL 64
+
+/*===========================================================================*\
+ * global types definitions
+\*===========================================================================*/
+
+/**
+ * struct ramindex_archive_entry - where to find one sample of an archive
+ * @timestamp:	@timestamp of the archived snapshot
+ * @offset:	file offset of the sample
+ * @prev:	index of the sample the sample is stored against
+ *		(UINT32_MAX if it is stored whole)
+ * @cpu:	@cpu of the archived snapshot
+ * @level:	cache level of the archived snapshot (0 based)
+ * @icache:	non-zero if an instruction cache has been archived
+ */
+struct ramindex_archive_entry {
+    uint64_t timestamp;
+    uint64_t offset;
+    uint32_t prev;
+    int32_t cpu;
+    int32_t level;
+    int32_t icache;
+};
+
+/**
+ * struct ramindex_archive_stats - what archiving has saved
+ * @nsamples:	number of samples
+ * @nlines:	number of lines of all the samples
+ * @nblobs:	number of distinct line contents stored
+ * @ndedup:	number of line contents found already stored
+ * @nkeys:	number of samples stored whole
+ * @rawbytes:	size of the samples in the snapshot file format
+ * @bytes:	size of the samples (with the blobs) in the archive
+ */
+struct ramindex_archive_stats {
+    uint64_t nsamples;
+    uint64_t nlines;
+    uint64_t nblobs;
+    uint64_t ndedup;
+    uint64_t nkeys;
+    uint64_t rawbytes;
+    uint64_t bytes;
+};
+
+struct ramindex_archive_blob;
+struct ramindex_archive_stream;
+
+/**
+ * struct ramindex_archive - an archive opened for writing or for reading
+ * @stream:	archive file
+ * @flags:	RAMINDEX_ARCHIVE_F_* flags
+ * @writing:	non-zero if the archive has been created, zero if opened
+ * @nentries:	number of entries in @entries array, i.e. number of samples
+ * @entries:	samples in order they were appended in
+ * @order:	indexes of @entries sorted by timestamp (reading only)
+ * @stats:	what archiving has saved (@nsamples, @nkeys and @bytes are
+ *		valid for opened archives too)
+ *
+ * The remaining fields are private to the implementation.
+ */
+struct ramindex_archive {
+    FILE *stream;
+    uint32_t flags;
+    int writing;
+    uint32_t nentries;
+    struct ramindex_archive_entry *entries;
+    uint32_t *order;
+    struct ramindex_archive_stats stats;
+
+    uint32_t maxentries;
+    size_t nblobs, maxblobs;
+    struct ramindex_archive_blob *blobs;
+    size_t nstreams;
+    struct ramindex_archive_stream *streams;
+    size_t buffersize;
+    uint8_t *buffer;
+    uint8_t *encoded;
+};
+
+/*===========================================================================*\
+ * global (external linkage) functions declarations
+\*===========================================================================*/
+
+/**
+ * Creates (truncates) an archive file, flags are RAMINDEX_ARCHIVE_F_* flags.
+ *
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int ramindex_archive_create(struct ramindex_archive *archive, const char *filename,
+    uint32_t flags);
+
+/**
+ * Appends a snapshot to an archive created by ramindex_archive_create().
+ * Snapshots of many cpus and caches may be interleaved.
+ *
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int ramindex_archive_append(struct ramindex_archive *archive,
+    const struct ramindex_snapshot *snapshot);
+
+/**
+ * Opens an archive for reading. The index is read, or rebuilt by scanning
+ * the file if the archive has not been closed (a partially written last
+ * sample is ignored then).
+ *
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int ramindex_archive_open(struct ramindex_archive *archive, const char *filename);
+
+/**
+ * Finds the earliest sample taken at or after timestamp.
+ *
+ * @return index of the sample or -1 if there is none
+ */
+int64_t ramindex_archive_seek(const struct ramindex_archive *archive, uint64_t timestamp);
+
+/**
+ * Reads the selected sample of an opened archive (allocates all the buffers).
+ * Samples are decoded against the ones they were stored against,
+ * reading them in order they were appended in is thus the cheapest.
+ *
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int ramindex_archive_read(struct ramindex_archive *archive, uint32_t index,
+    struct ramindex_snapshot *snapshot);
+
+/**
+ * Closes an archive, the index of a created archive is written first.
+ *
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int ramindex_archive_close(struct ramindex_archive *archive);
+
+#endif /* _RAMINDEX_ARCHIVE_H_ */
@@ -0,0 +1,70 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-async.c
+ *
+ * Asynchronous dumps of caches.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/ioctl.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "ramindex-async.h"
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int ramindex_async_submit(int fd, int eventfd, uint64_t cookie,
+    struct ramindex_snapshot *snapshot)
+{
+    struct ramindex_async async;
+
+    memset(&async, 0, sizeof(async));
+    async.cookie = cookie;
+    async.cpu = snapshot->cpu;
+    async.eventfd = eventfd;
+    async.selector.level = snapshot->ccsidr.level;
+    async.selector.icache = snapshot->ccsidr.icache;
+    async.selector.set = -1;
+    async.selector.way = -1;
+    async.selector.nlines = snapshot->ccsidr.nsets * snapshot->ccsidr.nways;
+    async.selector.lines = snapshot->lines;
+    if (!(snapshot->flags & RAMINDEX_SNAPSHOT_F_DATA))
+        async.selector.flags |= RAMINDEX_DUMP_F_TAGS_ONLY;
+
+    return ioctl(fd, RAMINDEX_ASYNC_SUBMIT, &async) < 0 ? -1 : 0;
+}
+
+int ramindex_async_reap(int fd, struct ramindex_async_completion *completion)
+{
+    memset(completion, 0, sizeof(*completion));
+
+    return ioctl(fd, RAMINDEX_ASYNC_REAP, completion) < 0 ? -1 : 0;
+}
+
+int ramindex_async_complete(struct ramindex_snapshot *snapshot,
+    const struct ramindex_async_completion *completion)
+{
+    if (completion->status) {
+        snapshot->nlines = 0;
+        errno = -completion->status;
+        return -1;
+    }
+
+    snapshot->nlines = completion->nlines;
+    snapshot->timestamp = completion->start_ns;
+
+    return 0;
+}
@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-async.h
+ *
+ * Asynchronous dumps of caches.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+#ifndef _RAMINDEX_ASYNC_H_
+#define _RAMINDEX_ASYNC_H_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <stdint.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "../ramindex.h"
+#include "ramindex-snapshot.h"
+
+/*===========================================================================*\
+ * global (external linkage) functions declarations
+\*===========================================================================*/
+
+/**
+ * Queues a dump of all the lines of the cache described by snapshot->ccsidr
+ * on snapshot->cpu (using the RAMINDEX_ASYNC_SUBMIT ioctl) and returns at once.
+ * Only tags are read if RAMINDEX_SNAPSHOT_F_DATA is clear. The snapshot shall
+ * not be touched until its completion is reaped. eventfd (-1 for none) is
+ * signalled on completion, cookie is returned in the completion.
+ *
+ * @return 0 on success, -1 on failure (errno is set, EBUSY if there are
+ *         RAMINDEX_ASYNC_MAX requests outstanding)
+ */
+int ramindex_async_submit(int fd, int eventfd, uint64_t cookie,
+    struct ramindex_snapshot *snapshot);
+
+/**
+ * Reaps the oldest completion (using the RAMINDEX_ASYNC_REAP ioctl).
+ * Lines of the completed request are copied to its snapshot by this call,
+ * afterwards ramindex_async_complete() shall be called on that snapshot.
+ *
+ * @return 0 on success, -1 on failure (errno is set, EAGAIN if there
+ *         is no completion to be reaped)
+ */
+int ramindex_async_reap(int fd, struct ramindex_async_completion *completion);
+
+/**
+ * Updates the snapshot the completion has been reaped for: lines held
+ * by the snapshot are replaced with the dumped ones, its timestamp is set
+ * to the time the dump started at.
+ *
+ * @return 0 if the request succeeded, -1 otherwise (errno is set)
+ */
+int ramindex_async_complete(struct ramindex_snapshot *snapshot,
+    const struct ramindex_async_completion *completion);
+
+#endif /* _RAMINDEX_ASYNC_H_ */
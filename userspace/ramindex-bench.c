@@ -0,0 +1,361 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-bench.c
+ *
+ * Measures costs of reading caches through the ramindex driver.
+ *
+ * For every cache (and every mode: tags only, tags and data, low perturbation)
+ * reports the cost of a raw access (a RAMINDEX operation followed by dsb/isb
+ * on Cortex-A72, an SMC round trip to EL3 on Cortex-A720) and the line read
+ * rate as measured in the kernel (RAMINDEX_BENCH ioctl), the line read rate
+ * as seen by userspace (RAMINDEX_DUMP ioctl) and the cost of an ioctl itself.
+ * Results are written as JSON, so they may be tracked across kernel
+ * and firmware versions. With the driver loaded with 'sim=1' it runs
+ * on any arm64 system.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <sys/ioctl.h>
+#include <sys/utsname.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include <version.h>
+#include "ramindex-snapshot.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define RAMINDEX_DEVICENAME "/dev/ramindex"
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
+
+/*===========================================================================*\
+ * local types definitions
+\*===========================================================================*/
+enum ramindex_bench_mode {
+    BENCH_MODE_TAGS,
+    BENCH_MODE_DATA,
+    BENCH_MODE_QUIET,
+    BENCH_MODE_NR
+};
+
+/*===========================================================================*\
+ * local (internal linkage) objects definitions
+\*===========================================================================*/
+static const char *ramindex_bench_mode_names[BENCH_MODE_NR] = {
+    [BENCH_MODE_TAGS] = "tags",
+    [BENCH_MODE_DATA] = "data",
+    [BENCH_MODE_QUIET] = "quiet",
+};
+
+/*===========================================================================*\
+ * global (external linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) functions definitions
+\*===========================================================================*/
+static void ramindex_bench_print_usage(const char* progname)
+{
+    fprintf(stdout, "%s: [ OPTIONS ]\n", progname);
+    fprintf(stdout, "\t-h, --help        this message\n");
+    fprintf(stdout, "\t-v, --version     output version information\n");
+    fprintf(stdout, "\t-c, --cpu         cpu to run on (default: 0)\n");
+    fprintf(stdout, "\t-l, --level       measure only that cache level (default: all)\n");
+    fprintf(stdout, "\t-n, --iterations  raw accesses timed by the kernel (default: 1024)\n");
+    fprintf(stdout, "\t-r, --repeat      dumps (and ioctls x 1000) timed from userspace,\n");
+    fprintf(stdout, "\t                    the best run is reported (default: 5)\n");
+    fprintf(stdout, "\t-o, --output      write results to a file (default: stdout)\n");
+}
+
+static uint64_t ramindex_bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static double ramindex_bench_div(uint64_t a, uint64_t b)
+{
+    return b ? (double)a / b : 0.0;
+}
+
+static void ramindex_bench_ioctl(int fd, int repeat, FILE *stream)
+{
+    int n, i;
+    uint64_t start, elapsed, best = UINT64_MAX;
+    struct ramindex_version version;
+
+    for (n = 0; n < repeat; n++) {
+        start = ramindex_bench_now();
+        for (i = 0; i < 1000; i++)
+            if (ioctl(fd, RAMINDEX_VERSION, &version) < 0) {
+                fprintf(stderr, "ioctl(RAMINDEX_VERSION) failed with code %d : %s\n",
+                    errno, strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+        elapsed = ramindex_bench_now() - start;
+        if (elapsed < best)
+            best = elapsed;
+    }
+
+    fprintf(stream, "  \"ioctl_ns\": %.3f,\n", ramindex_bench_div(best, 1000));
+}
+
+/* returns the best time of dumping the whole cache from userspace, 0 if not supported */
+static uint64_t ramindex_bench_dump(int fd, const struct ramindex_ccsidr *ccsidr,
+    enum ramindex_bench_mode mode, int repeat, int cpu)
+{
+    int n, status;
+    uint64_t start, elapsed, best = UINT64_MAX;
+    struct ramindex_snapshot snapshot;
+
+    if (ramindex_snapshot_alloc(&snapshot, ccsidr,
+            mode == BENCH_MODE_DATA ? RAMINDEX_SNAPSHOT_F_DATA : 0) < 0) {
+        fprintf(stderr, "Cannot allocate snapshot of %d lines\n",
+            ccsidr->nsets * ccsidr->nways);
+        exit(EXIT_FAILURE);
+    }
+    snapshot.cpu = cpu;
+
+    for (n = 0; n < repeat; n++) {
+        snapshot.nlines = 0;
+        start = ramindex_bench_now();
+        if (mode == BENCH_MODE_QUIET)
+            status = ramindex_snapshot_capture_quiet(fd, -1, 0, -1, 0, &snapshot, NULL);
+        else
+            status = ramindex_snapshot_capture(fd, -1, 0, -1, &snapshot);
+        elapsed = ramindex_bench_now() - start;
+        if (status < 0) {
+            if (errno == EOPNOTSUPP)
+                break;
+            fprintf(stderr, "ioctl(RAMINDEX_DUMP) failed with code %d : %s\n",
+                errno, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        if (elapsed < best)
+            best = elapsed;
+    }
+
+    ramindex_snapshot_free(&snapshot);
+
+    return best == UINT64_MAX ? 0 : best;
+}
+
+/* returns 1 if results have been written, 0 if the cache is not supported */
+static int ramindex_bench_cache(int fd, int level, int icache, enum ramindex_bench_mode mode,
+    uint32_t iterations, int repeat, int cpu, int first, FILE *stream)
+{
+    uint64_t dump_ns;
+    struct ramindex_ccsidr ccsidr;
+    struct ramindex_bench bench;
+
+    memset(&ccsidr, 0, sizeof(ccsidr));
+    ccsidr.level = level;
+    ccsidr.icache = icache;
+    if (ioctl(fd, RAMINDEX_CCSIDR, &ccsidr) < 0) {
+        fprintf(stderr, "ioctl(RAMINDEX_CCSIDR) failed with code %d : %s\n",
+            errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    /* low perturbation captures read only tags, so the kernel side is the same as of 'tags' */
+    memset(&bench, 0, sizeof(bench));
+    bench.level = level;
+    bench.icache = icache;
+    bench.iterations = iterations;
+    bench.flags = mode == BENCH_MODE_DATA ? 0 : RAMINDEX_DUMP_F_TAGS_ONLY;
+    if (ioctl(fd, RAMINDEX_BENCH, &bench) < 0) {
+        if (errno == EOPNOTSUPP)
+            return 0;
+        fprintf(stderr, "ioctl(RAMINDEX_BENCH) failed with code %d : %s\n",
+            errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    dump_ns = ramindex_bench_dump(fd, &ccsidr, mode, repeat, cpu);
+
+    fprintf(stream, "%s    {\n", first ? "" : ",\n");
+    fprintf(stream, "      \"level\": %d,\n", level + 1);
+    fprintf(stream, "      \"type\": \"%s\",\n", icache ? "instruction" : "data");
+    fprintf(stream, "      \"mode\": \"%s\",\n", ramindex_bench_mode_names[mode]);
+    fprintf(stream, "      \"sets\": %d,\n", ccsidr.nsets);
+    fprintf(stream, "      \"ways\": %d,\n", ccsidr.nways);
+    fprintf(stream, "      \"linesize\": %d,\n", ccsidr.linesize);
+    fprintf(stream, "      \"backend\": \"%.*s\",\n", (int)sizeof(bench.backend), bench.backend);
+    fprintf(stream, "      \"cpu\": %d,\n", bench.cpu);
+    fprintf(stream, "      \"access_ns\": %.3f,\n",
+        ramindex_bench_div(bench.access_ns, bench.iterations));
+    fprintf(stream, "      \"access_cycles\": %.3f,\n",
+        ramindex_bench_div(bench.access_cycles, bench.iterations));
+    fprintf(stream, "      \"kernel_line_ns\": %.3f,\n",
+        ramindex_bench_div(bench.lines_ns, bench.nlines));
+    fprintf(stream, "      \"kernel_line_cycles\": %.3f,\n",
+        ramindex_bench_div(bench.lines_cycles, bench.nlines));
+    fprintf(stream, "      \"kernel_lines_per_sec\": %.0f,\n",
+        ramindex_bench_div(bench.nlines * 1000000000ULL, bench.lines_ns));
+    fprintf(stream, "      \"dump_lines_per_sec\": %.0f\n",
+        ramindex_bench_div((uint64_t)ccsidr.nsets * ccsidr.nways * 1000000000ULL, dump_ns));
+    fprintf(stream, "    }");
+
+    return 1;
+}
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int main(int argc, char *argv[])
+{
+    int c;
+    int fd;
+    int level, icache, mode, first = 1;
+    FILE *stream = stdout;
+    struct utsname uts;
+    struct ramindex_version version;
+    struct ramindex_clid clid;
+    // cmdline options
+    int cpu = 0;
+    int selected_level = 0;
+    uint32_t iterations = 0;
+    int repeat = 5;
+    const char *filename = NULL;
+
+    static struct option long_options[] = {
+        {"help",       no_argument,       0, 'h'},
+        {"version",    no_argument,       0, 'v'},
+        {"cpu",        required_argument, 0, 'c'},
+        {"level",      required_argument, 0, 'l'},
+        {"iterations", required_argument, 0, 'n'},
+        {"repeat",     required_argument, 0, 'r'},
+        {"output",     required_argument, 0, 'o'},
+        {0, 0, 0, 0}
+    };
+
+    for (;;) {
+        c = getopt_long(argc, argv, "hvc:l:n:r:o:", long_options, 0);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'h':
+                ramindex_bench_print_usage(argv[0]);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'v':
+                fprintf(stdout, "%s (this program) version: %s\n", argv[0], PROJECT_VER);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'c':
+                cpu = atoi(optarg);
+                break;
+
+            case 'l':
+                selected_level = atoi(optarg);
+                break;
+
+            case 'n':
+                iterations = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'r':
+                repeat = atoi(optarg);
+                break;
+
+            case 'o':
+                filename = optarg;
+                break;
+
+            default:
+                ramindex_bench_print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (optind < argc || repeat < 1 || selected_level < 0 ||
+        selected_level > (int)ARRAY_SIZE(clid.ctype)) {
+        ramindex_bench_print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (ramindex_bind_cpu(cpu) < 0) {
+        fprintf(stderr, "Cannot bind to cpu %d: %s\n", cpu, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    fd = open(RAMINDEX_DEVICENAME, O_RDWR);
+    if (fd == -1) {
+        fprintf(stderr, "Cannot open '%s': %s\n",
+            RAMINDEX_DEVICENAME, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    memset(&version, 0, sizeof(version));
+    if (ioctl(fd, RAMINDEX_VERSION, &version) < 0 || ioctl(fd, RAMINDEX_CLID, &clid) < 0) {
+        fprintf(stderr, "ioctl(RAMINDEX_VERSION/RAMINDEX_CLID) failed with code %d : %s\n",
+            errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    if (filename) {
+        stream = fopen(filename, "w");
+        if (stream == NULL) {
+            fprintf(stderr, "Cannot open '%s': %s\n", filename, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    uname(&uts);
+
+    fprintf(stream, "{\n");
+    fprintf(stream, "  \"tool\": \"%s\",\n", PROJECT_VER);
+    fprintf(stream, "  \"driver\": \"%d.%d.%d\",\n", version.major, version.minor, version.micro);
+    fprintf(stream, "  \"kernel\": \"%s\",\n", uts.release);
+    fprintf(stream, "  \"machine\": \"%s\",\n", uts.machine);
+    ramindex_bench_ioctl(fd, repeat, stream);
+    fprintf(stream, "  \"caches\": [\n");
+
+    for (level = 0; level < (int)ARRAY_SIZE(clid.ctype); level++) {
+        if (clid.ctype[level] == CTYPE_NO_CACHE)
+            break;
+        if (selected_level && selected_level != level + 1)
+            continue;
+        for (icache = 0; icache < 2; icache++) {
+            if (icache && clid.ctype[level] != CTYPE_SEPARATE_I_AND_D_CACHES)
+                continue;
+            for (mode = 0; mode < BENCH_MODE_NR; mode++)
+                if (ramindex_bench_cache(fd, level, icache, mode, iterations, repeat,
+                        cpu, first, stream))
+                    first = 0;
+        }
+    }
+
+    fprintf(stream, "\n  ]\n}\n");
+
+    if (filename)
+        fclose(stream);
+    close(fd);
+
+    return 0;
+}
@@ -0,0 +1,381 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-churn-tool.c
+ *
+ * Estimates cache churn and eviction rates from successive tag snapshots.
+ *
+ * Snapshots are grouped into streams (cpu and cache) and every snapshot is
+ * compared with the previous one of its stream. Lines inserted, evicted and
+ * retained are reported per pair, along with the eviction rate given by
+ * the time between the snapshots. Eviction rates of a cache turned over many
+ * times a second (or sets standing out in the per set summary) tell a core
+ * thrashing its L1 D$ or L2 without any PMU access.
+ *
+ *     $ sudo ramindex-collect -l 1 -c 2 -n 1000 -o l1.snapshot
+ *     $ ramindex-churn l1.snapshot
+ *
+ * Snapshots carrying PMU counts (ramindex -P) also tell how many events
+ * were counted between them, so the churn seen by tags can be set against
+ * the refills the cache really took.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include <version.h>
+#include "ramindex-snapshot.h"
+#include "ramindex-churn.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local types definitions
+\*===========================================================================*/
+
+/**
+ * struct ramindex_churn_stream - snapshots of one cache of one cpu
+ * @cpu:	cpu the snapshots have been taken on
+ * @tags:	keys of the previous and of the current snapshot
+ * @current:	index of the current snapshot's keys in @tags
+ * @nsnapshots:	number of snapshots of the stream
+ * @total:	churn summed over all the pairs
+ * @elapsed:	time between the first and the last snapshot [ns]
+ * @set_evicted: evictions of every set summed over all the pairs
+ * @pmu_valid:	events counted by the previous snapshot
+ * @pmu_after:	counters of the previous snapshot right after its dump
+ * @pmu_counted: events counted between the snapshots of every pair
+ * @pmu_total:	events counted between the snapshots summed over all the pairs
+ */
+struct ramindex_churn_stream {
+    int32_t cpu;
+    struct ramindex_churn_tags tags[2];
+    int current;
+    uint64_t nsnapshots;
+    struct ramindex_churn total;
+    uint64_t elapsed;
+    uint64_t *set_evicted;
+    uint32_t pmu_valid;
+    uint64_t pmu_after[RAMINDEX_PMU_EVENTS_MAX];
+    uint32_t pmu_counted;
+    uint64_t pmu_total[RAMINDEX_PMU_EVENTS_MAX];
+};
+
+/*===========================================================================*\
+ * local (internal linkage) objects definitions
+\*===========================================================================*/
+static struct ramindex_churn_stream *ramindex_churn_streams;
+static size_t ramindex_churn_nstreams;
+
+/*===========================================================================*\
+ * global (external linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) functions definitions
+\*===========================================================================*/
+static void ramindex_churn_print_usage(const char* progname)
+{
+    fprintf(stdout, "%s: [ OPTIONS ] SNAPSHOT...\n", progname);
+    fprintf(stdout, "\t-h, --help      this message\n");
+    fprintf(stdout, "\t-v, --version   output version information\n");
+    fprintf(stdout, "\t-d, --interval  time between successive snapshots [ns]\n");
+    fprintf(stdout, "\t                  (default: 0, taken from timestamps of the snapshots)\n");
+    fprintf(stdout, "\t-n, --sets      number of sets with most evictions listed per stream\n");
+    fprintf(stdout, "\t                  (default: 8)\n");
+    fprintf(stdout, "\t-q, --quiet     print only the summary of every stream\n");
+}
+
+static struct ramindex_churn_stream *ramindex_churn_stream(const struct ramindex_snapshot *snapshot)
+{
+    size_t n;
+    struct ramindex_churn_stream *streams, *s;
+
+    for (n = 0; n < ramindex_churn_nstreams; n++) {
+        s = &ramindex_churn_streams[n];
+        if (s->cpu == snapshot->cpu &&
+            s->tags[0].ccsidr.level == snapshot->ccsidr.level &&
+            s->tags[0].ccsidr.icache == snapshot->ccsidr.icache)
+            return s;
+    }
+
+    streams = realloc(ramindex_churn_streams, (ramindex_churn_nstreams + 1) * sizeof(*streams));
+    if (streams == NULL)
+        return NULL;
+    ramindex_churn_streams = streams;
+
+    s = &streams[ramindex_churn_nstreams];
+    memset(s, 0, sizeof(*s));
+    s->cpu = snapshot->cpu;
+    s->pmu_counted = RAMINDEX_PMU_ALL;
+    s->set_evicted = calloc(snapshot->ccsidr.nsets, sizeof(*s->set_evicted));
+    if (s->set_evicted == NULL ||
+        ramindex_churn_tags_alloc(&s->tags[0], &snapshot->ccsidr) < 0 ||
+        ramindex_churn_tags_alloc(&s->tags[1], &snapshot->ccsidr) < 0)
+        return NULL;
+    ramindex_churn_nstreams++;
+
+    return s;
+}
+
+/* events counted between the previous snapshot of the stream and this one */
+static uint32_t ramindex_churn_pmu(struct ramindex_churn_stream *s,
+    const struct ramindex_snapshot *snapshot, uint64_t *between)
+{
+    uint32_t counted = s->pmu_valid & snapshot->pmu_valid;
+    int n;
+
+    for (n = 0; n < RAMINDEX_PMU_NR; n++) {
+        between[n] = 0;
+        /* counters going back have been recreated (e.g. the module reloaded) */
+        if (snapshot->pmu_before[n] < s->pmu_after[n])
+            counted &= ~(1u << n);
+        if (counted & (1u << n))
+            between[n] = snapshot->pmu_before[n] - s->pmu_after[n];
+    }
+
+    s->pmu_valid = snapshot->pmu_valid;
+    for (n = 0; n < RAMINDEX_PMU_NR; n++)
+        s->pmu_after[n] = snapshot->pmu_before[n] + snapshot->pmu_delta[n];
+
+    return counted;
+}
+
+static void ramindex_churn_print_pmu(const char *prefix, uint32_t counted,
+    const uint64_t *counts, uint64_t elapsed)
+{
+    int n;
+
+    if (counted == 0)
+        return;
+
+    fprintf(stdout, "%s", prefix);
+    for (n = 0; n < RAMINDEX_PMU_NR; n++) {
+        if (!(counted & (1u << n)))
+            continue;
+        fprintf(stdout, " %s %llu", ramindex_pmu_event_name(n), (unsigned long long)counts[n]);
+        if (elapsed)
+            fprintf(stdout, " (%.0f/s)", counts[n] * 1e9 / elapsed);
+    }
+    fprintf(stdout, "\n");
+}
+
+static int ramindex_churn_add(const struct ramindex_snapshot *snapshot, uint64_t interval, int quiet)
+{
+    struct ramindex_churn_stream *s;
+    struct ramindex_churn_tags *before, *after;
+    struct ramindex_churn churn;
+    uint64_t elapsed;
+    uint64_t between[RAMINDEX_PMU_EVENTS_MAX];
+    uint32_t nlines, counted;
+    int n;
+
+    s = ramindex_churn_stream(snapshot);
+    if (s == NULL)
+        return -1;
+
+    after = &s->tags[s->current ^ 1];
+    if (ramindex_churn_tags_fill(after, snapshot) < 0)
+        return -1;
+    s->current ^= 1;
+    s->nsnapshots++;
+    counted = ramindex_churn_pmu(s, snapshot, between);
+    if (s->nsnapshots == 1)
+        return 0;
+
+    s->pmu_counted &= counted;
+    for (n = 0; n < RAMINDEX_PMU_NR; n++)
+        s->pmu_total[n] += between[n];
+
+    before = &s->tags[s->current ^ 1];
+    ramindex_churn_compare(before, after, &churn, s->set_evicted);
+    s->total.retained += churn.retained;
+    s->total.inserted += churn.inserted;
+    s->total.evicted += churn.evicted;
+
+    /* snapshots out of order (e.g. of files given in the wrong order) tell no rate */
+    elapsed = interval ? interval :
+        after->timestamp > before->timestamp ? after->timestamp - before->timestamp : 0;
+    s->elapsed += elapsed;
+
+    if (!quiet) {
+        nlines = after->ccsidr.nsets * after->ccsidr.nways;
+        fprintf(stdout, "%16llu %4d  L%d%c  %12.1f %8llu %8llu %8llu  %7.2f%% %14.0f\n",
+            (unsigned long long)after->timestamp, s->cpu,
+            after->ccsidr.level + 1, after->ccsidr.icache ? 'i' : 'd',
+            elapsed / 1e3, (unsigned long long)churn.retained,
+            (unsigned long long)churn.inserted, (unsigned long long)churn.evicted,
+            churn.evicted * 100.0 / nlines, elapsed ? churn.evicted * 1e9 / elapsed : 0.0);
+        ramindex_churn_print_pmu("                  pmu:", counted, between, 0);
+    }
+
+    return 0;
+}
+
+static void ramindex_churn_print_summary(const struct ramindex_churn_stream *s, int nsets)
+{
+    const struct ramindex_ccsidr *ccsidr = &s->tags[0].ccsidr;
+    uint32_t nlines = ccsidr->nsets * ccsidr->nways;
+    uint64_t npairs = s->nsnapshots - 1;
+    double rate = s->elapsed ? s->total.evicted * 1e9 / s->elapsed : 0.0;
+    uint64_t listed = UINT64_MAX;
+    int32_t n, set, selected, last = -1;
+    int refill;
+
+    fprintf(stdout, "cpu %d, L%d%c (%dx%dx%d): %llu snapshots over %.3f ms\n",
+        s->cpu, ccsidr->level + 1, ccsidr->icache ? 'i' : 'd',
+        ccsidr->nsets, ccsidr->nways, ccsidr->linesize,
+        (unsigned long long)s->nsnapshots, s->elapsed / 1e6);
+
+    if (npairs == 0)
+        return;
+
+    fprintf(stdout, "  per pair: retained %.1f, inserted %.1f, evicted %.1f (%.2f%% of the lines)\n",
+        (double)s->total.retained / npairs, (double)s->total.inserted / npairs,
+        (double)s->total.evicted / npairs, s->total.evicted * 100.0 / npairs / nlines);
+    fprintf(stdout, "  eviction rate: %.0f lines/s (the cache turned over %.1f times/s)\n",
+        rate, rate / nlines);
+
+    /* refills the cache took against the evictions its tags tell about */
+    ramindex_churn_print_pmu("  between the snapshots:", s->pmu_counted, s->pmu_total, s->elapsed);
+    refill = ccsidr->level > 0 ? RAMINDEX_PMU_L2D_REFILL :
+        ccsidr->icache ? RAMINDEX_PMU_L1I_REFILL : RAMINDEX_PMU_L1D_REFILL;
+    if (ccsidr->level < 2 && (s->pmu_counted & (1u << refill)) && s->total.evicted)
+        fprintf(stdout, "  %s per eviction seen: %.2f (lines evicted and brought back"
+            " between the snapshots are not seen)\n", ramindex_pmu_event_name(refill),
+            (double)s->pmu_total[refill] / s->total.evicted);
+
+    /* sets with most evictions, ties listed by set index */
+    for (n = 0; n < nsets && n < ccsidr->nsets; n++) {
+        selected = -1;
+        for (set = 0; set < ccsidr->nsets; set++) {
+            if (s->set_evicted[set] > listed || (s->set_evicted[set] == listed && set <= last))
+                continue;
+            if (selected < 0 || s->set_evicted[set] > s->set_evicted[selected])
+                selected = set;
+        }
+        if (selected < 0 || s->set_evicted[selected] == 0)
+            break;
+
+        fprintf(stdout, "  set %5d: %8llu evictions (%.2f per pair, %.1f ways)\n", selected,
+            (unsigned long long)s->set_evicted[selected],
+            (double)s->set_evicted[selected] / npairs,
+            (double)s->set_evicted[selected] / npairs / ccsidr->nways);
+        listed = s->set_evicted[selected];
+        last = selected;
+    }
+}
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int main(int argc, char *argv[])
+{
+    int c, n, status;
+    size_t i;
+    FILE *input;
+    struct ramindex_snapshot snapshot;
+    // cmdline options
+    uint64_t interval = 0;
+    int nsets = 8;
+    int quiet = 0;
+
+    static struct option long_options[] = {
+        {"help",     no_argument,       0, 'h'},
+        {"version",  no_argument,       0, 'v'},
+        {"interval", required_argument, 0, 'd'},
+        {"sets",     required_argument, 0, 'n'},
+        {"quiet",    no_argument,       0, 'q'},
+        {0, 0, 0, 0}
+    };
+
+    for (;;) {
+        c = getopt_long(argc, argv, "hvd:n:q", long_options, 0);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'h':
+                ramindex_churn_print_usage(argv[0]);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'v':
+                fprintf(stdout, "%s (this program) version: %s\n", argv[0], PROJECT_VER);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'd':
+                interval = strtoull(optarg, NULL, 0);
+                break;
+
+            case 'n':
+                nsets = atoi(optarg);
+                break;
+
+            case 'q':
+                quiet = 1;
+                break;
+
+            default:
+                ramindex_churn_print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (optind >= argc) {
+        ramindex_churn_print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (!quiet)
+        fprintf(stdout, "       TIMESTAMP  CPU  CACHE  INTERVAL[us] RETAINED INSERTED  EVICTED  TURNOVER    EVICTIONS/s\n");
+
+    for (n = optind; n < argc; n++) {
+        input = fopen(argv[n], "rb");
+        if (input == NULL) {
+            fprintf(stderr, "Cannot open '%s': %s\n", argv[n], strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        while ((status = ramindex_snapshot_read(input, &snapshot)) > 0) {
+            status = ramindex_churn_add(&snapshot, interval, quiet);
+            ramindex_snapshot_free(&snapshot);
+            if (status < 0) {
+                fprintf(stderr, "Cannot compare snapshot from '%s': %s\n", argv[n], strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+        }
+        if (status < 0) {
+            fprintf(stderr, "Cannot read snapshot from '%s': %s\n", argv[n], strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        fclose(input);
+    }
+
+    for (i = 0; i < ramindex_churn_nstreams; i++) {
+        ramindex_churn_print_summary(&ramindex_churn_streams[i], nsets);
+        ramindex_churn_tags_free(&ramindex_churn_streams[i].tags[0]);
+        ramindex_churn_tags_free(&ramindex_churn_streams[i].tags[1]);
+        free(ramindex_churn_streams[i].set_evicted);
+    }
+    free(ramindex_churn_streams);
+
+    return 0;
+}
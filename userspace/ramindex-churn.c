@@ -0,0 +1,175 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-churn.c
+ *
+ * Churn of a cache between successive tag snapshots of it.
+ *
+ * Keys are bucketed by set with a counting sort and every bucket (at most
+ * nways keys) is sorted by insertion, both linear in the number of lines
+ * for a given associativity. The merge of two buckets is branchless - both
+ * cursors advance by comparison results - as whether a line is retained
+ * or not is exactly what a branch predictor cannot guess.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "ramindex-churn.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local types definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global (external linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) functions definitions
+\*===========================================================================*/
+static void ramindex_churn_sort(uint64_t *keys, uint32_t n)
+{
+    uint32_t i, j;
+    uint64_t key;
+
+    for (i = 1; i < n; i++) {
+        key = keys[i];
+        for (j = i; j > 0 && keys[j - 1] > key; j--)
+            keys[j] = keys[j - 1];
+        keys[j] = key;
+    }
+}
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int ramindex_churn_tags_alloc(struct ramindex_churn_tags *tags, const struct ramindex_ccsidr *ccsidr)
+{
+    memset(tags, 0, sizeof(*tags));
+
+    if (ccsidr->nsets <= 0 || ccsidr->nways <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    tags->ccsidr = *ccsidr;
+
+    /* two extra counters let the counting sort leave @offsets in place */
+    tags->offsets = calloc(ccsidr->nsets + 2, sizeof(*tags->offsets));
+    tags->keys = calloc((size_t)ccsidr->nsets * ccsidr->nways, sizeof(*tags->keys));
+    if (tags->offsets == NULL || tags->keys == NULL) {
+        ramindex_churn_tags_free(tags);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    return 0;
+}
+
+void ramindex_churn_tags_free(struct ramindex_churn_tags *tags)
+{
+    free(tags->offsets);
+    free(tags->keys);
+    tags->offsets = NULL;
+    tags->keys = NULL;
+}
+
+int ramindex_churn_tags_fill(struct ramindex_churn_tags *tags, const struct ramindex_snapshot *snapshot)
+{
+    uint32_t n, s;
+    uint32_t nsets = tags->ccsidr.nsets;
+    uint32_t *offsets = tags->offsets;
+
+    if (snapshot->ccsidr.level != tags->ccsidr.level ||
+        snapshot->ccsidr.icache != tags->ccsidr.icache ||
+        snapshot->ccsidr.nsets != tags->ccsidr.nsets ||
+        snapshot->ccsidr.nways != tags->ccsidr.nways ||
+        snapshot->nlines > nsets * tags->ccsidr.nways) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(offsets, 0, (nsets + 2) * sizeof(*offsets));
+    for (n = 0; n < snapshot->nlines; n++) {
+        const struct ramindex_cacheline *l = &snapshot->lines[n];
+
+        if ((uint32_t)l->set >= nsets) {
+            errno = EINVAL;
+            return -1;
+        }
+        offsets[l->set + 2] += !!l->valid;
+    }
+
+    for (s = 2; s < nsets + 2; s++)
+        offsets[s] += offsets[s - 1];
+
+    /* offsets[s + 1] is where the next key of set s goes, and ends up where set s + 1 starts */
+    for (n = 0; n < snapshot->nlines; n++) {
+        const struct ramindex_cacheline *l = &snapshot->lines[n];
+
+        if (l->valid)
+            tags->keys[offsets[l->set + 1]++] = l->tag | (l->ns & 1);
+    }
+
+    for (s = 0; s < nsets; s++)
+        ramindex_churn_sort(&tags->keys[offsets[s]], offsets[s + 1] - offsets[s]);
+
+    tags->nkeys = offsets[nsets];
+    tags->timestamp = snapshot->timestamp;
+
+    return 0;
+}
+
+void ramindex_churn_compare(const struct ramindex_churn_tags *before,
+    const struct ramindex_churn_tags *after, struct ramindex_churn *churn, uint64_t *set_evicted)
+{
+    uint32_t s, i, j, iend, jend;
+    uint32_t nsets = before->ccsidr.nsets;
+    uint64_t retained = 0, retained_set;
+    uint64_t a, b;
+
+    for (s = 0; s < nsets; s++) {
+        i = before->offsets[s];
+        iend = before->offsets[s + 1];
+        j = after->offsets[s];
+        jend = after->offsets[s + 1];
+        retained_set = 0;
+
+        while (i < iend && j < jend) {
+            a = before->keys[i];
+            b = after->keys[j];
+            retained_set += a == b;
+            i += a <= b;
+            j += b <= a;
+        }
+
+        retained += retained_set;
+        if (set_evicted)
+            set_evicted[s] += before->offsets[s + 1] - before->offsets[s] - retained_set;
+    }
+
+    churn->retained = retained;
+    churn->inserted = after->nkeys - retained;
+    churn->evicted = before->nkeys - retained;
+}
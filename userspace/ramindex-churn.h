@@ -0,0 +1,99 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-churn.h
+ *
+ * Churn of a cache between successive tag snapshots of it.
+ *
+ * Valid lines of a snapshot are turned into keys (tag and non-secure bit)
+ * sorted within their sets, so that two snapshots are compared by one merge
+ * of the key arrays, set after set, in time linear in the number of lines.
+ * Lines of the later snapshot missing from the earlier one have been
+ * inserted, lines of the earlier one missing from the later one have been
+ * evicted. A line evicted and brought back between the snapshots is not
+ * seen, so the counts are lower bounds, the closer the snapshots the tighter.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+#ifndef _RAMINDEX_CHURN_H_
+#define _RAMINDEX_CHURN_H_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <stdint.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "ramindex-snapshot.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global types definitions
+\*===========================================================================*/
+
+/**
+ * struct ramindex_churn_tags - valid lines of a snapshot, sorted
+ * @ccsidr:	geometry of the cache the snapshot has been taken of
+ * @timestamp:	@timestamp of the snapshot
+ * @nkeys:	number of valid lines
+ * @offsets:	keys of set s are @keys[@offsets[s]] till @keys[@offsets[s + 1] - 1]
+ * @keys:	tags of the valid lines (with the non-secure bit in bit 0),
+ *		ascending within every set
+ */
+struct ramindex_churn_tags {
+    struct ramindex_ccsidr ccsidr;
+    uint64_t timestamp;
+    uint32_t nkeys;
+    uint32_t *offsets;
+    uint64_t *keys;
+};
+
+/**
+ * struct ramindex_churn - how the cache changed between two snapshots
+ * @retained:	number of lines held by both snapshots
+ * @inserted:	number of lines held by the later snapshot only
+ * @evicted:	number of lines held by the earlier snapshot only
+ */
+struct ramindex_churn {
+    uint64_t retained;
+    uint64_t inserted;
+    uint64_t evicted;
+};
+
+/*===========================================================================*\
+ * global (external linkage) functions declarations
+\*===========================================================================*/
+
+/**
+ * Allocates key arrays for snapshots of a cache of the given geometry.
+ *
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int ramindex_churn_tags_alloc(struct ramindex_churn_tags *tags, const struct ramindex_ccsidr *ccsidr);
+
+/**
+ * Releases key arrays.
+ */
+void ramindex_churn_tags_free(struct ramindex_churn_tags *tags);
+
+/**
+ * Turns valid lines of a snapshot of the cache tags have been allocated for
+ * into sorted keys. Lines may come in any order (e.g. dumped in chunks).
+ *
+ * @return 0 on success, -1 if the snapshot is of another cache (errno is set)
+ */
+int ramindex_churn_tags_fill(struct ramindex_churn_tags *tags, const struct ramindex_snapshot *snapshot);
+
+/**
+ * Compares keys of two snapshots of the same cache. Evictions of every set
+ * are added to set_evicted (an array of nsets counters) unless it is NULL.
+ */
+void ramindex_churn_compare(const struct ramindex_churn_tags *before,
+    const struct ramindex_churn_tags *after, struct ramindex_churn *churn, uint64_t *set_evicted);
+
+#endif /* _RAMINDEX_CHURN_H_ */
@@ -0,0 +1,403 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-collect.c
+ *
+ * Single threaded collector of cache dumps of many cpus.
+ *
+ * Dumps are submitted asynchronously (RAMINDEX_ASYNC_SUBMIT) to kernel
+ * workers of every selected cpu, completions are waited for with poll()
+ * on the device (or on an eventfd) and reaped as they come, and a new
+ * dump is submitted right away, so that every cpu keeps dumping its cache
+ * while one thread collects (and optionally writes) the snapshots.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <poll.h>
+#include <sched.h>
+#include <time.h>
+
+#include <sys/ioctl.h>
+#include <sys/eventfd.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include <version.h>
+#include "ramindex-snapshot.h"
+#include "ramindex-async.h"
+#include "ramindex-archive.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define RAMINDEX_DEVICENAME "/dev/ramindex"
+
+#define MAX_CPUS 1024
+
+/*===========================================================================*\
+ * local types definitions
+\*===========================================================================*/
+struct ramindex_collect_cpu {
+    int cpu;
+    uint32_t submitted;
+    uint32_t completed;
+    uint32_t failed;
+    uint64_t busy_ns;       /* sum of durations of the completed dumps */
+};
+
+/*===========================================================================*\
+ * local (internal linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global (external linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) functions definitions
+\*===========================================================================*/
+static void ramindex_collect_print_usage(const char* progname)
+{
+    fprintf(stdout, "%s: [ OPTIONS ]\n", progname);
+    fprintf(stdout, "\t-h, --help      this message\n");
+    fprintf(stdout, "\t-v, --version   output version information\n");
+    fprintf(stdout, "\t-l, --level     select cache level (default: 1)\n");
+    fprintf(stdout, "\t-t, --type      select cache type (1 for instruction cache,\n");
+    fprintf(stdout, "\t                  0 for data and unified caches, default: 0)\n");
+    fprintf(stdout, "\t-c, --cpus      list of cpus, e.g. 0-3,6 (default: all we may run on)\n");
+    fprintf(stdout, "\t-n, --rounds    dumps to be taken on every cpu (default: 10)\n");
+    fprintf(stdout, "\t-d, --depth     dumps kept in flight on every cpu (default: 1)\n");
+    fprintf(stdout, "\t-D, --data      dump content of the lines too (default: only tags)\n");
+    fprintf(stdout, "\t-e, --eventfd   wait for completions on an eventfd instead of the device\n");
+    fprintf(stdout, "\t-o, --output    write snapshots to a file as they are collected\n");
+    fprintf(stdout, "\t-A, --archive   append snapshots to an archive as they are collected\n");
+    fprintf(stdout, "\t-z, --compress  zero-run encode frames of the archive\n");
+}
+
+static uint64_t ramindex_collect_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int ramindex_collect_default_cpus(int *cpus, int max)
+{
+    int cpu, n = 0;
+    cpu_set_t cpuset;
+
+    if (sched_getaffinity(0, sizeof(cpuset), &cpuset) < 0)
+        return -1;
+
+    for (cpu = 0; cpu < CPU_SETSIZE && n < max; cpu++)
+        if (CPU_ISSET(cpu, &cpuset))
+            cpus[n++] = cpu;
+
+    return n;
+}
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int main(int argc, char *argv[])
+{
+    int c;
+    int fd, efd = -1;
+    int n, ncpus = 0;
+    uint32_t i, total = 0, remaining;
+    uint64_t start, elapsed, nlines = 0, value;
+    int cpus[MAX_CPUS];
+    FILE *output = NULL;
+    struct pollfd pfd;
+    struct ramindex_ccsidr ccsidr;
+    struct ramindex_async_completion completion;
+    struct ramindex_collect_cpu *stats;
+    struct ramindex_snapshot *snapshots;
+    struct ramindex_archive archive;
+    // cmdline options
+    int level = 1;
+    int type = 0;
+    uint32_t rounds = 10;
+    uint32_t depth = 1;
+    int data = 0;
+    int use_eventfd = 0;
+    const char *filename = NULL;
+    const char *archivename = NULL;
+    int compress = 0;
+
+    static struct option long_options[] = {
+        {"help",    no_argument,       0, 'h'},
+        {"version", no_argument,       0, 'v'},
+        {"level",   required_argument, 0, 'l'},
+        {"type",    required_argument, 0, 't'},
+        {"cpus",    required_argument, 0, 'c'},
+        {"rounds",  required_argument, 0, 'n'},
+        {"depth",   required_argument, 0, 'd'},
+        {"data",    no_argument,       0, 'D'},
+        {"eventfd", no_argument,       0, 'e'},
+        {"output",  required_argument, 0, 'o'},
+        {"archive", required_argument, 0, 'A'},
+        {"compress", no_argument,      0, 'z'},
+        {0, 0, 0, 0}
+    };
+
+    for (;;) {
+        c = getopt_long(argc, argv, "hvl:t:c:n:d:Deo:A:z", long_options, 0);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'h':
+                ramindex_collect_print_usage(argv[0]);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'v':
+                fprintf(stdout, "%s (this program) version: %s\n", argv[0], PROJECT_VER);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'l':
+                level = atoi(optarg);
+                break;
+
+            case 't':
+                type = atoi(optarg);
+                break;
+
+            case 'c':
+                ncpus = ramindex_parse_cpus(optarg, cpus, MAX_CPUS);
+                if (ncpus <= 0) {
+                    fprintf(stderr, "Invalid list of cpus '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'n':
+                rounds = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'd':
+                depth = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'D':
+                data = 1;
+                break;
+
+            case 'e':
+                use_eventfd = 1;
+                break;
+
+            case 'o':
+                filename = optarg;
+                break;
+
+            case 'A':
+                archivename = optarg;
+                break;
+
+            case 'z':
+                compress = 1;
+                break;
+
+            default:
+                ramindex_collect_print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (ncpus == 0)
+        ncpus = ramindex_collect_default_cpus(cpus, MAX_CPUS);
+
+    if (optind < argc || ncpus <= 0 || rounds == 0 || depth == 0 ||
+        depth * ncpus > RAMINDEX_ASYNC_MAX) {
+        fprintf(stderr, "At most %d dumps may be in flight (cpus x depth)\n", RAMINDEX_ASYNC_MAX);
+        ramindex_collect_print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    fd = open(RAMINDEX_DEVICENAME, O_RDWR);
+    if (fd == -1) {
+        fprintf(stderr, "Cannot open '%s': %s\n",
+            RAMINDEX_DEVICENAME, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    if (use_eventfd) {
+        efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (efd < 0) {
+            fprintf(stderr, "Cannot create eventfd: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    memset(&ccsidr, 0, sizeof(ccsidr));
+    ccsidr.level = level - 1;
+    ccsidr.icache = type;
+    if (ioctl(fd, RAMINDEX_CCSIDR, &ccsidr) < 0) {
+        fprintf(stderr, "ioctl(RAMINDEX_CCSIDR) failed with code %d : %s\n",
+            errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    if (filename) {
+        output = fopen(filename, "wb");
+        if (output == NULL) {
+            fprintf(stderr, "Cannot open '%s': %s\n", filename, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (archivename && ramindex_archive_create(&archive, archivename,
+            compress ? RAMINDEX_ARCHIVE_F_COMPRESS : 0) < 0) {
+        fprintf(stderr, "Cannot create '%s': %s\n", archivename, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    /* snapshot n belongs to stats[n / depth], its index is the cookie of its requests */
+    stats = calloc(ncpus, sizeof(*stats));
+    snapshots = calloc((size_t)ncpus * depth, sizeof(*snapshots));
+    if (stats == NULL || snapshots == NULL) {
+        fprintf(stderr, "Cannot allocate snapshots of %d cpus\n", ncpus);
+        exit(EXIT_FAILURE);
+    }
+
+    start = ramindex_collect_now();
+
+    for (i = 0; i < ncpus * depth; i++) {
+        struct ramindex_collect_cpu *s = &stats[i / depth];
+
+        s->cpu = cpus[i / depth];
+        if (ramindex_snapshot_alloc(&snapshots[i], &ccsidr,
+                data ? RAMINDEX_SNAPSHOT_F_DATA : 0) < 0) {
+            fprintf(stderr, "Cannot allocate snapshot of %d lines\n",
+                ccsidr.nsets * ccsidr.nways);
+            exit(EXIT_FAILURE);
+        }
+        snapshots[i].cpu = s->cpu;
+
+        if (s->submitted == rounds)
+            continue;
+        if (ramindex_async_submit(fd, efd, i, &snapshots[i]) < 0) {
+            fprintf(stderr, "ioctl(RAMINDEX_ASYNC_SUBMIT) failed on cpu %d with code %d : %s\n",
+                s->cpu, errno, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        s->submitted++;
+    }
+
+    remaining = 0;
+    for (n = 0; n < ncpus; n++)
+        remaining += stats[n].submitted;
+
+    pfd.fd = use_eventfd ? efd : fd;
+    pfd.events = POLLIN;
+
+    while (remaining > 0) {
+        if (poll(&pfd, 1, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "poll() failed: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        if (use_eventfd && read(efd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+            fprintf(stderr, "Cannot read eventfd: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        while (ramindex_async_reap(fd, &completion) == 0) {
+            struct ramindex_snapshot *snapshot = &snapshots[completion.cookie];
+            struct ramindex_collect_cpu *s = &stats[completion.cookie / depth];
+
+            remaining--;
+
+            if (ramindex_async_complete(snapshot, &completion) < 0) {
+                fprintf(stderr, "Dump on cpu %d failed with code %d : %s\n",
+                    completion.cpu, errno, strerror(errno));
+                s->failed++;
+            } else {
+                s->completed++;
+                s->busy_ns += completion.end_ns - completion.start_ns;
+                nlines += snapshot->nlines;
+                total++;
+
+                if (output && ramindex_snapshot_write(output, snapshot) < 0) {
+                    fprintf(stderr, "Cannot write snapshot to '%s': %s\n",
+                        filename, strerror(errno));
+                    exit(EXIT_FAILURE);
+                }
+
+                if (archivename && ramindex_archive_append(&archive, snapshot) < 0) {
+                    fprintf(stderr, "Cannot append snapshot to '%s': %s\n",
+                        archivename, strerror(errno));
+                    exit(EXIT_FAILURE);
+                }
+            }
+
+            if (s->submitted < rounds) {
+                if (ramindex_async_submit(fd, efd, completion.cookie, snapshot) < 0) {
+                    fprintf(stderr, "ioctl(RAMINDEX_ASYNC_SUBMIT) failed on cpu %d with code %d : %s\n",
+                        s->cpu, errno, strerror(errno));
+                    exit(EXIT_FAILURE);
+                }
+                s->submitted++;
+                remaining++;
+            }
+        }
+
+        if (errno != EAGAIN) {
+            fprintf(stderr, "ioctl(RAMINDEX_ASYNC_REAP) failed with code %d : %s\n",
+                errno, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    elapsed = ramindex_collect_now() - start;
+
+    fprintf(stdout, "CPU  DUMPS  FAILED  AVG DUMP [us]\n");
+    for (n = 0; n < ncpus; n++)
+        fprintf(stdout, "%3d %6u %7u %14.1f\n", stats[n].cpu, stats[n].completed, stats[n].failed,
+            stats[n].completed ? stats[n].busy_ns / 1000.0 / stats[n].completed : 0.0);
+
+    fprintf(stdout, "\nCollected %u dumps (%llu lines) of L%d %s cache in %.3f ms (%.0f lines/s)\n",
+        total, (unsigned long long)nlines, level, type ? "instruction" : "data/unified",
+        elapsed / 1e6, elapsed ? nlines * 1e9 / elapsed : 0.0);
+
+    for (i = 0; i < ncpus * depth; i++)
+        ramindex_snapshot_free(&snapshots[i]);
+    free(snapshots);
+    free(stats);
+    if (output)
+        fclose(output);
+    if (archivename) {
+        fprintf(stdout, "Archived %llu bytes (%llu as snapshots)\n",
+            (unsigned long long)archive.stats.bytes, (unsigned long long)archive.stats.rawbytes);
+        if (ramindex_archive_close(&archive) < 0) {
+            fprintf(stderr, "Cannot close '%s': %s\n", archivename, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (efd >= 0)
+        close(efd);
+    close(fd);
+
+    return 0;
+}
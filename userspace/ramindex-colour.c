@@ -0,0 +1,400 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-colour.c
+ *
+ * Page colour analysis of physically indexed (L2/L3) cache snapshots.
+ *
+ * Set index bits above the page offset define page colours - pages of different
+ * colours never compete for the same cache sets. For every colour the tool reports
+ * how many lines are occupied, how pages and cached lines of selected processes
+ * are spread across colours, and how many colours a workload actually uses.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include <version.h>
+#include "ramindex-snapshot.h"
+#include "ramindex-pagemap.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define MAX_PIDS 64
+
+/*===========================================================================*\
+ * local types definitions
+\*===========================================================================*/
+struct ramindex_colour_process {
+    struct ramindex_pagemap pagemap;
+    uint64_t *pages;  /* resident pages per colour */
+    uint64_t *lines;  /* cached (valid) lines per colour */
+};
+
+struct ramindex_colour_report {
+    struct ramindex_ccsidr ccsidr;
+    uint64_t pagesize;
+    uint32_t ncolours;
+    uint32_t sets_per_colour;
+    uint32_t nsnapshots;
+    uint64_t *valid;  /* valid lines per colour */
+    uint64_t *dirty;  /* dirty lines per colour */
+    size_t nprocesses;
+    struct ramindex_colour_process processes[MAX_PIDS];
+};
+
+/*===========================================================================*\
+ * local (internal linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global (external linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) functions definitions
+\*===========================================================================*/
+static void ramindex_colour_print_usage(const char* progname)
+{
+    fprintf(stdout, "%s: [ OPTIONS ] snapshot...\n", progname);
+    fprintf(stdout, "\t-h, --help      this message\n");
+    fprintf(stdout, "\t-v, --version   output version information\n");
+    fprintf(stdout, "\t-P, --pagesize  page size used for colouring (default: system page size)\n");
+    fprintf(stdout, "\t-p, --pid       attribute lines to that process (may be repeated)\n");
+    fprintf(stdout, "\t-c, --coverage  percentage of lines the recommended colours\n");
+    fprintf(stdout, "\t                  shall hold (default: 90)\n");
+}
+
+static int ramindex_colour_compare(const void *a, const void *b)
+{
+    uint64_t va = *(const uint64_t *)a;
+    uint64_t vb = *(const uint64_t *)b;
+
+    return va < vb ? 1 : va > vb ? -1 : 0;
+}
+
+static void *ramindex_colour_calloc(size_t n, size_t size)
+{
+    void *p = calloc(n, size);
+
+    if (p == NULL) {
+        fprintf(stderr, "calloc(%zu, %zu) failed\n", n, size);
+        exit(EXIT_FAILURE);
+    }
+
+    return p;
+}
+
+static int ramindex_colour_init(struct ramindex_colour_report *report,
+    const struct ramindex_ccsidr *ccsidr, uint64_t pagesize)
+{
+    size_t n;
+
+    report->ccsidr = *ccsidr;
+    report->pagesize = pagesize;
+
+    /* a way smaller than a page leaves no set index bits above page offset */
+    if ((uint64_t)ccsidr->nsets * ccsidr->linesize <= pagesize) {
+        report->ncolours = 1;
+        report->sets_per_colour = ccsidr->nsets;
+    } else {
+        report->sets_per_colour = pagesize / ccsidr->linesize;
+        report->ncolours = ccsidr->nsets / report->sets_per_colour;
+    }
+
+    report->valid = ramindex_colour_calloc(report->ncolours, sizeof(uint64_t));
+    report->dirty = ramindex_colour_calloc(report->ncolours, sizeof(uint64_t));
+
+    for (n = 0; n < report->nprocesses; n++) {
+        struct ramindex_colour_process *p = &report->processes[n];
+        size_t i;
+
+        p->pages = ramindex_colour_calloc(report->ncolours, sizeof(uint64_t));
+        p->lines = ramindex_colour_calloc(report->ncolours, sizeof(uint64_t));
+
+        for (i = 0; i < p->pagemap.npages; i++)
+            p->pages[p->pagemap.pages[i].pfn * p->pagemap.pagesize / pagesize
+                % report->ncolours]++;
+    }
+
+    return 0;
+}
+
+static void ramindex_colour_account(struct ramindex_colour_report *report,
+    const struct ramindex_snapshot *snapshot)
+{
+    uint32_t n;
+    size_t i;
+
+    for (n = 0; n < snapshot->nlines; n++) {
+        const struct ramindex_cacheline *l = &snapshot->lines[n];
+        uint32_t colour = (uint32_t)l->set / report->sets_per_colour;
+
+        if (!l->valid || colour >= report->ncolours)
+            continue;
+
+        report->valid[colour]++;
+        if (l->dirty)
+            report->dirty[colour]++;
+
+        for (i = 0; i < report->nprocesses; i++) {
+            struct ramindex_colour_process *p = &report->processes[i];
+            if (ramindex_pagemap_find(&p->pagemap, l->tag / p->pagemap.pagesize))
+                p->lines[colour]++;
+        }
+    }
+
+    report->nsnapshots++;
+}
+
+/**
+ * Returns number of the most occupied colours which hold
+ * at least 'coverage' percent of all the counted entries.
+ */
+static uint32_t ramindex_colour_needed(const uint64_t *counts, uint32_t ncolours,
+    double coverage)
+{
+    uint64_t *sorted;
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint32_t n;
+
+    for (n = 0; n < ncolours; n++)
+        total += counts[n];
+
+    if (total == 0)
+        return 0;
+
+    sorted = ramindex_colour_calloc(ncolours, sizeof(uint64_t));
+    memcpy(sorted, counts, ncolours * sizeof(uint64_t));
+    qsort(sorted, ncolours, sizeof(uint64_t), ramindex_colour_compare);
+
+    for (n = 0; n < ncolours && sum * 100.0 < coverage * total; n++)
+        sum += sorted[n];
+
+    free(sorted);
+
+    return n;
+}
+
+/**
+ * Returns max/mean ratio of the counts (1.0 means perfectly even spread).
+ */
+static double ramindex_colour_imbalance(const uint64_t *counts, uint32_t ncolours)
+{
+    uint64_t total = 0;
+    uint64_t max = 0;
+    uint32_t n;
+
+    for (n = 0; n < ncolours; n++) {
+        total += counts[n];
+        if (counts[n] > max)
+            max = counts[n];
+    }
+
+    return total ? (double)max * ncolours / total : 0.0;
+}
+
+static uint32_t ramindex_colour_roundup(uint32_t n)
+{
+    uint32_t p = 1;
+
+    while (p < n)
+        p <<= 1;
+
+    return n ? p : 0;
+}
+
+static void ramindex_colour_print(const struct ramindex_colour_report *report,
+    double coverage)
+{
+    uint64_t capacity = (uint64_t)report->sets_per_colour *
+        report->ccsidr.nways * report->nsnapshots;
+    uint64_t total = 0;
+    uint32_t used = 0;
+    uint32_t needed;
+    uint32_t n;
+    size_t i;
+
+    fprintf(stdout, "Cache: L%d (%d sets, %d ways, %d bytes per line), %u snapshot(s)\n",
+        report->ccsidr.level + 1, report->ccsidr.nsets, report->ccsidr.nways,
+        report->ccsidr.linesize, report->nsnapshots);
+    fprintf(stdout, "Page size: %llu, colours: %u (%u sets per colour)\n\n",
+        (unsigned long long)report->pagesize, report->ncolours, report->sets_per_colour);
+
+    fprintf(stdout, "COLOUR    VALID    DIRTY  OCCUPANCY\n");
+    for (n = 0; n < report->ncolours; n++) {
+        fprintf(stdout, "%6u %8llu %8llu %9.1f%%\n", n,
+            (unsigned long long)report->valid[n], (unsigned long long)report->dirty[n],
+            capacity ? 100.0 * report->valid[n] / capacity : 0.0);
+        total += report->valid[n];
+        used += report->valid[n] != 0;
+    }
+
+    needed = ramindex_colour_needed(report->valid, report->ncolours, coverage);
+    fprintf(stdout, "\nAll lines: %llu, colours used: %u/%u, imbalance (max/mean): %.2f\n",
+        (unsigned long long)total, used, report->ncolours,
+        ramindex_colour_imbalance(report->valid, report->ncolours));
+    fprintf(stdout, "Colours holding %.0f%% of lines: %u (recommended partition: %u)\n",
+        coverage, needed, ramindex_colour_roundup(needed));
+
+    for (i = 0; i < report->nprocesses; i++) {
+        const struct ramindex_colour_process *p = &report->processes[i];
+        uint64_t lines = 0;
+
+        for (n = 0; n < report->ncolours; n++)
+            lines += p->lines[n];
+
+        needed = ramindex_colour_needed(p->lines, report->ncolours, coverage);
+        fprintf(stdout, "\nPID %d: %zu resident pages, %llu cached lines\n",
+            (int)p->pagemap.pid, p->pagemap.npages, (unsigned long long)lines);
+        fprintf(stdout, "\tpage imbalance (max/mean): %.2f, line imbalance (max/mean): %.2f\n",
+            ramindex_colour_imbalance(p->pages, report->ncolours),
+            ramindex_colour_imbalance(p->lines, report->ncolours));
+        fprintf(stdout, "\tcolours holding %.0f%% of its lines: %u (recommended partition: %u)\n",
+            coverage, needed, ramindex_colour_roundup(needed));
+        fprintf(stdout, "\tCOLOUR    PAGES    LINES\n");
+        for (n = 0; n < report->ncolours; n++)
+            fprintf(stdout, "\t%6u %8llu %8llu\n", n,
+                (unsigned long long)p->pages[n], (unsigned long long)p->lines[n]);
+    }
+}
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int main(int argc, char *argv[])
+{
+    int c;
+    int i;
+    int status;
+    FILE *stream;
+    size_t n;
+    struct ramindex_snapshot snapshot;
+    struct ramindex_colour_report report;
+    int initialized = 0;
+    // cmdline options
+    uint64_t pagesize = sysconf(_SC_PAGESIZE);
+    double coverage = 90.0;
+
+    static struct option long_options[] = {
+        {"help",     no_argument,       0, 'h'},
+        {"version",  no_argument,       0, 'v'},
+        {"pagesize", required_argument, 0, 'P'},
+        {"pid",      required_argument, 0, 'p'},
+        {"coverage", required_argument, 0, 'c'},
+        {0, 0, 0, 0}
+    };
+
+    memset(&report, 0, sizeof(report));
+
+    for (;;) {
+        c = getopt_long(argc, argv, "hvP:p:c:", long_options, 0);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'h':
+                ramindex_colour_print_usage(argv[0]);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'v':
+                fprintf(stdout, "%s (this program) version: %s\n", argv[0], PROJECT_VER);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'P':
+                pagesize = strtoull(optarg, NULL, 0);
+                break;
+
+            case 'p':
+                if (report.nprocesses == MAX_PIDS) {
+                    fprintf(stderr, "At most %d processes can be selected\n", MAX_PIDS);
+                    exit(EXIT_FAILURE);
+                }
+                status = ramindex_pagemap_read(atoi(optarg), 0, UINT64_MAX,
+                    &report.processes[report.nprocesses].pagemap);
+                if (status < 0) {
+                    fprintf(stderr, "Cannot read pagemap of process %s: %s\n",
+                        optarg, strerror(errno));
+                    exit(EXIT_FAILURE);
+                }
+                report.nprocesses++;
+                break;
+
+            case 'c':
+                coverage = atof(optarg);
+                break;
+
+            default:
+                ramindex_colour_print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (optind >= argc || pagesize == 0 || (pagesize & (pagesize - 1)) ||
+        coverage <= 0.0 || coverage > 100.0) {
+        ramindex_colour_print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    for (i = optind; i < argc; i++) {
+        stream = fopen(argv[i], "rb");
+        if (stream == NULL) {
+            fprintf(stderr, "Cannot open '%s': %s\n", argv[i], strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        while ((status = ramindex_snapshot_read(stream, &snapshot)) > 0) {
+            if (!initialized) {
+                ramindex_colour_init(&report, &snapshot.ccsidr, pagesize);
+                initialized = 1;
+            } else if (memcmp(&report.ccsidr, &snapshot.ccsidr, sizeof(snapshot.ccsidr))) {
+                fprintf(stderr, "'%s' contains snapshot of a different cache\n", argv[i]);
+                exit(EXIT_FAILURE);
+            }
+            ramindex_colour_account(&report, &snapshot);
+            ramindex_snapshot_free(&snapshot);
+        }
+
+        if (status < 0) {
+            fprintf(stderr, "Cannot read snapshot from '%s': %s\n", argv[i], strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        fclose(stream);
+    }
+
+    if (!initialized) {
+        fprintf(stderr, "No snapshots found\n");
+        exit(EXIT_FAILURE);
+    }
+
+    ramindex_colour_print(&report, coverage);
+
+    for (n = 0; n < report.nprocesses; n++) {
+        ramindex_pagemap_free(&report.processes[n].pagemap);
+        free(report.processes[n].pages);
+        free(report.processes[n].lines);
+    }
+    free(report.valid);
+    free(report.dirty);
+
+    return 0;
+}
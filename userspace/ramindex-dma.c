@@ -0,0 +1,543 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-dma.c
+ *
+ * Dirty footprint of DMA buffers in data and unified caches.
+ *
+ * Buffers are given as physical address ranges or as virtual address
+ * ranges of a process (resolved via /proc/<pid>/pagemap). Only the sets
+ * the buffers map to are read, tags only, by RAMINDEX_DUMPV ioctls, so
+ * a buffer much smaller than a cache costs a fraction of a full dump.
+ * Valid lines of every buffer are counted as resident, dirty ones as what
+ * a clean to the point of coherency would have to write back. A buffer
+ * which is mostly not cached when the device accesses it gains nothing
+ * from a cacheable mapping but still pays for the maintenance of all of it.
+ *
+ * Data caches are assumed to be indexed by physical addresses (as Arm
+ * data caches behave).
+ *
+ *     $ sudo ramindex-dma -a 0x880000000-0x880100000 -c 0-3
+ *     $ sudo ramindex-dma -p 1234 -r 7f0000000000-7f0000200000 -l 1,2
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include <sys/ioctl.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include <version.h>
+#include "ramindex-snapshot.h"
+#include "ramindex-pagemap.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define RAMINDEX_DEVICENAME "/dev/ramindex"
+
+#define MAX_CPUS 1024
+#define MAX_LEVELS 7
+#define MAX_BUFFERS 64
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
+
+/*===========================================================================*\
+ * local types definitions
+\*===========================================================================*/
+
+/**
+ * struct ramindex_dma_buffer - buffer given on the command line
+ * @range:	range as given (for reports)
+ * @virtual:	non-zero if @range is of virtual addresses of the process
+ * @start:	first byte of the range
+ * @end:	one past the last byte of the range
+ * @resident:	number of bytes of the range backed by memory
+ */
+struct ramindex_dma_buffer {
+    const char *range;
+    int virtual;
+    uint64_t start;
+    uint64_t end;
+    uint64_t resident;
+};
+
+/**
+ * struct ramindex_dma_extent - physically contiguous part of a buffer
+ * @start:	first physical address
+ * @end:	one past the last physical address
+ * @buffer:	index of the buffer the extent belongs to
+ */
+struct ramindex_dma_extent {
+    uint64_t start;
+    uint64_t end;
+    uint32_t buffer;
+};
+
+/**
+ * struct ramindex_dma - extents of all the buffers, sorted by @start
+ * @nextents:	number of entries of @extents in use
+ * @maxextents:	number of entries of @extents
+ * @extents:	extents of the buffers
+ */
+struct ramindex_dma {
+    size_t nextents;
+    size_t maxextents;
+    struct ramindex_dma_extent *extents;
+};
+
+/*===========================================================================*\
+ * local (internal linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global (external linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) functions definitions
+\*===========================================================================*/
+static void ramindex_dma_print_usage(const char* progname)
+{
+    fprintf(stdout, "%s: [ OPTIONS ] -a START-END ... | -p PID -r START-END ...\n", progname);
+    fprintf(stdout, "\t-h, --help      this message\n");
+    fprintf(stdout, "\t-v, --version   output version information\n");
+    fprintf(stdout, "\t-a, --phys      physical address range of a buffer (hex, may be repeated)\n");
+    fprintf(stdout, "\t-p, --pid       process the virtual address ranges belong to\n");
+    fprintf(stdout, "\t-r, --range     virtual address range of a buffer (hex, may be repeated)\n");
+    fprintf(stdout, "\t-c, --cpus      probe caches of these cpus, e.g. 0-3 (default: 0)\n");
+    fprintf(stdout, "\t-l, --levels    select cache levels, e.g. 1-2 (default: all)\n");
+    fprintf(stdout, "\t(at most %d buffers)\n", MAX_BUFFERS);
+}
+
+static void ramindex_dma_add_extent(struct ramindex_dma *dma, uint64_t start, uint64_t end, uint32_t buffer)
+{
+    struct ramindex_dma_extent *extents;
+
+    /* pages of a buffer often are physically contiguous */
+    if (dma->nextents && dma->extents[dma->nextents - 1].buffer == buffer &&
+        dma->extents[dma->nextents - 1].end == start) {
+        dma->extents[dma->nextents - 1].end = end;
+        return;
+    }
+
+    if (dma->nextents == dma->maxextents) {
+        dma->maxextents = dma->maxextents ? 2 * dma->maxextents : 64;
+        extents = realloc(dma->extents, dma->maxextents * sizeof(*extents));
+        if (extents == NULL) {
+            fprintf(stderr, "Cannot allocate %zu extents\n", dma->maxextents);
+            exit(EXIT_FAILURE);
+        }
+        dma->extents = extents;
+    }
+
+    dma->extents[dma->nextents].start = start;
+    dma->extents[dma->nextents].end = end;
+    dma->extents[dma->nextents].buffer = buffer;
+    dma->nextents++;
+}
+
+/* resident pages of a virtual range become extents, in the order of virtual addresses */
+static void ramindex_dma_add_virtual(struct ramindex_dma *dma, pid_t pid,
+    struct ramindex_dma_buffer *buffer, uint32_t index)
+{
+    struct ramindex_pagemap pagemap;
+    struct ramindex_page *pages;
+    uint64_t from, to;
+    size_t n, i, j;
+
+    if (ramindex_pagemap_read(pid, buffer->start, buffer->end, &pagemap) < 0) {
+        fprintf(stderr, "Cannot read pagemap of process %d: %s\n", (int)pid, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    /* pages come sorted by frames, a buffer is contiguous in virtual addresses */
+    pages = pagemap.pages;
+    for (i = 1; i < pagemap.npages; i++) {
+        struct ramindex_page page = pages[i];
+
+        for (j = i; j > 0 && pages[j - 1].vaddr > page.vaddr; j--)
+            pages[j] = pages[j - 1];
+        pages[j] = page;
+    }
+
+    for (n = 0; n < pagemap.npages; n++) {
+        from = pages[n].vaddr > buffer->start ? pages[n].vaddr : buffer->start;
+        to = pages[n].vaddr + pagemap.pagesize < buffer->end ?
+            pages[n].vaddr + pagemap.pagesize : buffer->end;
+        if (from >= to)
+            continue;
+
+        buffer->resident += to - from;
+        ramindex_dma_add_extent(dma, pages[n].pfn * pagemap.pagesize + from - pages[n].vaddr,
+            pages[n].pfn * pagemap.pagesize + to - pages[n].vaddr, index);
+    }
+
+    ramindex_pagemap_free(&pagemap);
+}
+
+static int ramindex_dma_extent_cmp(const void *a, const void *b)
+{
+    const struct ramindex_dma_extent *ea = a, *eb = b;
+
+    return ea->start < eb->start ? -1 : ea->start > eb->start;
+}
+
+/* extent holding any byte of the line at @paddr, NULL if there is none */
+static const struct ramindex_dma_extent *ramindex_dma_find(const struct ramindex_dma *dma,
+    uint64_t paddr, uint32_t linesize)
+{
+    size_t lo = 0, hi = dma->nextents;
+
+    /* the last extent starting before the end of the line */
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (dma->extents[mid].start < paddr + linesize)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo == 0 || dma->extents[lo - 1].end <= paddr)
+        return NULL;
+
+    return &dma->extents[lo - 1];
+}
+
+/* marks sets the extents map to, returns number of lines of the buffers (by buffer) */
+static uint32_t ramindex_dma_mark_sets(const struct ramindex_dma *dma, const struct ramindex_ccsidr *ccsidr,
+    uint8_t *sets, uint64_t *buffer_lines)
+{
+    uint64_t linesize = ccsidr->linesize;
+    uint64_t addr, nlines;
+    uint32_t nmarked = 0;
+    size_t n;
+    int32_t set;
+
+    memset(sets, 0, ccsidr->nsets);
+
+    for (n = 0; n < dma->nextents; n++) {
+        const struct ramindex_dma_extent *e = &dma->extents[n];
+
+        nlines = (e->end + linesize - 1) / linesize - e->start / linesize;
+        buffer_lines[e->buffer] += nlines;
+
+        /* an extent as big as the cache maps to all its sets */
+        if (nlines > (uint64_t)ccsidr->nsets)
+            nlines = ccsidr->nsets;
+
+        for (addr = e->start & ~(linesize - 1); nlines > 0; addr += linesize, nlines--) {
+            set = (addr / linesize) % ccsidr->nsets;
+            if (!sets[set]) {
+                sets[set] = 1;
+                nmarked++;
+            }
+        }
+    }
+
+    return nmarked;
+}
+
+/* consecutive marked sets make up one entry */
+static uint32_t ramindex_dma_entries(const struct ramindex_ccsidr *ccsidr, const uint8_t *sets,
+    struct ramindex_vec_entry *entries)
+{
+    uint32_t nentries = 0;
+    int32_t set;
+
+    for (set = 0; set < ccsidr->nsets; set++) {
+        if (!sets[set])
+            continue;
+
+        if (nentries && entries[nentries - 1].set + entries[nentries - 1].nsets == set) {
+            entries[nentries - 1].nsets++;
+            continue;
+        }
+
+        memset(&entries[nentries], 0, sizeof(entries[nentries]));
+        entries[nentries].level = ccsidr->level;
+        entries[nentries].icache = 0;
+        entries[nentries].set = set;
+        entries[nentries].nsets = 1;
+        entries[nentries].flags = RAMINDEX_DUMP_F_TAGS_ONLY;
+        nentries++;
+    }
+
+    return nentries;
+}
+
+/* dumps selected sets (at most RAMINDEX_DUMPV_MAX entries a call), returns number of lines read */
+static uint32_t ramindex_dma_dump(int fd, struct ramindex_vec_entry *entries, uint32_t nentries,
+    struct ramindex_cacheline *lines, uint32_t nlines)
+{
+    struct ramindex_vec_selector vs;
+    uint32_t n, count, total = 0;
+    int cpu = -1;
+
+    for (n = 0; n < nentries; n += count) {
+        count = nentries - n < RAMINDEX_DUMPV_MAX ? nentries - n : RAMINDEX_DUMPV_MAX;
+
+        memset(&vs, 0, sizeof(vs));
+        vs.nentries = count;
+        vs.entries = &entries[n];
+        vs.nlines = nlines - total;
+        vs.lines = &lines[total];
+        if (ioctl(fd, RAMINDEX_DUMPV, &vs) < 0) {
+            fprintf(stderr, "ioctl(RAMINDEX_DUMPV) failed with code %d : %s\n",
+                errno, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        /* all the batches shall read the caches of the cpu the thread is bound to */
+        if (cpu >= 0 && vs.cpu != cpu) {
+            fprintf(stderr, "Batches of one dump read on cpus %d and %d\n", cpu, vs.cpu);
+            exit(EXIT_FAILURE);
+        }
+        cpu = vs.cpu;
+
+        total += vs.nlines;
+    }
+
+    return total;
+}
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int main(int argc, char *argv[])
+{
+    int c, fd, i, l;
+    uint32_t n, b, nmarked, nentries, nlines, ndumped;
+    struct ramindex_clid clid;
+    struct ramindex_ccsidr ccsidr;
+    struct ramindex_dma dma;
+    struct ramindex_vec_entry *entries;
+    struct ramindex_cacheline *lines;
+    uint8_t *sets;
+    uint64_t buffer_lines[MAX_BUFFERS];
+    uint32_t resident[MAX_BUFFERS], dirty[MAX_BUFFERS];
+    // cmdline options
+    struct ramindex_dma_buffer buffers[MAX_BUFFERS];
+    uint32_t nbuffers = 0;
+    pid_t pid = 0;
+    int cpus[MAX_CPUS] = { 0 };
+    int ncpus = 1;
+    int levels[MAX_LEVELS];
+    int nlevels = 0;
+
+    static struct option long_options[] = {
+        {"help",     no_argument,       0, 'h'},
+        {"version",  no_argument,       0, 'v'},
+        {"phys",     required_argument, 0, 'a'},
+        {"pid",      required_argument, 0, 'p'},
+        {"range",    required_argument, 0, 'r'},
+        {"cpus",     required_argument, 0, 'c'},
+        {"levels",   required_argument, 0, 'l'},
+        {0, 0, 0, 0}
+    };
+
+    for (;;) {
+        c = getopt_long(argc, argv, "hva:p:r:c:l:", long_options, 0);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'h':
+                ramindex_dma_print_usage(argv[0]);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'v':
+                fprintf(stdout, "%s (this program) version: %s\n", argv[0], PROJECT_VER);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'a':
+            case 'r':
+                if (nbuffers == MAX_BUFFERS) {
+                    fprintf(stderr, "Too many buffers (at most %d)\n", MAX_BUFFERS);
+                    exit(EXIT_FAILURE);
+                }
+                memset(&buffers[nbuffers], 0, sizeof(buffers[nbuffers]));
+                if (sscanf(optarg, "%" SCNx64 "-%" SCNx64,
+                        &buffers[nbuffers].start, &buffers[nbuffers].end) != 2 ||
+                    buffers[nbuffers].start >= buffers[nbuffers].end) {
+                    fprintf(stderr, "Invalid range '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                buffers[nbuffers].range = optarg;
+                buffers[nbuffers].virtual = c == 'r';
+                nbuffers++;
+                break;
+
+            case 'p':
+                pid = atoi(optarg);
+                break;
+
+            case 'c':
+                ncpus = ramindex_parse_cpus(optarg, cpus, MAX_CPUS);
+                if (ncpus <= 0) {
+                    fprintf(stderr, "Invalid list of cpus '%s' (at most %d cpus)\n",
+                        optarg, MAX_CPUS);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'l':
+                nlevels = ramindex_parse_cpus(optarg, levels, MAX_LEVELS);
+                if (nlevels <= 0) {
+                    fprintf(stderr, "Invalid list of levels '%s' (at most %d levels)\n",
+                        optarg, MAX_LEVELS);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            default:
+                ramindex_dma_print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (optind < argc || nbuffers == 0) {
+        ramindex_dma_print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    memset(&dma, 0, sizeof(dma));
+    for (b = 0; b < nbuffers; b++) {
+        if (!buffers[b].virtual) {
+            buffers[b].resident = buffers[b].end - buffers[b].start;
+            ramindex_dma_add_extent(&dma, buffers[b].start, buffers[b].end, b);
+            continue;
+        }
+
+        if (pid <= 0) {
+            fprintf(stderr, "Virtual range '%s' needs a process (-p)\n", buffers[b].range);
+            exit(EXIT_FAILURE);
+        }
+        ramindex_dma_add_virtual(&dma, pid, &buffers[b], b);
+    }
+
+    qsort(dma.extents, dma.nextents, sizeof(*dma.extents), ramindex_dma_extent_cmp);
+
+    fd = open(RAMINDEX_DEVICENAME, O_RDWR);
+    if (fd == -1) {
+        fprintf(stderr, "Cannot open '%s': %s\n", RAMINDEX_DEVICENAME, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    memset(&clid, 0, sizeof(clid));
+    if (ioctl(fd, RAMINDEX_CLID, &clid) < 0) {
+        fprintf(stderr, "ioctl(RAMINDEX_CLID) failed with code %d : %s\n",
+            errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    /* every level holding data, all of them take part in cache maintenance */
+    if (nlevels == 0)
+        for (l = 0; l < (int)ARRAY_SIZE(clid.ctype) && l < MAX_LEVELS && clid.ctype[l] != CTYPE_NO_CACHE; l++)
+            levels[nlevels++] = l + 1;
+
+    for (l = 0; l < nlevels; l++) {
+        if (levels[l] <= 0 || levels[l] > (int)ARRAY_SIZE(clid.ctype) ||
+            clid.ctype[levels[l] - 1] == CTYPE_NO_CACHE) {
+            fprintf(stderr, "There is no cache at level %d\n", levels[l]);
+            exit(EXIT_FAILURE);
+        }
+
+        memset(&ccsidr, 0, sizeof(ccsidr));
+        ccsidr.level = levels[l] - 1;
+        ccsidr.icache = 0;
+        if (ioctl(fd, RAMINDEX_CCSIDR, &ccsidr) < 0) {
+            fprintf(stderr, "ioctl(RAMINDEX_CCSIDR) failed for level %d with code %d : %s\n",
+                levels[l], errno, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        memset(buffer_lines, 0, sizeof(buffer_lines));
+        sets = calloc(ccsidr.nsets, 1);
+        entries = calloc(ccsidr.nsets, sizeof(*entries));
+        if (sets == NULL || entries == NULL) {
+            fprintf(stderr, "Cannot allocate %d sets\n", ccsidr.nsets);
+            exit(EXIT_FAILURE);
+        }
+
+        nmarked = ramindex_dma_mark_sets(&dma, &ccsidr, sets, buffer_lines);
+        nentries = ramindex_dma_entries(&ccsidr, sets, entries);
+        nlines = nmarked * ccsidr.nways;
+        lines = calloc(nlines ? nlines : 1, sizeof(*lines));
+        if (lines == NULL) {
+            fprintf(stderr, "Cannot allocate %u lines\n", nlines);
+            exit(EXIT_FAILURE);
+        }
+
+        fprintf(stdout, "L%dd (%dx%dx%d): probing %u of %d sets (%.2f%% of a full dump)\n",
+            levels[l], ccsidr.nsets, ccsidr.nways, ccsidr.linesize,
+            nmarked, ccsidr.nsets, nmarked * 100.0 / ccsidr.nsets);
+
+        for (i = 0; i < ncpus; i++) {
+            if (ramindex_bind_cpu(cpus[i]) < 0) {
+                fprintf(stderr, "Cannot bind to cpu %d: %s\n", cpus[i], strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+
+            ndumped = nentries ? ramindex_dma_dump(fd, entries, nentries, lines, nlines) : 0;
+
+            memset(resident, 0, sizeof(resident));
+            memset(dirty, 0, sizeof(dirty));
+            for (n = 0; n < ndumped; n++) {
+                const struct ramindex_cacheline *cl = &lines[n];
+                const struct ramindex_dma_extent *e;
+
+                if (!cl->valid)
+                    continue;
+
+                e = ramindex_dma_find(&dma, cl->tag, ccsidr.linesize);
+                if (e == NULL)
+                    continue;
+
+                resident[e->buffer]++;
+                dirty[e->buffer] += !!cl->dirty;
+            }
+
+            fprintf(stdout, "  cpu %d:\n", cpus[i]);
+            fprintf(stdout, "    %-36s %10s %10s %7s %10s %10s\n",
+                "BUFFER", "LINES", "RESIDENT", "SHARE", "DIRTY", "DIRTY KiB");
+            for (b = 0; b < nbuffers; b++)
+                fprintf(stdout, "    %-36s %10" PRIu64 " %10u %6.2f%% %10u %10.1f\n",
+                    buffers[b].range, buffer_lines[b], resident[b],
+                    buffer_lines[b] ? resident[b] * 100.0 / buffer_lines[b] : 0.0,
+                    dirty[b], (double)dirty[b] * ccsidr.linesize / 1024);
+        }
+
+        free(lines);
+        free(entries);
+        free(sets);
+    }
+
+    for (b = 0; b < nbuffers; b++)
+        if (buffers[b].virtual && buffers[b].resident < buffers[b].end - buffers[b].start)
+            fprintf(stdout, "%s: %" PRIu64 " of %" PRIu64 " bytes resident\n", buffers[b].range,
+                buffers[b].resident, buffers[b].end - buffers[b].start);
+
+    free(dma.extents);
+    close(fd);
+
+    return 0;
+}
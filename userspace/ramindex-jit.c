@@ -0,0 +1,479 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-jit.c
+ *
+ * Detector of stale instructions cached in L1 instruction caches.
+ *
+ * Code generated by a JIT has to be cleaned to the point of unification
+ * and invalidated in instruction caches (DC CVAU, DSB, IC IVAU, DSB, ISB)
+ * before it is executed, otherwise old instructions may still be fetched.
+ * For a selected virtual address range of a process its resident pages
+ * are resolved (via /proc/<pid>/pagemap), L1 instruction cache sets those
+ * pages map to are computed and only those sets are dumped, by a single
+ * RAMINDEX_DUMPV ioctl per cpu. Valid lines holding the process' pages
+ * are compared with the current content of the memory (/proc/<pid>/mem)
+ * and lines which differ in several consecutive rounds are reported
+ * as stale, together with their virtual addresses.
+ *
+ * Sets are computed from virtual addresses for VIPT instruction caches
+ * and from physical addresses for PIPT ones (as told by CTR_EL0.L1Ip).
+ * Contents of the lines are compared as returned by the backend, i.e.
+ * it is assumed it returns the instructions as they are held in memory.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sched.h>
+
+#include <sys/ioctl.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include <version.h>
+#include "ramindex-snapshot.h"
+#include "ramindex-pagemap.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define RAMINDEX_DEVICENAME "/dev/ramindex"
+
+#define MAX_CPUS 1024
+
+/*===========================================================================*\
+ * local types definitions
+\*===========================================================================*/
+
+/* line found stale in the last @rounds consecutive rounds */
+struct ramindex_jit_suspect {
+    int cpu;
+    uint64_t vaddr;
+    uint32_t rounds;
+    uint32_t round;         /* round the line was last found stale in */
+    int reported;
+};
+
+struct ramindex_jit {
+    pid_t pid;
+    int memfd;
+    uint64_t start;
+    uint64_t end;
+    int vipt;
+    struct ramindex_ccsidr ccsidr;
+    struct ramindex_pagemap pagemap;
+    uint8_t *sets;          /* non-zero for sets holding lines of the range */
+    uint8_t *memory;        /* content of a line read from the process */
+    size_t nsuspects;
+    size_t maxsuspects;
+    struct ramindex_jit_suspect *suspects;
+};
+
+/*===========================================================================*\
+ * local (internal linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global (external linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) functions definitions
+\*===========================================================================*/
+static void ramindex_jit_print_usage(const char* progname)
+{
+    fprintf(stdout, "%s: [ OPTIONS ] -p PID -r START-END\n", progname);
+    fprintf(stdout, "\t-h, --help      this message\n");
+    fprintf(stdout, "\t-v, --version   output version information\n");
+    fprintf(stdout, "\t-p, --pid       process running the JIT\n");
+    fprintf(stdout, "\t-r, --range     virtual address range of the generated code\n");
+    fprintf(stdout, "\t-c, --cpus      list of cpus whose caches are checked (default: all we may run on)\n");
+    fprintf(stdout, "\t-n, --rounds    number of rounds (default: 0, until killed)\n");
+    fprintf(stdout, "\t-i, --interval  time between rounds in ms (default: 100)\n");
+    fprintf(stdout, "\t-k, --confirm   consecutive rounds a line has to be stale in\n");
+    fprintf(stdout, "\t                  to be reported (default: 2)\n");
+    fprintf(stdout, "\t-x, --index     compute sets from 'va' or 'pa' (default: as told by CTR_EL0)\n");
+}
+
+/* non-zero if L1 instruction cache is indexed by virtual addresses */
+static int ramindex_jit_icache_vipt(void)
+{
+#if defined(__aarch64__)
+    uint64_t ctr;
+
+    __asm__ __volatile__("mrs %0, ctr_el0" : "=r" (ctr));
+
+    return ((ctr >> 14) & 0x3) != 0x3; /* L1Ip 0b11 stands for PIPT */
+#else
+    return 0;
+#endif
+}
+
+/* marks sets holding lines of the range, returns number of marked sets */
+static uint32_t ramindex_jit_mark_sets(struct ramindex_jit *jit)
+{
+    const struct ramindex_ccsidr *ccsidr = &jit->ccsidr;
+    uint64_t pagesize = jit->pagemap.pagesize;
+    uint64_t from, to, addr;
+    uint32_t nmarked = 0;
+    size_t n;
+    int32_t set;
+
+    memset(jit->sets, 0, ccsidr->nsets);
+
+    for (n = 0; n < jit->pagemap.npages; n++) {
+        const struct ramindex_page *page = &jit->pagemap.pages[n];
+
+        from = page->vaddr > jit->start ? page->vaddr : jit->start;
+        to = page->vaddr + pagesize < jit->end ? page->vaddr + pagesize : jit->end;
+
+        for (addr = from & ~((uint64_t)ccsidr->linesize - 1); addr < to; addr += ccsidr->linesize) {
+            uint64_t index = jit->vipt ? addr : page->pfn * pagesize + addr - page->vaddr;
+
+            set = (index / ccsidr->linesize) % ccsidr->nsets;
+            if (!jit->sets[set]) {
+                jit->sets[set] = 1;
+                nmarked++;
+            }
+        }
+    }
+
+    return nmarked;
+}
+
+/* consecutive marked sets make up one entry */
+static uint32_t ramindex_jit_entries(const struct ramindex_jit *jit,
+    struct ramindex_vec_entry *entries)
+{
+    uint32_t nentries = 0;
+    int32_t set;
+
+    for (set = 0; set < jit->ccsidr.nsets; set++) {
+        if (!jit->sets[set])
+            continue;
+
+        if (nentries && entries[nentries - 1].set + entries[nentries - 1].nsets == set) {
+            entries[nentries - 1].nsets++;
+            continue;
+        }
+
+        memset(&entries[nentries], 0, sizeof(entries[nentries]));
+        entries[nentries].level = 0;
+        entries[nentries].icache = 1;
+        entries[nentries].set = set;
+        entries[nentries].nsets = 1;
+        nentries++;
+    }
+
+    return nentries;
+}
+
+static struct ramindex_jit_suspect *ramindex_jit_suspect(struct ramindex_jit *jit,
+    int cpu, uint64_t vaddr)
+{
+    struct ramindex_jit_suspect *suspects;
+    size_t n;
+
+    for (n = 0; n < jit->nsuspects; n++)
+        if (jit->suspects[n].cpu == cpu && jit->suspects[n].vaddr == vaddr)
+            return &jit->suspects[n];
+
+    if (jit->nsuspects == jit->maxsuspects) {
+        jit->maxsuspects = jit->maxsuspects ? 2 * jit->maxsuspects : 64;
+        suspects = realloc(jit->suspects, jit->maxsuspects * sizeof(*suspects));
+        if (suspects == NULL) {
+            fprintf(stderr, "Cannot allocate %zu suspects\n", jit->maxsuspects);
+            exit(EXIT_FAILURE);
+        }
+        jit->suspects = suspects;
+    }
+
+    memset(&jit->suspects[jit->nsuspects], 0, sizeof(*suspects));
+    jit->suspects[jit->nsuspects].cpu = cpu;
+    jit->suspects[jit->nsuspects].vaddr = vaddr;
+
+    return &jit->suspects[jit->nsuspects++];
+}
+
+static void ramindex_jit_report(const struct ramindex_jit *jit, int cpu, uint64_t vaddr,
+    const struct ramindex_cacheline *l, uint32_t rounds)
+{
+    const uint32_t *cached = l->linedata;
+    const uint32_t *memory = (const uint32_t *)jit->memory;
+    uint32_t n;
+
+    fprintf(stdout, "STALE cpu %d va 0x%016llx pa 0x%012llx set %d way %d (%u rounds)\n",
+        cpu, (unsigned long long)vaddr, (unsigned long long)l->tag, l->set, l->way, rounds);
+
+    for (n = 0; n < l->linesize / sizeof(*cached); n++)
+        if (cached[n] != memory[n])
+            fprintf(stdout, "    va 0x%016llx cached %08x memory %08x\n",
+                (unsigned long long)(vaddr + n * sizeof(*cached)), cached[n], memory[n]);
+}
+
+/* checks lines dumped on the cpu, returns number of stale lines */
+static uint32_t ramindex_jit_check(struct ramindex_jit *jit, int cpu, uint32_t round,
+    uint32_t confirm, const struct ramindex_cacheline *lines, uint32_t nlines)
+{
+    uint64_t pagesize = jit->pagemap.pagesize;
+    uint32_t n, nstale = 0;
+
+    for (n = 0; n < nlines; n++) {
+        const struct ramindex_cacheline *l = &lines[n];
+        const struct ramindex_page *page;
+        struct ramindex_jit_suspect *s;
+        uint64_t vaddr;
+
+        if (!l->valid || l->linesize == 0)
+            continue;
+
+        page = ramindex_pagemap_find(&jit->pagemap, l->tag / pagesize);
+        if (page == NULL)
+            continue;
+
+        vaddr = page->vaddr + l->tag % pagesize;
+        if (vaddr + l->linesize <= jit->start || vaddr >= jit->end)
+            continue;
+
+        /* the page may have just been unmapped, nothing to compare with then */
+        if (pread(jit->memfd, jit->memory, l->linesize, vaddr) != (ssize_t)l->linesize)
+            continue;
+
+        if (memcmp(l->linedata, jit->memory, l->linesize) == 0)
+            continue;
+
+        nstale++;
+
+        /* code being regenerated right now is not stale yet, only if it stays so */
+        s = ramindex_jit_suspect(jit, cpu, vaddr);
+        s->rounds = s->round + 1 == round ? s->rounds + 1 : 1;
+        s->round = round;
+        if (s->rounds >= confirm && !s->reported) {
+            ramindex_jit_report(jit, cpu, vaddr, l, s->rounds);
+            s->reported = 1;
+        }
+    }
+
+    return nstale;
+}
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int main(int argc, char *argv[])
+{
+    int c, fd, n;
+    int ncpus = 0;
+    int cpus[MAX_CPUS];
+    char path[64];
+    uint32_t round, nmarked, nentries, nlines, nstale, i;
+    struct ramindex_jit jit;
+    struct ramindex_vec_selector vs;
+    struct ramindex_vec_entry *entries;
+    struct ramindex_cacheline *lines;
+    uint8_t *data;
+    cpu_set_t cpuset;
+    // cmdline options
+    pid_t pid = 0;
+    uint64_t start = 0, end = 0;
+    uint32_t rounds = 0;
+    uint32_t interval = 100;
+    uint32_t confirm = 2;
+    int vipt = -1;
+
+    static struct option long_options[] = {
+        {"help",     no_argument,       0, 'h'},
+        {"version",  no_argument,       0, 'v'},
+        {"pid",      required_argument, 0, 'p'},
+        {"range",    required_argument, 0, 'r'},
+        {"cpus",     required_argument, 0, 'c'},
+        {"rounds",   required_argument, 0, 'n'},
+        {"interval", required_argument, 0, 'i'},
+        {"confirm",  required_argument, 0, 'k'},
+        {"index",    required_argument, 0, 'x'},
+        {0, 0, 0, 0}
+    };
+
+    for (;;) {
+        c = getopt_long(argc, argv, "hvp:r:c:n:i:k:x:", long_options, 0);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'h':
+                ramindex_jit_print_usage(argv[0]);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'v':
+                fprintf(stdout, "%s (this program) version: %s\n", argv[0], PROJECT_VER);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'p':
+                pid = atoi(optarg);
+                break;
+
+            case 'r':
+                if (sscanf(optarg, "%" SCNx64 "-%" SCNx64, &start, &end) != 2 || start >= end) {
+                    fprintf(stderr, "Invalid range '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'c':
+                ncpus = ramindex_parse_cpus(optarg, cpus, MAX_CPUS);
+                if (ncpus <= 0) {
+                    fprintf(stderr, "Invalid list of cpus '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'n':
+                rounds = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'i':
+                interval = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'k':
+                confirm = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'x':
+                vipt = strcmp(optarg, "va") == 0 ? 1 : strcmp(optarg, "pa") == 0 ? 0 : -2;
+                break;
+
+            default:
+                ramindex_jit_print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (pid <= 0 || start >= end || confirm == 0 || vipt == -2) {
+        ramindex_jit_print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (ncpus == 0) {
+        if (sched_getaffinity(0, sizeof(cpuset), &cpuset) < 0) {
+            fprintf(stderr, "Cannot get cpus we may run on: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        for (n = 0; n < CPU_SETSIZE && ncpus < MAX_CPUS; n++)
+            if (CPU_ISSET(n, &cpuset))
+                cpus[ncpus++] = n;
+    }
+
+    memset(&jit, 0, sizeof(jit));
+    jit.pid = pid;
+    jit.start = start;
+    jit.end = end;
+    jit.vipt = vipt >= 0 ? vipt : ramindex_jit_icache_vipt();
+
+    fd = open(RAMINDEX_DEVICENAME, O_RDWR);
+    if (fd == -1) {
+        fprintf(stderr, "Cannot open '%s': %s\n",
+            RAMINDEX_DEVICENAME, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    snprintf(path, sizeof(path), "/proc/%d/mem", (int)pid);
+    jit.memfd = open(path, O_RDONLY);
+    if (jit.memfd == -1) {
+        fprintf(stderr, "Cannot open '%s': %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    jit.ccsidr.level = 0;
+    jit.ccsidr.icache = 1;
+    if (ioctl(fd, RAMINDEX_CCSIDR, &jit.ccsidr) < 0) {
+        fprintf(stderr, "ioctl(RAMINDEX_CCSIDR) failed with code %d : %s\n",
+            errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    /* room for the whole cache, whatever the range maps to */
+    nlines = jit.ccsidr.nsets * jit.ccsidr.nways;
+    jit.sets = calloc(jit.ccsidr.nsets, 1);
+    jit.memory = malloc(jit.ccsidr.linesize);
+    entries = calloc(jit.ccsidr.nsets, sizeof(*entries));
+    lines = calloc(nlines, sizeof(*lines));
+    data = malloc((size_t)nlines * jit.ccsidr.linesize);
+    if (jit.sets == NULL || jit.memory == NULL || entries == NULL || lines == NULL || data == NULL) {
+        fprintf(stderr, "Cannot allocate buffers for %u lines\n", nlines);
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(stdout, "Checking L1 instruction caches (%d sets, indexed by %s addresses) of %d cpus\n",
+        jit.ccsidr.nsets, jit.vipt ? "virtual" : "physical", ncpus);
+
+    for (round = 1; rounds == 0 || round <= rounds; round++) {
+        /* code comes and goes, so does its backing memory */
+        if (ramindex_pagemap_read(pid, start, end, &jit.pagemap) < 0) {
+            fprintf(stderr, "Cannot read pagemap of process %d: %s\n", (int)pid, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        nmarked = ramindex_jit_mark_sets(&jit);
+        nentries = ramindex_jit_entries(&jit, entries);
+        nstale = 0;
+
+        for (n = 0; n < ncpus && nentries > 0; n++) {
+            if (ramindex_bind_cpu(cpus[n]) < 0)
+                continue; /* e.g. went offline */
+
+            for (i = 0; i < nlines; i++) {
+                lines[i].linesize = jit.ccsidr.linesize;
+                lines[i].linedata = data + (size_t)i * jit.ccsidr.linesize;
+            }
+
+            memset(&vs, 0, sizeof(vs));
+            vs.nentries = nentries;
+            vs.entries = entries;
+            vs.nlines = nlines;
+            vs.lines = lines;
+            if (ioctl(fd, RAMINDEX_DUMPV, &vs) < 0) {
+                fprintf(stderr, "ioctl(RAMINDEX_DUMPV) failed with code %d : %s\n",
+                    errno, strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+
+            nstale += ramindex_jit_check(&jit, vs.cpu, round, confirm, lines, vs.nlines);
+        }
+
+        fprintf(stderr, "round %u: %zu pages, %u sets, %u stale lines\n",
+            round, jit.pagemap.npages, nmarked, nstale);
+
+        ramindex_pagemap_free(&jit.pagemap);
+
+        if (rounds == 0 || round < rounds)
+            usleep(interval * 1000);
+    }
+
+    free(data);
+    free(lines);
+    free(entries);
+    free(jit.suspects);
+    free(jit.memory);
+    free(jit.sets);
+    close(jit.memfd);
+    close(fd);
+
+    return 0;
+}
@@ -0,0 +1,461 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-mock.c
+ *
+ * LD_PRELOAD shim emulating /dev/ramindex.
+ *
+ * Opening the device returns a descriptor of /dev/null, ioctls issued
+ * on it are served by this library, so the tools (and the benchmarks
+ * of the tools) run on any Linux box. One unified cache at level 1 is
+ * reported, its geometry is taken from RAMINDEX_MOCK_GEOMETRY environment
+ * variable ("<nsets>x<nways>x<linesize>", default "256x2x64") when
+ * the device is opened. Lines are synthesized from their coordinates,
+ * so consecutive dumps return the same content.
+ *
+ *     $ LD_PRELOAD=libramindex-mock.so ramindex -l 1
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "../ramindex.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define RAMINDEX_DEVICENAME "/dev/ramindex"
+
+#define RAMINDEX_MOCK_GEOMETRY_DEFAULT "256x2x64"
+
+/*===========================================================================*\
+ * local types definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) objects definitions
+\*===========================================================================*/
+static int ramindex_mock_fd = -1;
+static struct ramindex_ccsidr ramindex_mock_ccsidr;
+
+/*===========================================================================*\
+ * global (external linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) functions definitions
+\*===========================================================================*/
+static void ramindex_mock_geometry(void)
+{
+    const char *geometry = getenv("RAMINDEX_MOCK_GEOMETRY");
+
+    memset(&ramindex_mock_ccsidr, 0, sizeof(ramindex_mock_ccsidr));
+    if (geometry == NULL || sscanf(geometry, "%dx%dx%d", &ramindex_mock_ccsidr.nsets,
+            &ramindex_mock_ccsidr.nways, &ramindex_mock_ccsidr.linesize) != 3)
+        sscanf(RAMINDEX_MOCK_GEOMETRY_DEFAULT, "%dx%dx%d", &ramindex_mock_ccsidr.nsets,
+            &ramindex_mock_ccsidr.nways, &ramindex_mock_ccsidr.linesize);
+}
+
+static uint64_t ramindex_mock_hash(int32_t set, int32_t way)
+{
+    uint64_t h = ((uint64_t)set << 16 | (uint32_t)way) * 0x9e3779b97f4a7c15ULL;
+
+    return h ^ (h >> 29);
+}
+
+static int ramindex_mock_dump(struct ramindex_selector *selector)
+{
+    const struct ramindex_ccsidr *ccsidr = &ramindex_mock_ccsidr;
+    int32_t start_set, end_set, start_way, end_way;
+    uint32_t n, total, linesize;
+
+    if (selector->level != 0 || selector->icache)
+        return -EOPNOTSUPP;
+
+    if (selector->reserved)
+        return -EINVAL;
+
+    if (selector->set >= ccsidr->nsets || selector->way >= ccsidr->nways ||
+        (selector->set >= 0 && (selector->nsets < 0 || selector->nsets > ccsidr->nsets - selector->set)))
+        return -EINVAL;
+
+    if (selector->set < 0 || (selector->flags & RAMINDEX_DUMP_F_LOW_PERTURB))
+        start_set = 0, end_set = ccsidr->nsets;
+    else
+        start_set = selector->set, end_set = selector->set + (selector->nsets > 1 ? selector->nsets : 1);
+
+    if (selector->way < 0)
+        start_way = 0, end_way = ccsidr->nways;
+    else
+        start_way = selector->way, end_way = selector->way + 1;
+
+    if ((selector->flags & RAMINDEX_DUMP_F_LOW_PERTURB) &&
+        (uint32_t)(end_set - start_set) * (end_way - start_way) > RAMINDEX_LOW_PERTURB_LINES_MAX)
+        return -E2BIG;
+
+    linesize = (selector->flags & (RAMINDEX_DUMP_F_TAGS_ONLY | RAMINDEX_DUMP_F_LOW_PERTURB)) ?
+        0 : ccsidr->linesize;
+    total = (uint32_t)(end_set - start_set) * (end_way - start_way);
+    if (selector->nlines < total)
+        total = selector->nlines;
+
+    for (n = 0; n < total; n++) {
+        struct ramindex_cacheline *l = &selector->lines[n];
+        int32_t set = start_set + n / (end_way - start_way);
+        int32_t way = start_way + n % (end_way - start_way);
+        uint64_t h = ramindex_mock_hash(set, way);
+
+        l->set = set;
+        l->way = way;
+        l->valid = (h & 0x3) != 0;
+        l->dirty = l->valid && (h & 0x4);
+        l->ns = (h >> 3) & 0x1;
+        l->state = !l->valid ? CSTATE_INVALID :
+            l->dirty ? CSTATE_UNIQUE_DIRTY : CSTATE_SHARED_CLEAN;
+        l->tag = (h & 0xffffff0000ULL) | ((uint64_t)(set & 0x3ff) << 6);
+        if (l->linesize > linesize)
+            l->linesize = linesize;
+        if (l->linesize)
+            memset(l->linedata, (uint8_t)(h >> 8), l->linesize);
+    }
+
+    selector->nlines = total;
+    selector->cpu = 0;
+    selector->npolluted = 0;
+
+    return 0;
+}
+
+/* every selected line is dumped by a one line RAMINDEX_DUMP */
+static int ramindex_mock_dumpv(struct ramindex_vec_selector *vs)
+{
+    struct ramindex_selector selector;
+    uint32_t n, nlines = 0;
+    int32_t set, way, nsets;
+    int status;
+
+    if (vs->nentries == 0 || vs->nentries > RAMINDEX_DUMPV_MAX || vs->reserved)
+        return -EINVAL;
+
+    for (n = 0; n < vs->nentries; n++) {
+        struct ramindex_vec_entry *e = &vs->entries[n];
+
+        if (e->flags & ~RAMINDEX_DUMP_F_TAGS_ONLY)
+            return -EINVAL;
+        if (e->level != 0 || e->icache)
+            return -EOPNOTSUPP;
+        if (e->set >= ramindex_mock_ccsidr.nsets || (e->set >= 0 &&
+                (e->nsets < 0 || e->nsets > ramindex_mock_ccsidr.nsets - e->set)) ||
+            (ramindex_mock_ccsidr.nways < 64 && (e->ways >> ramindex_mock_ccsidr.nways)))
+            return -EINVAL;
+    }
+
+    for (n = 0; n < vs->nentries; n++) {
+        struct ramindex_vec_entry *e = &vs->entries[n];
+
+        e->nlines = 0;
+        set = e->set < 0 ? 0 : e->set;
+        nsets = e->set < 0 ? ramindex_mock_ccsidr.nsets : (e->nsets > 1 ? e->nsets : 1);
+        for (; nsets > 0; set++, nsets--) {
+            for (way = 0; way < ramindex_mock_ccsidr.nways; way++) {
+                if ((e->ways && (way >= 64 || !(e->ways >> way & 1))) || nlines == vs->nlines)
+                    continue;
+
+                memset(&selector, 0, sizeof(selector));
+                selector.set = set;
+                selector.way = way;
+                selector.flags = e->flags;
+                selector.nlines = 1;
+                selector.lines = &vs->lines[nlines];
+                status = ramindex_mock_dump(&selector);
+                if (status < 0)
+                    return status;
+                e->nlines++;
+                nlines++;
+            }
+        }
+    }
+
+    vs->nlines = nlines;
+    vs->cpu = 0;
+
+    return 0;
+}
+
+/*
+ * Counters follow CLOCK_MONOTONIC (so that they keep growing across
+ * processes, as counters of a cpu do), a dump counts in proportion
+ * to the number of dumped lines.
+ */
+static int ramindex_mock_dump_pmu(struct ramindex_pmu_selector *ps)
+{
+    int n, status;
+    struct timespec ts;
+    uint64_t now;
+
+    if (ps->events == 0 || (ps->events & ~RAMINDEX_PMU_ALL))
+        return -EINVAL;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+    status = ramindex_mock_dump(&ps->selector);
+    if (status < 0)
+        return status;
+
+    ps->valid = ps->events;
+    for (n = 0; n < RAMINDEX_PMU_EVENTS_MAX; n++) {
+        int counted = (ps->valid >> n) & 1;
+
+        ps->before[n] = counted ? (now >> 4) * (n + 1) : 0;
+        ps->delta[n] = counted ? (uint64_t)ps->selector.nlines * (n + 1) : 0;
+    }
+
+    return 0;
+}
+
+/* a quarter of the pages is charged to no cgroup, the rest to one of three cgroups */
+static int ramindex_mock_occupancy(struct ramindex_occupancy *occupancy)
+{
+    struct ramindex_cacheline line;
+    struct ramindex_selector selector;
+    uint32_t n, c, nlines;
+    uint64_t id;
+    int status;
+
+    if (occupancy->flags || occupancy->reserved || occupancy->ncgroups > RAMINDEX_OCCUPANCY_MAX)
+        return -EINVAL;
+
+    occupancy->cpu = 0;
+
+    nlines = ramindex_mock_ccsidr.nsets * ramindex_mock_ccsidr.nways;
+    c = occupancy->ncgroups;
+    occupancy->ncgroups = 0;
+    occupancy->nlines = occupancy->ndirty = 0;
+    occupancy->nunowned = occupancy->noverflow = 0;
+
+    for (n = 0; n < nlines; n++) {
+        memset(&selector, 0, sizeof(selector));
+        memset(&line, 0, sizeof(line));
+        selector.level = occupancy->level;
+        selector.icache = occupancy->icache;
+        selector.set = n / ramindex_mock_ccsidr.nways;
+        selector.way = n % ramindex_mock_ccsidr.nways;
+        selector.flags = RAMINDEX_DUMP_F_TAGS_ONLY;
+        selector.nlines = 1;
+        selector.lines = &line;
+        status = ramindex_mock_dump(&selector);
+        if (status < 0)
+            return status;
+        if (!line.valid)
+            continue;
+
+        occupancy->nlines++;
+        occupancy->ndirty += line.dirty;
+        id = (line.tag >> 12) % 4;
+        if (id == 0) {
+            occupancy->nunowned++;
+            continue;
+        }
+        id += 1000;
+
+        /* ids come in ascending order, as the array is sorted by them */
+        if (id - 1001 >= c) {
+            occupancy->noverflow++;
+            continue;
+        }
+        while (occupancy->ncgroups <= id - 1001) {
+            occupancy->cgroups[occupancy->ncgroups].cgroup_id = 1001 + occupancy->ncgroups;
+            occupancy->cgroups[occupancy->ncgroups].nlines = 0;
+            occupancy->cgroups[occupancy->ncgroups].ndirty = 0;
+            occupancy->ncgroups++;
+        }
+        occupancy->cgroups[id - 1001].nlines++;
+        occupancy->cgroups[id - 1001].ndirty += line.dirty;
+    }
+
+    return 0;
+}
+
+/* node 0 holds most of the pages, node 1 (movable, as CXL memory is) a quarter, the rest is unmanaged */
+static int ramindex_mock_placement(struct ramindex_placement *placement)
+{
+    struct ramindex_cacheline line;
+    struct ramindex_selector selector;
+    struct ramindex_line_placement lp;
+    uint32_t n, nlines, h;
+    int status;
+
+    if (placement->flags)
+        return -EINVAL;
+
+    nlines = ramindex_mock_ccsidr.nsets * ramindex_mock_ccsidr.nways;
+    placement->cpu = 0;
+    placement->cpu_node = 0;
+    placement->nvalid = placement->nunmanaged = placement->noverflow = 0;
+    memset(placement->valid, 0, sizeof(placement->valid));
+    memset(placement->dirty, 0, sizeof(placement->dirty));
+    if (placement->lines == NULL || placement->nlines > nlines)
+        placement->nlines = placement->lines ? nlines : 0;
+
+    for (n = 0; n < nlines; n++) {
+        memset(&selector, 0, sizeof(selector));
+        memset(&line, 0, sizeof(line));
+        selector.level = placement->level;
+        selector.icache = placement->icache;
+        selector.set = n / ramindex_mock_ccsidr.nways;
+        selector.way = n % ramindex_mock_ccsidr.nways;
+        selector.flags = RAMINDEX_DUMP_F_TAGS_ONLY;
+        selector.nlines = 1;
+        selector.lines = &line;
+        status = ramindex_mock_dump(&selector);
+        if (status < 0)
+            return status;
+
+        lp.node = lp.zone = -1;
+        if (line.valid) {
+            placement->nvalid++;
+            h = (line.tag >> 16) % 8;
+            if (h == 7) {
+                placement->nunmanaged++;
+            } else {
+                lp.node = h < 5 ? 0 : 1;
+                lp.zone = h < 5 ? RAMINDEX_ZONE_NORMAL : RAMINDEX_ZONE_MOVABLE;
+                placement->valid[lp.node][lp.zone]++;
+                placement->dirty[lp.node][lp.zone] += line.dirty;
+            }
+        }
+
+        if (n < placement->nlines)
+            placement->lines[n] = lp;
+    }
+
+    return 0;
+}
+
+static int ramindex_mock_ioctl(unsigned long request, void *arg)
+{
+    struct ramindex_version *version = arg;
+    struct ramindex_clid *clid = arg;
+    struct ramindex_ccsidr *ccsidr = arg;
+
+    switch (request) {
+    case RAMINDEX_VERSION:
+        version->major = RAMINDEX_VERSION_MAJOR;
+        version->minor = RAMINDEX_VERSION_MINOR;
+        version->micro = RAMINDEX_VERSION_MICRO;
+        return 0;
+    case RAMINDEX_CLID:
+        memset(clid, 0, sizeof(*clid));
+        clid->ctype[0] = CTYPE_UNIFIED_CACHE;
+        return 0;
+    case RAMINDEX_CCSIDR:
+        if (ccsidr->level != 0 || ccsidr->icache)
+            return -EINVAL;
+        *ccsidr = ramindex_mock_ccsidr;
+        return 0;
+    case RAMINDEX_DUMP:
+        return ramindex_mock_dump(arg);
+    case RAMINDEX_DUMPV:
+        return ramindex_mock_dumpv(arg);
+    case RAMINDEX_DUMP_PMU:
+        return ramindex_mock_dump_pmu(arg);
+    case RAMINDEX_OCCUPANCY:
+        return ramindex_mock_occupancy(arg);
+    case RAMINDEX_PLACEMENT:
+        return ramindex_mock_placement(arg);
+    default:
+        return -EOPNOTSUPP;
+    }
+}
+
+static int ramindex_mock_open(const char *pathname, int flags, mode_t mode)
+{
+    if (strcmp(pathname, RAMINDEX_DEVICENAME) == 0) {
+        ramindex_mock_geometry();
+        ramindex_mock_fd = syscall(SYS_openat, AT_FDCWD, "/dev/null", O_RDWR);
+        return ramindex_mock_fd;
+    }
+
+    return syscall(SYS_openat, AT_FDCWD, pathname, flags, mode);
+}
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int open(const char *pathname, int flags, ...)
+{
+    va_list ap;
+    mode_t mode = 0;
+
+    if ((flags & O_CREAT) || (flags & O_TMPFILE) == O_TMPFILE) {
+        va_start(ap, flags);
+        mode = va_arg(ap, mode_t);
+        va_end(ap);
+    }
+
+    return ramindex_mock_open(pathname, flags, mode);
+}
+
+int open64(const char *pathname, int flags, ...)
+{
+    va_list ap;
+    mode_t mode = 0;
+
+    if ((flags & O_CREAT) || (flags & O_TMPFILE) == O_TMPFILE) {
+        va_start(ap, flags);
+        mode = va_arg(ap, mode_t);
+        va_end(ap);
+    }
+
+    return ramindex_mock_open(pathname, flags, mode);
+}
+
+int close(int fd)
+{
+    if (fd >= 0 && fd == ramindex_mock_fd)
+        ramindex_mock_fd = -1;
+
+    return syscall(SYS_close, fd);
+}
+
+int ioctl(int fd, unsigned long request, ...)
+{
+    va_list ap;
+    void *arg;
+    int status;
+
+    va_start(ap, request);
+    arg = va_arg(ap, void *);
+    va_end(ap);
+
+    if (fd < 0 || fd != ramindex_mock_fd)
+        return syscall(SYS_ioctl, fd, request, arg);
+
+    status = ramindex_mock_ioctl(request, arg);
+    if (status < 0) {
+        errno = -status;
+        return -1;
+    }
+
+    return status;
+}
@@ -0,0 +1,468 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-model-tool.c
+ *
+ * Replays a memory access trace through a modelled cache and writes
+ * its content as snapshots, so that predictions of a model may be put
+ * side by side with dumps of the real cache by the other tools.
+ *
+ *     $ valgrind --tool=lackey --trace-mem=yes --log-file=app.trace ./app
+ *     $ ramindex-model -g 256x4x64 -p plru -i 1000000 -o model.snapshot app.trace
+ *
+ * Trace records are lines of valgrind lackey ("I  0023C790,2", " L 1FFEFFF8,8",
+ * " S ...", " M ...") or of the form "R|W|X address[,size]" (hex address,
+ * decimal size, 1 by default). Fetches (I, X) feed instruction caches,
+ * loads and stores (L, S, M, R, W) feed L1 data caches and all of them feed
+ * unified caches. Other lines (e.g. "==1234== ...") are skipped.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <sys/ioctl.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include <version.h>
+#include "../ramindex.h"
+#include "ramindex-snapshot.h"
+#include "ramindex-model.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define RAMINDEX_DEVICENAME "/dev/ramindex"
+
+/* trace is read in chunks of that many bytes */
+#define RAMINDEX_MODEL_CHUNK (1 << 20)
+
+/*===========================================================================*\
+ * local types definitions
+\*===========================================================================*/
+
+/**
+ * struct ramindex_model_replay - state of a trace replay
+ * @model:	the modelled cache
+ * @snapshot:	snapshot taken every @interval records
+ * @output:	stream snapshots are written to (NULL to print them)
+ * @fetches:	whether instruction fetches are replayed
+ * @data:	whether loads and stores are replayed
+ * @interval:	number of records between snapshots (0 for one at the end)
+ * @records:	number of replayed records
+ * @skipped:	number of lines which are not records
+ */
+struct ramindex_model_replay {
+    struct ramindex_model model;
+    struct ramindex_snapshot snapshot;
+    FILE *output;
+    int fetches;
+    int data;
+    uint64_t interval;
+    uint64_t records;
+    uint64_t skipped;
+};
+
+/*===========================================================================*\
+ * local (internal linkage) objects definitions
+\*===========================================================================*/
+static const char *ramindex_model_policies[] = {
+    [RAMINDEX_MODEL_LRU] = "lru",
+    [RAMINDEX_MODEL_PLRU] = "plru",
+    [RAMINDEX_MODEL_RANDOM] = "random",
+};
+
+/* value of a hex digit, or 0xff */
+static uint8_t ramindex_model_hex[256];
+
+/*===========================================================================*\
+ * global (external linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) functions definitions
+\*===========================================================================*/
+static void ramindex_model_print_usage(const char* progname)
+{
+    fprintf(stdout, "%s: [ OPTIONS ] [ TRACE ]  (standard input if no TRACE or '-')\n", progname);
+    fprintf(stdout, "\t-h, --help      this message\n");
+    fprintf(stdout, "\t-v, --version   output version information\n");
+    fprintf(stdout, "\t-g, --geometry  geometry of the modelled cache as SETSxWAYSxLINESIZE\n");
+    fprintf(stdout, "\t                  (default: geometry of the cache selected by -l and -t\n");
+    fprintf(stdout, "\t                  as read from %s)\n", RAMINDEX_DEVICENAME);
+    fprintf(stdout, "\t-l, --level     select cache level (default: 1)\n");
+    fprintf(stdout, "\t-t, --type      select cache type (1 for instruction cache,\n");
+    fprintf(stdout, "\t                  0 for data and unified caches, default: 0)\n");
+    fprintf(stdout, "\t-p, --policy    replacement policy: lru, plru or random (default: lru)\n");
+    fprintf(stdout, "\t-s, --seed      seed of the random policy (default: 0, fixed seed)\n");
+    fprintf(stdout, "\t-i, --interval  take a snapshot every that many records\n");
+    fprintf(stdout, "\t                  (default: 0, one snapshot at the end)\n");
+    fprintf(stdout, "\t-c, --cpu       cpu the snapshots are stamped with (default: -1)\n");
+    fprintf(stdout, "\t-o, --output    write binary snapshots to a file instead of\n");
+    fprintf(stdout, "\t                  printing them\n");
+}
+
+static void ramindex_model_print_versions(void)
+{
+    fprintf(stdout, "ramindex-model (this program) version: %s\n", PROJECT_VER);
+}
+
+static uint64_t ramindex_model_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void ramindex_model_get_ccsidr(int level, int type, struct ramindex_ccsidr *ccsidr)
+{
+    int fd;
+    int status;
+
+    fd = open(RAMINDEX_DEVICENAME, O_RDWR);
+    assert(fd >= -1);
+    if (fd == -1) {
+        fprintf(stderr, "Cannot open '%s' (select geometry by -g instead): %s\n",
+            RAMINDEX_DEVICENAME, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    memset(ccsidr, 0, sizeof(*ccsidr));
+    ccsidr->level = level - 1;
+    ccsidr->icache = type;
+
+    status = ioctl(fd, RAMINDEX_CCSIDR, ccsidr);
+    if (status < 0) {
+        fprintf(stderr, "ioctl(RAMINDEX_CCSIDR) failed with code %d : %s\n",
+            errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    close(fd);
+}
+
+static void ramindex_model_take_snapshot(struct ramindex_model_replay *replay)
+{
+    ramindex_model_snapshot(&replay->model, &replay->snapshot);
+    replay->snapshot.timestamp = replay->records;
+
+    if (replay->output) {
+        if (ramindex_snapshot_write(replay->output, &replay->snapshot) < 0) {
+            fprintf(stderr, "Cannot write snapshot: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        ramindex_snapshot_print(stdout, &replay->snapshot);
+    }
+}
+
+/*
+ * Replays one line of a trace (without its '\n'), returns 0 if it is not a record.
+ */
+static int ramindex_model_record(struct ramindex_model_replay *replay, const char *p, const char *end)
+{
+    char op;
+    int fetch, write;
+    uint64_t address = 0;
+    uint32_t size = 0;
+    uint8_t digit;
+
+    while (p < end && *p == ' ')
+        p++;
+    if (end - p < 3 || p[1] != ' ')
+        return 0;
+
+    op = *p;
+    switch (op) {
+        case 'I': case 'X':
+            fetch = 1; write = 0;
+            break;
+        case 'L': case 'R':
+            fetch = 0; write = 0;
+            break;
+        case 'S': case 'W': case 'M':
+            fetch = 0; write = 1;
+            break;
+        default:
+            return 0;
+    }
+
+    p += 2;
+    while (p < end && *p == ' ')
+        p++;
+    if (end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+        p += 2;
+    if (p == end || ramindex_model_hex[(uint8_t)*p] == 0xff)
+        return 0;
+    while (p < end && (digit = ramindex_model_hex[(uint8_t)*p]) != 0xff) {
+        address = (address << 4) | digit;
+        p++;
+    }
+
+    if (p < end && *p == ',')
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+            size = size * 10 + (*p - '0');
+
+    if ((fetch && replay->fetches) || (!fetch && replay->data))
+        ramindex_model_access(&replay->model, address, size ? size : 1, write);
+
+    replay->records++;
+    if (replay->interval && replay->records % replay->interval == 0)
+        ramindex_model_take_snapshot(replay);
+
+    return 1;
+}
+
+static void ramindex_model_replay(struct ramindex_model_replay *replay, FILE *input)
+{
+    char *buffer;
+    size_t pending = 0, n;
+    const char *p, *eol, *end;
+
+    buffer = malloc(RAMINDEX_MODEL_CHUNK);
+    if (buffer == NULL) {
+        fprintf(stderr, "Cannot allocate trace buffer\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (;;) {
+        n = fread(buffer + pending, 1, RAMINDEX_MODEL_CHUNK - pending, input);
+        end = buffer + pending + n;
+
+        for (p = buffer; p < end; p = eol + 1) {
+            eol = memchr(p, '\n', end - p);
+            if (eol == NULL) {
+                /* the last line of the trace, or one cut by the end of the chunk */
+                if (n == 0)
+                    eol = end;
+                else if (p == buffer && end - buffer == RAMINDEX_MODEL_CHUNK)
+                    p = end; /* not a record, nobody writes that long lines */
+                else
+                    break;
+                if (p == end)
+                    break;
+            }
+            if (!ramindex_model_record(replay, p, eol) && eol > p)
+                replay->skipped++;
+        }
+
+        if (n == 0)
+            break;
+
+        pending = end > p ? end - p : 0;
+        memmove(buffer, p, pending);
+    }
+
+    if (ferror(input)) {
+        fprintf(stderr, "Cannot read trace: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    free(buffer);
+}
+
+static void ramindex_model_print_stats(const struct ramindex_model_replay *replay, uint64_t elapsed)
+{
+    const struct ramindex_model_stats *st = &replay->model.stats;
+    const struct ramindex_ccsidr *ccsidr = &replay->model.ccsidr;
+
+    fprintf(stderr, "Model: %dx%dx%d (%d KiB), %s\n",
+        ccsidr->nsets, ccsidr->nways, ccsidr->linesize,
+        ccsidr->nsets * ccsidr->nways * ccsidr->linesize / 1024,
+        ramindex_model_policies[replay->model.policy]);
+    fprintf(stderr, "Records: %llu (%llu other lines skipped), %.1f M records/s\n",
+        (unsigned long long)replay->records, (unsigned long long)replay->skipped,
+        elapsed ? replay->records * 1e3 / elapsed : 0.0);
+    fprintf(stderr, "Line accesses: %llu, hits: %llu (%.2f%%), misses: %llu\n",
+        (unsigned long long)st->accesses, (unsigned long long)st->hits,
+        st->accesses ? st->hits * 100.0 / st->accesses : 0.0,
+        (unsigned long long)(st->accesses - st->hits));
+    fprintf(stderr, "Evictions: %llu, writebacks: %llu\n",
+        (unsigned long long)st->evictions, (unsigned long long)st->writebacks);
+}
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int main(int argc, char *argv[])
+{
+    int c;
+    unsigned n;
+    FILE *input = stdin;
+    uint64_t start;
+    struct ramindex_ccsidr ccsidr;
+    struct ramindex_model_replay replay;
+    // cmdline options
+    int geometry = 0;
+    int level = 1;
+    int type = 0;
+    int policy = RAMINDEX_MODEL_LRU;
+    uint64_t seed = 0;
+    uint64_t interval = 0;
+    int cpu = -1;
+    const char *filename = NULL;
+
+    static struct option long_options[] = {
+        {"help",     no_argument,       0, 'h'},
+        {"version",  no_argument,       0, 'v'},
+        {"geometry", required_argument, 0, 'g'},
+        {"level",    required_argument, 0, 'l'},
+        {"type",     required_argument, 0, 't'},
+        {"policy",   required_argument, 0, 'p'},
+        {"seed",     required_argument, 0, 's'},
+        {"interval", required_argument, 0, 'i'},
+        {"cpu",      required_argument, 0, 'c'},
+        {"output",   required_argument, 0, 'o'},
+        {0, 0, 0, 0}
+    };
+
+    memset(&ccsidr, 0, sizeof(ccsidr));
+
+    for (;;) {
+        c = getopt_long(argc, argv, "hvg:l:t:p:s:i:c:o:", long_options, 0);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'h':
+                ramindex_model_print_usage(argv[0]);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'v':
+                ramindex_model_print_versions();
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'g':
+                if (sscanf(optarg, "%dx%dx%d", &ccsidr.nsets, &ccsidr.nways, &ccsidr.linesize) != 3) {
+                    ramindex_model_print_usage(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                geometry = 1;
+                break;
+
+            case 'l':
+                level = atoi(optarg);
+                break;
+
+            case 't':
+                type = atoi(optarg);
+                break;
+
+            case 'p':
+                for (n = 0; n < sizeof(ramindex_model_policies) / sizeof(ramindex_model_policies[0]); n++)
+                    if (strcmp(optarg, ramindex_model_policies[n]) == 0)
+                        break;
+                if (n == sizeof(ramindex_model_policies) / sizeof(ramindex_model_policies[0])) {
+                    fprintf(stderr, "Unknown replacement policy '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                policy = n;
+                break;
+
+            case 's':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+
+            case 'i':
+                interval = strtoull(optarg, NULL, 0);
+                break;
+
+            case 'c':
+                cpu = atoi(optarg);
+                break;
+
+            case 'o':
+                filename = optarg;
+                break;
+        }
+    }
+
+    if (level <= 0 || (type != 0 && type != 1)) {
+        ramindex_model_print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (geometry) {
+        ccsidr.level = level - 1;
+        ccsidr.icache = type;
+    } else {
+        ramindex_model_get_ccsidr(level, type, &ccsidr);
+    }
+
+    memset(&replay, 0, sizeof(replay));
+    if (ramindex_model_init(&replay.model, &ccsidr, policy, seed) < 0) {
+        fprintf(stderr, "Cannot model %dx%dx%d cache with %s policy: %s\n",
+            ccsidr.nsets, ccsidr.nways, ccsidr.linesize,
+            ramindex_model_policies[policy], strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    if (ramindex_snapshot_alloc(&replay.snapshot, &ccsidr, 0) < 0) {
+        fprintf(stderr, "Cannot allocate snapshot of %d lines\n", ccsidr.nsets * ccsidr.nways);
+        exit(EXIT_FAILURE);
+    }
+    replay.snapshot.cpu = cpu;
+
+    replay.fetches = type == 1 || level > 1;
+    replay.data = type == 0;
+    replay.interval = interval;
+
+    memset(ramindex_model_hex, 0xff, sizeof(ramindex_model_hex));
+    for (n = 0; n < 10; n++)
+        ramindex_model_hex['0' + n] = n;
+    for (n = 0; n < 6; n++)
+        ramindex_model_hex['a' + n] = ramindex_model_hex['A' + n] = 10 + n;
+
+    if (optind < argc && strcmp(argv[optind], "-") != 0) {
+        input = fopen(argv[optind], "r");
+        if (input == NULL) {
+            fprintf(stderr, "Cannot open '%s': %s\n", argv[optind], strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (filename) {
+        replay.output = fopen(filename, "wb");
+        if (replay.output == NULL) {
+            fprintf(stderr, "Cannot open '%s': %s\n", filename, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    start = ramindex_model_now();
+    ramindex_model_replay(&replay, input);
+    if (!interval || replay.records % interval)
+        ramindex_model_take_snapshot(&replay);
+    ramindex_model_print_stats(&replay, ramindex_model_now() - start);
+
+    if (replay.output && fclose(replay.output) != 0) {
+        fprintf(stderr, "Cannot write '%s': %s\n", filename, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if (input != stdin)
+        fclose(input);
+
+    ramindex_snapshot_free(&replay.snapshot);
+    ramindex_model_free(&replay.model);
+
+    return 0;
+}
@@ -0,0 +1,284 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-model.c
+ *
+ * Set associative cache model replaying memory accesses.
+ *
+ * Lines of a set are kept way after way (as in snapshots), a line being
+ * its address shifted right by log2 of the line size (all ones for invalid
+ * lines). Lookups compare line addresses of all the ways of a set, which
+ * for caches of up to 16 ways is cheaper than any index. Invalid ways are filled first whatever the
+ * policy, a replacement policy picks a victim out of a full set only.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "ramindex-model.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define RAMINDEX_MODEL_VALID (1u << 0)
+#define RAMINDEX_MODEL_DIRTY (1u << 1)
+
+/* line address of invalid lines, so that lookups compare line addresses only */
+#define RAMINDEX_MODEL_NOLINE UINT64_MAX
+
+/*===========================================================================*\
+ * local types definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global (external linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) functions definitions
+\*===========================================================================*/
+static int ramindex_model_is_pow2(uint64_t x)
+{
+    return x && !(x & (x - 1));
+}
+
+static unsigned ramindex_model_log2(uint64_t x)
+{
+    unsigned n = 0;
+
+    while (x >>= 1)
+        n++;
+
+    return n;
+}
+
+static uint64_t ramindex_model_random(struct ramindex_model *model)
+{
+    /* xorshift64 */
+    uint64_t x = model->random;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    model->random = x;
+
+    return x;
+}
+
+/*
+ * Tree pseudo LRU: node n (1 .. nways - 1, root being 1) has children
+ * 2n and 2n + 1, a bit of the node set means the victim is on the right.
+ * Ways are the leaves (nways .. 2 * nways - 1).
+ */
+static void ramindex_model_plru_touch(struct ramindex_model *model, uint64_t set, unsigned way)
+{
+    uint64_t bits = model->plru[set];
+    unsigned node = model->ccsidr.nways + way;
+
+    while (node > 1) {
+        unsigned right = node & 1;
+
+        node >>= 1;
+        /* point away from the touched way */
+        if (right)
+            bits &= ~(1ull << node);
+        else
+            bits |= 1ull << node;
+    }
+
+    model->plru[set] = bits;
+}
+
+static unsigned ramindex_model_plru_victim(const struct ramindex_model *model, uint64_t set)
+{
+    uint64_t bits = model->plru[set];
+    unsigned nways = model->ccsidr.nways;
+    unsigned node = 1;
+
+    while (node < nways)
+        node = 2 * node + ((bits >> node) & 1);
+
+    return node - nways;
+}
+
+static unsigned ramindex_model_victim(struct ramindex_model *model, uint64_t set, size_t base)
+{
+    unsigned nways = model->ccsidr.nways;
+    unsigned way, victim;
+    uint64_t age;
+
+    for (way = 0; way < nways; way++)
+        if (!(model->flags[base + way] & RAMINDEX_MODEL_VALID))
+            return way;
+
+    switch (model->policy) {
+        case RAMINDEX_MODEL_PLRU:
+            return ramindex_model_plru_victim(model, set);
+
+        case RAMINDEX_MODEL_RANDOM:
+            return ramindex_model_random(model) % nways;
+
+        default:
+            victim = 0;
+            age = model->ages[base];
+            for (way = 1; way < nways; way++)
+                if (model->ages[base + way] < age) {
+                    age = model->ages[base + way];
+                    victim = way;
+                }
+            return victim;
+    }
+}
+
+static int ramindex_model_line(struct ramindex_model *model, uint64_t line, int write)
+{
+    uint64_t set = line & model->setmask;
+    unsigned nways = model->ccsidr.nways;
+    size_t base = (size_t)set * nways;
+    unsigned way;
+    uint8_t dirty = write ? RAMINDEX_MODEL_DIRTY : 0;
+    int hit = 0;
+
+    for (way = 0; way < nways; way++)
+        if (model->tags[base + way] == line) {
+            hit = 1;
+            break;
+        }
+
+    if (hit) {
+        model->stats.hits++;
+        model->flags[base + way] |= dirty;
+    } else {
+        way = ramindex_model_victim(model, set, base);
+        if (model->flags[base + way] & RAMINDEX_MODEL_VALID) {
+            model->stats.evictions++;
+            if (model->flags[base + way] & RAMINDEX_MODEL_DIRTY)
+                model->stats.writebacks++;
+        }
+        model->tags[base + way] = line;
+        model->flags[base + way] = RAMINDEX_MODEL_VALID | dirty;
+    }
+
+    if (model->policy == RAMINDEX_MODEL_PLRU)
+        ramindex_model_plru_touch(model, set, way);
+    else if (model->policy == RAMINDEX_MODEL_LRU)
+        model->ages[base + way] = ++model->clock;
+
+    model->stats.accesses++;
+
+    return hit;
+}
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int ramindex_model_init(struct ramindex_model *model, const struct ramindex_ccsidr *ccsidr,
+    int policy, uint64_t seed)
+{
+    size_t nlines;
+
+    memset(model, 0, sizeof(*model));
+
+    if (ccsidr->nsets <= 0 || ccsidr->nways <= 0 || ccsidr->linesize <= 0 ||
+        !ramindex_model_is_pow2(ccsidr->nsets) || !ramindex_model_is_pow2(ccsidr->linesize) ||
+        ccsidr->nways > RAMINDEX_MODEL_WAYS_MAX ||
+        (policy == RAMINDEX_MODEL_PLRU && !ramindex_model_is_pow2(ccsidr->nways)) ||
+        policy < RAMINDEX_MODEL_LRU || policy > RAMINDEX_MODEL_RANDOM) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    model->ccsidr = *ccsidr;
+    model->policy = policy;
+    model->lineshift = ramindex_model_log2(ccsidr->linesize);
+    model->setmask = ccsidr->nsets - 1;
+    model->random = seed ? seed : 0x9e3779b97f4a7c15ull;
+
+    nlines = (size_t)ccsidr->nsets * ccsidr->nways;
+    model->tags = calloc(nlines, sizeof(*model->tags));
+    model->flags = calloc(nlines, sizeof(*model->flags));
+    if (policy == RAMINDEX_MODEL_LRU)
+        model->ages = calloc(nlines, sizeof(*model->ages));
+    if (policy == RAMINDEX_MODEL_PLRU)
+        model->plru = calloc(ccsidr->nsets, sizeof(*model->plru));
+
+    if (model->tags == NULL || model->flags == NULL ||
+        (policy == RAMINDEX_MODEL_LRU && model->ages == NULL) ||
+        (policy == RAMINDEX_MODEL_PLRU && model->plru == NULL)) {
+        ramindex_model_free(model);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    while (nlines--)
+        model->tags[nlines] = RAMINDEX_MODEL_NOLINE;
+
+    return 0;
+}
+
+void ramindex_model_free(struct ramindex_model *model)
+{
+    free(model->tags);
+    free(model->flags);
+    free(model->ages);
+    free(model->plru);
+    model->tags = NULL;
+    model->flags = NULL;
+    model->ages = NULL;
+    model->plru = NULL;
+}
+
+unsigned ramindex_model_access(struct ramindex_model *model, uint64_t address,
+    uint32_t size, int write)
+{
+    uint64_t line = address >> model->lineshift;
+    uint64_t last = (address + (size ? size - 1 : 0)) >> model->lineshift;
+    unsigned nmisses = 0;
+
+    do {
+        nmisses += !ramindex_model_line(model, line, write);
+    } while (line++ != last);
+
+    return nmisses;
+}
+
+void ramindex_model_snapshot(const struct ramindex_model *model,
+    struct ramindex_snapshot *snapshot)
+{
+    uint32_t n;
+    uint32_t nways = model->ccsidr.nways;
+    uint32_t nlines = model->ccsidr.nsets * nways;
+
+    for (n = 0; n < nlines; n++) {
+        struct ramindex_cacheline *l = &snapshot->lines[n];
+        uint8_t flags = model->flags[n];
+
+        l->set = n / nways;
+        l->way = n % nways;
+        l->valid = !!(flags & RAMINDEX_MODEL_VALID);
+        l->dirty = !!(flags & RAMINDEX_MODEL_DIRTY);
+        l->ns = 0;
+        l->state = !l->valid ? CSTATE_INVALID :
+            l->dirty ? CSTATE_UNIQUE_DIRTY : CSTATE_UNIQUE_CLEAN;
+        l->tag = l->valid ? model->tags[n] << model->lineshift : 0;
+        l->linesize = 0;
+    }
+
+    snapshot->nlines = nlines;
+}
@@ -0,0 +1,119 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-model.h
+ *
+ * Set associative cache model replaying memory accesses, whose content
+ * is taken as snapshots in the same form as dumps of real caches.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+#ifndef _RAMINDEX_MODEL_H_
+#define _RAMINDEX_MODEL_H_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <stdint.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "ramindex-snapshot.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+
+/* tree pseudo LRU keeps nways - 1 bits per set in one 64-bit word */
+#define RAMINDEX_MODEL_WAYS_MAX 64
+
+/*===========================================================================*\
+ * global types definitions
+\*===========================================================================*/
+
+/**
+ * enum ramindex_model_policy - replacement policies
+ * @RAMINDEX_MODEL_LRU:		least recently used line is evicted
+ * @RAMINDEX_MODEL_PLRU:	tree pseudo LRU (number of ways shall be a power of 2)
+ * @RAMINDEX_MODEL_RANDOM:	random line is evicted
+ */
+enum ramindex_model_policy {
+    RAMINDEX_MODEL_LRU,
+    RAMINDEX_MODEL_PLRU,
+    RAMINDEX_MODEL_RANDOM,
+};
+
+/**
+ * struct ramindex_model_stats - what the replay has done
+ * @accesses:	number of line accesses (an access spanning lines counts once per line)
+ * @hits:	number of accesses finding their line in the cache
+ * @evictions:	number of valid lines replaced
+ * @writebacks:	number of dirty lines replaced
+ */
+struct ramindex_model_stats {
+    uint64_t accesses;
+    uint64_t hits;
+    uint64_t evictions;
+    uint64_t writebacks;
+};
+
+/**
+ * struct ramindex_model - state of a modelled cache
+ * @ccsidr:	geometry of the cache
+ * @policy:	enum ramindex_model_policy
+ * @stats:	what the replay has done
+ *
+ * The remaining fields are private to the implementation.
+ */
+struct ramindex_model {
+    struct ramindex_ccsidr ccsidr;
+    int policy;
+    struct ramindex_model_stats stats;
+
+    unsigned lineshift;
+    uint64_t setmask;
+    uint64_t *tags;
+    uint8_t *flags;
+    uint64_t *ages;
+    uint64_t *plru;
+    uint64_t clock;
+    uint64_t random;
+};
+
+/*===========================================================================*\
+ * global (external linkage) functions declarations
+\*===========================================================================*/
+
+/**
+ * Sets up an empty cache of the given geometry (number of sets and line size
+ * shall be powers of 2). seed initializes the generator of the random policy.
+ *
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int ramindex_model_init(struct ramindex_model *model, const struct ramindex_ccsidr *ccsidr,
+    int policy, uint64_t seed);
+
+/**
+ * Releases buffers held by the model.
+ */
+void ramindex_model_free(struct ramindex_model *model);
+
+/**
+ * Replays an access of size bytes (at least one) at the address,
+ * write is non-zero for stores (they make lines dirty).
+ *
+ * @return number of lines touched by the access which have been missed
+ */
+unsigned ramindex_model_access(struct ramindex_model *model, uint64_t address,
+    uint32_t size, int write);
+
+/**
+ * Takes content of the modelled cache as a snapshot allocated by
+ * ramindex_snapshot_alloc() for the same geometry (without data).
+ * Tags are line addresses, as they are in dumps of real caches.
+ */
+void ramindex_model_snapshot(const struct ramindex_model *model,
+    struct ramindex_snapshot *snapshot);
+
+#endif /* _RAMINDEX_MODEL_H_ */
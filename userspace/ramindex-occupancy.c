@@ -0,0 +1,495 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-occupancy.c
+ *
+ * Reports how many lines of a cache every memory cgroup (container) holds.
+ *
+ * Lines are attributed to cgroups by the kernel (RAMINDEX_OCCUPANCY), only
+ * per cgroup counts come back, so a scrape of even a big shared L3 costs
+ * one walk of its tags. Counts are printed as a table or in the Prometheus
+ * text exposition format, written to a file (atomically replaced every
+ * round, e.g. for the node exporter's textfile collector) if requested.
+ * Cgroup ids are told as paths by looking up directories of the cgroup
+ * filesystem, as the id of a cgroup is the inode number of its directory.
+ *
+ *     $ sudo ramindex-occupancy -c 0,4 -l 3 -i 10000000 -m -o /var/lib/node_exporter/ramindex.prom
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <signal.h>
+#include <ftw.h>
+
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include <version.h>
+#include "../ramindex.h"
+#include "ramindex-snapshot.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define RAMINDEX_DEVICENAME "/dev/ramindex"
+#define RAMINDEX_CGROUP_ROOT "/sys/fs/cgroup"
+
+#define MAX_CPUS 1024
+
+/*===========================================================================*\
+ * local types definitions
+\*===========================================================================*/
+
+/**
+ * struct ramindex_occupancy_path - directory of a cgroup
+ * @id:		id of the cgroup (inode number of the directory)
+ * @path:	path of the directory relative to the cgroup filesystem root
+ */
+struct ramindex_occupancy_path {
+    uint64_t id;
+    char *path;
+};
+
+/*===========================================================================*\
+ * local (internal linkage) objects definitions
+\*===========================================================================*/
+static volatile sig_atomic_t ramindex_occupancy_stop = 0;
+
+/* cgroup directories sorted by id, nftw() gives no way to pass them to the callback */
+static struct ramindex_occupancy_path *ramindex_occupancy_paths;
+static size_t ramindex_occupancy_npaths;
+static size_t ramindex_occupancy_rootlen;
+
+/*===========================================================================*\
+ * global (external linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) functions definitions
+\*===========================================================================*/
+static void ramindex_occupancy_print_usage(const char* progname)
+{
+    fprintf(stdout, "%s: [ OPTIONS ]\n", progname);
+    fprintf(stdout, "\t-h, --help      this message\n");
+    fprintf(stdout, "\t-v, --version   output version information\n");
+    fprintf(stdout, "\t-c, --cpus      walk caches of these cpus, e.g. 0,4 (one per shared cache\n");
+    fprintf(stdout, "\t                  is enough, default: 0)\n");
+    fprintf(stdout, "\t-l, --level     select cache level (default: 2)\n");
+    fprintf(stdout, "\t-t, --type      select cache type (1 for instruction cache,\n");
+    fprintf(stdout, "\t                  0 for data and unified caches, default: 0)\n");
+    fprintf(stdout, "\t-n, --rounds    number of rounds (default: 1, 0 until interrupted)\n");
+    fprintf(stdout, "\t-i, --interval  time between rounds in microseconds (default: 1000000)\n");
+    fprintf(stdout, "\t-g, --cgroups   max number of cgroups reported per cache (default: 256)\n");
+    fprintf(stdout, "\t-r, --root      cgroup filesystem mount point (default: %s)\n",
+        RAMINDEX_CGROUP_ROOT);
+    fprintf(stdout, "\t-m, --metrics   print in Prometheus text exposition format\n");
+    fprintf(stdout, "\t-o, --output    replace that file with the output of every round\n");
+}
+
+static void ramindex_occupancy_signal(int signum)
+{
+    (void)signum;
+    ramindex_occupancy_stop = 1;
+}
+
+static int ramindex_occupancy_path_cmp(const void *a, const void *b)
+{
+    const struct ramindex_occupancy_path *pa = a, *pb = b;
+
+    return pa->id < pb->id ? -1 : pa->id > pb->id;
+}
+
+static int ramindex_occupancy_visit(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+    struct ramindex_occupancy_path *paths;
+    const char *relative = path + ramindex_occupancy_rootlen;
+
+    (void)ftw;
+    if (flag != FTW_D)
+        return 0;
+
+    paths = realloc(ramindex_occupancy_paths,
+        (ramindex_occupancy_npaths + 1) * sizeof(*paths));
+    if (paths == NULL)
+        return -1;
+    ramindex_occupancy_paths = paths;
+
+    paths[ramindex_occupancy_npaths].id = st->st_ino;
+    paths[ramindex_occupancy_npaths].path = strdup(*relative ? relative : "/");
+    if (paths[ramindex_occupancy_npaths].path == NULL)
+        return -1;
+    ramindex_occupancy_npaths++;
+
+    return 0;
+}
+
+static void ramindex_occupancy_paths_free(void)
+{
+    size_t n;
+
+    for (n = 0; n < ramindex_occupancy_npaths; n++)
+        free(ramindex_occupancy_paths[n].path);
+    free(ramindex_occupancy_paths);
+    ramindex_occupancy_paths = NULL;
+    ramindex_occupancy_npaths = 0;
+}
+
+static void ramindex_occupancy_paths_scan(const char *root)
+{
+    ramindex_occupancy_paths_free();
+    ramindex_occupancy_rootlen = strlen(root);
+
+    /* a cgroup removed while being walked is just not found */
+    if (nftw(root, ramindex_occupancy_visit, 16, FTW_PHYS | FTW_MOUNT) < 0 && errno == ENOMEM) {
+        fprintf(stderr, "Cannot scan '%s': %s\n", root, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    qsort(ramindex_occupancy_paths, ramindex_occupancy_npaths,
+        sizeof(*ramindex_occupancy_paths), ramindex_occupancy_path_cmp);
+}
+
+static const char *ramindex_occupancy_path(uint64_t id)
+{
+    struct ramindex_occupancy_path key = { .id = id };
+    const struct ramindex_occupancy_path *p;
+
+    p = bsearch(&key, ramindex_occupancy_paths, ramindex_occupancy_npaths,
+        sizeof(*ramindex_occupancy_paths), ramindex_occupancy_path_cmp);
+
+    return p ? p->path : NULL;
+}
+
+static int ramindex_occupancy_lines_cmp(const void *a, const void *b)
+{
+    const struct ramindex_cgroup_lines *la = a, *lb = b;
+
+    return la->nlines > lb->nlines ? -1 : la->nlines < lb->nlines;
+}
+
+/* label values escape backslashes, double quotes and new lines */
+static void ramindex_occupancy_print_label(FILE *stream, const char *value)
+{
+    for (; *value; value++) {
+        if (*value == '\\' || *value == '"')
+            fputc('\\', stream);
+        if (*value == '\n')
+            fputs("\\n", stream);
+        else
+            fputc(*value, stream);
+    }
+}
+
+/* samples of a metric family shall not be interleaved with other families */
+static void ramindex_occupancy_print_metrics(FILE *stream, int ncpus,
+    const struct ramindex_ccsidr *ccsidr, const struct ramindex_occupancy *occupancy)
+{
+    static const struct {
+        const char *name;
+        const char *help;
+    } families[] = {
+        { "ramindex_cgroup_lines", "Valid lines of the cache charged to the cgroup." },
+        { "ramindex_cgroup_dirty_lines", "Dirty lines of the cache charged to the cgroup." },
+        { "ramindex_cache_lines", "Lines of the cache." },
+        { "ramindex_cache_valid_lines", "Valid lines of the cache." },
+        { "ramindex_cache_dirty_lines", "Dirty lines of the cache." },
+        { "ramindex_cache_unowned_lines", "Valid lines of the cache charged to no cgroup." },
+        { "ramindex_cache_overflow_lines", "Valid lines of cgroups not reported." },
+    };
+    const struct ramindex_occupancy *o;
+    const char *path;
+    uint32_t n, value;
+    size_t f;
+    int i;
+
+    for (f = 0; f < sizeof(families) / sizeof(families[0]); f++) {
+        fprintf(stream, "# HELP %s %s\n", families[f].name, families[f].help);
+        fprintf(stream, "# TYPE %s gauge\n", families[f].name);
+
+        for (i = 0; i < ncpus; i++) {
+            o = &occupancy[i];
+
+            for (n = 0; f < 2 && n < o->ncgroups; n++) {
+                fprintf(stream, "%s{cpu=\"%d\",cache=\"L%d%c\",cgroup=\"", families[f].name,
+                    o->cpu, ccsidr->level + 1, ccsidr->icache ? 'i' : 'd');
+                path = ramindex_occupancy_path(o->cgroups[n].cgroup_id);
+                if (path)
+                    ramindex_occupancy_print_label(stream, path);
+                else
+                    fprintf(stream, "%llu", (unsigned long long)o->cgroups[n].cgroup_id);
+                fprintf(stream, "\"} %u\n", f ? o->cgroups[n].ndirty : o->cgroups[n].nlines);
+            }
+
+            if (f < 2)
+                continue;
+
+            value = f == 2 ? (uint32_t)(ccsidr->nsets * ccsidr->nways) : f == 3 ? o->nlines :
+                f == 4 ? o->ndirty : f == 5 ? o->nunowned : o->noverflow;
+            fprintf(stream, "%s{cpu=\"%d\",cache=\"L%d%c\"} %u\n", families[f].name,
+                o->cpu, ccsidr->level + 1, ccsidr->icache ? 'i' : 'd', value);
+        }
+    }
+}
+
+static void ramindex_occupancy_print_table(FILE *stream,
+    const struct ramindex_ccsidr *ccsidr, struct ramindex_occupancy *occupancy)
+{
+    uint32_t n;
+    uint32_t nlines = ccsidr->nsets * ccsidr->nways;
+    const char *path;
+
+    fprintf(stream, "cpu %d, L%d%c (%dx%dx%d): %u valid lines, %u dirty, %u unowned, %u of other cgroups\n",
+        occupancy->cpu, ccsidr->level + 1, ccsidr->icache ? 'i' : 'd',
+        ccsidr->nsets, ccsidr->nways, ccsidr->linesize,
+        occupancy->nlines, occupancy->ndirty, occupancy->nunowned, occupancy->noverflow);
+
+    qsort(occupancy->cgroups, occupancy->ncgroups, sizeof(*occupancy->cgroups),
+        ramindex_occupancy_lines_cmp);
+
+    fprintf(stream, "      LINES        KiB   SHARE     DIRTY  CGROUP\n");
+    for (n = 0; n < occupancy->ncgroups; n++) {
+        const struct ramindex_cgroup_lines *cl = &occupancy->cgroups[n];
+
+        fprintf(stream, "%11u %10.1f %6.2f%% %9u  ", cl->nlines,
+            (double)cl->nlines * ccsidr->linesize / 1024, cl->nlines * 100.0 / nlines, cl->ndirty);
+        path = ramindex_occupancy_path(cl->cgroup_id);
+        if (path)
+            fprintf(stream, "%s\n", path);
+        else
+            fprintf(stream, "%llu\n", (unsigned long long)cl->cgroup_id);
+    }
+}
+
+static int ramindex_occupancy_all_known(const struct ramindex_occupancy *occupancy)
+{
+    uint32_t n;
+
+    for (n = 0; n < occupancy->ncgroups; n++)
+        if (ramindex_occupancy_path(occupancy->cgroups[n].cgroup_id) == NULL)
+            return 0;
+
+    return 1;
+}
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int main(int argc, char *argv[])
+{
+    int c, fd, status, i, r, scanned;
+    FILE *stream;
+    char *tmpname = NULL;
+    struct ramindex_ccsidr ccsidr;
+    struct ramindex_occupancy *occupancy;
+    // cmdline options
+    int cpus[MAX_CPUS] = { 0 };
+    int ncpus = 1;
+    int level = 2;
+    int type = 0;
+    int rounds = 1;
+    int interval = 1000000;
+    uint32_t ncgroups = 256;
+    const char *root = RAMINDEX_CGROUP_ROOT;
+    int metrics = 0;
+    const char *filename = NULL;
+
+    static struct option long_options[] = {
+        {"help",     no_argument,       0, 'h'},
+        {"version",  no_argument,       0, 'v'},
+        {"cpus",     required_argument, 0, 'c'},
+        {"level",    required_argument, 0, 'l'},
+        {"type",     required_argument, 0, 't'},
+        {"rounds",   required_argument, 0, 'n'},
+        {"interval", required_argument, 0, 'i'},
+        {"cgroups",  required_argument, 0, 'g'},
+        {"root",     required_argument, 0, 'r'},
+        {"metrics",  no_argument,       0, 'm'},
+        {"output",   required_argument, 0, 'o'},
+        {0, 0, 0, 0}
+    };
+
+    for (;;) {
+        c = getopt_long(argc, argv, "hvc:l:t:n:i:g:r:mo:", long_options, 0);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'h':
+                ramindex_occupancy_print_usage(argv[0]);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'v':
+                fprintf(stdout, "%s (this program) version: %s\n", argv[0], PROJECT_VER);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'c':
+                ncpus = ramindex_parse_cpus(optarg, cpus, MAX_CPUS);
+                if (ncpus <= 0) {
+                    fprintf(stderr, "Invalid list of cpus '%s' (at most %d cpus)\n",
+                        optarg, MAX_CPUS);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'l':
+                level = atoi(optarg);
+                break;
+
+            case 't':
+                type = atoi(optarg);
+                break;
+
+            case 'n':
+                rounds = atoi(optarg);
+                break;
+
+            case 'i':
+                interval = atoi(optarg);
+                break;
+
+            case 'g':
+                ncgroups = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'r':
+                root = optarg;
+                break;
+
+            case 'm':
+                metrics = 1;
+                break;
+
+            case 'o':
+                filename = optarg;
+                break;
+
+            default:
+                ramindex_occupancy_print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (optind < argc || level <= 0 || rounds < 0 || ncgroups > RAMINDEX_OCCUPANCY_MAX) {
+        ramindex_occupancy_print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    fd = open(RAMINDEX_DEVICENAME, O_RDWR);
+    if (fd == -1) {
+        fprintf(stderr, "Cannot open '%s': %s\n", RAMINDEX_DEVICENAME, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    memset(&ccsidr, 0, sizeof(ccsidr));
+    ccsidr.level = level - 1;
+    ccsidr.icache = type;
+    if (ioctl(fd, RAMINDEX_CCSIDR, &ccsidr) < 0) {
+        fprintf(stderr, "ioctl(RAMINDEX_CCSIDR) failed with code %d : %s\n",
+            errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    occupancy = calloc(ncpus, sizeof(*occupancy));
+    if (occupancy == NULL) {
+        fprintf(stderr, "Cannot allocate counts of %d cpus\n", ncpus);
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < ncpus; i++) {
+        occupancy[i].cgroups = calloc(ncgroups ? ncgroups : 1, sizeof(*occupancy[i].cgroups));
+        if (occupancy[i].cgroups == NULL) {
+            fprintf(stderr, "Cannot allocate counts of %u cgroups\n", ncgroups);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (filename && asprintf(&tmpname, "%s.tmp", filename) < 0) {
+        fprintf(stderr, "Cannot allocate name of the temporary file\n");
+        exit(EXIT_FAILURE);
+    }
+
+    signal(SIGINT, ramindex_occupancy_signal);
+    signal(SIGTERM, ramindex_occupancy_signal);
+
+    ramindex_occupancy_paths_scan(root);
+
+    for (r = 0; (rounds == 0 || r < rounds) && !ramindex_occupancy_stop; r++) {
+        if (r > 0 && interval > 0)
+            usleep(interval);
+
+        scanned = 0;
+        for (i = 0; i < ncpus; i++) {
+            if (ramindex_bind_cpu(cpus[i]) < 0) {
+                fprintf(stderr, "Cannot bind to cpu %d: %s\n", cpus[i], strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+
+            occupancy[i].level = level - 1;
+            occupancy[i].icache = type;
+            occupancy[i].ncgroups = ncgroups;
+            status = ioctl(fd, RAMINDEX_OCCUPANCY, &occupancy[i]);
+            if (status < 0) {
+                fprintf(stderr, "ioctl(RAMINDEX_OCCUPANCY) failed on cpu %d with code %d : %s\n",
+                    cpus[i], errno, strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+
+            /* cgroups created since the last scan, at most one rescan a round */
+            if (!scanned && !ramindex_occupancy_all_known(&occupancy[i])) {
+                ramindex_occupancy_paths_scan(root);
+                scanned = 1;
+            }
+        }
+
+        stream = stdout;
+        if (filename) {
+            stream = fopen(tmpname, "w");
+            if (stream == NULL) {
+                fprintf(stderr, "Cannot open '%s': %s\n", tmpname, strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        if (metrics) {
+            ramindex_occupancy_print_metrics(stream, ncpus, &ccsidr, occupancy);
+        } else {
+            for (i = 0; i < ncpus; i++)
+                ramindex_occupancy_print_table(stream, &ccsidr, &occupancy[i]);
+        }
+
+        if (filename) {
+            /* scrapers never see a partially written file */
+            if (fclose(stream) != 0 || rename(tmpname, filename) < 0) {
+                fprintf(stderr, "Cannot write '%s': %s\n", filename, strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+        } else {
+            fflush(stream);
+        }
+    }
+
+    for (i = 0; i < ncpus; i++)
+        free(occupancy[i].cgroups);
+    free(occupancy);
+    free(tmpname);
+    ramindex_occupancy_paths_free();
+    close(fd);
+
+    return 0;
+}
@@ -0,0 +1,222 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-pagemap.c
+ *
+ * Helpers translating virtual pages of a process into physical frames.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "ramindex-pagemap.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define PAGEMAP_PRESENT (1ULL << 63)
+#define PAGEMAP_PFN_MASK ((1ULL << 55) - 1)
+
+/* number of pagemap entries read at once */
+#define PAGEMAP_BATCH 512
+
+/*===========================================================================*\
+ * local types definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global (external linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) functions definitions
+\*===========================================================================*/
+static int ramindex_pagemap_compare(const void *a, const void *b)
+{
+    const struct ramindex_page *pa = a;
+    const struct ramindex_page *pb = b;
+
+    if (pa->pfn != pb->pfn)
+        return pa->pfn < pb->pfn ? -1 : 1;
+
+    return pa->vaddr < pb->vaddr ? -1 : pa->vaddr > pb->vaddr;
+}
+
+static int ramindex_pagemap_append(struct ramindex_pagemap *pagemap,
+    size_t *capacity, uint64_t vaddr, uint64_t pfn)
+{
+    struct ramindex_page *pages;
+
+    if (pagemap->npages == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 1024;
+        pages = realloc(pagemap->pages, *capacity * sizeof(*pages));
+        if (pages == NULL)
+            return -1;
+        pagemap->pages = pages;
+    }
+
+    pagemap->pages[pagemap->npages].vaddr = vaddr;
+    pagemap->pages[pagemap->npages].pfn = pfn;
+    pagemap->npages++;
+
+    return 0;
+}
+
+static int ramindex_pagemap_scan(int fd, uint64_t start, uint64_t end,
+    struct ramindex_pagemap *pagemap, size_t *capacity)
+{
+    uint64_t entries[PAGEMAP_BATCH];
+    uint64_t vaddr = start;
+    ssize_t n, i;
+    size_t count;
+
+    while (vaddr < end) {
+        count = (end - vaddr) / pagemap->pagesize;
+        if (count > PAGEMAP_BATCH)
+            count = PAGEMAP_BATCH;
+
+        n = pread(fd, entries, count * sizeof(entries[0]),
+            (vaddr / pagemap->pagesize) * sizeof(entries[0]));
+        if (n <= 0)
+            break; /* e.g. [vsyscall] cannot be read, skip the rest of such mapping */
+
+        for (i = 0; i < n / (ssize_t)sizeof(entries[0]); i++, vaddr += pagemap->pagesize)
+            if ((entries[i] & PAGEMAP_PRESENT) && (entries[i] & PAGEMAP_PFN_MASK))
+                if (ramindex_pagemap_append(pagemap, capacity, vaddr,
+                        entries[i] & PAGEMAP_PFN_MASK) < 0)
+                    return -1;
+    }
+
+    return 0;
+}
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int ramindex_pagemap_read(pid_t pid, uint64_t start, uint64_t end,
+    struct ramindex_pagemap *pagemap)
+{
+    char path[64];
+    char line[512];
+    FILE *maps;
+    int fd;
+    int status = 0;
+    size_t capacity = 0;
+    uint64_t from, to;
+
+    memset(pagemap, 0, sizeof(*pagemap));
+    pagemap->pid = pid;
+    pagemap->pagesize = sysconf(_SC_PAGESIZE);
+
+    snprintf(path, sizeof(path), "/proc/%d/maps", (int)pid);
+    maps = fopen(path, "r");
+    if (maps == NULL)
+        return -1;
+
+    snprintf(path, sizeof(path), "/proc/%d/pagemap", (int)pid);
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fclose(maps);
+        return -1;
+    }
+
+    while (status == 0 && fgets(line, sizeof(line), maps)) {
+        if (sscanf(line, "%" SCNx64 "-%" SCNx64, &from, &to) != 2)
+            continue;
+        if (from < start)
+            from = start & ~(pagemap->pagesize - 1);
+        if (to > end)
+            to = end;
+        if (from < to)
+            status = ramindex_pagemap_scan(fd, from, to, pagemap, &capacity);
+    }
+
+    close(fd);
+    fclose(maps);
+
+    if (status < 0) {
+        ramindex_pagemap_free(pagemap);
+        return -1;
+    }
+
+    qsort(pagemap->pages, pagemap->npages, sizeof(*pagemap->pages),
+        ramindex_pagemap_compare);
+
+    return 0;
+}
+
+void ramindex_pagemap_free(struct ramindex_pagemap *pagemap)
+{
+    free(pagemap->pages);
+    pagemap->pages = NULL;
+    pagemap->npages = 0;
+}
+
+const struct ramindex_page *ramindex_pagemap_find(
+    const struct ramindex_pagemap *pagemap, uint64_t pfn)
+{
+    size_t lo = 0;
+    size_t hi = pagemap->npages;
+    size_t mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (pagemap->pages[mid].pfn < pfn)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo < pagemap->npages && pagemap->pages[lo].pfn == pfn)
+        return &pagemap->pages[lo];
+
+    return NULL;
+}
+
+int ramindex_pagemap_translate(pid_t pid, uint64_t vaddr, uint64_t *paddr)
+{
+    char path[64];
+    int fd;
+    ssize_t n;
+    uint64_t entry;
+    uint64_t pagesize = sysconf(_SC_PAGESIZE);
+
+    snprintf(path, sizeof(path), "/proc/%d/pagemap", (int)pid);
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    n = pread(fd, &entry, sizeof(entry), (vaddr / pagesize) * sizeof(entry));
+    close(fd);
+
+    if (n != sizeof(entry))
+        return -1;
+
+    if (!(entry & PAGEMAP_PRESENT) || !(entry & PAGEMAP_PFN_MASK)) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    *paddr = (entry & PAGEMAP_PFN_MASK) * pagesize + (vaddr & (pagesize - 1));
+
+    return 0;
+}
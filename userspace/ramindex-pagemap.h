@@ -0,0 +1,82 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-pagemap.h
+ *
+ * Helpers translating virtual pages of a process into physical frames
+ * (via /proc/<pid>/pagemap) so that cached lines can be attributed to processes.
+ * Reading frame numbers requires CAP_SYS_ADMIN.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+#ifndef _RAMINDEX_PAGEMAP_H_
+#define _RAMINDEX_PAGEMAP_H_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <stdint.h>
+#include <sys/types.h>
+
+/*===========================================================================*\
+ * global types definitions
+\*===========================================================================*/
+
+/**
+ * struct ramindex_page - one resident page of a process
+ * @vaddr:	virtual address of the page
+ * @pfn:	physical frame number backing the page
+ */
+struct ramindex_page {
+    uint64_t vaddr;
+    uint64_t pfn;
+};
+
+/**
+ * struct ramindex_pagemap - resident pages of a process
+ * @pid:	process the pages belong to
+ * @pagesize:	size of a page (in bytes)
+ * @npages:	number of entries in @pages array
+ * @pages:	resident pages sorted by their frame numbers
+ */
+struct ramindex_pagemap {
+    pid_t pid;
+    uint64_t pagesize;
+    size_t npages;
+    struct ramindex_page *pages;
+};
+
+/*===========================================================================*\
+ * global (external linkage) functions declarations
+\*===========================================================================*/
+
+/**
+ * Collects resident pages of the process from the given virtual address range
+ * (pass 0 and UINT64_MAX to collect pages of all the mappings).
+ *
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int ramindex_pagemap_read(pid_t pid, uint64_t start, uint64_t end,
+    struct ramindex_pagemap *pagemap);
+
+/**
+ * Releases pages collected by ramindex_pagemap_read().
+ */
+void ramindex_pagemap_free(struct ramindex_pagemap *pagemap);
+
+/**
+ * Looks up a resident page backed by the given physical frame.
+ *
+ * @return found page or NULL
+ */
+const struct ramindex_page *ramindex_pagemap_find(
+    const struct ramindex_pagemap *pagemap, uint64_t pfn);
+
+/**
+ * Translates single virtual address of the process into a physical one.
+ *
+ * @return 0 on success, -1 if the page is not resident or on failure
+ */
+int ramindex_pagemap_translate(pid_t pid, uint64_t vaddr, uint64_t *paddr);
+
+#endif /* _RAMINDEX_PAGEMAP_H_ */
@@ -0,0 +1,381 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-placement.c
+ *
+ * Reports which NUMA nodes, zones and memory tiers the lines of caches
+ * hold memory of.
+ *
+ * Lines are classified by the kernel (RAMINDEX_PLACEMENT), which knows
+ * the node and the zone of every online page. Memory tiers are sets of
+ * nodes of similar performance (DRAM, CXL attached memory, ...) the kernel
+ * exports under /sys/devices/virtual/memory_tiering, so node counts are
+ * folded into tiers here. Lower tiers are the faster ones. Placement of
+ * every valid line may also be written to a file, e.g. to see which sets
+ * slow memory ends up in.
+ *
+ *     $ sudo ramindex-placement -c 0,4 -l 2,3 -p lines.txt
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <dirent.h>
+
+#include <sys/ioctl.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include <version.h>
+#include "../ramindex.h"
+#include "ramindex-snapshot.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define RAMINDEX_DEVICENAME "/dev/ramindex"
+#define RAMINDEX_TIERING_ROOT "/sys/devices/virtual/memory_tiering"
+
+#define MAX_CPUS 1024
+#define MAX_LEVELS 7
+
+/*===========================================================================*\
+ * local types definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) objects definitions
+\*===========================================================================*/
+static const char *ramindex_placement_zones[RAMINDEX_ZONE_NR] = {
+    "DMA", "DMA32", "Normal", "Movable", "Device"
+};
+
+/* memory tier of every node, -1 for nodes of no (known) tier */
+static int ramindex_placement_tiers[RAMINDEX_PLACEMENT_NODES];
+
+/*===========================================================================*\
+ * global (external linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) functions definitions
+\*===========================================================================*/
+static void ramindex_placement_print_usage(const char* progname)
+{
+    fprintf(stdout, "%s: [ OPTIONS ]\n", progname);
+    fprintf(stdout, "\t-h, --help      this message\n");
+    fprintf(stdout, "\t-v, --version   output version information\n");
+    fprintf(stdout, "\t-c, --cpus      walk caches of these cpus, e.g. 0,4 (default: 0)\n");
+    fprintf(stdout, "\t-l, --levels    select cache levels, e.g. 1-3 (default: 2)\n");
+    fprintf(stdout, "\t-t, --type      select cache type (1 for instruction cache,\n");
+    fprintf(stdout, "\t                  0 for data and unified caches, default: 0)\n");
+    fprintf(stdout, "\t-r, --root      memory tiering sysfs directory (default: %s)\n",
+        RAMINDEX_TIERING_ROOT);
+    fprintf(stdout, "\t-p, --lines     write placement of every valid line to that file\n");
+}
+
+/* tiers are memory_tier<id> directories, each with a nodelist file, e.g. "0-1" */
+static int ramindex_placement_tiers_scan(const char *root)
+{
+    DIR *dir;
+    FILE *file;
+    struct dirent *entry;
+    char path[4096], list[256];
+    int nodes[RAMINDEX_PLACEMENT_NODES];
+    int tier, nnodes, n, ntiers = 0;
+
+    for (n = 0; n < RAMINDEX_PLACEMENT_NODES; n++)
+        ramindex_placement_tiers[n] = -1;
+
+    /* kernels without memory tiering (or with one tier of all nodes) */
+    dir = opendir(root);
+    if (dir == NULL)
+        return 0;
+
+    while ((entry = readdir(dir)) != NULL) {
+        if (sscanf(entry->d_name, "memory_tier%d", &tier) != 1)
+            continue;
+
+        snprintf(path, sizeof(path), "%s/%s/nodelist", root, entry->d_name);
+        file = fopen(path, "r");
+        if (file == NULL)
+            continue;
+        if (fgets(list, sizeof(list), file) == NULL)
+            list[0] = '\0';
+        fclose(file);
+
+        list[strcspn(list, "\n")] = '\0';
+        nnodes = list[0] ? ramindex_parse_cpus(list, nodes, RAMINDEX_PLACEMENT_NODES) : 0;
+        for (n = 0; n < nnodes; n++)
+            if (nodes[n] >= 0 && nodes[n] < RAMINDEX_PLACEMENT_NODES)
+                ramindex_placement_tiers[nodes[n]] = tier;
+        ntiers++;
+    }
+
+    closedir(dir);
+
+    return ntiers;
+}
+
+static void ramindex_placement_print(int cpu, const struct ramindex_ccsidr *ccsidr,
+    const struct ramindex_placement *placement)
+{
+    uint32_t valid, dirty, local = 0, managed = 0;
+    uint32_t tier_lines[RAMINDEX_PLACEMENT_NODES] = { 0 };
+    int tier_ids[RAMINDEX_PLACEMENT_NODES];
+    int node, zone, tier, t, ntiers = 0;
+
+    fprintf(stdout, "cpu %d (node %d), L%d%c (%dx%dx%d): %u valid lines, %u unmanaged, %u of other nodes\n",
+        cpu, placement->cpu_node, ccsidr->level + 1, ccsidr->icache ? 'i' : 'd',
+        ccsidr->nsets, ccsidr->nways, ccsidr->linesize,
+        placement->nvalid, placement->nunmanaged, placement->noverflow);
+
+    fprintf(stdout, "   NODE  ZONE      TIER      LINES   SHARE     DIRTY\n");
+    for (node = 0; node < RAMINDEX_PLACEMENT_NODES; node++) {
+        for (zone = 0; zone < RAMINDEX_ZONE_NR; zone++) {
+            valid = placement->valid[node][zone];
+            dirty = placement->dirty[node][zone];
+            if (valid == 0)
+                continue;
+
+            tier = ramindex_placement_tiers[node];
+            if (tier >= 0)
+                fprintf(stdout, "%7d  %-8s %5d", node, ramindex_placement_zones[zone], tier);
+            else
+                fprintf(stdout, "%7d  %-8s %5s", node, ramindex_placement_zones[zone], "-");
+            fprintf(stdout, " %10u %6.2f%% %9u\n", valid,
+                placement->nvalid ? valid * 100.0 / placement->nvalid : 0.0, dirty);
+
+            managed += valid;
+            if (node == placement->cpu_node)
+                local += valid;
+
+            /* few tiers, so they are just searched for */
+            for (t = 0; t < ntiers && tier_ids[t] != tier; t++)
+                ;
+            if (t == ntiers)
+                tier_ids[ntiers++] = tier;
+            tier_lines[t] += valid;
+        }
+    }
+
+    for (t = 0; t < ntiers; t++) {
+        if (tier_ids[t] >= 0)
+            fprintf(stdout, "   tier %d: %u lines (%.2f%%)\n", tier_ids[t], tier_lines[t],
+                tier_lines[t] * 100.0 / managed);
+        else
+            fprintf(stdout, "   no tier: %u lines (%.2f%%)\n", tier_lines[t],
+                tier_lines[t] * 100.0 / managed);
+    }
+
+    if (managed)
+        fprintf(stdout, "   local node: %u lines (%.2f%%), remote nodes: %u lines (%.2f%%)\n",
+            local, local * 100.0 / managed, managed - local, (managed - local) * 100.0 / managed);
+}
+
+static void ramindex_placement_print_lines(FILE *stream, int cpu, const struct ramindex_ccsidr *ccsidr,
+    const struct ramindex_placement *placement)
+{
+    uint32_t n;
+    int tier;
+
+    for (n = 0; n < placement->nlines; n++) {
+        const struct ramindex_line_placement *lp = &placement->lines[n];
+
+        if (lp->node < 0)
+            continue;
+
+        fprintf(stream, "%d L%d%c %u %u %d %s ", cpu, ccsidr->level + 1, ccsidr->icache ? 'i' : 'd',
+            n / ccsidr->nways, n % ccsidr->nways, lp->node,
+            lp->zone >= 0 && lp->zone < RAMINDEX_ZONE_NR ? ramindex_placement_zones[lp->zone] : "-");
+        tier = lp->node < RAMINDEX_PLACEMENT_NODES ? ramindex_placement_tiers[lp->node] : -1;
+        if (tier >= 0)
+            fprintf(stream, "%d\n", tier);
+        else
+            fprintf(stream, "-\n");
+    }
+}
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int main(int argc, char *argv[])
+{
+    int c, fd, status, i, l;
+    FILE *stream = NULL;
+    struct ramindex_ccsidr ccsidr;
+    struct ramindex_placement *placement;
+    // cmdline options
+    int cpus[MAX_CPUS] = { 0 };
+    int ncpus = 1;
+    int levels[MAX_LEVELS] = { 2 };
+    int nlevels = 1;
+    int type = 0;
+    const char *root = RAMINDEX_TIERING_ROOT;
+    const char *filename = NULL;
+
+    static struct option long_options[] = {
+        {"help",     no_argument,       0, 'h'},
+        {"version",  no_argument,       0, 'v'},
+        {"cpus",     required_argument, 0, 'c'},
+        {"levels",   required_argument, 0, 'l'},
+        {"type",     required_argument, 0, 't'},
+        {"root",     required_argument, 0, 'r'},
+        {"lines",    required_argument, 0, 'p'},
+        {0, 0, 0, 0}
+    };
+
+    for (;;) {
+        c = getopt_long(argc, argv, "hvc:l:t:r:p:", long_options, 0);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'h':
+                ramindex_placement_print_usage(argv[0]);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'v':
+                fprintf(stdout, "%s (this program) version: %s\n", argv[0], PROJECT_VER);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'c':
+                ncpus = ramindex_parse_cpus(optarg, cpus, MAX_CPUS);
+                if (ncpus <= 0) {
+                    fprintf(stderr, "Invalid list of cpus '%s' (at most %d cpus)\n",
+                        optarg, MAX_CPUS);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'l':
+                nlevels = ramindex_parse_cpus(optarg, levels, MAX_LEVELS);
+                if (nlevels <= 0) {
+                    fprintf(stderr, "Invalid list of levels '%s' (at most %d levels)\n",
+                        optarg, MAX_LEVELS);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 't':
+                type = atoi(optarg);
+                break;
+
+            case 'r':
+                root = optarg;
+                break;
+
+            case 'p':
+                filename = optarg;
+                break;
+
+            default:
+                ramindex_placement_print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (optind < argc) {
+        ramindex_placement_print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    for (l = 0; l < nlevels; l++) {
+        if (levels[l] <= 0 || levels[l] > MAX_LEVELS) {
+            fprintf(stderr, "Invalid cache level %d\n", levels[l]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    fd = open(RAMINDEX_DEVICENAME, O_RDWR);
+    if (fd == -1) {
+        fprintf(stderr, "Cannot open '%s': %s\n", RAMINDEX_DEVICENAME, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    if (filename) {
+        stream = fopen(filename, "w");
+        if (stream == NULL) {
+            fprintf(stderr, "Cannot open '%s': %s\n", filename, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        fprintf(stream, "# cpu cache set way node zone tier\n");
+    }
+
+    if (ramindex_placement_tiers_scan(root) == 0)
+        fprintf(stdout, "no memory tiers found in '%s'\n", root);
+
+    placement = calloc(1, sizeof(*placement));
+    if (placement == NULL) {
+        fprintf(stderr, "Cannot allocate counts\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (l = 0; l < nlevels; l++) {
+        memset(&ccsidr, 0, sizeof(ccsidr));
+        ccsidr.level = levels[l] - 1;
+        ccsidr.icache = type;
+        if (ioctl(fd, RAMINDEX_CCSIDR, &ccsidr) < 0) {
+            fprintf(stderr, "ioctl(RAMINDEX_CCSIDR) failed for level %d with code %d : %s\n",
+                levels[l], errno, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        free(placement->lines);
+        memset(placement, 0, sizeof(*placement));
+        if (filename) {
+            placement->lines = calloc((size_t)ccsidr.nsets * ccsidr.nways, sizeof(*placement->lines));
+            if (placement->lines == NULL) {
+                fprintf(stderr, "Cannot allocate placement of %d lines\n", ccsidr.nsets * ccsidr.nways);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        for (i = 0; i < ncpus; i++) {
+            if (ramindex_bind_cpu(cpus[i]) < 0) {
+                fprintf(stderr, "Cannot bind to cpu %d: %s\n", cpus[i], strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+
+            placement->level = levels[l] - 1;
+            placement->icache = type;
+            placement->flags = 0;
+            placement->nlines = filename ? ccsidr.nsets * ccsidr.nways : 0;
+            status = ioctl(fd, RAMINDEX_PLACEMENT, placement);
+            if (status < 0) {
+                fprintf(stderr, "ioctl(RAMINDEX_PLACEMENT) failed on cpu %d with code %d : %s\n",
+                    cpus[i], errno, strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+
+            ramindex_placement_print(cpus[i], &ccsidr, placement);
+            if (stream)
+                ramindex_placement_print_lines(stream, cpus[i], &ccsidr, placement);
+        }
+    }
+
+    if (stream && fclose(stream) != 0) {
+        fprintf(stderr, "Cannot write '%s': %s\n", filename, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    free(placement->lines);
+    free(placement);
+    close(fd);
+
+    return 0;
+}
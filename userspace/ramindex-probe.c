@@ -0,0 +1,264 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-probe.c
+ *
+ * Sparse probing of caches - many selections, possibly of different caches,
+ * dumped by one RAMINDEX_DUMPV ioctl.
+ *
+ * Every selection is given as <level>[d|i][:<set>[+<nsets>]][:<waymask>],
+ * e.g. '1d:12' (set 12 of L1 data cache), '2:100+4:0x3' (ways 0 and 1
+ * of sets 100-103 of L2 cache), '1i' (whole L1 instruction cache).
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sched.h>
+
+#include <sys/ioctl.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include <version.h>
+#include "ramindex-snapshot.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define RAMINDEX_DEVICENAME "/dev/ramindex"
+
+/*===========================================================================*\
+ * local types definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global (external linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) functions definitions
+\*===========================================================================*/
+static void ramindex_probe_print_usage(const char* progname)
+{
+    fprintf(stdout, "%s: [ OPTIONS ] SELECTION...\n", progname);
+    fprintf(stdout, "\t-h, --help     this message\n");
+    fprintf(stdout, "\t-v, --version  output version information\n");
+    fprintf(stdout, "\t-c, --cpu      probe caches of that cpu (default: -1, any cpu)\n");
+    fprintf(stdout, "\t-T, --tags     dump only tags (and state) of the lines\n");
+    fprintf(stdout, "\tSELECTION is <level>[d|i][:<set>[+<nsets>]][:<waymask>], e.g. 1d:12 2:100+4:0x3\n");
+}
+
+static int ramindex_probe_parse(const char *spec, struct ramindex_vec_entry *entry)
+{
+    char *end;
+
+    memset(entry, 0, sizeof(*entry));
+    entry->set = -1;
+
+    entry->level = strtol(spec, &end, 10) - 1;
+    if (end == spec || entry->level < 0)
+        return -1;
+
+    if (*end == 'i')
+        entry->icache = 1, end++;
+    else if (*end == 'd' || *end == 'u')
+        end++;
+
+    if (*end == ':') {
+        spec = end + 1;
+        entry->set = strtol(spec, &end, 0);
+        if (end == spec || entry->set < 0)
+            return -1;
+        if (*end == '+') {
+            spec = end + 1;
+            entry->nsets = strtol(spec, &end, 0);
+            if (end == spec || entry->nsets <= 0)
+                return -1;
+        }
+    }
+
+    if (*end == ':') {
+        spec = end + 1;
+        entry->ways = strtoull(spec, &end, 0);
+        if (end == spec || entry->ways == 0)
+            return -1;
+    }
+
+    return *end == '\0' ? 0 : -1;
+}
+
+static uint32_t ramindex_probe_nlines(const struct ramindex_vec_entry *entry,
+    const struct ramindex_ccsidr *ccsidr)
+{
+    uint32_t nsets = entry->set < 0 ? ccsidr->nsets : (entry->nsets > 1 ? entry->nsets : 1);
+    uint32_t nways = entry->ways ? __builtin_popcountll(entry->ways) : ccsidr->nways;
+
+    return nsets * nways;
+}
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int main(int argc, char *argv[])
+{
+    int fd;
+    int c, i, n;
+    uint32_t nlines, linesize;
+    struct ramindex_vec_selector vs;
+    struct ramindex_vec_entry *entries;
+    struct ramindex_ccsidr *ccsidrs;
+    struct ramindex_cacheline *lines;
+    struct ramindex_snapshot view;
+    uint8_t *data;
+    // cmdline options
+    int cpu = -1;
+    int tags = 0;
+
+    static struct option long_options[] = {
+        {"help",    no_argument,       0, 'h'},
+        {"version", no_argument,       0, 'v'},
+        {"cpu",     required_argument, 0, 'c'},
+        {"tags",    no_argument,       0, 'T'},
+        {0, 0, 0, 0}
+    };
+
+    for (;;) {
+        c = getopt_long(argc, argv, "hvc:T", long_options, 0);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'h':
+                ramindex_probe_print_usage(argv[0]);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'v':
+                fprintf(stdout, "%s (this program) version: %s\n", argv[0], PROJECT_VER);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'c':
+                cpu = atoi(optarg);
+                break;
+
+            case 'T':
+                tags = 1;
+                break;
+
+            default:
+                ramindex_probe_print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    n = argc - optind;
+    if (n <= 0 || n > RAMINDEX_DUMPV_MAX) {
+        ramindex_probe_print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (cpu >= 0 && ramindex_bind_cpu(cpu) < 0) {
+        fprintf(stderr, "Cannot bind to cpu %d: %s\n", cpu, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    fd = open(RAMINDEX_DEVICENAME, O_RDWR);
+    if (fd == -1) {
+        fprintf(stderr, "Cannot open '%s': %s\n",
+            RAMINDEX_DEVICENAME, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    entries = calloc(n, sizeof(*entries));
+    ccsidrs = calloc(n, sizeof(*ccsidrs));
+    if (entries == NULL || ccsidrs == NULL) {
+        fprintf(stderr, "Cannot allocate %d selections\n", n);
+        exit(EXIT_FAILURE);
+    }
+
+    /* geometries are needed here only to size the buffers */
+    nlines = 0;
+    linesize = 0;
+    for (i = 0; i < n; i++) {
+        if (ramindex_probe_parse(argv[optind + i], &entries[i]) < 0) {
+            fprintf(stderr, "Invalid selection '%s'\n", argv[optind + i]);
+            exit(EXIT_FAILURE);
+        }
+        entries[i].flags = tags ? RAMINDEX_DUMP_F_TAGS_ONLY : 0;
+
+        ccsidrs[i].level = entries[i].level;
+        ccsidrs[i].icache = entries[i].icache;
+        if (ioctl(fd, RAMINDEX_CCSIDR, &ccsidrs[i]) < 0) {
+            fprintf(stderr, "ioctl(RAMINDEX_CCSIDR) failed with code %d : %s\n",
+                errno, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        nlines += ramindex_probe_nlines(&entries[i], &ccsidrs[i]);
+        if (!tags && ccsidrs[i].linesize > linesize)
+            linesize = ccsidrs[i].linesize;
+    }
+
+    lines = calloc(nlines, sizeof(*lines));
+    data = linesize ? malloc((size_t)nlines * linesize) : NULL;
+    if (lines == NULL || (linesize && data == NULL)) {
+        fprintf(stderr, "Cannot allocate %u lines\n", nlines);
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < (int)nlines; i++) {
+        lines[i].linesize = linesize;
+        lines[i].linedata = data ? data + (size_t)i * linesize : NULL;
+    }
+
+    memset(&vs, 0, sizeof(vs));
+    vs.nentries = n;
+    vs.entries = entries;
+    vs.nlines = nlines;
+    vs.lines = lines;
+    if (ioctl(fd, RAMINDEX_DUMPV, &vs) < 0) {
+        fprintf(stderr, "ioctl(RAMINDEX_DUMPV) failed with code %d : %s\n",
+            errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(stdout, "CPU %d\n", vs.cpu);
+
+    /* lines of every selection are printed through a snapshot viewing them */
+    memset(&view, 0, sizeof(view));
+    view.lines = lines;
+    for (i = 0; i < n; i++) {
+        fprintf(stdout, "Selection '%s': L%d '%s' cache, %u lines\n", argv[optind + i],
+            entries[i].level + 1, entries[i].icache ? "instruction" : "data/unified",
+            entries[i].nlines);
+        view.ccsidr = ccsidrs[i];
+        view.nlines = entries[i].nlines;
+        ramindex_snapshot_print(stdout, &view);
+        view.lines += entries[i].nlines;
+    }
+
+    free(data);
+    free(lines);
+    free(ccsidrs);
+    free(entries);
+    close(fd);
+
+    return 0;
+}
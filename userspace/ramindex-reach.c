@@ -0,0 +1,460 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-reach.c
+ *
+ * TLB contents and TLB reach analysis.
+ *
+ * Dumps L1 and L2 TLBs of a selected cpu and reports which page sizes
+ * the resident translations use, how they are spread across ASIDs/VMIDs
+ * and how much memory translations of every selected process cover (TLB reach).
+ * Non global translations are attributed to a process by matching their
+ * virtual and physical addresses against its pagemap; all the translations
+ * tagged with the ASID found that way are then counted as belonging to it.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include <version.h>
+#include "ramindex-snapshot.h"
+#include "ramindex-pagemap.h"
+#include "ramindex-tlb.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define RAMINDEX_DEVICENAME "/dev/ramindex"
+
+#define MAX_PIDS 64
+#define MAX_PAGESIZES 16
+#define MAX_ASIDS 1024
+
+/*===========================================================================*\
+ * local types definitions
+\*===========================================================================*/
+struct ramindex_reach_mix {
+    size_t n;
+    uint64_t pagesize[MAX_PAGESIZES];
+    uint64_t entries[MAX_PAGESIZES];
+};
+
+struct ramindex_reach_asid {
+    uint16_t vmid;
+    uint16_t asid;
+    pid_t pid;        /* 0 if not attributed to any of the selected processes */
+    uint64_t entries;
+    uint64_t reach;
+};
+
+struct ramindex_reach_process {
+    struct ramindex_pagemap pagemap;
+    uint64_t entries;
+    uint64_t reach;
+    struct ramindex_reach_mix mix;
+};
+
+struct ramindex_reach_report {
+    size_t nasids;
+    struct ramindex_reach_asid asids[MAX_ASIDS];
+    uint64_t global_entries;
+    uint64_t global_reach;
+    size_t nprocesses;
+    struct ramindex_reach_process processes[MAX_PIDS];
+};
+
+/*===========================================================================*\
+ * local (internal linkage) objects definitions
+\*===========================================================================*/
+static const struct {
+    int level;
+    int itlb;
+} ramindex_reach_tlbs[] = {
+    {1, 1},
+    {1, 0},
+    {2, 0},
+};
+
+/*===========================================================================*\
+ * global (external linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) functions definitions
+\*===========================================================================*/
+static void ramindex_reach_print_usage(const char* progname)
+{
+    fprintf(stdout, "%s: [ OPTIONS ]\n", progname);
+    fprintf(stdout, "\t-h, --help     this message\n");
+    fprintf(stdout, "\t-v, --version  output version information\n");
+    fprintf(stdout, "\t-c, --cpu      dump TLBs of that cpu (default: 0)\n");
+    fprintf(stdout, "\t-p, --pid      attribute translations to that process (may be repeated)\n");
+    fprintf(stdout, "\t-r, --raw      print all the dumped entries as well\n");
+}
+
+static void ramindex_reach_mix_add(struct ramindex_reach_mix *mix, uint64_t pagesize)
+{
+    size_t n;
+
+    for (n = 0; n < mix->n; n++)
+        if (mix->pagesize[n] == pagesize)
+            break;
+
+    if (n == mix->n) {
+        if (mix->n == MAX_PAGESIZES)
+            return;
+        /* keep page sizes sorted in ascending order */
+        for (; n > 0 && mix->pagesize[n - 1] > pagesize; n--) {
+            mix->pagesize[n] = mix->pagesize[n - 1];
+            mix->entries[n] = mix->entries[n - 1];
+        }
+        mix->pagesize[n] = pagesize;
+        mix->entries[n] = 0;
+        mix->n++;
+    }
+
+    mix->entries[n]++;
+}
+
+static const char *ramindex_reach_size(uint64_t size, char *buf, size_t len)
+{
+    static const char units[] = "KMGT";
+    int n;
+
+    if (size < 1024 || size % 1024) {
+        snprintf(buf, len, "%llu", (unsigned long long)size);
+        return buf;
+    }
+
+    for (n = 0, size /= 1024; n < 3 && size >= 1024 && size % 1024 == 0; n++)
+        size /= 1024;
+
+    snprintf(buf, len, "%llu%c", (unsigned long long)size, units[n]);
+
+    return buf;
+}
+
+static void ramindex_reach_mix_print(const struct ramindex_reach_mix *mix)
+{
+    char buf[32];
+    size_t n;
+
+    for (n = 0; n < mix->n; n++)
+        fprintf(stdout, " %s:%llu",
+            ramindex_reach_size(mix->pagesize[n], buf, sizeof(buf)),
+            (unsigned long long)mix->entries[n]);
+    fprintf(stdout, "\n");
+}
+
+static struct ramindex_reach_asid *ramindex_reach_asid(
+    struct ramindex_reach_report *report, uint16_t vmid, uint16_t asid)
+{
+    size_t n;
+
+    for (n = 0; n < report->nasids; n++)
+        if (report->asids[n].vmid == vmid && report->asids[n].asid == asid)
+            return &report->asids[n];
+
+    if (report->nasids == MAX_ASIDS)
+        return NULL;
+
+    report->asids[n].vmid = vmid;
+    report->asids[n].asid = asid;
+
+    return &report->asids[report->nasids++];
+}
+
+/**
+ * Returns non zero if the translation maps a page resident in the pagemap,
+ * i.e. the page backed by the first frame of the translated region
+ * is mapped at the translated virtual address.
+ */
+static int ramindex_reach_match(const struct ramindex_pagemap *pagemap,
+    const struct ramindex_tlbentry *e)
+{
+    uint64_t pfn = e->pa / pagemap->pagesize;
+    uint64_t vaddr = e->va & ~(pagemap->pagesize - 1);
+    const struct ramindex_page *page = ramindex_pagemap_find(pagemap, pfn);
+    const struct ramindex_page *end = pagemap->pages + pagemap->npages;
+
+    for (; page != NULL && page < end && page->pfn == pfn; page++)
+        if (page->vaddr == vaddr)
+            return 1;
+
+    return 0;
+}
+
+static void ramindex_reach_account(struct ramindex_reach_report *report,
+    const struct ramindex_tlb_snapshot *snapshot)
+{
+    uint32_t n;
+    size_t i;
+
+    for (n = 0; n < snapshot->nentries; n++) {
+        const struct ramindex_tlbentry *e = &snapshot->entries[n];
+        struct ramindex_reach_asid *a;
+
+        if (!e->valid || e->global)
+            continue;
+
+        a = ramindex_reach_asid(report, e->vmid, e->asid);
+        if (a == NULL || a->pid)
+            continue;
+
+        for (i = 0; i < report->nprocesses; i++)
+            if (ramindex_reach_match(&report->processes[i].pagemap, e)) {
+                a->pid = report->processes[i].pagemap.pid;
+                break;
+            }
+    }
+}
+
+static void ramindex_reach_print_tlb(struct ramindex_reach_report *report,
+    const struct ramindex_tlb_snapshot *snapshot)
+{
+    struct ramindex_reach_mix mix;
+    uint64_t valid = 0;
+    uint64_t unverified = 0;
+    uint64_t reach = 0;
+    char buf[32];
+    uint32_t n;
+    size_t i;
+
+    memset(&mix, 0, sizeof(mix));
+
+    for (n = 0; n < snapshot->nentries; n++) {
+        const struct ramindex_tlbentry *e = &snapshot->entries[n];
+        struct ramindex_reach_asid *a;
+
+        if (!e->valid)
+            continue;
+
+        valid++;
+        unverified += e->unverified;
+        reach += e->pagesize;
+        ramindex_reach_mix_add(&mix, e->pagesize);
+
+        if (e->global) {
+            report->global_entries++;
+            report->global_reach += e->pagesize;
+            continue;
+        }
+
+        a = ramindex_reach_asid(report, e->vmid, e->asid);
+        if (a == NULL)
+            continue;
+
+        a->entries++;
+        a->reach += e->pagesize;
+
+        for (i = 0; i < report->nprocesses; i++) {
+            struct ramindex_reach_process *p = &report->processes[i];
+            if (p->pagemap.pid == a->pid) {
+                p->entries++;
+                p->reach += e->pagesize;
+                ramindex_reach_mix_add(&p->mix, e->pagesize);
+            }
+        }
+    }
+
+    fprintf(stdout, "%s: %d sets, %d ways, %llu valid entries, reach %s\n",
+        ramindex_tlb_name(&snapshot->geometry),
+        snapshot->geometry.nsets, snapshot->geometry.nways,
+        (unsigned long long)valid, ramindex_reach_size(reach, buf, sizeof(buf)));
+    fprintf(stdout, "\tpage sizes:");
+    ramindex_reach_mix_print(&mix);
+    if (unverified)
+        fprintf(stdout, "\t%llu entries decoded by an unverified layout (see --raw)\n",
+            (unsigned long long)unverified);
+}
+
+static void ramindex_reach_print(const struct ramindex_reach_report *report)
+{
+    char buf[32];
+    size_t n;
+
+    fprintf(stdout, "\n VMID  ASID  ENTRIES      REACH      PID\n");
+    for (n = 0; n < report->nasids; n++) {
+        const struct ramindex_reach_asid *a = &report->asids[n];
+        if (a->entries == 0)
+            continue;
+        fprintf(stdout, "%5u %5u %8llu %10s ", a->vmid, a->asid,
+            (unsigned long long)a->entries,
+            ramindex_reach_size(a->reach, buf, sizeof(buf)));
+        if (a->pid)
+            fprintf(stdout, "%8d\n", (int)a->pid);
+        else
+            fprintf(stdout, "%8s\n", "-");
+    }
+    fprintf(stdout, "global %10llu %10s\n",
+        (unsigned long long)report->global_entries,
+        ramindex_reach_size(report->global_reach, buf, sizeof(buf)));
+
+    for (n = 0; n < report->nprocesses; n++) {
+        const struct ramindex_reach_process *p = &report->processes[n];
+
+        fprintf(stdout, "\nPID %d: %zu resident pages, %llu resident translations, reach %s",
+            (int)p->pagemap.pid, p->pagemap.npages, (unsigned long long)p->entries,
+            ramindex_reach_size(p->reach, buf, sizeof(buf)));
+        fprintf(stdout, " (%.1f%% of resident memory)\n", p->pagemap.npages ?
+            100.0 * p->reach / ((double)p->pagemap.npages * p->pagemap.pagesize) : 0.0);
+        fprintf(stdout, "\tpage sizes:");
+        ramindex_reach_mix_print(&p->mix);
+    }
+}
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int main(int argc, char *argv[])
+{
+    int c;
+    int fd;
+    int status;
+    size_t n;
+    size_t nsnapshots = 0;
+    struct ramindex_tlb_snapshot snapshots[sizeof(ramindex_reach_tlbs) / sizeof(ramindex_reach_tlbs[0])];
+    struct ramindex_reach_report *report;
+    // cmdline options
+    int cpu = 0;
+    int raw = 0;
+
+    static struct option long_options[] = {
+        {"help",    no_argument,       0, 'h'},
+        {"version", no_argument,       0, 'v'},
+        {"cpu",     required_argument, 0, 'c'},
+        {"pid",     required_argument, 0, 'p'},
+        {"raw",     no_argument,       0, 'r'},
+        {0, 0, 0, 0}
+    };
+
+    report = calloc(1, sizeof(*report));
+    if (report == NULL) {
+        fprintf(stderr, "calloc(1, %zu) failed\n", sizeof(*report));
+        exit(EXIT_FAILURE);
+    }
+
+    for (;;) {
+        c = getopt_long(argc, argv, "hvc:p:r", long_options, 0);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'h':
+                ramindex_reach_print_usage(argv[0]);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'v':
+                fprintf(stdout, "%s (this program) version: %s\n", argv[0], PROJECT_VER);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'c':
+                cpu = atoi(optarg);
+                break;
+
+            case 'p':
+                if (report->nprocesses == MAX_PIDS) {
+                    fprintf(stderr, "At most %d processes can be selected\n", MAX_PIDS);
+                    exit(EXIT_FAILURE);
+                }
+                status = ramindex_pagemap_read(atoi(optarg), 0, UINT64_MAX,
+                    &report->processes[report->nprocesses].pagemap);
+                if (status < 0) {
+                    fprintf(stderr, "Cannot read pagemap of process %s: %s\n",
+                        optarg, strerror(errno));
+                    exit(EXIT_FAILURE);
+                }
+                report->nprocesses++;
+                break;
+
+            case 'r':
+                raw = 1;
+                break;
+
+            default:
+                ramindex_reach_print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (optind < argc || cpu < 0) {
+        ramindex_reach_print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (ramindex_bind_cpu(cpu) < 0) {
+        fprintf(stderr, "Cannot bind to cpu %d: %s\n", cpu, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    fd = open(RAMINDEX_DEVICENAME, O_RDWR);
+    if (fd == -1) {
+        fprintf(stderr, "cannot open '%s': %s\n",
+            RAMINDEX_DEVICENAME, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    /* dump all the TLBs first, so the analysis does not pollute them */
+    for (n = 0; n < sizeof(ramindex_reach_tlbs) / sizeof(ramindex_reach_tlbs[0]); n++) {
+        status = ramindex_tlb_capture(fd, ramindex_reach_tlbs[n].level,
+            ramindex_reach_tlbs[n].itlb, &snapshots[nsnapshots]);
+        if (status < 0) {
+            if (errno == EOPNOTSUPP)
+                continue;
+            fprintf(stderr, "Cannot dump L%d %s TLB: %s\n", ramindex_reach_tlbs[n].level,
+                ramindex_reach_tlbs[n].itlb ? "instruction" : "data", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        if (snapshots[nsnapshots].cpu != cpu) {
+            fprintf(stderr, "L%d %s TLB dumped on cpu %d instead of %d\n",
+                ramindex_reach_tlbs[n].level, ramindex_reach_tlbs[n].itlb ? "instruction" : "data",
+                snapshots[nsnapshots].cpu, cpu);
+            exit(EXIT_FAILURE);
+        }
+        nsnapshots++;
+    }
+
+    close(fd);
+
+    if (nsnapshots == 0) {
+        fprintf(stderr, "No TLB of cpu %d can be dumped\n", cpu);
+        exit(EXIT_FAILURE);
+    }
+
+    for (n = 0; n < nsnapshots; n++)
+        ramindex_reach_account(report, &snapshots[n]);
+
+    fprintf(stdout, "CPU %d\n", cpu);
+    for (n = 0; n < nsnapshots; n++) {
+        ramindex_reach_print_tlb(report, &snapshots[n]);
+        if (raw)
+            ramindex_tlb_print(stdout, &snapshots[n]);
+    }
+
+    ramindex_reach_print(report);
+
+    for (n = 0; n < nsnapshots; n++)
+        ramindex_tlb_free(&snapshots[n]);
+    for (n = 0; n < report->nprocesses; n++)
+        ramindex_pagemap_free(&report->processes[n].pagemap);
+    free(report);
+
+    return 0;
+}
@@ -0,0 +1,616 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-share.c
+ *
+ * False sharing detection based on synchronized snapshots of private caches.
+ *
+ * Tags of the selected cache (L1 data cache by default) are dumped on a set
+ * of cpus at once (see RAMINDEX_SYNC_DUMP), repeatedly. Physical lines which
+ * are held dirty or unique (i.e. written) by more than one cpu over the rounds
+ * are lines bouncing between the cores; the more often their writer changes,
+ * the more expensive the ping-pong. As only tags are read, the tool cannot tell
+ * true sharing from false sharing - it points at the lines worth looking at.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include <sys/ioctl.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include <version.h>
+#include "ramindex-snapshot.h"
+#include "ramindex-pagemap.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define RAMINDEX_DEVICENAME "/dev/ramindex"
+
+#define MAX_CPUS 64
+#define MAX_PIDS 64
+
+/*===========================================================================*\
+ * local types definitions
+\*===========================================================================*/
+struct ramindex_share_line {
+    uint64_t key;           /* physical address of the line | ns bit */
+    uint8_t used;
+    int8_t last_writer;     /* index of the cpu which wrote the line most recently */
+    uint32_t rounds;        /* rounds the line was cached in */
+    uint32_t shared;        /* rounds the line was cached by more than one cpu */
+    uint32_t contended;     /* rounds the line was written by more than one cpu */
+    uint32_t transfers;     /* times the writer changed between rounds */
+    uint64_t holders;       /* cpus (indices) which cached the line */
+    uint64_t writers;       /* cpus (indices) which held the line dirty or unique */
+    uint64_t round_holders; /* the same, but for the current round only */
+    uint64_t round_writers;
+};
+
+struct ramindex_share_report {
+    uint32_t linesize;
+    size_t ncpus;
+    int cpus[MAX_CPUS];     /* index -> cpu */
+    uint32_t nrounds;
+    uint32_t ntimedout;     /* rounds in which some cpus gave up waiting for others */
+    uint64_t max_skew_ns;
+    uint64_t sum_skew_ns;
+    size_t size;            /* capacity of the hash table (power of 2) */
+    size_t nlines;
+    struct ramindex_share_line *lines;
+    size_t ntouched;        /* lines cached in the current round */
+    uint64_t *touched;
+    size_t nprocesses;
+    struct ramindex_pagemap pagemaps[MAX_PIDS];
+};
+
+/*===========================================================================*\
+ * local (internal linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * global (external linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) functions definitions
+\*===========================================================================*/
+static void ramindex_share_print_usage(const char* progname)
+{
+    fprintf(stdout, "%s: [ OPTIONS ] [ snapshot... ]\n", progname);
+    fprintf(stdout, "\t-h, --help      this message\n");
+    fprintf(stdout, "\t-v, --version   output version information\n");
+    fprintf(stdout, "\t-c, --cpus      capture caches of these cpus (e.g. 0-3,6),\n");
+    fprintf(stdout, "\t                  snapshots are analysed if not given\n");
+    fprintf(stdout, "\t-l, --level     select cache level (default: 1)\n");
+    fprintf(stdout, "\t-n, --rounds    number of synchronized captures (default: 10)\n");
+    fprintf(stdout, "\t-i, --interval  time between captures in microseconds (default: 1000)\n");
+    fprintf(stdout, "\t-o, --output    write captured snapshots to a file as well\n");
+    fprintf(stdout, "\t-p, --pid       attribute lines to that process (may be repeated)\n");
+    fprintf(stdout, "\t-m, --max       number of reported lines (default: 20)\n");
+}
+
+static void *ramindex_share_calloc(size_t n, size_t size)
+{
+    void *p = calloc(n, size);
+
+    if (p == NULL) {
+        fprintf(stderr, "calloc(%zu, %zu) failed\n", n, size);
+        exit(EXIT_FAILURE);
+    }
+
+    return p;
+}
+
+static int ramindex_share_cpu_index(struct ramindex_share_report *report, int cpu)
+{
+    size_t n;
+
+    for (n = 0; n < report->ncpus; n++)
+        if (report->cpus[n] == cpu)
+            return n;
+
+    if (report->ncpus == MAX_CPUS)
+        return -1;
+
+    report->cpus[report->ncpus] = cpu;
+
+    return report->ncpus++;
+}
+
+static size_t ramindex_share_slot(const struct ramindex_share_report *report, uint64_t key)
+{
+    size_t slot = (size_t)((key >> 4) * 0x9e3779b97f4a7c15ULL) & (report->size - 1);
+
+    while (report->lines[slot].used && report->lines[slot].key != key)
+        slot = (slot + 1) & (report->size - 1);
+
+    return slot;
+}
+
+static struct ramindex_share_line *ramindex_share_lookup(
+    struct ramindex_share_report *report, uint64_t key)
+{
+    struct ramindex_share_line *l;
+    size_t n;
+
+    /* keep load factor below 1/2 */
+    if (2 * (report->nlines + 1) > report->size) {
+        struct ramindex_share_line *lines = report->lines;
+        size_t size = report->size;
+
+        report->size = size ? 2 * size : 4096;
+        report->lines = ramindex_share_calloc(report->size, sizeof(*report->lines));
+        for (n = 0; n < size; n++)
+            if (lines[n].used)
+                report->lines[ramindex_share_slot(report, lines[n].key)] = lines[n];
+        free(lines);
+    }
+
+    l = &report->lines[ramindex_share_slot(report, key)];
+    if (!l->used) {
+        l->used = 1;
+        l->key = key;
+        l->last_writer = -1;
+        report->nlines++;
+    }
+
+    return l;
+}
+
+static void ramindex_share_account(struct ramindex_share_report *report,
+    const struct ramindex_snapshot *snapshot)
+{
+    struct ramindex_share_line *l;
+    uint32_t n;
+    int index;
+
+    index = ramindex_share_cpu_index(report, snapshot->cpu);
+    if (index < 0) {
+        fprintf(stderr, "At most %d cpus can be analysed\n", MAX_CPUS);
+        exit(EXIT_FAILURE);
+    }
+
+    report->touched = realloc(report->touched,
+        (report->ntouched + snapshot->nlines) * sizeof(*report->touched));
+    if (report->touched == NULL && report->ntouched + snapshot->nlines) {
+        fprintf(stderr, "realloc() failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (n = 0; n < snapshot->nlines; n++) {
+        const struct ramindex_cacheline *cl = &snapshot->lines[n];
+
+        if (!cl->valid)
+            continue;
+
+        l = ramindex_share_lookup(report,
+            (cl->tag & ~((uint64_t)report->linesize - 1)) | (cl->ns & 1));
+
+        if (!l->round_holders)
+            report->touched[report->ntouched++] = l->key;
+
+        l->round_holders |= 1ULL << index;
+        if (cl->dirty || cl->state == CSTATE_UNIQUE_CLEAN ||
+            cl->state == CSTATE_UNIQUE_DIRTY || cl->state == CSTATE_SHARED_DIRTY)
+            l->round_writers |= 1ULL << index;
+    }
+}
+
+static void ramindex_share_end_round(struct ramindex_share_report *report)
+{
+    struct ramindex_share_line *l;
+    size_t n;
+
+    for (n = 0; n < report->ntouched; n++) {
+        l = &report->lines[ramindex_share_slot(report, report->touched[n])];
+
+        l->rounds++;
+        if (__builtin_popcountll(l->round_holders) > 1)
+            l->shared++;
+        if (__builtin_popcountll(l->round_writers) > 1)
+            l->contended++;
+
+        if (l->round_writers) {
+            if (l->last_writer >= 0 && !(l->round_writers & (1ULL << l->last_writer)))
+                l->transfers++;
+            l->last_writer = __builtin_ctzll(l->round_writers);
+        }
+
+        l->holders |= l->round_holders;
+        l->writers |= l->round_writers;
+        l->round_holders = 0;
+        l->round_writers = 0;
+    }
+
+    report->ntouched = 0;
+    report->nrounds++;
+}
+
+static int ramindex_share_compare(const void *a, const void *b)
+{
+    const struct ramindex_share_line *la = *(const struct ramindex_share_line * const *)a;
+    const struct ramindex_share_line *lb = *(const struct ramindex_share_line * const *)b;
+
+    if (la->transfers != lb->transfers)
+        return la->transfers < lb->transfers ? 1 : -1;
+    if (la->contended != lb->contended)
+        return la->contended < lb->contended ? 1 : -1;
+    if (la->shared != lb->shared)
+        return la->shared < lb->shared ? 1 : -1;
+
+    return la->key < lb->key ? -1 : la->key > lb->key;
+}
+
+static void ramindex_share_print_cpus(const struct ramindex_share_report *report,
+    uint64_t mask)
+{
+    char buf[4 * MAX_CPUS];
+    size_t len = 0;
+    size_t n;
+
+    buf[0] = '\0';
+    for (n = 0; n < report->ncpus; n++)
+        if (mask & (1ULL << n))
+            len += snprintf(buf + len, sizeof(buf) - len, "%s%d",
+                len ? "," : "", report->cpus[n]);
+
+    fprintf(stdout, " %-16s", buf);
+}
+
+static void ramindex_share_print_owner(const struct ramindex_share_report *report,
+    uint64_t paddr)
+{
+    const struct ramindex_page *page;
+    size_t n;
+
+    for (n = 0; n < report->nprocesses; n++) {
+        const struct ramindex_pagemap *pm = &report->pagemaps[n];
+
+        page = ramindex_pagemap_find(pm, paddr / pm->pagesize);
+        if (page != NULL) {
+            fprintf(stdout, " %d:0x%llx", (int)pm->pid,
+                (unsigned long long)(page->vaddr + paddr % pm->pagesize));
+            return;
+        }
+    }
+}
+
+static void ramindex_share_print(const struct ramindex_share_report *report, size_t max)
+{
+    const struct ramindex_share_line **candidates;
+    size_t ncandidates = 0;
+    size_t nshared = 0;
+    size_t n;
+
+    candidates = ramindex_share_calloc(report->nlines + 1, sizeof(*candidates));
+
+    for (n = 0; n < report->size; n++) {
+        const struct ramindex_share_line *l = &report->lines[n];
+
+        if (!l->used)
+            continue;
+        if (__builtin_popcountll(l->holders) > 1)
+            nshared++;
+        if (__builtin_popcountll(l->writers) > 1)
+            candidates[ncandidates++] = l;
+    }
+
+    qsort(candidates, ncandidates, sizeof(*candidates), ramindex_share_compare);
+
+    fprintf(stdout, "Rounds: %u, cpus: %zu, line size: %u\n",
+        report->nrounds, report->ncpus, report->linesize);
+    fprintf(stdout, "Capture skew: mean %.0f ns, max %llu ns, rounds with late cpus: %u\n",
+        report->nrounds ? (double)report->sum_skew_ns / report->nrounds : 0.0,
+        (unsigned long long)report->max_skew_ns, report->ntimedout);
+    fprintf(stdout, "Lines: %zu, cached by more than one cpu: %zu, "
+        "written by more than one cpu: %zu\n\n", report->nlines, nshared, ncandidates);
+
+    if (ncandidates == 0) {
+        free(candidates);
+        return;
+    }
+
+    fprintf(stdout, "PADDR         NS ROUNDS SHARED CONTENDED TRANSFERS WRITERS          PID:VADDR\n");
+    for (n = 0; n < ncandidates && n < max; n++) {
+        const struct ramindex_share_line *l = candidates[n];
+        uint64_t paddr = l->key & ~((uint64_t)report->linesize - 1);
+
+        fprintf(stdout, "%012llx %3d %6u %6u %9u %9u",
+            (unsigned long long)paddr, (int)(l->key & 1),
+            l->rounds, l->shared, l->contended, l->transfers);
+        ramindex_share_print_cpus(report, l->writers);
+        ramindex_share_print_owner(report, paddr);
+        fprintf(stdout, "\n");
+    }
+
+    free(candidates);
+}
+
+static void ramindex_share_capture(struct ramindex_share_report *report,
+    const int *cpus, int ncpus, int level, int rounds, int interval, FILE *output)
+{
+    struct ramindex_snapshot *snapshots;
+    struct ramindex_ccsidr ccsidr;
+    uint64_t skew;
+    size_t timedout;
+    int status;
+    int fd;
+    int n, r;
+
+    fd = open(RAMINDEX_DEVICENAME, O_RDWR);
+    if (fd == -1) {
+        fprintf(stderr, "Cannot open '%s': %s\n",
+            RAMINDEX_DEVICENAME, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    memset(&ccsidr, 0, sizeof(ccsidr));
+    ccsidr.level = level - 1;
+    status = ioctl(fd, RAMINDEX_CCSIDR, &ccsidr);
+    if (status < 0) {
+        fprintf(stderr, "ioctl(RAMINDEX_CCSIDR) failed with code %d : %s\n",
+            errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    report->linesize = ccsidr.linesize;
+
+    snapshots = ramindex_share_calloc(ncpus, sizeof(*snapshots));
+    for (n = 0; n < ncpus; n++) {
+        if (ramindex_snapshot_alloc(&snapshots[n], &ccsidr, 0) < 0) {
+            fprintf(stderr, "Cannot allocate snapshot of %d lines\n",
+                ccsidr.nsets * ccsidr.nways);
+            exit(EXIT_FAILURE);
+        }
+        snapshots[n].cpu = cpus[n];
+    }
+
+    for (r = 0; r < rounds; r++) {
+        if (r > 0 && interval > 0)
+            usleep(interval);
+
+        status = ramindex_snapshot_capture_sync(fd, snapshots, ncpus, &skew, &timedout);
+        if (status < 0) {
+            fprintf(stderr, "ioctl(RAMINDEX_SYNC_DUMP) failed with code %d : %s\n",
+                errno, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        for (n = 0; n < ncpus; n++) {
+            ramindex_share_account(report, &snapshots[n]);
+            if (output && ramindex_snapshot_write(output, &snapshots[n]) < 0) {
+                fprintf(stderr, "Cannot write snapshot: %s\n", strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+        }
+        ramindex_share_end_round(report);
+
+        report->sum_skew_ns += skew;
+        if (skew > report->max_skew_ns)
+            report->max_skew_ns = skew;
+        if (timedout)
+            report->ntimedout++;
+    }
+
+    for (n = 0; n < ncpus; n++)
+        ramindex_snapshot_free(&snapshots[n]);
+    free(snapshots);
+    close(fd);
+}
+
+/**
+ * Snapshots written by a synchronized capture come in rounds, one snapshot
+ * per cpu. A new round starts with a snapshot of a cpu already seen
+ * in the current round. Skew of a round is taken from snapshots' timestamps.
+ */
+static void ramindex_share_read(struct ramindex_share_report *report, const char *filename)
+{
+    struct ramindex_snapshot snapshot;
+    uint64_t round_cpus = 0;
+    uint64_t min_ts = UINT64_MAX, max_ts = 0;
+    FILE *stream;
+    int status;
+    int index;
+
+    stream = fopen(filename, "rb");
+    if (stream == NULL) {
+        fprintf(stderr, "Cannot open '%s': %s\n", filename, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    while ((status = ramindex_snapshot_read(stream, &snapshot)) > 0) {
+        if (report->linesize == 0)
+            report->linesize = snapshot.ccsidr.linesize;
+        else if (report->linesize != (uint32_t)snapshot.ccsidr.linesize) {
+            fprintf(stderr, "'%s' contains snapshot of a different cache\n", filename);
+            exit(EXIT_FAILURE);
+        }
+
+        index = ramindex_share_cpu_index(report, snapshot.cpu);
+        if (index >= 0 && (round_cpus & (1ULL << index))) {
+            ramindex_share_end_round(report);
+            report->sum_skew_ns += max_ts - min_ts;
+            if (max_ts - min_ts > report->max_skew_ns)
+                report->max_skew_ns = max_ts - min_ts;
+            round_cpus = 0;
+            min_ts = UINT64_MAX;
+            max_ts = 0;
+        }
+        if (index >= 0)
+            round_cpus |= 1ULL << index;
+        if (snapshot.timestamp < min_ts)
+            min_ts = snapshot.timestamp;
+        if (snapshot.timestamp > max_ts)
+            max_ts = snapshot.timestamp;
+
+        ramindex_share_account(report, &snapshot);
+        ramindex_snapshot_free(&snapshot);
+    }
+
+    if (status < 0) {
+        fprintf(stderr, "Cannot read snapshot from '%s': %s\n", filename, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    if (round_cpus) {
+        ramindex_share_end_round(report);
+        report->sum_skew_ns += max_ts - min_ts;
+        if (max_ts - min_ts > report->max_skew_ns)
+            report->max_skew_ns = max_ts - min_ts;
+    }
+
+    fclose(stream);
+}
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int main(int argc, char *argv[])
+{
+    int c;
+    int i;
+    int status;
+    size_t n;
+    FILE *output = NULL;
+    struct ramindex_share_report *report;
+    // cmdline options
+    int cpus[MAX_CPUS];
+    int ncpus = 0;
+    int level = 1;
+    int rounds = 10;
+    int interval = 1000;
+    size_t max = 20;
+    const char *filename = NULL;
+
+    static struct option long_options[] = {
+        {"help",     no_argument,       0, 'h'},
+        {"version",  no_argument,       0, 'v'},
+        {"cpus",     required_argument, 0, 'c'},
+        {"level",    required_argument, 0, 'l'},
+        {"rounds",   required_argument, 0, 'n'},
+        {"interval", required_argument, 0, 'i'},
+        {"output",   required_argument, 0, 'o'},
+        {"pid",      required_argument, 0, 'p'},
+        {"max",      required_argument, 0, 'm'},
+        {0, 0, 0, 0}
+    };
+
+    report = ramindex_share_calloc(1, sizeof(*report));
+
+    for (;;) {
+        c = getopt_long(argc, argv, "hvc:l:n:i:o:p:m:", long_options, 0);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'h':
+                ramindex_share_print_usage(argv[0]);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'v':
+                fprintf(stdout, "%s (this program) version: %s\n", argv[0], PROJECT_VER);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'c':
+                ncpus = ramindex_parse_cpus(optarg, cpus, MAX_CPUS);
+                if (ncpus <= 0) {
+                    fprintf(stderr, "Invalid list of cpus '%s' (at most %d cpus)\n",
+                        optarg, MAX_CPUS);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'l':
+                level = atoi(optarg);
+                break;
+
+            case 'n':
+                rounds = atoi(optarg);
+                break;
+
+            case 'i':
+                interval = atoi(optarg);
+                break;
+
+            case 'o':
+                filename = optarg;
+                break;
+
+            case 'p':
+                if (report->nprocesses == MAX_PIDS) {
+                    fprintf(stderr, "At most %d processes can be selected\n", MAX_PIDS);
+                    exit(EXIT_FAILURE);
+                }
+                status = ramindex_pagemap_read(atoi(optarg), 0, UINT64_MAX,
+                    &report->pagemaps[report->nprocesses]);
+                if (status < 0) {
+                    fprintf(stderr, "Cannot read pagemap of process %s: %s\n",
+                        optarg, strerror(errno));
+                    exit(EXIT_FAILURE);
+                }
+                report->nprocesses++;
+                break;
+
+            case 'm':
+                max = strtoul(optarg, NULL, 0);
+                break;
+
+            default:
+                ramindex_share_print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if ((ncpus == 0) == (optind >= argc) || level <= 0 || rounds <= 0) {
+        ramindex_share_print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (ncpus > 0) {
+        if (filename) {
+            output = fopen(filename, "wb");
+            if (output == NULL) {
+                fprintf(stderr, "Cannot open '%s': %s\n", filename, strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+        }
+        ramindex_share_capture(report, cpus, ncpus, level, rounds, interval, output);
+        if (output)
+            fclose(output);
+    } else {
+        for (i = optind; i < argc; i++)
+            ramindex_share_read(report, argv[i]);
+    }
+
+    if (report->nrounds == 0) {
+        fprintf(stderr, "No snapshots found\n");
+        exit(EXIT_FAILURE);
+    }
+
+    ramindex_share_print(report, max);
+
+    for (n = 0; n < report->nprocesses; n++)
+        ramindex_pagemap_free(&report->pagemaps[n]);
+    free(report->lines);
+    free(report->touched);
+    free(report);
+
+    return 0;
+}
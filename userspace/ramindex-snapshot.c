@@ -0,0 +1,559 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-snapshot.c
+ *
+ * In-memory and on-disk representation of a single cache dump.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+
+#include <sys/ioctl.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "ramindex-snapshot.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local types definitions
+\*===========================================================================*/
+
+/* on-disk header of every snapshot (host byte order) */
+struct ramindex_snapshot_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    int32_t cpu;
+    int32_t level;
+    int32_t icache;
+    int32_t nsets;
+    int32_t nways;
+    int32_t linesize;
+    uint64_t timestamp;
+    uint32_t nlines;
+    uint32_t reserved;
+};
+
+/* on-disk PMU counts, following the header of version 2 snapshots */
+struct ramindex_snapshot_pmu {
+    uint32_t events;
+    uint32_t valid;
+    uint64_t before[RAMINDEX_PMU_EVENTS_MAX];
+    uint64_t delta[RAMINDEX_PMU_EVENTS_MAX];
+};
+
+/* on-disk representation of every line, followed by linesize bytes of data
+   if RAMINDEX_SNAPSHOT_F_DATA is set */
+struct ramindex_snapshot_record {
+    int32_t set;
+    int32_t way;
+    uint8_t valid;
+    uint8_t dirty;
+    uint8_t ns;
+    uint8_t state;
+    uint32_t linesize;
+    uint64_t tag;
+};
+
+/*===========================================================================*\
+ * local (internal linkage) objects definitions
+\*===========================================================================*/
+static const char *ramindex_pmu_event_names[RAMINDEX_PMU_NR] = {
+    [RAMINDEX_PMU_CYCLES] = "cycles",
+    [RAMINDEX_PMU_INSTRUCTIONS] = "instructions",
+    [RAMINDEX_PMU_L1D_REFILL] = "l1d-refill",
+    [RAMINDEX_PMU_L1I_REFILL] = "l1i-refill",
+    [RAMINDEX_PMU_L2D_REFILL] = "l2d-refill",
+    [RAMINDEX_PMU_L1D_WB] = "l1d-wb",
+    [RAMINDEX_PMU_L2D_WB] = "l2d-wb",
+};
+
+/*===========================================================================*\
+ * global (external linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) functions definitions
+\*===========================================================================*/
+static uint64_t ramindex_snapshot_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int ramindex_snapshot_dump_pmu(int fd, struct ramindex_selector *selector,
+    struct ramindex_snapshot *snapshot)
+{
+    int n, status;
+    struct ramindex_pmu_selector ps;
+
+    memset(&ps, 0, sizeof(ps));
+    ps.selector = *selector;
+    ps.events = snapshot->pmu_events;
+
+    status = ioctl(fd, RAMINDEX_DUMP_PMU, &ps);
+    if (status < 0)
+        return -1;
+
+    *selector = ps.selector;
+
+    /* counters before the first chunk, counts over all of them */
+    if (snapshot->nlines == 0) {
+        snapshot->pmu_valid = ps.valid;
+        memcpy(snapshot->pmu_before, ps.before, sizeof(snapshot->pmu_before));
+        memset(snapshot->pmu_delta, 0, sizeof(snapshot->pmu_delta));
+    } else {
+        snapshot->pmu_valid &= ps.valid;
+    }
+    for (n = 0; n < RAMINDEX_PMU_EVENTS_MAX; n++)
+        snapshot->pmu_delta[n] += ps.delta[n];
+
+    return 0;
+}
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int ramindex_snapshot_alloc(struct ramindex_snapshot *snapshot,
+    const struct ramindex_ccsidr *ccsidr, uint32_t flags)
+{
+    uint32_t n;
+    uint32_t ncachelines = ccsidr->nsets * ccsidr->nways;
+
+    memset(snapshot, 0, sizeof(*snapshot));
+    snapshot->cpu = -1;
+    snapshot->flags = flags;
+    snapshot->ccsidr = *ccsidr;
+
+    snapshot->lines = calloc(ncachelines, sizeof(*snapshot->lines));
+    if (snapshot->lines == NULL)
+        return -1;
+
+    if (flags & RAMINDEX_SNAPSHOT_F_DATA) {
+        snapshot->data = malloc((size_t)ncachelines * ccsidr->linesize);
+        if (snapshot->data == NULL) {
+            free(snapshot->lines);
+            snapshot->lines = NULL;
+            return -1;
+        }
+    }
+
+    for (n = 0; n < ncachelines; n++) {
+        snapshot->lines[n].linesize = snapshot->data ? ccsidr->linesize : 0;
+        snapshot->lines[n].linedata = snapshot->data ?
+            snapshot->data + (size_t)n * ccsidr->linesize : NULL;
+    }
+
+    return 0;
+}
+
+void ramindex_snapshot_free(struct ramindex_snapshot *snapshot)
+{
+    free(snapshot->lines);
+    free(snapshot->data);
+    snapshot->lines = NULL;
+    snapshot->data = NULL;
+    snapshot->nlines = 0;
+}
+
+int ramindex_snapshot_capture(int fd, int set, int nsets, int way,
+    struct ramindex_snapshot *snapshot)
+{
+    int status;
+    struct ramindex_selector selector;
+
+    memset(&selector, 0, sizeof(selector));
+    selector.level = snapshot->ccsidr.level;
+    selector.icache = snapshot->ccsidr.icache;
+    selector.set = set;
+    selector.nsets = nsets;
+    selector.way = way;
+    selector.nlines = snapshot->ccsidr.nsets * snapshot->ccsidr.nways - snapshot->nlines;
+    selector.lines = snapshot->lines + snapshot->nlines;
+    if (!(snapshot->flags & RAMINDEX_SNAPSHOT_F_DATA))
+        selector.flags |= RAMINDEX_DUMP_F_TAGS_ONLY;
+
+    if (snapshot->nlines == 0)
+        snapshot->timestamp = ramindex_snapshot_now();
+
+    if (snapshot->pmu_events)
+        status = ramindex_snapshot_dump_pmu(fd, &selector, snapshot);
+    else
+        status = ioctl(fd, RAMINDEX_DUMP, &selector);
+    if (status < 0)
+        return -1;
+
+    /* chunks of one snapshot read on different cpus would mix their (private) caches */
+    if (snapshot->nlines == 0) {
+        snapshot->cpu = selector.cpu;
+    } else if (snapshot->cpu != selector.cpu) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    snapshot->nlines += selector.nlines;
+
+    return 0;
+}
+
+int ramindex_snapshot_capture_quiet(int fd, int set, int nsets, int way, int victim_last,
+    struct ramindex_snapshot *snapshot, uint32_t *npolluted)
+{
+    int status;
+    struct ramindex_selector selector;
+
+    memset(&selector, 0, sizeof(selector));
+    selector.level = snapshot->ccsidr.level;
+    selector.icache = snapshot->ccsidr.icache;
+    selector.set = set;
+    selector.nsets = nsets;
+    selector.way = way;
+    selector.nlines = snapshot->ccsidr.nsets * snapshot->ccsidr.nways;
+    selector.lines = snapshot->lines;
+    selector.flags = RAMINDEX_DUMP_F_TAGS_ONLY | RAMINDEX_DUMP_F_LOW_PERTURB;
+    if (victim_last)
+        selector.flags |= RAMINDEX_DUMP_F_VICTIM_LAST;
+
+    snapshot->timestamp = ramindex_snapshot_now();
+    snapshot->nlines = 0;
+
+    if (snapshot->pmu_events)
+        status = ramindex_snapshot_dump_pmu(fd, &selector, snapshot);
+    else
+        status = ioctl(fd, RAMINDEX_DUMP, &selector);
+    if (status < 0)
+        return -1;
+
+    snapshot->cpu = selector.cpu;
+    snapshot->nlines = selector.nlines;
+    if (npolluted)
+        *npolluted = selector.npolluted;
+
+    return 0;
+}
+
+int ramindex_snapshot_capture_sync(int fd, struct ramindex_snapshot *snapshots,
+    size_t ncpus, uint64_t *skew_ns, size_t *timedout)
+{
+    int status;
+    size_t n;
+    struct ramindex_sync_selector selector;
+    struct ramindex_sync_cpu *cpus;
+
+    cpus = calloc(ncpus, sizeof(*cpus));
+    if (cpus == NULL)
+        return -1;
+
+    for (n = 0; n < ncpus; n++) {
+        cpus[n].cpu = snapshots[n].cpu;
+        cpus[n].nlines = snapshots[n].ccsidr.nsets * snapshots[n].ccsidr.nways;
+        cpus[n].lines = snapshots[n].lines;
+    }
+
+    memset(&selector, 0, sizeof(selector));
+    selector.level = snapshots[0].ccsidr.level;
+    selector.icache = snapshots[0].ccsidr.icache;
+    selector.ncpus = ncpus;
+    selector.cpus = cpus;
+
+    status = ioctl(fd, RAMINDEX_SYNC_DUMP, &selector);
+    if (status < 0) {
+        free(cpus);
+        return -1;
+    }
+
+    if (timedout)
+        *timedout = 0;
+
+    for (n = 0; n < ncpus; n++) {
+        snapshots[n].nlines = cpus[n].nlines;
+        snapshots[n].timestamp = cpus[n].start_ns;
+        if (timedout && (cpus[n].flags & RAMINDEX_SYNC_F_TIMEDOUT))
+            (*timedout)++;
+    }
+
+    if (skew_ns)
+        *skew_ns = selector.skew_ns;
+
+    free(cpus);
+
+    return 0;
+}
+
+int ramindex_snapshot_write(FILE *stream, const struct ramindex_snapshot *snapshot)
+{
+    uint32_t n;
+    struct ramindex_snapshot_header header;
+    struct ramindex_snapshot_pmu pmu;
+    struct ramindex_snapshot_record record;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RAMINDEX_SNAPSHOT_MAGIC, sizeof(header.magic));
+    /* snapshots without PMU counts stay readable by older tools */
+    header.version = snapshot->pmu_events ? RAMINDEX_SNAPSHOT_VERSION : RAMINDEX_SNAPSHOT_VERSION_V1;
+    header.flags = snapshot->flags;
+    header.cpu = snapshot->cpu;
+    header.level = snapshot->ccsidr.level;
+    header.icache = snapshot->ccsidr.icache;
+    header.nsets = snapshot->ccsidr.nsets;
+    header.nways = snapshot->ccsidr.nways;
+    header.linesize = snapshot->ccsidr.linesize;
+    header.timestamp = snapshot->timestamp;
+    header.nlines = snapshot->nlines;
+
+    if (fwrite(&header, sizeof(header), 1, stream) != 1)
+        return -1;
+
+    if (snapshot->pmu_events) {
+        pmu.events = snapshot->pmu_events;
+        pmu.valid = snapshot->pmu_valid;
+        memcpy(pmu.before, snapshot->pmu_before, sizeof(pmu.before));
+        memcpy(pmu.delta, snapshot->pmu_delta, sizeof(pmu.delta));
+        if (fwrite(&pmu, sizeof(pmu), 1, stream) != 1)
+            return -1;
+    }
+
+    for (n = 0; n < snapshot->nlines; n++) {
+        const struct ramindex_cacheline *l = &snapshot->lines[n];
+
+        memset(&record, 0, sizeof(record));
+        record.set = l->set;
+        record.way = l->way;
+        record.valid = l->valid;
+        record.dirty = l->dirty;
+        record.ns = l->ns;
+        record.state = l->state;
+        record.linesize = (snapshot->flags & RAMINDEX_SNAPSHOT_F_DATA) ? l->linesize : 0;
+        record.tag = l->tag;
+
+        if (fwrite(&record, sizeof(record), 1, stream) != 1)
+            return -1;
+
+        if (record.linesize && fwrite(l->linedata, record.linesize, 1, stream) != 1)
+            return -1;
+    }
+
+    return 0;
+}
+
+size_t ramindex_snapshot_size(const struct ramindex_snapshot *snapshot)
+{
+    size_t size = sizeof(struct ramindex_snapshot_header);
+    uint32_t n;
+
+    if (snapshot->pmu_events)
+        size += sizeof(struct ramindex_snapshot_pmu);
+
+    size += (size_t)snapshot->nlines * sizeof(struct ramindex_snapshot_record);
+    if (snapshot->flags & RAMINDEX_SNAPSHOT_F_DATA)
+        for (n = 0; n < snapshot->nlines; n++)
+            size += snapshot->lines[n].linesize;
+
+    return size;
+}
+
+int ramindex_snapshot_read(FILE *stream, struct ramindex_snapshot *snapshot)
+{
+    uint32_t n;
+    struct ramindex_snapshot_header header;
+    struct ramindex_snapshot_pmu pmu;
+    struct ramindex_snapshot_record record;
+    struct ramindex_ccsidr ccsidr;
+
+    if (fread(&header, sizeof(header), 1, stream) != 1)
+        return feof(stream) ? 0 : -1;
+
+    if (memcmp(header.magic, RAMINDEX_SNAPSHOT_MAGIC, sizeof(header.magic)) ||
+        (header.version != RAMINDEX_SNAPSHOT_VERSION &&
+         header.version != RAMINDEX_SNAPSHOT_VERSION_V1)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(&pmu, 0, sizeof(pmu));
+    if (header.version == RAMINDEX_SNAPSHOT_VERSION &&
+        fread(&pmu, sizeof(pmu), 1, stream) != 1)
+        return -1;
+
+    if (header.nsets <= 0 || header.nways <= 0 || header.linesize <= 0 ||
+        header.nlines > (uint32_t)header.nsets * header.nways) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(&ccsidr, 0, sizeof(ccsidr));
+    ccsidr.level = header.level;
+    ccsidr.icache = header.icache;
+    ccsidr.nsets = header.nsets;
+    ccsidr.nways = header.nways;
+    ccsidr.linesize = header.linesize;
+
+    if (ramindex_snapshot_alloc(snapshot, &ccsidr, header.flags) < 0)
+        return -1;
+
+    snapshot->cpu = header.cpu;
+    snapshot->timestamp = header.timestamp;
+    snapshot->nlines = header.nlines;
+    snapshot->pmu_events = pmu.events;
+    snapshot->pmu_valid = pmu.valid;
+    memcpy(snapshot->pmu_before, pmu.before, sizeof(snapshot->pmu_before));
+    memcpy(snapshot->pmu_delta, pmu.delta, sizeof(snapshot->pmu_delta));
+
+    for (n = 0; n < snapshot->nlines; n++) {
+        struct ramindex_cacheline *l = &snapshot->lines[n];
+
+        if (fread(&record, sizeof(record), 1, stream) != 1)
+            goto error;
+
+        if (record.linesize > (uint32_t)header.linesize ||
+            (record.linesize && !(header.flags & RAMINDEX_SNAPSHOT_F_DATA))) {
+            errno = EINVAL;
+            goto error;
+        }
+
+        l->set = record.set;
+        l->way = record.way;
+        l->valid = record.valid;
+        l->dirty = record.dirty;
+        l->ns = record.ns;
+        l->state = record.state;
+        l->tag = record.tag;
+        l->linesize = record.linesize;
+
+        if (record.linesize && fread(l->linedata, record.linesize, 1, stream) != 1)
+            goto error;
+    }
+
+    return 1;
+
+error:
+    ramindex_snapshot_free(snapshot);
+    return -1;
+}
+
+void ramindex_snapshot_print(FILE *stream, const struct ramindex_snapshot *snapshot)
+{
+    uint32_t n, m;
+
+    for (n = 0; n < snapshot->nlines; n++) {
+        const struct ramindex_cacheline *l = &snapshot->lines[n];
+        const uint8_t *ld = (const uint8_t *)l->linedata;
+        fprintf(stream, "SET:%04d WAY:%02d V:%d D:%d NS:%d ST:%-2s TAG:%012llx",
+            l->set, l->way, l->valid, l->dirty, l->ns,
+            ramindex_cstate_to_string(l->state), l->tag);
+        if (l->linesize) {
+            fprintf(stream, " DATA[0:%u] ", l->linesize - 1);
+            for (m = 0; m < l->linesize; m++) {
+                fprintf(stream, "%02x", ld[m]);
+                if ((m + 1) % 4 == 0)
+                    fprintf(stream, " ");
+            }
+        }
+        fprintf(stream, "\n");
+    }
+}
+
+void ramindex_snapshot_print_pmu(FILE *stream, const struct ramindex_snapshot *snapshot)
+{
+    int n;
+
+    for (n = 0; n < RAMINDEX_PMU_NR; n++) {
+        if (!(snapshot->pmu_events & (1u << n)))
+            continue;
+        if (snapshot->pmu_valid & (1u << n))
+            fprintf(stream, "PMU:%-12s BEFORE:%20llu DELTA:%12llu\n", ramindex_pmu_event_names[n],
+                (unsigned long long)snapshot->pmu_before[n],
+                (unsigned long long)snapshot->pmu_delta[n]);
+        else
+            fprintf(stream, "PMU:%-12s not counted\n", ramindex_pmu_event_names[n]);
+    }
+}
+
+const char *ramindex_pmu_event_name(int event)
+{
+    return event >= 0 && event < RAMINDEX_PMU_NR ? ramindex_pmu_event_names[event] : "unknown";
+}
+
+int64_t ramindex_parse_pmu_events(const char *list)
+{
+    int64_t events = 0;
+    size_t length;
+    int n;
+
+    if (strcmp(list, "all") == 0)
+        return RAMINDEX_PMU_ALL;
+
+    for (;;) {
+        length = strcspn(list, ",");
+        for (n = 0; n < RAMINDEX_PMU_NR; n++)
+            if (strlen(ramindex_pmu_event_names[n]) == length &&
+                strncmp(list, ramindex_pmu_event_names[n], length) == 0)
+                break;
+        if (n == RAMINDEX_PMU_NR)
+            return -1;
+        events |= 1u << n;
+        if (list[length] == '\0')
+            return events;
+        list += length + 1;
+    }
+}
+
+int ramindex_bind_cpu(int cpu)
+{
+    cpu_set_t cpuset;
+
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+
+    return sched_setaffinity(0, sizeof(cpuset), &cpuset);
+}
+
+int ramindex_parse_cpus(const char *list, int *cpus, int max)
+{
+    int n = 0;
+    long first, last;
+    char *end;
+
+    for (;;) {
+        first = strtol(list, &end, 10);
+        if (end == list || first < 0)
+            return -1;
+        last = first;
+        if (*end == '-') {
+            list = end + 1;
+            last = strtol(list, &end, 10);
+            if (end == list || last < first)
+                return -1;
+        }
+        for (; first <= last; first++) {
+            if (n == max)
+                return -1;
+            cpus[n++] = first;
+        }
+        if (*end == '\0')
+            return n;
+        if (*end != ',')
+            return -1;
+        list = end + 1;
+    }
+}
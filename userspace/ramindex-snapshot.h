@@ -0,0 +1,189 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-snapshot.h
+ *
+ * In-memory and on-disk representation of a single cache dump.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+#ifndef _RAMINDEX_SNAPSHOT_H_
+#define _RAMINDEX_SNAPSHOT_H_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <stdio.h>
+#include <stdint.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "../ramindex.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define RAMINDEX_SNAPSHOT_MAGIC "RAMINDEX"
+#define RAMINDEX_SNAPSHOT_VERSION 2
+
+/* version of snapshots without PMU counts, still written for them */
+#define RAMINDEX_SNAPSHOT_VERSION_V1 1
+
+/* snapshot carries content of the lines, not only their tags */
+#define RAMINDEX_SNAPSHOT_F_DATA (1u << 0)
+
+/*===========================================================================*\
+ * global types definitions
+\*===========================================================================*/
+
+/**
+ * struct ramindex_snapshot - one dump of (a part of) a selected cache
+ * @cpu:	cpu the dump was taken on (-1 if not known)
+ * @flags:	RAMINDEX_SNAPSHOT_F_* flags
+ * @timestamp:	CLOCK_MONOTONIC time (in ns) the dump was taken at
+ * @ccsidr:	geometry of the dumped cache (level is 0 based, as in ioctls)
+ * @nlines:	number of entries in @lines array
+ * @lines:	dumped lines, @lines[n].linedata points into @data
+ * @data:	content of all lines (NULL if RAMINDEX_SNAPSHOT_F_DATA is clear)
+ * @pmu_events:	RAMINDEX_PMU_* events counted alongside the dump (0 for none)
+ * @pmu_valid:	events actually counted
+ * @pmu_before:	counters read right before the dump, indexed by event
+ * @pmu_delta:	counts over the dump itself (summed over its chunks)
+ */
+struct ramindex_snapshot {
+    int32_t cpu;
+    uint32_t flags;
+    uint64_t timestamp;
+    struct ramindex_ccsidr ccsidr;
+    uint32_t nlines;
+    struct ramindex_cacheline *lines;
+    uint8_t *data;
+    uint32_t pmu_events;
+    uint32_t pmu_valid;
+    uint64_t pmu_before[RAMINDEX_PMU_EVENTS_MAX];
+    uint64_t pmu_delta[RAMINDEX_PMU_EVENTS_MAX];
+};
+
+/*===========================================================================*\
+ * global (external linkage) functions declarations
+\*===========================================================================*/
+
+/**
+ * Allocates buffers for a snapshot of a cache with the given geometry.
+ * Room for the whole cache (nsets * nways lines) is reserved.
+ *
+ * @return 0 on success, -1 on failure
+ */
+int ramindex_snapshot_alloc(struct ramindex_snapshot *snapshot,
+    const struct ramindex_ccsidr *ccsidr, uint32_t flags);
+
+/**
+ * Releases buffers held by the snapshot.
+ */
+void ramindex_snapshot_free(struct ramindex_snapshot *snapshot);
+
+/**
+ * Dumps selected lines (set/way equal to -1 selects all of them, otherwise
+ * nsets consecutive sets starting from set are selected) of the cache described
+ * by snapshot->ccsidr using the RAMINDEX_DUMP ioctl. Lines are appended
+ * to the ones already held by the snapshot, so a big cache may be captured
+ * in chunks. Only tags are read if RAMINDEX_SNAPSHOT_F_DATA is clear.
+ * If snapshot->pmu_events is set, RAMINDEX_DUMP_PMU is used instead and
+ * PMU counters read by the first chunk (snapshot->nlines equal to 0) replace
+ * the ones held by the snapshot, counts of the next chunks are added up.
+ * snapshot->cpu is set to the cpu the first chunk has been read on, next chunks
+ * read on another one fail with EAGAIN (bind the calling thread to avoid that).
+ *
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int ramindex_snapshot_capture(int fd, int set, int nsets, int way,
+    struct ramindex_snapshot *snapshot);
+
+/**
+ * Dumps tags of all the sets of the selected way(s) (way equal to -1 selects
+ * all of them) of the cache described by snapshot->ccsidr using the low
+ * perturbation mode of the RAMINDEX_DUMP ioctl. nsets consecutive victim sets
+ * starting from set (none if set is -1) are read first, or last if victim_last
+ * is non-zero. The snapshot shall be allocated without RAMINDEX_SNAPSHOT_F_DATA,
+ * lines already held by it are replaced. If not NULL, npolluted receives
+ * the number of lines holding the capture's own footprint. PMU counters
+ * are read as by ramindex_snapshot_capture() if snapshot->pmu_events is set.
+ *
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int ramindex_snapshot_capture_quiet(int fd, int set, int nsets, int way, int victim_last,
+    struct ramindex_snapshot *snapshot, uint32_t *npolluted);
+
+/**
+ * Dumps tags of all the lines of the cache described by snapshots[0].ccsidr
+ * on ncpus cpus at once (cpus are taken from snapshots[n].cpu) using
+ * the RAMINDEX_SYNC_DUMP ioctl. Snapshots shall be allocated without
+ * RAMINDEX_SNAPSHOT_F_DATA, lines already held by them are replaced.
+ * Timestamp of every snapshot is set to the time its cpu started to read tags.
+ * If not NULL, skew_ns receives the time between the earliest
+ * and the latest start, timedout the number of cpus which gave up
+ * waiting for the others.
+ *
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int ramindex_snapshot_capture_sync(int fd, struct ramindex_snapshot *snapshots,
+    size_t ncpus, uint64_t *skew_ns, size_t *timedout);
+
+/**
+ * Writes snapshot to a stream in binary format.
+ *
+ * @return 0 on success, -1 on failure
+ */
+int ramindex_snapshot_write(FILE *stream, const struct ramindex_snapshot *snapshot);
+
+/**
+ * Returns number of bytes ramindex_snapshot_write() writes for the snapshot.
+ */
+size_t ramindex_snapshot_size(const struct ramindex_snapshot *snapshot);
+
+/**
+ * Reads next snapshot from a stream (allocates all the buffers).
+ *
+ * @return 1 if snapshot has been read, 0 on end of stream, -1 on failure
+ */
+int ramindex_snapshot_read(FILE *stream, struct ramindex_snapshot *snapshot);
+
+/**
+ * Prints snapshot to a stream in human readable format.
+ */
+void ramindex_snapshot_print(FILE *stream, const struct ramindex_snapshot *snapshot);
+
+/**
+ * Prints PMU counts of the snapshot (if any) to a stream.
+ */
+void ramindex_snapshot_print_pmu(FILE *stream, const struct ramindex_snapshot *snapshot);
+
+/**
+ * Returns name of a RAMINDEX_PMU_* event, as accepted by ramindex_parse_pmu_events().
+ */
+const char *ramindex_pmu_event_name(int event);
+
+/**
+ * Parses list of PMU event names, e.g. "cycles,l1d-refill", or "all"
+ * into a bitmask of RAMINDEX_PMU_* events.
+ *
+ * @return the bitmask or -1 if the list is malformed
+ */
+int64_t ramindex_parse_pmu_events(const char *list);
+
+/**
+ * Binds the calling thread to the selected cpu.
+ *
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int ramindex_bind_cpu(int cpu);
+
+/**
+ * Parses list of cpus, e.g. "0-3,6", into at most max entries of cpus.
+ *
+ * @return number of parsed cpus or -1 if the list is malformed
+ */
+int ramindex_parse_cpus(const char *list, int *cpus, int max);
+
+#endif /* _RAMINDEX_SNAPSHOT_H_ */
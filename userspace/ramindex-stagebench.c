@@ -0,0 +1,457 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-stagebench.c
+ *
+ * Benchmarks the stages the ramindex tool goes through.
+ *
+ * For every selected cache geometry the same stages as of the ramindex
+ * tool and of the analysing tools are timed separately: buffer setup,
+ * ioctl capture, text formatting, binary writing, binary reading and
+ * analysis passes (coherence state census, page colour histogram and
+ * distinct tags). Latency percentiles of every stage are written as JSON.
+ * Geometries are passed to the device through RAMINDEX_MOCK_GEOMETRY,
+ * which is honoured by the ramindex-mock shim, so run with LD_PRELOAD
+ * (or 'make bench') on any Linux box; against the real driver all the
+ * geometries measure the L1 data cache.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <sys/ioctl.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include <version.h>
+#include "ramindex-snapshot.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define RAMINDEX_DEVICENAME "/dev/ramindex"
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
+
+#define MAX_GEOMETRIES 16
+
+/* page colours are counted for 4KiB pages */
+#define RAMINDEX_STAGEBENCH_PAGE_SHIFT 12
+
+/*===========================================================================*\
+ * local types definitions
+\*===========================================================================*/
+enum ramindex_stage {
+    STAGE_SETUP,
+    STAGE_CAPTURE,
+    STAGE_FORMAT,
+    STAGE_WRITE,
+    STAGE_READ,
+    STAGE_STATES,
+    STAGE_COLOURS,
+    STAGE_DISTINCT,
+    STAGE_NR
+};
+
+struct ramindex_stagebench_geometry {
+    const char *name;
+    int nsets;
+    int nways;
+    int linesize;
+};
+
+/*===========================================================================*\
+ * local (internal linkage) objects definitions
+\*===========================================================================*/
+static const char *ramindex_stage_names[STAGE_NR] = {
+    [STAGE_SETUP] = "setup",
+    [STAGE_CAPTURE] = "capture",
+    [STAGE_FORMAT] = "format",
+    [STAGE_WRITE] = "write",
+    [STAGE_READ] = "read",
+    [STAGE_STATES] = "analysis_states",
+    [STAGE_COLOURS] = "analysis_colours",
+    [STAGE_DISTINCT] = "analysis_distinct",
+};
+
+static const struct ramindex_stagebench_geometry ramindex_stagebench_defaults[] = {
+    { "32KiB-2way", 256, 2, 64 },       /* Cortex-A72 L1 D$ */
+    { "64KiB-4way", 256, 4, 64 },       /* Cortex-A720 L1 D$ */
+    { "1MiB-16way", 1024, 16, 64 },     /* Cortex-A72 L2 */
+    { "512KiB-8way", 1024, 8, 64 },     /* Cortex-A720 L2 */
+    { "8MiB-16way", 8192, 16, 64 },     /* DSU L3 */
+};
+
+/* keeps the compiler from optimising the analysis passes away */
+static volatile uint64_t ramindex_stagebench_sink;
+
+/*===========================================================================*\
+ * global (external linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) functions definitions
+\*===========================================================================*/
+static void ramindex_stagebench_print_usage(const char* progname)
+{
+    fprintf(stdout, "%s: [ OPTIONS ]\n", progname);
+    fprintf(stdout, "\t-h, --help        this message\n");
+    fprintf(stdout, "\t-v, --version     output version information\n");
+    fprintf(stdout, "\t-g, --geometry    cache geometry <nsets>x<nways>x<linesize>,\n");
+    fprintf(stdout, "\t                    may be repeated (default: a set of common ones)\n");
+    fprintf(stdout, "\t-n, --iterations  iterations per geometry (default: 20)\n");
+    fprintf(stdout, "\t-o, --output      write results to a file (default: stdout)\n");
+}
+
+static uint64_t ramindex_stagebench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int ramindex_stagebench_compare(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static uint64_t ramindex_stagebench_states(const struct ramindex_snapshot *snapshot)
+{
+    uint64_t counts[8] = {0};
+    uint32_t n;
+
+    for (n = 0; n < snapshot->nlines; n++)
+        counts[snapshot->lines[n].state & 0x7]++;
+
+    return counts[CSTATE_UNIQUE_DIRTY] + counts[CSTATE_SHARED_DIRTY];
+}
+
+static uint64_t ramindex_stagebench_colours(const struct ramindex_snapshot *snapshot)
+{
+    uint64_t *counts;
+    uint64_t max = 0;
+    uint32_t ncolours, n;
+
+    /* number of page colours of the cache, at least one */
+    ncolours = ((uint32_t)snapshot->ccsidr.nsets * snapshot->ccsidr.linesize) >>
+        RAMINDEX_STAGEBENCH_PAGE_SHIFT;
+    if (ncolours == 0)
+        ncolours = 1;
+
+    counts = calloc(ncolours, sizeof(*counts));
+    if (counts == NULL) {
+        fprintf(stderr, "Cannot allocate %u colours\n", ncolours);
+        exit(EXIT_FAILURE);
+    }
+
+    for (n = 0; n < snapshot->nlines; n++)
+        if (snapshot->lines[n].valid)
+            counts[(snapshot->lines[n].tag >> RAMINDEX_STAGEBENCH_PAGE_SHIFT) % ncolours]++;
+
+    for (n = 0; n < ncolours; n++)
+        if (counts[n] > max)
+            max = counts[n];
+
+    free(counts);
+
+    return max;
+}
+
+static uint64_t ramindex_stagebench_distinct(const struct ramindex_snapshot *snapshot)
+{
+    uint64_t *tags;
+    uint64_t distinct = 0;
+    uint32_t n, ntags = 0;
+
+    tags = malloc((snapshot->nlines + 1) * sizeof(*tags));
+    if (tags == NULL) {
+        fprintf(stderr, "Cannot allocate %u tags\n", snapshot->nlines);
+        exit(EXIT_FAILURE);
+    }
+
+    for (n = 0; n < snapshot->nlines; n++)
+        if (snapshot->lines[n].valid)
+            tags[ntags++] = snapshot->lines[n].tag;
+
+    qsort(tags, ntags, sizeof(*tags), ramindex_stagebench_compare);
+
+    for (n = 0; n < ntags; n++)
+        distinct += n == 0 || tags[n] != tags[n - 1];
+
+    free(tags);
+
+    return distinct;
+}
+
+static void ramindex_stagebench_geometry(int fd, struct ramindex_ccsidr *ccsidr)
+{
+    memset(ccsidr, 0, sizeof(*ccsidr));
+    ccsidr->level = 0;
+    ccsidr->icache = 0;
+    if (ioctl(fd, RAMINDEX_CCSIDR, ccsidr) < 0) {
+        fprintf(stderr, "ioctl(RAMINDEX_CCSIDR) failed with code %d : %s\n",
+            errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* samples holds iterations samples of every stage, one stage after another */
+static void ramindex_stagebench_run(const struct ramindex_stagebench_geometry *geometry,
+    int iterations, uint64_t *samples)
+{
+    int fd, i, s;
+    char env[64];
+    char *buffer = NULL;
+    size_t length = 0;
+    uint64_t t[STAGE_NR + 1];
+    FILE *text, *binary, *input;
+    struct ramindex_ccsidr ccsidr;
+    struct ramindex_snapshot snapshot, copy;
+
+    snprintf(env, sizeof(env), "%dx%dx%d", geometry->nsets, geometry->nways, geometry->linesize);
+    setenv("RAMINDEX_MOCK_GEOMETRY", env, 1);
+
+    fd = open(RAMINDEX_DEVICENAME, O_RDWR);
+    if (fd == -1) {
+        fprintf(stderr, "Cannot open '%s': %s\n",
+            RAMINDEX_DEVICENAME, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    ramindex_stagebench_geometry(fd, &ccsidr);
+
+    text = fopen("/dev/null", "w");
+    binary = open_memstream(&buffer, &length);
+    if (text == NULL || binary == NULL) {
+        fprintf(stderr, "Cannot open output streams: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    for (i = 0; i < iterations; i++) {
+        t[STAGE_SETUP] = ramindex_stagebench_now();
+        if (ramindex_snapshot_alloc(&snapshot, &ccsidr, RAMINDEX_SNAPSHOT_F_DATA) < 0) {
+            fprintf(stderr, "Cannot allocate snapshot of %d lines\n",
+                ccsidr.nsets * ccsidr.nways);
+            exit(EXIT_FAILURE);
+        }
+
+        t[STAGE_CAPTURE] = ramindex_stagebench_now();
+        if (ramindex_snapshot_capture(fd, -1, 0, -1, &snapshot) < 0) {
+            fprintf(stderr, "ioctl(RAMINDEX_DUMP) failed with code %d : %s\n",
+                errno, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        t[STAGE_FORMAT] = ramindex_stagebench_now();
+        ramindex_snapshot_print(text, &snapshot);
+        fflush(text);
+
+        t[STAGE_WRITE] = ramindex_stagebench_now();
+        rewind(binary);
+        if (ramindex_snapshot_write(binary, &snapshot) < 0 || fflush(binary) != 0) {
+            fprintf(stderr, "Cannot write snapshot: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        t[STAGE_READ] = ramindex_stagebench_now();
+        input = fmemopen(buffer, length, "rb");
+        if (input == NULL || ramindex_snapshot_read(input, &copy) != 1) {
+            fprintf(stderr, "Cannot read snapshot back\n");
+            exit(EXIT_FAILURE);
+        }
+        fclose(input);
+        ramindex_snapshot_free(&copy);
+
+        t[STAGE_STATES] = ramindex_stagebench_now();
+        ramindex_stagebench_sink += ramindex_stagebench_states(&snapshot);
+
+        t[STAGE_COLOURS] = ramindex_stagebench_now();
+        ramindex_stagebench_sink += ramindex_stagebench_colours(&snapshot);
+
+        t[STAGE_DISTINCT] = ramindex_stagebench_now();
+        ramindex_stagebench_sink += ramindex_stagebench_distinct(&snapshot);
+
+        t[STAGE_NR] = ramindex_stagebench_now();
+        ramindex_snapshot_free(&snapshot);
+
+        for (s = 0; s < STAGE_NR; s++)
+            samples[s * iterations + i] = t[s + 1] - t[s];
+    }
+
+    fclose(binary);
+    free(buffer);
+    fclose(text);
+    close(fd);
+}
+
+static uint64_t ramindex_stagebench_percentile(const uint64_t *sorted, int n, int p)
+{
+    return sorted[((int64_t)(n - 1) * p + 50) / 100];
+}
+
+static void ramindex_stagebench_print(FILE *stream, const struct ramindex_stagebench_geometry *geometry,
+    int iterations, uint64_t *samples, int first)
+{
+    int s, i;
+    uint64_t sum;
+
+    fprintf(stream, "%s    {\n", first ? "" : ",\n");
+    fprintf(stream, "      \"name\": \"%s\",\n", geometry->name);
+    fprintf(stream, "      \"sets\": %d,\n", geometry->nsets);
+    fprintf(stream, "      \"ways\": %d,\n", geometry->nways);
+    fprintf(stream, "      \"linesize\": %d,\n", geometry->linesize);
+    fprintf(stream, "      \"stages\": {\n");
+
+    for (s = 0; s < STAGE_NR; s++) {
+        uint64_t *sorted = samples + s * iterations;
+
+        qsort(sorted, iterations, sizeof(*sorted), ramindex_stagebench_compare);
+        for (sum = 0, i = 0; i < iterations; i++)
+            sum += sorted[i];
+
+        fprintf(stream, "        \"%s\": { \"min\": %llu, \"p50\": %llu, \"p90\": %llu, "
+            "\"p99\": %llu, \"max\": %llu, \"mean\": %llu }%s\n",
+            ramindex_stage_names[s],
+            (unsigned long long)sorted[0],
+            (unsigned long long)ramindex_stagebench_percentile(sorted, iterations, 50),
+            (unsigned long long)ramindex_stagebench_percentile(sorted, iterations, 90),
+            (unsigned long long)ramindex_stagebench_percentile(sorted, iterations, 99),
+            (unsigned long long)sorted[iterations - 1],
+            (unsigned long long)(sum / iterations),
+            s + 1 < STAGE_NR ? "," : "");
+    }
+
+    fprintf(stream, "      }\n");
+    fprintf(stream, "    }");
+}
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int main(int argc, char *argv[])
+{
+    int c;
+    size_t n, ngeometries = 0;
+    uint64_t *samples;
+    FILE *stream = stdout;
+    struct ramindex_stagebench_geometry geometries[MAX_GEOMETRIES];
+    char names[MAX_GEOMETRIES][32];
+    // cmdline options
+    int iterations = 20;
+    const char *filename = NULL;
+
+    static struct option long_options[] = {
+        {"help",       no_argument,       0, 'h'},
+        {"version",    no_argument,       0, 'v'},
+        {"geometry",   required_argument, 0, 'g'},
+        {"iterations", required_argument, 0, 'n'},
+        {"output",     required_argument, 0, 'o'},
+        {0, 0, 0, 0}
+    };
+
+    for (;;) {
+        c = getopt_long(argc, argv, "hvg:n:o:", long_options, 0);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'h':
+                ramindex_stagebench_print_usage(argv[0]);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'v':
+                fprintf(stdout, "%s (this program) version: %s\n", argv[0], PROJECT_VER);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'g':
+                if (ngeometries == MAX_GEOMETRIES ||
+                    sscanf(optarg, "%dx%dx%d", &geometries[ngeometries].nsets,
+                        &geometries[ngeometries].nways, &geometries[ngeometries].linesize) != 3 ||
+                    geometries[ngeometries].nsets <= 0 || geometries[ngeometries].nways <= 0 ||
+                    geometries[ngeometries].linesize <= 0) {
+                    ramindex_stagebench_print_usage(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                snprintf(names[ngeometries], sizeof(names[ngeometries]), "%s", optarg);
+                geometries[ngeometries].name = names[ngeometries];
+                ngeometries++;
+                break;
+
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+
+            case 'o':
+                filename = optarg;
+                break;
+
+            default:
+                ramindex_stagebench_print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (optind < argc || iterations < 1) {
+        ramindex_stagebench_print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (ngeometries == 0) {
+        memcpy(geometries, ramindex_stagebench_defaults, sizeof(ramindex_stagebench_defaults));
+        ngeometries = ARRAY_SIZE(ramindex_stagebench_defaults);
+    }
+
+    samples = calloc((size_t)STAGE_NR * iterations, sizeof(*samples));
+    if (samples == NULL) {
+        fprintf(stderr, "Cannot allocate %d samples\n", STAGE_NR * iterations);
+        exit(EXIT_FAILURE);
+    }
+
+    if (filename) {
+        stream = fopen(filename, "w");
+        if (stream == NULL) {
+            fprintf(stderr, "Cannot open '%s': %s\n", filename, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    fprintf(stream, "{\n");
+    fprintf(stream, "  \"tool\": \"%s\",\n", PROJECT_VER);
+    fprintf(stream, "  \"unit\": \"ns\",\n");
+    fprintf(stream, "  \"iterations\": %d,\n", iterations);
+    fprintf(stream, "  \"geometries\": [\n");
+
+    for (n = 0; n < ngeometries; n++) {
+        ramindex_stagebench_run(&geometries[n], iterations, samples);
+        ramindex_stagebench_print(stream, &geometries[n], iterations, samples, n == 0);
+    }
+
+    fprintf(stream, "\n  ]\n}\n");
+
+    if (filename)
+        fclose(stream);
+    free(samples);
+
+    return 0;
+}
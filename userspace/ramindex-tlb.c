@@ -0,0 +1,99 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-tlb.c
+ *
+ * Capturing and printing of TLB entries.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/ioctl.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "ramindex-tlb.h"
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int ramindex_tlb_capture(int fd, int level, int itlb,
+    struct ramindex_tlb_snapshot *snapshot)
+{
+    int status;
+    struct ramindex_tlb_selector selector;
+
+    memset(snapshot, 0, sizeof(*snapshot));
+    snapshot->cpu = -1;
+    snapshot->geometry.level = level - 1;
+    snapshot->geometry.itlb = itlb;
+
+    status = ioctl(fd, RAMINDEX_TLB_GEOMETRY, &snapshot->geometry);
+    if (status < 0)
+        return -1;
+
+    snapshot->entries = calloc(snapshot->geometry.nsets * snapshot->geometry.nways,
+        sizeof(*snapshot->entries));
+    if (snapshot->entries == NULL)
+        return -1;
+
+    memset(&selector, 0, sizeof(selector));
+    selector.level = level - 1;
+    selector.itlb = itlb;
+    selector.nentries = snapshot->geometry.nsets * snapshot->geometry.nways;
+    selector.entries = snapshot->entries;
+
+    status = ioctl(fd, RAMINDEX_TLB_DUMP, &selector);
+    if (status < 0) {
+        ramindex_tlb_free(snapshot);
+        return -1;
+    }
+
+    snapshot->nentries = selector.nentries;
+    snapshot->cpu = selector.cpu;
+
+    return 0;
+}
+
+void ramindex_tlb_free(struct ramindex_tlb_snapshot *snapshot)
+{
+    free(snapshot->entries);
+    snapshot->entries = NULL;
+    snapshot->nentries = 0;
+}
+
+const char *ramindex_tlb_name(const struct ramindex_tlb_geometry *geometry)
+{
+    if (geometry->level == 0)
+        return geometry->itlb ? "L1 I-TLB" : "L1 D-TLB";
+
+    return geometry->level == 1 ? "L2 TLB" : "TLB";
+}
+
+void ramindex_tlb_print(FILE *stream, const struct ramindex_tlb_snapshot *snapshot)
+{
+    uint32_t n;
+
+    for (n = 0; n < snapshot->nentries; n++) {
+        const struct ramindex_tlbentry *e = &snapshot->entries[n];
+        fprintf(stream, "SET:%04d WAY:%02d V:%d NS:%d G:%d ASID:%04x VMID:%04x "
+            "SIZE:%llx VA:%016llx PA:%012llx",
+            e->set, e->way, e->valid, e->ns, e->global, e->asid, e->vmid,
+            e->pagesize, e->va, e->pa);
+        if (e->unverified)
+            fprintf(stream, " RAW:%016llx:%016llx:%016llx:%016llx",
+                e->raw[0], e->raw[1], e->raw[2], e->raw[3]);
+        fprintf(stream, "\n");
+    }
+}
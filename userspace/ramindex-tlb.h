@@ -0,0 +1,72 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-tlb.h
+ *
+ * Capturing and printing of TLB entries.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+#ifndef _RAMINDEX_TLB_H_
+#define _RAMINDEX_TLB_H_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <stdio.h>
+#include <stdint.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "../ramindex.h"
+
+/*===========================================================================*\
+ * global types definitions
+\*===========================================================================*/
+
+/**
+ * struct ramindex_tlb_snapshot - all entries of a selected TLB
+ * @cpu:	cpu the dump was taken on
+ * @geometry:	geometry of the dumped TLB
+ * @nentries:	number of entries in @entries array
+ * @entries:	dumped entries
+ */
+struct ramindex_tlb_snapshot {
+    int32_t cpu;
+    struct ramindex_tlb_geometry geometry;
+    uint32_t nentries;
+    struct ramindex_tlbentry *entries;
+};
+
+/*===========================================================================*\
+ * global (external linkage) functions declarations
+\*===========================================================================*/
+
+/**
+ * Dumps all entries of the selected TLB (level is 1 based), all of them
+ * from the TLB of one cpu (the snapshot's cpu). The calling thread shall
+ * already be bound to the cpu of interest.
+ *
+ * @return 0 on success, -1 on failure (errno is set, EOPNOTSUPP
+ *         if the selected TLB cannot be dumped)
+ */
+int ramindex_tlb_capture(int fd, int level, int itlb,
+    struct ramindex_tlb_snapshot *snapshot);
+
+/**
+ * Releases entries held by the snapshot.
+ */
+void ramindex_tlb_free(struct ramindex_tlb_snapshot *snapshot);
+
+/**
+ * Returns human readable name of the TLB, e.g. "L1 I-TLB".
+ */
+const char *ramindex_tlb_name(const struct ramindex_tlb_geometry *geometry);
+
+/**
+ * Prints snapshot to a stream in human readable format.
+ */
+void ramindex_tlb_print(FILE *stream, const struct ramindex_tlb_snapshot *snapshot);
+
+#endif /* _RAMINDEX_TLB_H_ */
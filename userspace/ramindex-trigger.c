@@ -0,0 +1,66 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-trigger.c
+ *
+ * Event triggered captures of cache tags.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <string.h>
+
+#include <sys/ioctl.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "ramindex-trigger.h"
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int ramindex_trigger_arm(int fd, const struct ramindex_trigger *trigger)
+{
+    return ioctl(fd, RAMINDEX_TRIGGER_ARM, trigger) < 0 ? -1 : 0;
+}
+
+int ramindex_trigger_disarm(int fd)
+{
+    return ioctl(fd, RAMINDEX_TRIGGER_DISARM) < 0 ? -1 : 0;
+}
+
+int ramindex_trigger_fire(int fd)
+{
+    return ioctl(fd, RAMINDEX_TRIGGER_FIRE) < 0 ? -1 : 0;
+}
+
+int ramindex_trigger_read(int fd, uint32_t index, struct ramindex_snapshot *snapshot,
+    struct ramindex_trigger_capture *capture)
+{
+    int status;
+    struct ramindex_trigger_capture c;
+
+    memset(&c, 0, sizeof(c));
+    c.index = index;
+    c.nlines = snapshot->ccsidr.nsets * snapshot->ccsidr.nways;
+    c.lines = snapshot->lines;
+
+    status = ioctl(fd, RAMINDEX_TRIGGER_READ, &c);
+    if (status < 0)
+        return -1;
+
+    snapshot->cpu = c.cpu;
+    snapshot->timestamp = c.fired_ns;
+    snapshot->nlines = c.nlines;
+
+    if (capture)
+        *capture = c;
+
+    return 0;
+}
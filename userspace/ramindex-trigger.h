@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-trigger.h
+ *
+ * Event triggered captures of cache tags.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+#ifndef _RAMINDEX_TRIGGER_H_
+#define _RAMINDEX_TRIGGER_H_
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <stdint.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "../ramindex.h"
+#include "ramindex-snapshot.h"
+
+/*===========================================================================*\
+ * global (external linkage) functions declarations
+\*===========================================================================*/
+
+/**
+ * Arms the trigger (replacing the one which may already be armed).
+ *
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int ramindex_trigger_arm(int fd, const struct ramindex_trigger *trigger);
+
+/**
+ * Disarms the trigger, captures taken so far may still be read.
+ *
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int ramindex_trigger_disarm(int fd);
+
+/**
+ * Fires the trigger armed with TRIGGER_IOCTL type on the calling cpu.
+ *
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int ramindex_trigger_fire(int fd);
+
+/**
+ * Reads the selected capture into the snapshot, which shall be allocated
+ * (without RAMINDEX_SNAPSHOT_F_DATA) for the cache the trigger was armed for.
+ * Lines already held by the snapshot are replaced, its cpu and timestamp are
+ * set to the cpu and time the trigger fired on/at. If not NULL, capture
+ * receives the remaining details (latency, number of missed hits, ...).
+ *
+ * @return 0 on success, -1 on failure (errno is set, ENOENT if the capture
+ *         has not been taken yet)
+ */
+int ramindex_trigger_read(int fd, uint32_t index, struct ramindex_snapshot *snapshot,
+    struct ramindex_trigger_capture *capture);
+
+#endif /* _RAMINDEX_TRIGGER_H_ */
@@ -0,0 +1,335 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-watch.c
+ *
+ * Arms an event trigger, waits for it to fire and collects the captures.
+ *
+ * The driver captures tags of the selected cache on the cpu the trigger
+ * fired on (a kprobe, a tracepoint or an ioctl issued by a cooperating
+ * process) straight into preallocated buffers. This tool reports when
+ * and where every capture was taken, how long it took from the trigger
+ * to the first tag read and optionally writes the captures as snapshots.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
+
+#include <sys/ioctl.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include <version.h>
+#include "ramindex-snapshot.h"
+#include "ramindex-trigger.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define RAMINDEX_DEVICENAME "/dev/ramindex"
+
+/* how often the driver is asked whether all the captures have been taken */
+#define RAMINDEX_WATCH_POLL_US 10000
+
+/*===========================================================================*\
+ * local types definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) objects definitions
+\*===========================================================================*/
+static volatile sig_atomic_t ramindex_watch_stop = 0;
+
+/*===========================================================================*\
+ * global (external linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) functions definitions
+\*===========================================================================*/
+static void ramindex_watch_print_usage(const char* progname)
+{
+    fprintf(stdout, "%s: [ OPTIONS ]\n", progname);
+    fprintf(stdout, "\t-h, --help        this message\n");
+    fprintf(stdout, "\t-v, --version     output version information\n");
+    fprintf(stdout, "\t-k, --kprobe      fire when kprobed symbol is hit\n");
+    fprintf(stdout, "\t-e, --tracepoint  fire when tracepoint is hit (sched_switch, sched_wakeup,\n");
+    fprintf(stdout, "\t                    irq_handler_entry, sys_enter or cpu_idle)\n");
+    fprintf(stdout, "\t-I, --ioctl       fire when a cooperating process calls\n");
+    fprintf(stdout, "\t                    RAMINDEX_TRIGGER_FIRE (see --fire)\n");
+    fprintf(stdout, "\t-F, --fire        fire the armed trigger on the cpu we run on and exit\n");
+    fprintf(stdout, "\t-l, --level       select cache level (default: 1, at most %d lines)\n",
+        RAMINDEX_TRIGGER_LINES_MAX);
+    fprintf(stdout, "\t-t, --type        select cache type (1 for instruction cache,\n");
+    fprintf(stdout, "\t                    0 for data and unified caches, default: 0)\n");
+    fprintf(stdout, "\t-c, --cpu         fire only on that cpu (default: -1, any cpu)\n");
+    fprintf(stdout, "\t-n, --count       number of captures to be taken (default: 1)\n");
+    fprintf(stdout, "\t-w, --wait        give up after that many seconds (default: 10)\n");
+    fprintf(stdout, "\t-o, --output      write captures as snapshots to a file\n");
+}
+
+static void ramindex_watch_signal(int signum)
+{
+    (void)signum;
+    ramindex_watch_stop = 1;
+}
+
+static uint64_t ramindex_watch_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t ramindex_watch_valid(const struct ramindex_snapshot *snapshot)
+{
+    uint32_t n, valid = 0;
+
+    for (n = 0; n < snapshot->nlines; n++)
+        valid += snapshot->lines[n].valid != 0;
+
+    return valid;
+}
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int main(int argc, char *argv[])
+{
+    int c;
+    int fd;
+    int status;
+    uint32_t n;
+    uint64_t deadline;
+    uint64_t min_latency = UINT64_MAX, max_latency = 0, sum_latency = 0;
+    FILE *output = NULL;
+    struct ramindex_trigger trigger;
+    struct ramindex_trigger_capture capture;
+    struct ramindex_ccsidr ccsidr;
+    struct ramindex_snapshot snapshot;
+    // cmdline options
+    int fire = 0;
+    int wait = 10;
+    const char *filename = NULL;
+
+    static struct option long_options[] = {
+        {"help",       no_argument,       0, 'h'},
+        {"version",    no_argument,       0, 'v'},
+        {"kprobe",     required_argument, 0, 'k'},
+        {"tracepoint", required_argument, 0, 'e'},
+        {"ioctl",      no_argument,       0, 'I'},
+        {"fire",       no_argument,       0, 'F'},
+        {"level",      required_argument, 0, 'l'},
+        {"type",       required_argument, 0, 't'},
+        {"cpu",        required_argument, 0, 'c'},
+        {"count",      required_argument, 0, 'n'},
+        {"wait",       required_argument, 0, 'w'},
+        {"output",     required_argument, 0, 'o'},
+        {0, 0, 0, 0}
+    };
+
+    memset(&trigger, 0, sizeof(trigger));
+    trigger.level = 0;
+    trigger.cpu = -1;
+    trigger.count = 1;
+
+    for (;;) {
+        c = getopt_long(argc, argv, "hvk:e:IFl:t:c:n:w:o:", long_options, 0);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'h':
+                ramindex_watch_print_usage(argv[0]);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'v':
+                fprintf(stdout, "%s (this program) version: %s\n", argv[0], PROJECT_VER);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'k':
+                trigger.type = TRIGGER_KPROBE;
+                snprintf(trigger.symbol, sizeof(trigger.symbol), "%s", optarg);
+                break;
+
+            case 'e':
+                trigger.type = TRIGGER_TRACEPOINT;
+                snprintf(trigger.symbol, sizeof(trigger.symbol), "%s", optarg);
+                break;
+
+            case 'I':
+                trigger.type = TRIGGER_IOCTL;
+                break;
+
+            case 'F':
+                fire = 1;
+                break;
+
+            case 'l':
+                trigger.level = atoi(optarg) - 1;
+                break;
+
+            case 't':
+                trigger.icache = atoi(optarg);
+                break;
+
+            case 'c':
+                trigger.cpu = atoi(optarg);
+                break;
+
+            case 'n':
+                trigger.count = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'w':
+                wait = atoi(optarg);
+                break;
+
+            case 'o':
+                filename = optarg;
+                break;
+
+            default:
+                ramindex_watch_print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (optind < argc || (!fire && trigger.type == 0) ||
+        trigger.count == 0 || trigger.count > RAMINDEX_TRIGGER_COUNT_MAX) {
+        ramindex_watch_print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    fd = open(RAMINDEX_DEVICENAME, O_RDWR);
+    if (fd == -1) {
+        fprintf(stderr, "Cannot open '%s': %s\n",
+            RAMINDEX_DEVICENAME, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    if (fire) {
+        if (ramindex_trigger_fire(fd) < 0) {
+            fprintf(stderr, "ioctl(RAMINDEX_TRIGGER_FIRE) failed with code %d : %s\n",
+                errno, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        close(fd);
+        return 0;
+    }
+
+    memset(&ccsidr, 0, sizeof(ccsidr));
+    ccsidr.level = trigger.level;
+    ccsidr.icache = trigger.icache;
+    status = ioctl(fd, RAMINDEX_CCSIDR, &ccsidr);
+    if (status < 0) {
+        fprintf(stderr, "ioctl(RAMINDEX_CCSIDR) failed with code %d : %s\n",
+            errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    if (ramindex_snapshot_alloc(&snapshot, &ccsidr, 0) < 0) {
+        fprintf(stderr, "Cannot allocate snapshot of %d lines\n",
+            ccsidr.nsets * ccsidr.nways);
+        exit(EXIT_FAILURE);
+    }
+
+    if (filename) {
+        output = fopen(filename, "wb");
+        if (output == NULL) {
+            fprintf(stderr, "Cannot open '%s': %s\n", filename, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    signal(SIGINT, ramindex_watch_signal);
+    signal(SIGTERM, ramindex_watch_signal);
+
+    if (ramindex_trigger_arm(fd, &trigger) < 0) {
+        fprintf(stderr, "ioctl(RAMINDEX_TRIGGER_ARM) failed with code %d : %s\n",
+            errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(stdout, "Trigger armed, waiting for %u capture(s) of L%d '%s' cache\n",
+        trigger.count, trigger.level + 1, trigger.icache ? "instruction" : "data/unified");
+
+    /* the last capture is readable once all of them have been taken */
+    deadline = ramindex_watch_now() + (uint64_t)wait * 1000000000ULL;
+    while (!ramindex_watch_stop && ramindex_watch_now() < deadline) {
+        if (ramindex_trigger_read(fd, trigger.count - 1, &snapshot, NULL) == 0)
+            break;
+        if (errno != ENOENT) {
+            fprintf(stderr, "ioctl(RAMINDEX_TRIGGER_READ) failed with code %d : %s\n",
+                errno, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        usleep(RAMINDEX_WATCH_POLL_US);
+    }
+
+    if (ramindex_trigger_disarm(fd) < 0) {
+        fprintf(stderr, "ioctl(RAMINDEX_TRIGGER_DISARM) failed with code %d : %s\n",
+            errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(stdout, "CAPTURE  CPU         FIRED [ns]  LATENCY [ns]  DURATION [ns]  VALID\n");
+    for (n = 0; n < trigger.count; n++) {
+        if (ramindex_trigger_read(fd, n, &snapshot, &capture) < 0) {
+            if (errno == ENOENT)
+                break;
+            fprintf(stderr, "ioctl(RAMINDEX_TRIGGER_READ) failed with code %d : %s\n",
+                errno, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        fprintf(stdout, "%7u %4d %18llu %13llu %14llu %6u\n", n, capture.cpu,
+            (unsigned long long)capture.fired_ns, (unsigned long long)capture.latency_ns,
+            (unsigned long long)capture.duration_ns, ramindex_watch_valid(&snapshot));
+
+        if (capture.latency_ns < min_latency)
+            min_latency = capture.latency_ns;
+        if (capture.latency_ns > max_latency)
+            max_latency = capture.latency_ns;
+        sum_latency += capture.latency_ns;
+
+        if (output && ramindex_snapshot_write(output, &snapshot) < 0) {
+            fprintf(stderr, "Cannot write snapshot to '%s': %s\n", filename, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (n > 0)
+        fprintf(stdout, "\nCaptures: %u (missed hits: %u), trigger-to-capture latency "
+            "min/avg/max: %llu/%llu/%llu ns\n", capture.ncaptured, capture.nmissed,
+            (unsigned long long)min_latency, (unsigned long long)(sum_latency / n),
+            (unsigned long long)max_latency);
+    else
+        fprintf(stdout, "The trigger has not fired\n");
+
+    if (output)
+        fclose(output);
+    ramindex_snapshot_free(&snapshot);
+    close(fd);
+
+    return 0;
+}
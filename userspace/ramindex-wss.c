@@ -0,0 +1,626 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-wss.c
+ *
+ * Working set sizes and miss rate curves of processes estimated from periodic
+ * tag samples of L2/L3 caches.
+ *
+ * Every round (one synchronized capture of the selected cpus, or one round
+ * of snapshots read from files) cached lines are attributed to processes
+ * by their physical pages. For every line the tool keeps the last round
+ * it was seen in and the round its current residency started in, so that
+ * after every round and for windows of W = 1, 2, 4 ... rounds it knows:
+ *
+ * - WSS(W), the resident working set: distinct lines of a process seen in
+ *   the last W rounds,
+ * - retention(W): how many of the lines held W rounds ago are still held
+ *   (without having left the cache in between, as far as the rounds tell).
+ *
+ * WSS(W) is the working set of Denning's model, measured on what the cache
+ * held. A cache holding WSS(W) lines of the process misses on the lines
+ * joining the working set, (WSS(2W) - WSS(W)) / W per round, which gives
+ * the miss rate curve (misses per round versus cache size). Lines which
+ * came and went between two rounds are not seen, so the curve leans towards
+ * the cache that has been sampled - it tells sizes below it best.
+ *
+ * State is bounded by the lines seen in the largest window, so the tool
+ * may run forever as a daemon (-n 0) printing a report every few rounds.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <signal.h>
+
+#include <sys/ioctl.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include <version.h>
+#include "ramindex-snapshot.h"
+#include "ramindex-pagemap.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define RAMINDEX_DEVICENAME "/dev/ramindex"
+
+#define MAX_CPUS 64
+#define MAX_PIDS 64
+
+/* windows are powers of 2, up to 2^(MAX_WINDOWS - 1) rounds */
+#define MAX_WINDOWS 16
+
+/*===========================================================================*\
+ * local types definitions
+\*===========================================================================*/
+struct ramindex_wss_line {
+    uint64_t key;           /* physical address of the line | ns bit */
+    uint8_t used;
+    uint8_t owner;          /* index of the process (nprocesses for any other) */
+    uint32_t last;          /* round the line was seen in most recently */
+    uint32_t start;         /* round the current residency of the line started in */
+};
+
+struct ramindex_wss_report {
+    uint32_t linesize;
+    uint32_t window;        /* largest window (power of 2) */
+    uint32_t nrounds;       /* rounds are numbered from 1 */
+    uint32_t printed;       /* round the last report has been printed after */
+    uint64_t first_ts;      /* timestamps of the first and the last round */
+    uint64_t last_ts;
+    size_t size;            /* capacity of the hash table (power of 2) */
+    size_t nlines;
+    struct ramindex_wss_line *lines;
+    size_t nprocesses;
+    struct ramindex_pagemap pagemaps[MAX_PIDS];
+    uint32_t *occupancy;    /* lines held per owner and round, window + 1 rounds kept */
+    uint64_t *ages;         /* lines per owner and rounds since they were seen last */
+    uint64_t *runs;         /* lines held now per owner and rounds they have been held for */
+};
+
+/*===========================================================================*\
+ * local (internal linkage) objects definitions
+\*===========================================================================*/
+static volatile sig_atomic_t ramindex_wss_stop = 0;
+
+/*===========================================================================*\
+ * global (external linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) functions definitions
+\*===========================================================================*/
+static void ramindex_wss_print_usage(const char* progname)
+{
+    fprintf(stdout, "%s: [ OPTIONS ] [ snapshot... ]\n", progname);
+    fprintf(stdout, "\t-h, --help      this message\n");
+    fprintf(stdout, "\t-v, --version   output version information\n");
+    fprintf(stdout, "\t-c, --cpus      capture caches of these cpus (e.g. 0-3,6),\n");
+    fprintf(stdout, "\t                  snapshots are analysed if not given\n");
+    fprintf(stdout, "\t-l, --level     select cache level (default: 2)\n");
+    fprintf(stdout, "\t-n, --rounds    number of captures (default: 0, until interrupted)\n");
+    fprintf(stdout, "\t-i, --interval  time between captures in microseconds (default: 100000)\n");
+    fprintf(stdout, "\t-w, --window    largest window in rounds, rounded up to a power of 2\n");
+    fprintf(stdout, "\t                  (default: 64)\n");
+    fprintf(stdout, "\t-r, --report    print a report every that many rounds\n");
+    fprintf(stdout, "\t                  (default: 0, only when done)\n");
+    fprintf(stdout, "\t-o, --output    write captured snapshots to a file as well\n");
+    fprintf(stdout, "\t-p, --pid       attribute lines to that process (may be repeated)\n");
+}
+
+static void ramindex_wss_signal(int signum)
+{
+    (void)signum;
+    ramindex_wss_stop = 1;
+}
+
+static void *ramindex_wss_calloc(size_t n, size_t size)
+{
+    void *p = calloc(n, size);
+
+    if (p == NULL) {
+        fprintf(stderr, "calloc(%zu, %zu) failed\n", n, size);
+        exit(EXIT_FAILURE);
+    }
+
+    return p;
+}
+
+static size_t ramindex_wss_slot(const struct ramindex_wss_line *lines, size_t size, uint64_t key)
+{
+    size_t slot = (size_t)((key >> 4) * 0x9e3779b97f4a7c15ULL) & (size - 1);
+
+    while (lines[slot].used && lines[slot].key != key)
+        slot = (slot + 1) & (size - 1);
+
+    return slot;
+}
+
+/*
+ * Moves lines into a new table of the given size, leaving out the ones
+ * not seen within the largest window (they never count again).
+ */
+static void ramindex_wss_rehash(struct ramindex_wss_report *report, size_t size)
+{
+    struct ramindex_wss_line *lines = report->lines;
+    size_t n;
+
+    report->lines = ramindex_wss_calloc(size, sizeof(*report->lines));
+    report->nlines = 0;
+    for (n = 0; n < report->size; n++) {
+        if (!lines[n].used || report->nrounds - lines[n].last >= report->window)
+            continue;
+        report->lines[ramindex_wss_slot(report->lines, size, lines[n].key)] = lines[n];
+        report->nlines++;
+    }
+    report->size = size;
+    free(lines);
+}
+
+static struct ramindex_wss_line *ramindex_wss_lookup(struct ramindex_wss_report *report, uint64_t key)
+{
+    struct ramindex_wss_line *l;
+
+    /* keep load factor below 1/2 */
+    if (2 * (report->nlines + 1) > report->size)
+        ramindex_wss_rehash(report, report->size ? 2 * report->size : 4096);
+
+    l = &report->lines[ramindex_wss_slot(report->lines, report->size, key)];
+    if (!l->used) {
+        l->used = 1;
+        l->key = key;
+        report->nlines++;
+    }
+
+    return l;
+}
+
+static uint8_t ramindex_wss_owner(const struct ramindex_wss_report *report, uint64_t paddr)
+{
+    size_t n;
+
+    for (n = 0; n < report->nprocesses; n++) {
+        const struct ramindex_pagemap *pm = &report->pagemaps[n];
+
+        if (ramindex_pagemap_find(pm, paddr / pm->pagesize) != NULL)
+            return n;
+    }
+
+    return report->nprocesses;
+}
+
+static void ramindex_wss_refresh(struct ramindex_wss_report *report)
+{
+    pid_t pid;
+    size_t n;
+
+    /* pages come and go, lines starting a residency are attributed by fresh pagemaps */
+    for (n = 0; n < report->nprocesses; n++) {
+        pid = report->pagemaps[n].pid;
+        ramindex_pagemap_free(&report->pagemaps[n]);
+        if (ramindex_pagemap_read(pid, 0, UINT64_MAX, &report->pagemaps[n]) < 0) {
+            report->pagemaps[n].pid = pid;
+            report->pagemaps[n].pagesize = 4096;
+        }
+    }
+}
+
+static void ramindex_wss_begin_round(struct ramindex_wss_report *report, uint64_t timestamp)
+{
+    size_t n;
+    uint32_t *occupancy;
+
+    report->nrounds++;
+    if (report->nrounds == 1)
+        report->first_ts = timestamp;
+    report->last_ts = timestamp;
+
+    occupancy = &report->occupancy[(report->nrounds % (report->window + 1)) * (MAX_PIDS + 1)];
+    for (n = 0; n <= report->nprocesses; n++)
+        occupancy[n] = 0;
+
+    /* drop lines which fell out of the largest window once per window */
+    if (report->nrounds % report->window == 0 && report->size)
+        ramindex_wss_rehash(report, report->size);
+}
+
+static void ramindex_wss_account(struct ramindex_wss_report *report,
+    const struct ramindex_snapshot *snapshot)
+{
+    struct ramindex_wss_line *l;
+    uint32_t n;
+    uint32_t t = report->nrounds;
+    uint32_t *occupancy = &report->occupancy[(t % (report->window + 1)) * (MAX_PIDS + 1)];
+    uint64_t paddr;
+
+    for (n = 0; n < snapshot->nlines; n++) {
+        const struct ramindex_cacheline *cl = &snapshot->lines[n];
+
+        if (!cl->valid)
+            continue;
+
+        paddr = cl->tag & ~((uint64_t)report->linesize - 1);
+        l = ramindex_wss_lookup(report, paddr | (cl->ns & 1));
+
+        /* held by another cpu of the round already */
+        if (l->last == t)
+            continue;
+
+        if (l->last != t - 1 || l->last == 0) {
+            l->start = t;
+            l->owner = ramindex_wss_owner(report, paddr);
+        }
+        l->last = t;
+        occupancy[l->owner]++;
+    }
+}
+
+static void ramindex_wss_print(struct ramindex_wss_report *report)
+{
+    uint32_t t = report->nrounds;
+    uint32_t window = report->window;
+    uint32_t w, k, age;
+    uint64_t wss[MAX_WINDOWS + 1], held[MAX_WINDOWS];
+    uint64_t *ages, *runs;
+    uint32_t before;
+    size_t n, p, i, nwindows;
+
+    report->printed = t;
+    memset(report->ages, 0, (MAX_PIDS + 1) * window * sizeof(*report->ages));
+    memset(report->runs, 0, (MAX_PIDS + 1) * window * sizeof(*report->runs));
+
+    for (n = 0; n < report->size; n++) {
+        const struct ramindex_wss_line *l = &report->lines[n];
+
+        if (!l->used || t - l->last >= window)
+            continue;
+        report->ages[l->owner * window + t - l->last]++;
+        if (l->last == t)
+            report->runs[l->owner * window + (t - l->start < window ? t - l->start : window - 1)]++;
+    }
+
+    for (nwindows = 0; (1u << nwindows) <= window; nwindows++)
+        ;
+
+    fprintf(stdout, "Round %u, %.3f ms since the first one, line size %u\n",
+        t, (report->last_ts - report->first_ts) / 1e6, report->linesize);
+    fprintf(stdout, "PID     WINDOW  WSS[lines]    WSS[KiB]  RETAINED  MISSES/ROUND\n");
+
+    for (p = 0; p <= report->nprocesses; p++) {
+        ages = &report->ages[p * window];
+        runs = &report->runs[p * window];
+
+        /* wss[i] is WSS(2^i), held[i] the lines held for at least 2^i rounds */
+        age = 0;
+        for (i = 0, w = 1; i < nwindows; i++, w <<= 1) {
+            wss[i] = i ? wss[i - 1] : 0;
+            for (; age < w && age < window; age++)
+                wss[i] += ages[age];
+        }
+        for (i = 0, w = 1; i < nwindows; i++, w <<= 1) {
+            held[i] = 0;
+            for (k = w; k < window; k++)
+                held[i] += runs[k];
+        }
+
+        if (wss[nwindows - 1] == 0)
+            continue;
+
+        for (i = 0, w = 1; i < nwindows; i++, w <<= 1) {
+            if (i == 0) {
+                if (p < report->nprocesses)
+                    fprintf(stdout, "%-7d", (int)report->pagemaps[p].pid);
+                else
+                    fprintf(stdout, "%-7s", report->nprocesses ? "other" : "all");
+            } else {
+                fprintf(stdout, "%-7s", "");
+            }
+
+            fprintf(stdout, " %6u %11llu %11.1f", w, (unsigned long long)wss[i],
+                wss[i] * report->linesize / 1024.0);
+
+            before = t > w ? report->occupancy[((t - w) % (window + 1)) * (MAX_PIDS + 1) + p] : 0;
+            if (t > w && w < window && before)
+                fprintf(stdout, " %8.1f%%", held[i] * 100.0 / before);
+            else
+                fprintf(stdout, " %9s", "-");
+
+            if (i + 1 < nwindows && t >= 2 * w)
+                fprintf(stdout, " %13.1f\n", (double)(wss[i + 1] - wss[i]) / w);
+            else
+                fprintf(stdout, " %13s\n", "-");
+        }
+    }
+    fprintf(stdout, "\n");
+    fflush(stdout);
+}
+
+static void ramindex_wss_capture(struct ramindex_wss_report *report,
+    const int *cpus, int ncpus, int level, int rounds, int interval, int every, FILE *output)
+{
+    struct ramindex_snapshot *snapshots;
+    struct ramindex_ccsidr ccsidr;
+    int status;
+    int fd;
+    int n, r;
+
+    fd = open(RAMINDEX_DEVICENAME, O_RDWR);
+    if (fd == -1) {
+        fprintf(stderr, "Cannot open '%s': %s\n",
+            RAMINDEX_DEVICENAME, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    memset(&ccsidr, 0, sizeof(ccsidr));
+    ccsidr.level = level - 1;
+    status = ioctl(fd, RAMINDEX_CCSIDR, &ccsidr);
+    if (status < 0) {
+        fprintf(stderr, "ioctl(RAMINDEX_CCSIDR) failed with code %d : %s\n",
+            errno, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    report->linesize = ccsidr.linesize;
+
+    snapshots = ramindex_wss_calloc(ncpus, sizeof(*snapshots));
+    for (n = 0; n < ncpus; n++) {
+        if (ramindex_snapshot_alloc(&snapshots[n], &ccsidr, 0) < 0) {
+            fprintf(stderr, "Cannot allocate snapshot of %d lines\n",
+                ccsidr.nsets * ccsidr.nways);
+            exit(EXIT_FAILURE);
+        }
+        snapshots[n].cpu = cpus[n];
+    }
+
+    for (r = 0; (rounds == 0 || r < rounds) && !ramindex_wss_stop; r++) {
+        if (r > 0 && interval > 0)
+            usleep(interval);
+
+        status = ramindex_snapshot_capture_sync(fd, snapshots, ncpus, NULL, NULL);
+        if (status < 0) {
+            fprintf(stderr, "ioctl(RAMINDEX_SYNC_DUMP) failed with code %d : %s\n",
+                errno, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        ramindex_wss_begin_round(report, snapshots[0].timestamp);
+        for (n = 0; n < ncpus; n++) {
+            ramindex_wss_account(report, &snapshots[n]);
+            if (output && ramindex_snapshot_write(output, &snapshots[n]) < 0) {
+                fprintf(stderr, "Cannot write snapshot: %s\n", strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        if (every > 0 && report->nrounds % every == 0) {
+            ramindex_wss_print(report);
+            ramindex_wss_refresh(report);
+        }
+    }
+
+    for (n = 0; n < ncpus; n++)
+        ramindex_snapshot_free(&snapshots[n]);
+    free(snapshots);
+    close(fd);
+}
+
+/**
+ * Snapshots come in rounds, one snapshot per cpu (as written by -o).
+ * A new round starts with a snapshot of a cpu already seen in the current round.
+ */
+static void ramindex_wss_read(struct ramindex_wss_report *report, const char *filename, int every)
+{
+    struct ramindex_snapshot snapshot;
+    int round_cpus[MAX_CPUS];
+    int nround_cpus = 0;
+    FILE *stream;
+    int status = 0;
+    int n;
+
+    stream = fopen(filename, "rb");
+    if (stream == NULL) {
+        fprintf(stderr, "Cannot open '%s': %s\n", filename, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    while (!ramindex_wss_stop && (status = ramindex_snapshot_read(stream, &snapshot)) > 0) {
+        if (report->linesize == 0)
+            report->linesize = snapshot.ccsidr.linesize;
+        else if (report->linesize != (uint32_t)snapshot.ccsidr.linesize) {
+            fprintf(stderr, "'%s' contains snapshot of a different cache\n", filename);
+            exit(EXIT_FAILURE);
+        }
+
+        for (n = 0; n < nround_cpus; n++)
+            if (round_cpus[n] == snapshot.cpu)
+                break;
+        if (n < nround_cpus || nround_cpus == 0 || nround_cpus == MAX_CPUS) {
+            if (every > 0 && report->nrounds && report->nrounds % every == 0)
+                ramindex_wss_print(report);
+            ramindex_wss_begin_round(report, snapshot.timestamp);
+            nround_cpus = 0;
+        }
+        round_cpus[nround_cpus++] = snapshot.cpu;
+
+        ramindex_wss_account(report, &snapshot);
+        ramindex_snapshot_free(&snapshot);
+    }
+
+    if (status < 0) {
+        fprintf(stderr, "Cannot read snapshot from '%s': %s\n", filename, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    fclose(stream);
+}
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int main(int argc, char *argv[])
+{
+    int c;
+    int i;
+    int status;
+    size_t n;
+    FILE *output = NULL;
+    struct ramindex_wss_report *report;
+    // cmdline options
+    int cpus[MAX_CPUS];
+    int ncpus = 0;
+    int level = 2;
+    int rounds = 0;
+    int interval = 100000;
+    uint32_t window = 64;
+    int every = 0;
+    const char *filename = NULL;
+
+    static struct option long_options[] = {
+        {"help",     no_argument,       0, 'h'},
+        {"version",  no_argument,       0, 'v'},
+        {"cpus",     required_argument, 0, 'c'},
+        {"level",    required_argument, 0, 'l'},
+        {"rounds",   required_argument, 0, 'n'},
+        {"interval", required_argument, 0, 'i'},
+        {"window",   required_argument, 0, 'w'},
+        {"report",   required_argument, 0, 'r'},
+        {"output",   required_argument, 0, 'o'},
+        {"pid",      required_argument, 0, 'p'},
+        {0, 0, 0, 0}
+    };
+
+    report = ramindex_wss_calloc(1, sizeof(*report));
+
+    for (;;) {
+        c = getopt_long(argc, argv, "hvc:l:n:i:w:r:o:p:", long_options, 0);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'h':
+                ramindex_wss_print_usage(argv[0]);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'v':
+                fprintf(stdout, "%s (this program) version: %s\n", argv[0], PROJECT_VER);
+                exit(EXIT_SUCCESS);
+                break;
+
+            case 'c':
+                ncpus = ramindex_parse_cpus(optarg, cpus, MAX_CPUS);
+                if (ncpus <= 0) {
+                    fprintf(stderr, "Invalid list of cpus '%s' (at most %d cpus)\n",
+                        optarg, MAX_CPUS);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'l':
+                level = atoi(optarg);
+                break;
+
+            case 'n':
+                rounds = atoi(optarg);
+                break;
+
+            case 'i':
+                interval = atoi(optarg);
+                break;
+
+            case 'w':
+                window = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'r':
+                every = atoi(optarg);
+                break;
+
+            case 'o':
+                filename = optarg;
+                break;
+
+            case 'p':
+                if (report->nprocesses == MAX_PIDS) {
+                    fprintf(stderr, "At most %d processes can be selected\n", MAX_PIDS);
+                    exit(EXIT_FAILURE);
+                }
+                status = ramindex_pagemap_read(atoi(optarg), 0, UINT64_MAX,
+                    &report->pagemaps[report->nprocesses]);
+                if (status < 0) {
+                    fprintf(stderr, "Cannot read pagemap of process %s: %s\n",
+                        optarg, strerror(errno));
+                    exit(EXIT_FAILURE);
+                }
+                report->nprocesses++;
+                break;
+
+            default:
+                ramindex_wss_print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if ((ncpus == 0) == (optind >= argc) || level <= 0 || rounds < 0 ||
+        window < 2 || window > (1u << (MAX_WINDOWS - 1))) {
+        ramindex_wss_print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    for (report->window = 2; report->window < window; report->window <<= 1)
+        ;
+    report->occupancy = ramindex_wss_calloc((size_t)(report->window + 1) * (MAX_PIDS + 1),
+        sizeof(*report->occupancy));
+    report->ages = ramindex_wss_calloc((size_t)report->window * (MAX_PIDS + 1), sizeof(*report->ages));
+    report->runs = ramindex_wss_calloc((size_t)report->window * (MAX_PIDS + 1), sizeof(*report->runs));
+
+    signal(SIGINT, ramindex_wss_signal);
+    signal(SIGTERM, ramindex_wss_signal);
+
+    if (ncpus > 0) {
+        if (filename) {
+            output = fopen(filename, "wb");
+            if (output == NULL) {
+                fprintf(stderr, "Cannot open '%s': %s\n", filename, strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+        }
+        ramindex_wss_capture(report, cpus, ncpus, level, rounds, interval, every, output);
+        if (output)
+            fclose(output);
+    } else {
+        for (i = optind; i < argc; i++)
+            ramindex_wss_read(report, argv[i], every);
+    }
+
+    if (report->nrounds == 0) {
+        fprintf(stderr, "No snapshots found\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (report->printed != report->nrounds)
+        ramindex_wss_print(report);
+
+    for (n = 0; n < report->nprocesses; n++)
+        ramindex_pagemap_free(&report->pagemaps[n]);
+    free(report->lines);
+    free(report->occupancy);
+    free(report->ages);
+    free(report->runs);
+    free(report);
+
+    return 0;
+}
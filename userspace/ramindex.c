@@ -21,6 +21,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <getopt.h>
+#include <sched.h>
 
 #include <sys/ioctl.h>
 
@@ -29,6 +30,7 @@
 \*===========================================================================*/
 #include <version.h>
 #include "../ramindex.h"
+#include "ramindex-snapshot.h"
 
 /*===========================================================================*\
  * preprocessor #define constants and macros
@@ -61,6 +63,20 @@ static void ramindex_print_usage(const char* progname)
     fprintf(stdout, "\t                 0 for data and unified caches, default: 0)\n");
     fprintf(stdout, "\t-s, --set      select cache set (default: -1, all sets)\n");
     fprintf(stdout, "\t-w, --way      select cache way (default: -1, all ways)\n");
+    fprintf(stdout, "\t-c, --cpu      dump caches of that cpu (default: -1, any cpu)\n");
+    fprintf(stdout, "\t-o, --output   write binary snapshot to a file instead of\n");
+    fprintf(stdout, "\t                 printing it (see ramindex-colour)\n");
+    fprintf(stdout, "\t-T, --tags     dump only tags (and state) of the lines\n");
+    fprintf(stdout, "\t-C, --chunk    dump that many sets per ioctl, printed lines\n");
+    fprintf(stdout, "\t                 are streamed out chunk by chunk (default: 0, all at once)\n");
+    fprintf(stdout, "\t-q, --quiet    low perturbation capture - tags of the whole cache (way)\n");
+    fprintf(stdout, "\t                 are read at once by a minimal loop, selected sets\n");
+    fprintf(stdout, "\t                 (-s, -C for a range of them) are read first\n");
+    fprintf(stdout, "\t-V, --victim-last  read selected sets last in low perturbation capture\n");
+    fprintf(stdout, "\t-P, --pmu      read PMU counters of the listed events (or \"all\" of them)\n");
+    fprintf(stdout, "\t                 right before and after the dump, events: cycles,\n");
+    fprintf(stdout, "\t                 instructions, l1d-refill, l1i-refill, l2d-refill,\n");
+    fprintf(stdout, "\t                 l1d-wb, l2d-wb\n");
 }
 
 static void ramindex_print_versions(void)
@@ -175,27 +191,67 @@ static int ramindex_get_clid(int fd, struct ramindex_clid* clid)
     return n;
 }
 
+static void ramindex_dump_chunks(int fd, int set, int way, int chunk,
+    const struct ramindex_ccsidr *ccsidr, struct ramindex_snapshot *snapshot, int print)
+{
+    int status;
+    int start, n;
+
+    /* a single set or all of them at once, unless dumping in chunks was requested */
+    start = set;
+    n = 0;
+    if (chunk > 0 && set < 0) {
+        start = 0;
+        n = chunk;
+    }
+
+    do {
+        if (start >= 0 && n > ccsidr->nsets - start)
+            n = ccsidr->nsets - start;
+
+        status = ramindex_snapshot_capture(fd, start, n, way, snapshot);
+        if (status < 0) {
+            fprintf(stderr, "ioctl(RAMINDEX_DUMP) failed with code %d : %s\n",
+                errno, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        /* printed lines are streamed out, written ones are gathered into one snapshot */
+        if (print) {
+            ramindex_snapshot_print(stdout, snapshot);
+            ramindex_snapshot_print_pmu(stdout, snapshot);
+            snapshot->nlines = 0;
+        }
+
+        start += n;
+    } while (n > 0 && start < ccsidr->nsets);
+}
+
 /*===========================================================================*\
  * global (external linkage) functions definitions
 \*===========================================================================*/
 int main(int argc, char *argv[])
 {
-    int i;
     int fd;
     int c;
     int status;
-    int ncachelines;
-    unsigned n, m;
-    char *buf;
+    FILE *output = NULL;
     struct ramindex_clid clid;
     struct ramindex_ccsidr ccsidr;
-    struct ramindex_cacheline *cachelines;
-    struct ramindex_selector selector;
+    struct ramindex_snapshot snapshot;
     // cmdline options
     int level = 1;
     int type = 0;
     int set = -1;
     int way = -1;
+    int cpu = -1;
+    int tags = 0;
+    int chunk = 0;
+    int quiet = 0;
+    int victim_last = 0;
+    uint32_t npolluted;
+    const char *filename = NULL;
+    int64_t pmu_events = 0;
 
     static struct option long_options[] = {
         {"help",    no_argument,       0, 'h'},
@@ -204,11 +260,18 @@ int main(int argc, char *argv[])
         {"type",    required_argument, 0, 't'},
         {"set",     required_argument, 0, 's'},
         {"way",     required_argument, 0, 'w'},
+        {"cpu",     required_argument, 0, 'c'},
+        {"output",  required_argument, 0, 'o'},
+        {"tags",    no_argument,       0, 'T'},
+        {"chunk",   required_argument, 0, 'C'},
+        {"quiet",   no_argument,       0, 'q'},
+        {"victim-last", no_argument,   0, 'V'},
+        {"pmu",     required_argument, 0, 'P'},
         {0, 0, 0, 0}
     };
 
     for (;;) {
-        c = getopt_long(argc, argv, "hvl:t:s:w:", long_options, 0);
+        c = getopt_long(argc, argv, "hvl:t:s:w:c:o:TC:qVP:", long_options, 0);
         if (c == -1)
             break;
 
@@ -238,9 +301,50 @@ int main(int argc, char *argv[])
             case 'w':
                 way = atoi(optarg);
                 break;
+
+            case 'c':
+                cpu = atoi(optarg);
+                break;
+
+            case 'o':
+                filename = optarg;
+                break;
+
+            case 'T':
+                tags = 1;
+                break;
+
+            case 'C':
+                chunk = atoi(optarg);
+                break;
+
+            case 'q':
+                quiet = 1;
+                break;
+
+            case 'V':
+                victim_last = 1;
+                break;
+
+            case 'P':
+                pmu_events = ramindex_parse_pmu_events(optarg);
+                if (pmu_events <= 0) {
+                    fprintf(stderr, "Invalid list of PMU events '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
         }
     }
 
+    /* chunks of one snapshot shall be read on one cpu, the current one if none is selected */
+    if (cpu < 0 && chunk > 0 && set < 0)
+        cpu = sched_getcpu();
+
+    if (cpu >= 0 && ramindex_bind_cpu(cpu) < 0) {
+        fprintf(stderr, "Cannot bind to cpu %d: %s\n", cpu, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
     fd = open(RAMINDEX_DEVICENAME, O_RDWR);
     assert(fd >= -1);
     if (fd == -1) {
@@ -279,56 +383,49 @@ int main(int argc, char *argv[])
     fprintf(stdout, "Selected cache: L%d '%s' cache\n",
         level, type ? "instruction" : "data/unified");
 
-    ncachelines = ccsidr.nways * ccsidr.nsets;
-
-    buf = malloc(ncachelines * ccsidr.linesize);
-    if (buf == NULL) {
-        fprintf(stderr, "malloc(%d) failed\n", ncachelines * ccsidr.linesize);
-        exit(EXIT_FAILURE);
-    }
-
-    cachelines = calloc(ncachelines, sizeof(*cachelines));
-    if (cachelines == NULL) {
-        fprintf(stderr, "calloc(%d, %zu) failed\n",
-            ncachelines, sizeof(*cachelines));
-        exit(EXIT_FAILURE);
-    }
-
-    for (i = 0; i < ncachelines; i++) {
-        cachelines[i].linesize = ccsidr.linesize;
-        cachelines[i].linedata = buf + i * ccsidr.linesize;
-    }
-
-    memset(&selector, 0, sizeof(selector));
-    selector.level = level - 1;
-    selector.icache = type;
-    selector.set = set;
-    selector.way = way;
-    selector.nlines = ncachelines;
-    selector.lines = cachelines;
-
-    status = ioctl(fd, RAMINDEX_DUMP, &selector);
+    status = ramindex_snapshot_alloc(&snapshot, &ccsidr,
+        tags || quiet ? 0 : RAMINDEX_SNAPSHOT_F_DATA);
     if (status < 0) {
-        fprintf(stderr, "ioctl(RAMINDEX_DUMP) failed with code %d : %s\n",
-            errno, strerror(errno));
+        fprintf(stderr, "Cannot allocate snapshot of %d lines\n",
+            ccsidr.nways * ccsidr.nsets);
         exit(EXIT_FAILURE);
     }
+    snapshot.pmu_events = pmu_events;
+
+    if (quiet) {
+        status = ramindex_snapshot_capture_quiet(fd, set, set >= 0 ? chunk : 0, way,
+            victim_last, &snapshot, &npolluted);
+        if (status < 0 && errno == E2BIG) {
+            fprintf(stderr, "L%d cache has more than %d lines to be captured at once, "
+                "select a way (-w)\n", level, RAMINDEX_LOW_PERTURB_LINES_MAX);
+            exit(EXIT_FAILURE);
+        }
+        if (status < 0) {
+            fprintf(stderr, "ioctl(RAMINDEX_DUMP) failed with code %d : %s\n",
+                errno, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        if (!filename) {
+            ramindex_snapshot_print(stdout, &snapshot);
+            ramindex_snapshot_print_pmu(stdout, &snapshot);
+        }
+        fprintf(stdout, "Lines holding the capture's own footprint: %u\n", npolluted);
+    } else {
+        ramindex_dump_chunks(fd, set, way, chunk, &ccsidr, &snapshot, filename == NULL);
+    }
 
-    for (n = 0; n < selector.nlines; n++) {
-        const struct ramindex_cacheline *l = &selector.lines[n];
-        const char *ld = (const char *)l->linedata;
-        fprintf(stdout, "SET:%04d WAY:%02d V:%d D:%d NS:%d TAG:%012llx DATA[0:%u] ",
-            l->set, l->way, l->valid, l->dirty, l->ns, l->tag, l->linesize - 1);
-        for (m = 0; m < l->linesize; m++) {
-            fprintf(stdout, "%02x", ld[m]);
-            if ((m + 1) % 4 == 0)
-                fprintf(stdout, " ");
+    if (filename) {
+        output = fopen(filename, "wb");
+        if (output == NULL || ramindex_snapshot_write(output, &snapshot) < 0) {
+            fprintf(stderr, "Cannot write snapshot to '%s': %s\n",
+                filename, strerror(errno));
+            exit(EXIT_FAILURE);
         }
-        fprintf(stdout, "\n");
+        fclose(output);
+        ramindex_snapshot_print_pmu(stdout, &snapshot);
     }
 
-    free(buf);
-    free(cachelines);
+    ramindex_snapshot_free(&snapshot);
     close(fd);
 
     return 0;
@@ -0,0 +1,18 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file compiler.h
+ *
+ * Stand-in for the kernel's <linux/compiler.h>, so that headers of the module
+ * depending on nothing but types (ramindex-desc.h) build into userspace tests.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+#ifndef _RAMINDEX_TESTS_LINUX_COMPILER_H_
+#define _RAMINDEX_TESTS_LINUX_COMPILER_H_
+
+#ifndef __always_inline
+#define __always_inline inline __attribute__((__always_inline__))
+#endif
+
+#endif /* _RAMINDEX_TESTS_LINUX_COMPILER_H_ */
@@ -0,0 +1,37 @@
+# Page colours of a snapshot of known colour distribution (ramindex-colour)
+#
+# A 1024x4x64 L2 holds 16 colours of 64 sets each (4 KiB pages). The trace
+# touches 256 lines of colours 0 and 1, 200 lines of colour 2 and 24 lines
+# of colour 5, none of them evicted, so that the snapshot written by
+# ramindex-model holds 736 lines:
+#
+# - 4 of 16 colours are used,
+# - imbalance (max/mean) is 256 / (736 / 16) = 5.57,
+# - 3 colours hold 90% of the lines, which makes a partition of 4 colours.
+#
+# Expects MODEL, COLOUR and WORKDIR to be defined.
+
+include(${CMAKE_CURRENT_LIST_DIR}/ramindex-test.cmake)
+
+set(trace "")
+foreach(colour_lines 0:256 1:256 2:200 5:24)
+    string(REPLACE ":" ";" colour_lines ${colour_lines})
+    list(GET colour_lines 0 colour)
+    list(GET colour_lines 1 lines)
+    math(EXPR last "${lines} - 1")
+    foreach(i RANGE ${last})
+        # line i goes to way i / 64 (tag) and set i % 64 of the colour
+        math(EXPR address "0x10000000 + (${i} / 64) * 0x10000 + ${colour} * 0x1000 + (${i} % 64) * 64"
+            OUTPUT_FORMAT HEXADECIMAL)
+        string(APPEND trace "R ${address}\n")
+    endforeach()
+endforeach()
+file(WRITE ${WORKDIR}/colour.trace "${trace}")
+
+ramindex_test_run(output ${MODEL} -g 1024x4x64 -l 2 -o ${WORKDIR}/colour.snapshot ${WORKDIR}/colour.trace)
+ramindex_test_run(output ${COLOUR} -P 4096 ${WORKDIR}/colour.snapshot)
+
+ramindex_test_expect("${output}" "colours: 16 \\(64 sets per colour\\)")
+ramindex_test_expect("${output}" "\n     5       24        0 ")
+ramindex_test_expect("${output}" "All lines: 736, colours used: 4/16, imbalance \\(max/mean\\): 5.57\n")
+ramindex_test_expect("${output}" "Colours holding 90% of lines: 3 \\(recommended partition: 4\\)\n")
@@ -0,0 +1,25 @@
+# Snapshots written by ramindex-model for a known trace (golden output)
+#
+# ramindex-model.trace replays into a 4x2x64 LRU L1 D$ a mix of lackey and
+# R/W/X records: a modify evicting a clean line, a write spanning two lines,
+# a hit refreshing a dirty line and a load evicting (writing back) another
+# dirty one, while fetches and lackey comments are left out. A snapshot is
+# taken after 5 records and one at the end (after 9 records), both shall
+# print exactly as in ramindex-model.golden.
+#
+# Expects MODEL and WORKDIR to be defined.
+
+include(${CMAKE_CURRENT_LIST_DIR}/ramindex-test.cmake)
+
+ramindex_test_run(output ${MODEL} -g 4x2x64 -l 1 -i 5 ${CMAKE_CURRENT_LIST_DIR}/ramindex-model.trace)
+
+file(READ ${CMAKE_CURRENT_LIST_DIR}/ramindex-model.golden golden)
+if(NOT output STREQUAL golden)
+    file(WRITE ${WORKDIR}/model.output "${output}")
+    message(FATAL_ERROR "Snapshots differ from ramindex-model.golden "
+        "(see ${WORKDIR}/model.output):\n${output}")
+endif()
+
+ramindex_test_expect("${output_ERROR}" "Records: 9 \\(3 other lines skipped\\)")
+ramindex_test_expect("${output_ERROR}" "Line accesses: 8, hits: 1 \\(12.50%\\), misses: 7\n")
+ramindex_test_expect("${output_ERROR}" "Evictions: 2, writebacks: 1\n")
@@ -0,0 +1,142 @@
+/* SPDX-License-Identifier: MIT */
+/**
+ * @file ramindex-neoverse-test.c
+ *
+ * Checks decoding of Neoverse N1/N2 tags (ramindex-neoverse-desc.h).
+ *
+ * Every vector is an IMP_*SIDE_DATA0_EL3 value as returned by the CPU
+ * service for a line of a known physical address, set and state, encoded
+ * by the layouts documented in the descriptors. Once the layouts have been
+ * confirmed against the reference manuals, vectors recorded on N1/N2 cores
+ * belong here as well.
+ *
+ * @author Lukasz Wiecaszek <lukasz.wiecaszek@gmail.com>
+ */
+
+/*===========================================================================*\
+ * system header files
+\*===========================================================================*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+/*===========================================================================*\
+ * project header files
+\*===========================================================================*/
+#include "../../ramindex-neoverse-desc.h"
+
+/*===========================================================================*\
+ * preprocessor #define constants and macros
+\*===========================================================================*/
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
+
+/*===========================================================================*\
+ * local types definitions
+\*===========================================================================*/
+
+/**
+ * struct ramindex_neoverse_vector - one tag register and its expected decoding
+ * @name:	what the vector checks
+ * @desc:	layout of the tag
+ * @set:	set the tag has been read from
+ * @way:	way the tag has been read from
+ * @data0:	IMP_*SIDE_DATA0_EL3
+ * @expected:	expected decoding
+ */
+struct ramindex_neoverse_vector {
+    const char *name;
+    const struct ramindex_tag_desc *desc;
+    int32_t set;
+    int32_t way;
+    uint64_t data0;
+    struct ramindex_line expected;
+};
+
+/*===========================================================================*\
+ * local (internal linkage) objects definitions
+\*===========================================================================*/
+static const struct ramindex_tag_desc ramindex_neoverse_l1i = RAMINDEX_NEOVERSE_L1I_TAG;
+static const struct ramindex_tag_desc ramindex_neoverse_l1d = RAMINDEX_NEOVERSE_L1D_TAG;
+static const struct ramindex_tag_desc ramindex_neoverse_l2u = RAMINDEX_NEOVERSE_L2U_TAG;
+
+/* expected lines are { set, way, valid, dirty, ns, state, tag } */
+static const struct ramindex_neoverse_vector ramindex_neoverse_vectors[] = {
+    { "L1I valid, non-secure", &ramindex_neoverse_l1i, 0x95, 2,
+        (1ULL << 29) | (1ULL << 28) | 0x812346,
+        { 0x95, 2, 1, 0, 1, CSTATE_SHARED_CLEAN, 0x812346540ULL } },
+    { "L1I invalid", &ramindex_neoverse_l1i, 0x95, 3,
+        0x812346,
+        { 0x95, 3, 0, 0, 0, CSTATE_INVALID, 0x812346540ULL } },
+    { "L1D invalid", &ramindex_neoverse_l1d, 0x01, 0,
+        (0xeccULL << 2) | 0x0,
+        { 0x01, 0, 0, 0, 0, CSTATE_INVALID, 0xecc040ULL } },
+    { "L1D unique clean", &ramindex_neoverse_l1d, 0x01, 1,
+        (0xeccULL << 2) | 0x1,
+        { 0x01, 1, 1, 0, 0, CSTATE_UNIQUE_CLEAN, 0xecc040ULL } },
+    { "L1D unique dirty, non-secure", &ramindex_neoverse_l1d, 0x01, 2,
+        (1ULL << 30) | (0xeccULL << 2) | 0x2,
+        { 0x01, 2, 1, 1, 1, CSTATE_UNIQUE_DIRTY, 0xecc040ULL } },
+    { "L1D shared clean", &ramindex_neoverse_l1d, 0x01, 3,
+        (0xeccULL << 2) | 0x3,
+        { 0x01, 3, 1, 0, 0, CSTATE_SHARED_CLEAN, 0xecc040ULL } },
+    { "L1D top of PA[39:12], last set", &ramindex_neoverse_l1d, 0xff, 3,
+        (0xfffffffULL << 2) | 0x2,
+        { 0xff, 3, 1, 1, 0, CSTATE_UNIQUE_DIRTY, 0xffffffffc0ULL } },
+    { "L2 shared dirty, non-secure, set above 512", &ramindex_neoverse_l2u, 0x59f, 5,
+        (0xfe2468aULL << 4) | (1ULL << 3) | 0x4,
+        { 0x59f, 5, 1, 1, 1, CSTATE_SHARED_DIRTY, 0x7f1234567c0ULL } },
+    { "L2 unique dirty, set 0", &ramindex_neoverse_l2u, 0x000, 7,
+        (0x80ULL << 4) | 0x3,
+        { 0x000, 7, 1, 1, 0, CSTATE_UNIQUE_DIRTY, 0x400000ULL } },
+    { "L2 shared clean, top of PA[47:15]", &ramindex_neoverse_l2u, 0x7ff, 0,
+        (0x1ffffffffULL << 4) | 0x1,
+        { 0x7ff, 0, 1, 0, 0, CSTATE_SHARED_CLEAN, 0xffffffffffc0ULL } },
+    { "L2 reserved state", &ramindex_neoverse_l2u, 0x000, 1,
+        (0x80ULL << 4) | 0x5,
+        { 0x000, 1, 1, 0, 0, CSTATE_UNKNOWN, 0x400000ULL } },
+};
+
+/*===========================================================================*\
+ * global (external linkage) objects definitions
+\*===========================================================================*/
+
+/*===========================================================================*\
+ * local (internal linkage) functions definitions
+\*===========================================================================*/
+static int ramindex_neoverse_check(const struct ramindex_neoverse_vector *v)
+{
+    struct ramindex_line l = { 0 };
+    const struct ramindex_line *e = &v->expected;
+    __u64 r[1] = { v->data0 };
+
+    ramindex_decode_tag(v->desc, v->set, v->way, r, &l);
+
+    if (l.set == e->set && l.way == e->way && l.valid == e->valid && l.dirty == e->dirty &&
+        l.ns == e->ns && l.state == e->state && l.tag == e->tag)
+        return 0;
+
+    fprintf(stderr, "FAIL %s (DATA0 0x%016llx)\n", v->name, (unsigned long long)v->data0);
+    fprintf(stderr, "    expected SET:%04x WAY:%02x V:%d D:%d NS:%d ST:%d TAG:%012llx\n",
+        e->set, e->way, e->valid, e->dirty, e->ns, e->state, (unsigned long long)e->tag);
+    fprintf(stderr, "    decoded  SET:%04x WAY:%02x V:%d D:%d NS:%d ST:%d TAG:%012llx\n",
+        l.set, l.way, l.valid, l.dirty, l.ns, l.state, (unsigned long long)l.tag);
+
+    return -1;
+}
+
+/*===========================================================================*\
+ * global (external linkage) functions definitions
+\*===========================================================================*/
+int main(void)
+{
+    size_t n, nfailed = 0;
+
+    for (n = 0; n < ARRAY_SIZE(ramindex_neoverse_vectors); n++)
+        if (ramindex_neoverse_check(&ramindex_neoverse_vectors[n]))
+            nfailed++;
+
+    fprintf(stdout, "%zu of %zu vectors decoded as expected\n",
+        ARRAY_SIZE(ramindex_neoverse_vectors) - nfailed, ARRAY_SIZE(ramindex_neoverse_vectors));
+
+    return nfailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,21 @@
+# Helpers of the tests running the tools (include()d by 'cmake -P' test scripts)
+
+# Runs a tool and stores its standard output in 'output' (and its standard error
+# in 'output'_ERROR), fails the test if the tool fails
+function(ramindex_test_run output)
+    execute_process(COMMAND ${ARGN}
+        RESULT_VARIABLE result OUTPUT_VARIABLE out ERROR_VARIABLE err)
+    if(NOT result EQUAL 0)
+        string(REPLACE ";" " " command "${ARGN}")
+        message(FATAL_ERROR "'${command}' failed (${result}):\n${err}")
+    endif()
+    set(${output} "${out}" PARENT_SCOPE)
+    set(${output}_ERROR "${err}" PARENT_SCOPE)
+endfunction()
+
+# Fails the test unless 'output' matches 'regex'
+function(ramindex_test_expect output regex)
+    if(NOT output MATCHES "${regex}")
+        message(FATAL_ERROR "Expected '${regex}' in:\n${output}")
+    endif()
+endfunction()
@@ -0,0 +1,66 @@
+# Working set and miss rate curve of a trace of known working set (ramindex-wss)
+#
+# Every round of 600 records reads the next 400 lines of a loop over 1500
+# lines and writes 200 lines never seen before. ramindex-model replays the
+# trace through a 512x8x64 (4096 lines) LRU cache and takes a snapshot every
+# round. The loop stays resident (its lines are reused within 2250 lines),
+# so once the cache is full every round:
+#
+# - holds 4096 lines, WSS(1),
+# - misses on the 200 new lines only, (WSS(2W) - WSS(W)) / W for W = 1, 2.
+#
+# The estimate shall be within 5% of that.
+#
+# Expects MODEL, WSS and WORKDIR to be defined.
+
+include(${CMAKE_CURRENT_LIST_DIR}/ramindex-test.cmake)
+
+set(rounds 24)
+set(loop 1500)
+set(reads 400)
+set(writes 200)
+set(misses_per_round 200)
+set(tolerance_percent 5)
+
+set(trace "")
+set(hot 0)
+set(new 0)
+math(EXPR last_round "${rounds} - 1")
+math(EXPR last_read "${reads} - 1")
+math(EXPR last_write "${writes} - 1")
+foreach(round RANGE ${last_round})
+    foreach(i RANGE ${last_read})
+        math(EXPR address "0x10000000 + (${hot} % ${loop}) * 64" OUTPUT_FORMAT HEXADECIMAL)
+        string(APPEND trace "R ${address}\n")
+        math(EXPR hot "${hot} + 1")
+    endforeach()
+    foreach(i RANGE ${last_write})
+        math(EXPR address "0x40000000 + ${new} * 64" OUTPUT_FORMAT HEXADECIMAL)
+        string(APPEND trace "W ${address}\n")
+        math(EXPR new "${new} + 1")
+    endforeach()
+endforeach()
+file(WRITE ${WORKDIR}/wss.trace "${trace}")
+
+math(EXPR interval "${reads} + ${writes}")
+ramindex_test_run(output ${MODEL} -g 512x8x64 -l 2 -i ${interval} -o ${WORKDIR}/wss.snapshot ${WORKDIR}/wss.trace)
+ramindex_test_run(output ${WSS} -w 8 ${WORKDIR}/wss.snapshot)
+
+ramindex_test_expect("${output}" "Round ${rounds},")
+ramindex_test_expect("${output}" "\nall +1 +4096 ")
+
+# misses per round are compared in tenths (as printed)
+math(EXPR limit "${misses_per_round} * 10 * ${tolerance_percent} / 100")
+foreach(window 1 2)
+    if(NOT output MATCHES "\n(all)? +${window} +[0-9]+ +[0-9.]+ +[0-9.]+% +([0-9]+)\\.([0-9])\n")
+        message(FATAL_ERROR "No miss rate of window ${window} in:\n${output}")
+    endif()
+    math(EXPR error "${CMAKE_MATCH_2} * 10 + ${CMAKE_MATCH_3} - ${misses_per_round} * 10")
+    if(error LESS 0)
+        math(EXPR error "-(${error})")
+    endif()
+    if(error GREATER limit)
+        message(FATAL_ERROR "Miss rate of window ${window} is ${CMAKE_MATCH_2}.${CMAKE_MATCH_3}, "
+            "expected ${misses_per_round} +/- ${tolerance_percent}%:\n${output}")
+    endif()
+endforeach()